@@ -3,17 +3,23 @@
 #include "bench.h"
 #include "vosimlib/tables.h"
 #include "vosimlib/DSPMath.h"
+#include "vosimlib/FastMath.h"
 #include "vosimlib/IntMap.h"
 #include "vosimlib/Unit.h"
 #include "vosimlib/Circuit.h"
+#include "vosimlib/WorkerPool.h"
+#include "vosimlib/CircuitFile.h"
+#include "vosimlib/MemoryPool.h"
 
 #include <array>
 #include <algorithm>
+#include <cstdio>
+#include <memory>
 #include <random>
 
 std::random_device RandomDevice;
 
-NONIUS_BENCHMARK("[lut][sin] lut_sin_table.getraw", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[lut][sin] lut_sin_table.getraw", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     std::vector<int> phases(runs);
     const auto& lut_sin_table = syn::lut_sin_table();
@@ -22,7 +28,7 @@ NONIUS_BENCHMARK("[lut][sin] lut_sin_table.getraw", [](nonius::chronometer& mete
     meter.measure([&x, &phases, &lut_sin_table](int i) { x = lut_sin_table[phases[i]]; });
 })
 
-NONIUS_BENCHMARK("[lut][sin] lut_sin_table.lerp", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[lut][sin] lut_sin_table.lerp", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     std::vector<double> phases(runs);
     const auto& lut_sin_table = syn::lut_sin_table();
@@ -31,7 +37,7 @@ NONIUS_BENCHMARK("[lut][sin] lut_sin_table.lerp", [](nonius::chronometer& meter)
     meter.measure([&x, &phases, &lut_sin_table](int i) { x = lut_sin_table.lerp(phases[i]); });
 })
 
-NONIUS_BENCHMARK("[lut][sin] lut_sin_table.plerp", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[lut][sin] lut_sin_table.plerp", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     std::vector<double> phases(runs);
     const auto& lut_sin_table = syn::lut_sin_table();
@@ -80,15 +86,91 @@ NONIUS_BENCHMARK("[math][tanh] syn::fast_tanh_rat", [](nonius::chronometer& mete
     meter.measure([&x, &phases](int i) { x = syn::fast_tanh_rat<double>(phases[i]); });
 })
 
-NONIUS_BENCHMARK("[units][filters] LadderA", [](nonius::chronometer& meter) {
+/*
+ * Fast math approximations against the standard library, one at a time and over arrays
+ */
+
+NONIUS_BENCHMARK("[math][tan] std::tan (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(0.0, 20e3 / 44.1e3, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = std::tan(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][tan] syn::fast_tan (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(0.0, 20e3 / 44.1e3, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::fast_tan(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[math][tan] syn::fast_tan (array, 64 samples)", [](nonius::chronometer& meter) {
+    std::vector<syn::SampleType> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(0.0, 20e3 / 44.1e3, i / 64.0);
+    meter.measure([&phases, &out](int) { syn::fast_tan(phases.data(), out.data(), 64); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][exp] std::exp2 (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-100.0, 100.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = std::exp2(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][exp] syn::fast_exp2 (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-100.0, 100.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::fast_exp2(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[math][exp] syn::fast_exp2 (array, 64 samples)", [](nonius::chronometer& meter) {
+    std::vector<syn::SampleType> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-100.0, 100.0, i / 64.0);
+    meter.measure([&phases, &out](int) { syn::fast_exp2(phases.data(), out.data(), 64); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][log] std::log2 (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(1e-3, 1e3, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = std::log2(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][log] syn::fast_log2 (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(1e-3, 1e3, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::fast_log2(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[math][log] syn::fast_log2 (array, 64 samples)", [](nonius::chronometer& meter) {
+    std::vector<syn::SampleType> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(1e-3, 1e3, i / 64.0);
+    meter.measure([&phases, &out](int) { syn::fast_log2(phases.data(), out.data(), 64); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][tanh] std::tanh (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-10.0, 10.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = std::tanh(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][tanh] syn::fast_tanh (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-10.0, 10.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::fast_tanh(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[math][tanh] syn::fast_tanh (array, 64 samples)", [](nonius::chronometer& meter) {
+    std::vector<syn::SampleType> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-10.0, 10.0, i / 64.0);
+    meter.measure([&phases, &out](int) { syn::fast_tanh(phases.data(), out.data(), 64); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderA", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::LadderFilterA ladder("");
-    double input = 1.0;
+    syn::SampleType input = 1.0;
     ladder.setFs(48000.0);
     ladder.setParam(syn::LadderFilterA::pFc, 10000.0);
     ladder.setParam(syn::LadderFilterA::pFb, 0.0);
     ladder.setParam(syn::LadderFilterA::pDrv, 0.0);
-    ladder.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    ladder.connectInput(0, syn::ReadOnlyBuffer<syn::SampleType>{ &input });
 
     double x;
     meter.measure([&x, &ladder](int i)
@@ -99,15 +181,15 @@ NONIUS_BENCHMARK("[units][filters] LadderA", [](nonius::chronometer& meter) {
     });
 })
 
-NONIUS_BENCHMARK("[units][filters] LadderB", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderB", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::LadderFilterB ladder("");
-    double input = 1.0;
+    syn::SampleType input = 1.0;
     ladder.setFs(48000.0);
     ladder.setParam(syn::LadderFilterA::pFc, 10000.0);
     ladder.setParam(syn::LadderFilterA::pFb, 0.0);
     ladder.setParam(syn::LadderFilterA::pDrv, 0.0);
-    ladder.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    ladder.connectInput(0, syn::ReadOnlyBuffer<syn::SampleType>{ &input });
 
     double x;
     meter.measure([&x, &ladder](int i)
@@ -118,14 +200,79 @@ NONIUS_BENCHMARK("[units][filters] LadderB", [](nonius::chronometer& meter) {
     });
 })
 
-NONIUS_BENCHMARK("[units][filters] SVF", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderB (ADAA)", [](nonius::chronometer& meter) {
+    syn::LadderFilterB ladder("");
+    syn::SampleType input = 1.0;
+    syn::ReadOnlyBuffer<syn::SampleType> inputSrc{ &input };
+    ladder.setFs(48000.0);
+    ladder.setParam(syn::LadderFilterB::pFc, 10000.0);
+    ladder.setParam(syn::LadderFilterB::pFb, 0.0);
+    ladder.setParam(syn::LadderFilterB::pDrv, 0.0);
+    ladder.setParam(syn::LadderFilterB::pMode, syn::LadderFilterB::ModeAdaa);
+    ladder.connectInput(syn::LadderFilterB::iAudioIn, inputSrc);
+
+    double x;
+    meter.measure([&x, &ladder](int)
+    {
+        ladder.tick();
+        x = ladder.readOutput(0,0);
+        return x;
+    });
+})
+
+/**
+ * Renders 16 voices of an oscillator into a_filter, with the voices processed a_numLanes at a time.
+ */
+static void measureFilterVoices(nonius::chronometer& meter, syn::Unit* a_filter, int a_numLanes) {
+    syn::VoiceManager vm;
+    syn::Circuit mycircuit = makeFilterCircuit(a_filter);
+    vm.setNumLanes(a_numLanes);
+    vm.setPrototypeCircuit(mycircuit);
+    vm.setFs(48e3);
+    vm.setMaxVoices(16);
+    vm.setBufferSize(64);
+    vm.setInternalBufferSize(64);
+    for (int i = 0; i < 16; i++)
+        vm.noteOn(48 + i, 127);
+
+    std::vector<syn::SampleType> leftIn(64, 0), rightIn(64, 0);
+    std::vector<syn::SampleType> leftOut(64, 0), rightOut(64, 0);
+    meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int)
+    {
+        vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
+    });
+}
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderA (Voices: 16, Buffer Size: 64, Lanes: 1)", [](nonius::chronometer& meter) {
+    measureFilterVoices(meter, new syn::LadderFilterA("ladder"), 1);
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderA (Voices: 16, Buffer Size: 64, Lanes: 4)", [](nonius::chronometer& meter) {
+    measureFilterVoices(meter, new syn::LadderFilterA("ladder"), 4);
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderB (Voices: 16, Buffer Size: 64, Lanes: 1)", [](nonius::chronometer& meter) {
+    measureFilterVoices(meter, new syn::LadderFilterB("ladder"), 1);
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderB (Voices: 16, Buffer Size: 64, Lanes: 4)", [](nonius::chronometer& meter) {
+    measureFilterVoices(meter, new syn::LadderFilterB("ladder"), 4);
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] LadderB (ADAA, Voices: 16, Buffer Size: 64, Lanes: 4)", [](nonius::chronometer& meter) {
+    auto* ladder = new syn::LadderFilterB("ladder");
+    ladder->setParam(syn::LadderFilterB::pMode, syn::LadderFilterB::ModeAdaa);
+    measureFilterVoices(meter, ladder, 4);
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] SVF", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::StateVariableFilter svf("");
-    double input = 1.0;
+    syn::SampleType input = 1.0;
     svf.setFs(48000.0);
     svf.setParam(0, 10000.0);
     svf.setParam(1, 0.0);
-    svf.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    svf.connectInput(0, syn::ReadOnlyBuffer<syn::SampleType>{ &input });
 
     double x;
     meter.measure([&x, &svf](int i)
@@ -136,14 +283,33 @@ NONIUS_BENCHMARK("[units][filters] SVF", [](nonius::chronometer& meter) {
     });
 })
 
-NONIUS_BENCHMARK("[units][filters] TSVF", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] SVF (Chamberlin)", [](nonius::chronometer& meter) {
+    syn::StateVariableFilter svf("");
+    syn::SampleType input = 1.0;
+    syn::ReadOnlyBuffer<syn::SampleType> inputSrc{ &input };
+    svf.setFs(48000.0);
+    svf.setParam(syn::StateVariableFilter::pFc, 10000.0);
+    svf.setParam(syn::StateVariableFilter::pRes, 0.0);
+    svf.setParam(syn::StateVariableFilter::pMode, syn::StateVariableFilter::ModeChamberlin);
+    svf.connectInput(syn::StateVariableFilter::iAudioIn, inputSrc);
+
+    double x;
+    meter.measure([&x, &svf](int)
+    {
+        svf.tick();
+        x = svf.readOutput(0,0);
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] TSVF", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::TrapStateVariableFilter tsvf("");
-    double input = 1.0;
+    syn::SampleType input = 1.0;
     tsvf.setFs(48000.0);
     tsvf.setParam(0, 10000.0);
     tsvf.setParam(1, 0.0);
-    tsvf.connectInput(0, syn::ReadOnlyBuffer<double>{ &input });
+    tsvf.connectInput(0, syn::ReadOnlyBuffer<syn::SampleType>{ &input });
 
     double x;
     meter.measure([&x, &tsvf](int i)
@@ -154,7 +320,31 @@ NONIUS_BENCHMARK("[units][filters] TSVF", [](nonius::chronometer& meter) {
     });
 })
 
-NONIUS_BENCHMARK("[units][buffer size] Circuit (Buffer Size: 1)", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][filters] TSVF (Buffer Size: 64, Modulated fc)", [](nonius::chronometer& meter) {
+    const int bufSize = 64;
+    syn::TrapStateVariableFilter tsvf("");
+    std::vector<syn::SampleType> input(bufSize), fcMul(bufSize);
+    for (int i = 0; i < bufSize; i++) {
+        input[i] = (i % 16) / 8.0 - 1.0;
+        fcMul[i] = 0.5 + 0.5 * i / bufSize;
+    }
+    syn::ReadOnlyBuffer<syn::SampleType> inputSrc{ input.data() }, fcMulSrc{ fcMul.data() };
+    tsvf.setFs(48000.0);
+    tsvf.setBufferSize(bufSize);
+    tsvf.setParam(0, 10000.0);
+    tsvf.connectInput(syn::TrapStateVariableFilter::iAudioIn, inputSrc);
+    tsvf.connectInput(syn::TrapStateVariableFilter::iFcMul, fcMulSrc);
+
+    double x;
+    meter.measure([&x, &tsvf](int)
+    {
+        tsvf.tick();
+        x = tsvf.readOutput(0,0);
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][buffer size] Circuit (Buffer Size: 1)", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::Circuit mycircuit = makeTestCircuit();
     mycircuit.setFs(48000.0);
@@ -172,7 +362,7 @@ NONIUS_BENCHMARK("[units][buffer size] Circuit (Buffer Size: 1)", [](nonius::chr
     });
 })
 
-NONIUS_BENCHMARK("[units][buffer size] Circuit (Buffer Size: 200)", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][buffer size] Circuit (Buffer Size: 200)", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::Circuit mycircuit = makeTestCircuit();
     mycircuit.noteOn(60, 127);
@@ -188,7 +378,132 @@ NONIUS_BENCHMARK("[units][buffer size] Circuit (Buffer Size: 200)", [](nonius::c
     });
 })
 
-NONIUS_BENCHMARK("[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size: 1)", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][oversampling] Circuit (Buffer Size: 200, Oversampling: 4x)", [](nonius::chronometer& meter) {
+    const int runs = meter.runs();
+    syn::Circuit mycircuit = makeTestCircuit();
+    mycircuit.setParam(syn::Circuit::pOversampling, 2);
+    mycircuit.noteOn(60, 127);
+    mycircuit.setFs(48000.0);
+    mycircuit.setBufferSize(200);
+
+    double x;
+    meter.measure([&x, &mycircuit](int)
+    {
+        mycircuit.tick();
+        x = mycircuit.readOutput(0, 0);
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][parallel] Circuit (Buffer Size: 200, Threads: 4)", [](nonius::chronometer& meter) {
+    const int runs = meter.runs();
+    syn::WorkerPool pool(4);
+    syn::Circuit mycircuit = makeTestCircuit();
+    mycircuit.setWorkerPool(&pool);
+    mycircuit.noteOn(60, 127);
+    mycircuit.setFs(48000.0);
+    mycircuit.setBufferSize(200);
+
+    double x;
+    meter.measure([&x, &mycircuit](int)
+    {
+        mycircuit.tick();
+        x = mycircuit.readOutput(0, 0);
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][memory] Circuit (Buffer Size: 1, Units: heap)", [](nonius::chronometer& meter) {
+    // Units allocated one at a time as they were added, with other allocations in between
+    std::vector<std::unique_ptr<char[]>> clutter;
+    syn::Circuit mycircuit;
+    std::vector<int> ids;
+    for (int i = 0; i < 48; i++) {
+        ids.push_back(mycircuit.addUnit(new syn::OnePoleLPUnit));
+        clutter.emplace_back(new char[1024]);
+        if (i > 0)
+            mycircuit.connectInternal(ids[i - 1], 0, ids[i], 0);
+    }
+    mycircuit.connectInternal(ids.back(), 0, mycircuit.getOutputUnitId(), 0);
+    mycircuit.setFs(48000.0);
+    mycircuit.setBufferSize(1);
+
+    double x;
+    meter.measure([&x, &mycircuit](int)
+    {
+        for (int j = 0; j < 200; j++) {
+            mycircuit.tick();
+            x = mycircuit.readOutput(0, 0);
+        }
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][memory] Circuit (Buffer Size: 1, Units: arena)", [](nonius::chronometer& meter) {
+    // Same circuit, copied so that its units are stamped into one arena in execution order
+    std::vector<std::unique_ptr<char[]>> clutter;
+    syn::Circuit source;
+    std::vector<int> ids;
+    for (int i = 0; i < 48; i++) {
+        ids.push_back(source.addUnit(new syn::OnePoleLPUnit));
+        clutter.emplace_back(new char[1024]);
+        if (i > 0)
+            source.connectInternal(ids[i - 1], 0, ids[i], 0);
+    }
+    source.connectInternal(ids.back(), 0, source.getOutputUnitId(), 0);
+    syn::Circuit mycircuit(source);
+    mycircuit.setFs(48000.0);
+    mycircuit.setBufferSize(1);
+
+    double x;
+    meter.measure([&x, &mycircuit](int)
+    {
+        for (int j = 0; j < 200; j++) {
+            mycircuit.tick();
+            x = mycircuit.readOutput(0, 0);
+        }
+        return x;
+    });
+})
+
+NONIUS_BENCHMARK("[memory] new/delete (64 allocations, 16-16384 bytes)", [](nonius::chronometer& meter) {
+    std::mt19937 rng(1234);
+    std::array<size_t, 64> sizes;
+    for (size_t& size : sizes)
+        size = 16 << (rng() % 11);
+    std::array<char*, 64> ptrs;
+    meter.measure([&sizes, &ptrs](int)
+    {
+        for (int j = 0; j < 64; j++)
+            ptrs[j] = new char[sizes[j]];
+        for (int j = 0; j < 64; j += 2)
+            delete[] ptrs[j];
+        for (int j = 1; j < 64; j += 2)
+            delete[] ptrs[j];
+        return ptrs[0];
+    });
+})
+
+NONIUS_BENCHMARK("[memory] syn::MemoryPool (64 allocations, 16-16384 bytes)", [](nonius::chronometer& meter) {
+    std::mt19937 rng(1234);
+    std::array<size_t, 64> sizes;
+    for (size_t& size : sizes)
+        size = 16 << (rng() % 11);
+    std::array<void*, 64> ptrs;
+    syn::MemoryPool pool(1 << 20);
+    meter.measure([&sizes, &ptrs, &pool](int)
+    {
+        for (int j = 0; j < 64; j++)
+            ptrs[j] = pool.allocate(sizes[j]);
+        for (int j = 0; j < 64; j += 2)
+            pool.free(ptrs[j]);
+        for (int j = 1; j < 64; j += 2)
+            pool.free(ptrs[j]);
+        return ptrs[0];
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size: 1)", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     syn::VoiceManager vm;
     syn::Circuit mycircuit = makeTestCircuit();    
@@ -207,15 +522,15 @@ NONIUS_BENCHMARK("[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size
     vm.noteOn(66, 127);
     vm.noteOn(67, 127);
 
-    std::vector<double> leftIn(200,0), rightIn(200,0);
-    std::vector<double> leftOut(200,0), rightOut(200,0);
+    std::vector<syn::SampleType> leftIn(200,0), rightIn(200,0);
+    std::vector<syn::SampleType> leftOut(200,0), rightOut(200,0);
     meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int i)
     {
         vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
     });
 })
 
-NONIUS_BENCHMARK("[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size: 200)", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size: 200)", [](nonius::chronometer& meter) {
     const int runs = meter.runs();
     
     syn::VoiceManager vm;
@@ -235,15 +550,132 @@ NONIUS_BENCHMARK("[units][buffer size] syn::VoiceManager (Voices: 8, Buffer Size
     vm.noteOn(66, 127);
     vm.noteOn(67, 127);
 
-    std::vector<double> leftIn(200, 0), rightIn(200, 0);
-    std::vector<double> leftOut(200, 0), rightOut(200, 0);
+    std::vector<syn::SampleType> leftIn(200, 0), rightIn(200, 0);
+    std::vector<syn::SampleType> leftOut(200, 0), rightOut(200, 0);
     meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int i)
     {
         vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
     });
 })
 
-NONIUS_BENCHMARK("[math][mod] std::fmod", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][buffer size] syn::VoiceManager (Voices: 16, Buffer Size: 64)", [](nonius::chronometer& meter) {
+    syn::VoiceManager vm;
+    syn::Circuit mycircuit = makeTestCircuit();
+    vm.setPrototypeCircuit(mycircuit);
+    vm.setFs(48e3);
+    vm.setMaxVoices(16);
+    vm.setBufferSize(64);
+    vm.setInternalBufferSize(64);
+    // Trigger 16 voices
+    for (int i = 0; i < 16; i++)
+        vm.noteOn(60 + i, 127);
+
+    std::vector<syn::SampleType> leftIn(64, 0), rightIn(64, 0);
+    std::vector<syn::SampleType> leftOut(64, 0), rightOut(64, 0);
+    meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int)
+    {
+        vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][parallel] syn::VoiceManager (Voices: 16, Buffer Size: 64, Threads: 4)", [](nonius::chronometer& meter) {
+    syn::VoiceManager vm;
+    syn::Circuit mycircuit = makeTestCircuit();
+    vm.setNumThreads(4);
+    vm.setPrototypeCircuit(mycircuit);
+    vm.setFs(48e3);
+    vm.setMaxVoices(16);
+    vm.setBufferSize(64);
+    vm.setInternalBufferSize(64);
+    // Trigger 16 voices
+    for (int i = 0; i < 16; i++)
+        vm.noteOn(60 + i, 127);
+
+    std::vector<syn::SampleType> leftIn(64, 0), rightIn(64, 0);
+    std::vector<syn::SampleType> leftOut(64, 0), rightOut(64, 0);
+    meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int)
+    {
+        vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[units][lanes] syn::VoiceManager (Voices: 16, Buffer Size: 64, Lanes: 4)", [](nonius::chronometer& meter) {
+    syn::VoiceManager vm;
+    syn::Circuit mycircuit = makeTestCircuit();
+    vm.setNumLanes(4);
+    vm.setPrototypeCircuit(mycircuit);
+    vm.setFs(48e3);
+    vm.setMaxVoices(16);
+    vm.setBufferSize(64);
+    vm.setInternalBufferSize(64);
+    // Trigger 16 voices
+    for (int i = 0; i < 16; i++)
+        vm.noteOn(60 + i, 127);
+
+    std::vector<syn::SampleType> leftIn(64, 0), rightIn(64, 0);
+    std::vector<syn::SampleType> leftOut(64, 0), rightOut(64, 0);
+    meter.measure([&leftIn, &leftOut, &rightIn, &rightOut, &vm](int)
+    {
+        vm.tick(&leftIn.front(), &rightIn.front(), &leftOut.front(), &rightOut.front());
+    });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[voices] syn::VoiceManager note on/off (Voices: 256, all held)", [](nonius::chronometer& meter) {
+    syn::VoiceManager vm;
+    syn::Circuit mycircuit = makeTestCircuit();
+    vm.setPrototypeCircuit(mycircuit);
+    vm.setFs(48e3);
+    vm.setMaxVoices(256);
+    // Hold every voice, so that each note on steals one
+    for (int i = 0; i < 256; i++)
+        vm.noteOn(i % 128, 127);
+
+    meter.measure([&vm](int i)
+    {
+        vm.noteOn(i % 128, 127);
+        vm.noteOff((i + 64) % 128);
+    });
+})
+
+NONIUS_BENCHMARK("[serialization][json] save large patch", [](nonius::chronometer& meter) {
+    syn::Circuit mycircuit = makeLargeCircuit();
+    std::string str;
+    meter.measure([&str, &mycircuit]() { str = mycircuit.operator json().dump(); return str.size(); });
+})
+
+NONIUS_BENCHMARK("[serialization][json] load large patch", [](nonius::chronometer& meter) {
+    const std::string str = makeLargeCircuit().operator json().dump();
+    meter.measure([&str]() {
+        std::unique_ptr<syn::Unit> circuit(syn::Unit::fromJSON(json::parse(str)));
+        return circuit->numParams();
+    });
+})
+
+NONIUS_BENCHMARK("[serialization][binary] save large patch", [](nonius::chronometer& meter) {
+    syn::Circuit mycircuit = makeLargeCircuit();
+    std::vector<char> data;
+    meter.measure([&data, &mycircuit]() { data = syn::saveBinaryCircuit(mycircuit); return data.size(); });
+})
+
+NONIUS_BENCHMARK("[serialization][binary] load large patch", [](nonius::chronometer& meter) {
+    const std::vector<char> data = syn::saveBinaryCircuit(makeLargeCircuit());
+    meter.measure([&data]() {
+        std::unique_ptr<syn::Circuit> circuit(syn::loadBinaryCircuit(data.data(), data.size()));
+        return circuit->numParams();
+    });
+})
+
+NONIUS_BENCHMARK("[serialization][binary] load large patch (memory-mapped file)", [](nonius::chronometer& meter) {
+    const std::string path = "vosimlib_bench_circuit.bin";
+    syn::saveBinaryCircuitFile(makeLargeCircuit(), path);
+    meter.measure([&path]() {
+        std::unique_ptr<syn::Circuit> circuit(syn::loadBinaryCircuitFile(path));
+        return circuit->numParams();
+    });
+    std::remove(path.c_str());
+})
+
+NONIUS_BENCHMARK("[math][mod] std::fmod",[](nonius::chronometer& meter) {
     const int runs = meter.runs();
     std::vector<double> phases(runs);
     for (int i = 0; i < runs; i++) phases[i] = syn::LERP(-100.0, 100.0, i*1.0/runs);
@@ -267,7 +699,25 @@ NONIUS_BENCHMARK("[math][mod] syn::WRAP", [](nonius::chronometer& meter) {
     });
 })
 
-NONIUS_BENCHMARK("[lut][saw] band-limited saw", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK("[math][mod] syn::WRAP (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-100.0, 100.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::WRAP(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][mod] syn::fast_wrap (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-100.0, 100.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::fast_wrap(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[math][mod] syn::fast_wrap (array, 64 samples)", [](nonius::chronometer& meter) {
+    std::vector<syn::SampleType> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-100.0, 100.0, i / 64.0);
+    meter.measure([&phases, &out](int) { syn::fast_wrap(phases.data(), out.data(), 64); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[lut][saw] band-limited saw", [](nonius::chronometer& meter) {
     std::vector<double> periods(meter.runs());
     std::vector<double> phases(meter.runs());
     std::uniform_int_distribution<> _periodGenerator(2, syn::lut_bl_saw_table().m_size - 1);
@@ -294,7 +744,7 @@ NONIUS_BENCHMARK("[lut][saw] naive saw", [](nonius::chronometer& meter) {
     });
 })
 
-NONIUS_BENCHMARK("[lut][pitch] lut pitch2freq", [](nonius::chronometer& meter) {
+NONIUS_BENCHMARK(BENCH_PRECISION "[lut][pitch] lut pitch2freq", [](nonius::chronometer& meter) {
     int runs = meter.runs();
     std::vector<double> pitches(runs);
     for (int i = 0; i < runs; i++) pitches[i] = syn::LERP(-128.0, 128.0, i*1.0 / runs);
@@ -318,6 +768,24 @@ NONIUS_BENCHMARK("[lut][pitch] naive pitch2freq", [](nonius::chronometer& meter)
     });
 })
 
+NONIUS_BENCHMARK("[math][pitch] syn::naive_pitchToFreq (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-128.0, 128.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::naive_pitchToFreq(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK("[math][pitch] syn::fast_pitchToFreq (64 samples)", [](nonius::chronometer& meter) {
+    std::vector<double> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-128.0, 128.0, i / 64.0);
+    meter.measure([&phases, &out](int) { for (int j = 0; j < 64; j++) out[j] = syn::fast_pitchToFreq(phases[j]); return out[0]; });
+})
+
+NONIUS_BENCHMARK(BENCH_PRECISION "[math][pitch] syn::fast_pitchToFreq (array, 64 samples)", [](nonius::chronometer& meter) {
+    std::vector<syn::SampleType> phases(64), out(64);
+    for (int i = 0; i < 64; i++) phases[i] = syn::LERP(-128.0, 128.0, i / 64.0);
+    meter.measure([&phases, &out](int) { syn::fast_pitchToFreq(phases.data(), out.data(), 64); return out[0]; });
+})
+
 #define container_size 1024
 NONIUS_BENCHMARK("[container] syn::IntMap", [](nonius::chronometer& meter)
 {
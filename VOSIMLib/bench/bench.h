@@ -4,8 +4,16 @@
 #include "vosimlib/units/OscillatorUnit.h"
 #include "vosimlib/units/MidiUnits.h"
 #include "vosimlib/units/MathUnits.h"
+#include "vosimlib/UnitFactory.h"
 #include <vosimlib/lut_tables.h>
 
+/// Tag for benchmarks that depend on the sample type, so that float and double builds can be compared side by side
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+#define BENCH_PRECISION "[float]"
+#else
+#define BENCH_PRECISION "[double]"
+#endif
+
 inline syn::Circuit makeTestCircuit() {
     syn::lut_bl_tri_table();
     syn::lut_bl_saw_table();
@@ -42,3 +50,47 @@ inline syn::Circuit makeTestCircuit() {
     }
     return mycircuit;
 }
+
+/**
+ * Oscillator into a single filter, for measuring the filter's cost per voice. Takes ownership of a_filter.
+ */
+inline syn::Circuit makeFilterCircuit(syn::Unit* a_filter) {
+    syn::lut_bl_saw_table();
+
+    syn::Circuit mycircuit;
+    auto* mnu = new syn::MidiNoteUnit;
+    auto* osc = new syn::BasicOscillatorUnit;
+    mycircuit.addUnit(mnu);
+    mycircuit.addUnit(osc);
+    mycircuit.addUnit(a_filter);
+    mycircuit.connectInternal(mycircuit.getUnitId(*mnu), 0, mycircuit.getUnitId(*osc), syn::TunedOscillatorUnit::Input::iNote);
+    mycircuit.connectInternal(mycircuit.getUnitId(*osc), 0, mycircuit.getUnitId(*a_filter), 0);
+    mycircuit.connectInternal(mycircuit.getUnitId(*a_filter), 0, mycircuit.getOutputUnitId(), 0);
+    return mycircuit;
+}
+
+/**
+ * Patch of 8 copies of makeTestCircuit, each nested in its own circuit, for measuring preset loading and saving.
+ * The unit classes it uses are registered with the UnitFactory, so that it can be loaded.
+ */
+inline syn::Circuit makeLargeCircuit() {
+    syn::UnitFactory& uf = syn::UnitFactory::instance();
+    uf.addUnitPrototype<syn::OnePoleLPUnit>("Filters", "1P");
+    uf.addUnitPrototype<syn::SummerUnit>("Math", "sum");
+    uf.addUnitPrototype<syn::MidiNoteUnit>("MIDI", "pitch");
+    uf.addUnitPrototype<syn::BasicOscillatorUnit>("Oscillators", "basic");
+    uf.addUnitPrototype<syn::Circuit>("", "circuit");
+    uf.addUnitPrototype<syn::InputUnit>("", "in");
+    uf.addUnitPrototype<syn::OutputUnit>("", "out");
+
+    syn::Circuit mycircuit;
+    auto* sum = new syn::SummerUnit;
+    mycircuit.addUnit(sum);
+    mycircuit.connectInternal(mycircuit.getUnitId(*sum), 0, mycircuit.getOutputUnitId(), 0);
+    for (int i = 0; i < 8; i++) {
+        auto* sub = new syn::Circuit(makeTestCircuit());
+        mycircuit.addUnit(sub);
+        mycircuit.connectInternal(mycircuit.getUnitId(*sub), 0, mycircuit.getUnitId(*sum), i);
+    }
+    return mycircuit;
+}
@@ -220,7 +220,7 @@ def RewriteAutomatedSection(full_text, tag, replacement_text):
     result = full_text[:match.start("block")] + replacement_text + full_text[match.end("block"):]
     return result
 
-def MakeTableStr(table, name, ctype="double"):
+def MakeTableStr(table, name, ctype="SampleType"):
     rows = int(sqrt(table.size))
     cols = int(ceil(sqrt(table.size)))
     tablestr = "{} {}[{}] = {{\n".format(ctype, name, table.size)
@@ -601,7 +601,7 @@ def main(pargs):
     tableobjfuncs_def = ""
     for name, struct in tables:
         tabledata_def += MakeTableStr(struct['data'], name)
-        tabledata_decl += "extern double {}[];\n".format(name)
+        tabledata_decl += "extern SampleType {}[];\n".format(name)
 
         currargs = []
         classname = struct["classname"]
@@ -635,7 +635,9 @@ def main(pargs):
         print("Writing new {}...".format(os.path.realpath(LUT_TABLEDATA_FILE)))
     with open(LUT_TABLEDATA_FILE, 'w') as fp:
         # Add code to namespace
-        tabledata_def = """namespace {} {{
+        tabledata_def = """#include "vosimlib/common.h"
+
+namespace {} {{
     {}
 }}""".format(NAMESPACE, tabledata_def)
         fp.write(tabledata_def)
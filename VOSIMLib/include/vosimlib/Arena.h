@@ -0,0 +1,116 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file Arena.h
+ *  \brief Contiguous, cache line aligned storage for objects that are freed all at once.
+ *  \details
+ *  \author Austen Satterlee
+ */
+
+#ifndef __ARENA__
+#define __ARENA__
+#include "vosimlib/common.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace syn
+{
+    /// Alignment of Arena allocations and CacheAlignedAllocator buffers, i.e. the size of a cache line
+    const size_t CACHE_LINE_SIZE = 64;
+
+    /**
+     * \returns \p a_size rounded up to a whole number of cache lines.
+     */
+    inline size_t cacheAlignedSize(size_t a_size) { return (a_size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1); }
+
+    /**
+     * \brief A single block of memory that objects are carved out of one after another.
+     *
+     * Each allocation starts on its own cache line, right after the previous one. Nothing is freed individually:
+     * objects constructed in the arena must be destroyed explicitly, and the whole block is released with the arena.
+     * Circuits use one to lay their units out contiguously, in the order they are processed in, followed by the
+     * buffers their units' outputs share.
+     */
+    class VOSIMLIB_API Arena
+    {
+    public:
+        explicit Arena(size_t a_capacity);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+         * \returns Cache line aligned memory for \p a_numBytes bytes, or nullptr if the arena does not have enough
+         * left.
+         */
+        void* allocate(size_t a_numBytes);
+
+        /**
+         * \returns True if \p a_ptr points into the arena's block.
+         */
+        bool contains(const void* a_ptr) const {
+            const char* ptr = static_cast<const char*>(a_ptr);
+            return ptr >= m_data && ptr < m_data + m_capacity;
+        }
+
+        size_t capacity() const { return m_capacity; }
+        size_t used() const { return m_used; }
+
+    private:
+        char* m_block; ///< Block as allocated, before alignment
+        char* m_data;
+        size_t m_capacity;
+        size_t m_used;
+    };
+
+    /**
+     * \brief Standard allocator whose allocations start on a cache line.
+     *
+     * Buffers allocated with it can be loaded with aligned SIMD instructions, and never share a cache line with
+     * unrelated data.
+     */
+    template <typename T>
+    struct CacheAlignedAllocator
+    {
+        typedef T value_type;
+
+        CacheAlignedAllocator() = default;
+        template <typename U>
+        CacheAlignedAllocator(const CacheAlignedAllocator<U>&) {}
+
+        T* allocate(size_t a_n) {
+            // Room for the offset to the start of the block is kept in front of the aligned pointer
+            char* block = static_cast<char*>(::operator new(a_n * sizeof(T) + CACHE_LINE_SIZE + sizeof(void*)));
+            char* data = reinterpret_cast<char*>(cacheAlignedSize(reinterpret_cast<size_t>(block + sizeof(void*))));
+            reinterpret_cast<void**>(data)[-1] = block;
+            return reinterpret_cast<T*>(data);
+        }
+
+        void deallocate(T* a_ptr, size_t) { ::operator delete(reinterpret_cast<void**>(a_ptr)[-1]); }
+
+        template <typename U>
+        bool operator==(const CacheAlignedAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const CacheAlignedAllocator<U>&) const { return false; }
+    };
+}
+#endif
@@ -21,13 +21,19 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #define __Circuit__
 #include "vosimlib/Unit.h"
 #include "vosimlib/IntMap.h"
+#include "vosimlib/Oversampler.h"
 #include <vector>
+#include <memory>
 #include <unordered_set>
+#include <unordered_map>
+#include <algorithm>
 
 #define MAX_UNITS 128
 
 namespace syn
 {
+    class WorkerPool;
+
     struct VOSIMLIB_API ConnectionRecord
     {
         int from_id;
@@ -63,14 +69,17 @@ namespace syn
         void reset() override {};
 
     protected:
+        /**
+         * Only used when the unit is ticked on its own; inside a Circuit the passthrough units are never
+         * ticked and their ports are aliased instead (see Circuit::_bindPlan).
+         */
         void process_() override
         {
-            BEGIN_PROC_FUNC
             for (int i = 0; i < numInputs(); i++)
             {
-                WRITE_OUTPUT(i, READ_INPUT(i));
+                int id = inputs().ids()[i];
+                std::copy_n(inputBuf_(id), getBufferSize(), outputBuf_(id));
             }
-            END_PROC_FUNC
         }
     };
 
@@ -90,102 +99,233 @@ namespace syn
         OutputUnit(const OutputUnit& a_other) : OutputUnit(a_other.name()) {}
     };
 
+    /**
+     * \brief Directed graph used to order unit processing.
+     *
+     * Nodes and edges are kept in insertion order, so linearization is deterministic. Adjacency is only
+     * materialized (in compressed sparse row form) while linearizing.
+     */
     template <typename Node>
     class VOSIMLIB_API DirectedProcGraph {
     public:
         struct Props {
-            int layer = -1;
+            int layer = -1; ///< Length of the longest path from the node to a sink, counting each feedback loop as a single node
+            int loop = -1; ///< Index of the feedback loop containing the node, or -1 if it is not part of a cycle
         };
 
         void reset() {
-            m_adj.clear();
-            m_revAdj.clear();
+            m_nodes.clear();
+            m_nodeIndices.clear();
+            m_edges.clear();
         }
 
         void connect(Node a_from, Node a_to) {
-            m_adj[a_to].emplace(a_from);
-            if (!m_adj.count(a_from)) {
-                m_adj.emplace(a_from, std::unordered_multiset<Node>{});
-            }
-
-            m_revAdj[a_from].emplace(a_to);
-            if (!m_revAdj.count(a_to)) {
-                m_revAdj.emplace(a_to, std::unordered_multiset<Node>{});
-            }
+            m_edges.emplace_back(_addNode(a_from), _addNode(a_to));
         }
 
+        /**
+         * Removes one instance of the edge (a_from, a_to). Nodes left without any edges are omitted from the
+         * linearization.
+         */
         void disconnect(Node a_from, Node a_to) {
-            m_adj[a_to].erase(a_from);
-            if (m_adj[a_to].empty()) {
-                m_adj.erase(a_to);
-            }
-
-            m_revAdj[a_from].erase(a_to);
-            if (m_revAdj[a_from].empty()) {
-                m_revAdj.erase(a_from);
-            }
+            auto from = m_nodeIndices.find(a_from);
+            auto to = m_nodeIndices.find(a_to);
+            if (from == m_nodeIndices.end() || to == m_nodeIndices.end())
+                return;
+            std::pair<int, int> edge{from->second, to->second};
+            auto it = std::find(m_edges.rbegin(), m_edges.rend(), edge);
+            if (it != m_edges.rend())
+                m_edges.erase(std::next(it).base());
         }
 
+        /**
+         * Orders the nodes so that every node comes after all of its predecessors, except within feedback
+         * loops (strongly connected components), whose nodes are kept next to each other.
+         *
+         * The search starts at the sink nodes and walks incoming edges depth-first, in insertion order
+         * (Tarjan's algorithm). Nodes that cannot reach a sink are visited afterwards.
+         */
         std::vector<std::pair<Node,Props>> linearize() const {
-            std::unordered_set<Node> permClosedSet;
-            std::unordered_set<Node> tempClosedSet;
-            std::unordered_map<Node, Props> props;
-            std::vector<Node> order;
-            std::function<void(Node, int)> visit = [&](Node node, int depth)
-            {
-                if (tempClosedSet.count(node))
-                    return; // todo: cycle detected
-                if (permClosedSet.count(node)) {
-                    if (depth > props[node].layer)
-                        props[node].layer = depth;
-                    return;
-                }
-                tempClosedSet.insert(node);
-                
-                const auto& children = m_adj.at(node);
-                for (const auto& child : children)
-                {
-                    visit(child, depth + 1);
+            const int nNodes = int(m_nodes.size());
+
+            // Incoming edges in CSR layout
+            std::vector<int> inOffsets(nNodes + 1, 0);
+            std::vector<int> outDegree(nNodes, 0);
+            for (const auto& e : m_edges) {
+                inOffsets[e.second + 1]++;
+                outDegree[e.first]++;
+            }
+            for (int i = 0; i < nNodes; i++)
+                inOffsets[i + 1] += inOffsets[i];
+            std::vector<int> inEdges(m_edges.size());
+            std::vector<int> fill(inOffsets.begin(), inOffsets.end() - 1);
+            for (const auto& e : m_edges)
+                inEdges[fill[e.second]++] = e.first;
+
+            std::vector<int> roots;
+            roots.reserve(2 * nNodes);
+            for (int i = 0; i < nNodes; i++) {
+                if (!outDegree[i] && inOffsets[i] != inOffsets[i + 1])
+                    roots.push_back(i);
+            }
+            for (int i = 0; i < nNodes; i++) {
+                if (outDegree[i])
+                    roots.push_back(i);
+            }
+
+            std::vector<int> index(nNodes, -1);
+            std::vector<int> lowLink(nNodes, 0);
+            std::vector<char> onStack(nNodes, 0);
+            std::vector<int> loops(nNodes, -1);
+            std::vector<int> components(nNodes, -1);
+            std::vector<int> componentStack;
+            std::vector<int> order;
+            order.reserve(nNodes);
+            std::vector<std::pair<int, int>> callStack; // (node, next incoming edge to visit)
+            int nextIndex = 0;
+            int nComponents = 0;
+            int nLoops = 0;
+            for (int root : roots) {
+                if (index[root] >= 0)
+                    continue;
+                callStack.emplace_back(root, inOffsets[root]);
+                index[root] = lowLink[root] = nextIndex++;
+                componentStack.push_back(root);
+                onStack[root] = 1;
+                while (!callStack.empty()) {
+                    int node = callStack.back().first;
+                    int& next = callStack.back().second;
+                    if (next < inOffsets[node + 1]) {
+                        int pred = inEdges[next++];
+                        if (index[pred] < 0) {
+                            callStack.emplace_back(pred, inOffsets[pred]);
+                            index[pred] = lowLink[pred] = nextIndex++;
+                            componentStack.push_back(pred);
+                            onStack[pred] = 1;
+                        } else if (onStack[pred]) {
+                            lowLink[node] = std::min(lowLink[node], index[pred]);
+                        }
+                        continue;
+                    }
+
+                    callStack.pop_back();
+                    if (!callStack.empty()) {
+                        int parent = callStack.back().first;
+                        lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+                    }
+                    if (lowLink[node] != index[node])
+                        continue;
+
+                    // node is the root of a component, whose predecessors have all been emitted already
+                    const int first = int(order.size());
+                    int member;
+                    do {
+                        member = componentStack.back();
+                        componentStack.pop_back();
+                        onStack[member] = 0;
+                        components[member] = nComponents;
+                        order.push_back(member);
+                    } while (member != node);
+                    nComponents++;
+                    bool isLoop = int(order.size()) - first > 1;
+                    for (int j = inOffsets[node]; j < inOffsets[node + 1] && !isLoop; j++)
+                        isLoop = inEdges[j] == node;
+                    if (isLoop) {
+                        for (int j = first; j < int(order.size()); j++)
+                            loops[order[j]] = nLoops;
+                        nLoops++;
+                    }
                 }
-                permClosedSet.insert(node);
-                tempClosedSet.erase(node);
-                props[node].layer = depth;
-                order.push_back(node);
-            };
-
-            // Start the graph search at sink nodes            
-            for (const auto& p : m_revAdj)
-            {
-                if(p.second.empty()) {
-                    visit(p.first, 0);
+            }
+
+            // Layers of the components, in reverse order so that every successor is final before its predecessors
+            // are updated. All nodes in a loop share the loop's layer.
+            std::vector<int> layers(nComponents, 0);
+            for (int i = int(order.size()) - 1; i >= 0; i--) {
+                int node = order[i];
+                int component = components[node];
+                for (int j = inOffsets[node]; j < inOffsets[node + 1]; j++) {
+                    int predComponent = components[inEdges[j]];
+                    if (predComponent != component)
+                        layers[predComponent] = std::max(layers[predComponent], layers[component] + 1);
                 }
             }
 
-            // Create output
             std::vector<std::pair<Node, Props>> out(order.size());
-            std::transform(order.begin(), order.end(), out.begin(), [&props](Node n) {return std::make_pair(n, props[n]); });
+            for (int i = 0; i < int(order.size()); i++) {
+                out[i].first = m_nodes[order[i]];
+                out[i].second.layer = layers[components[order[i]]];
+                out[i].second.loop = loops[order[i]];
+            }
             return out;
         }
 
+    private:
+        int _addNode(Node a_node) {
+            auto result = m_nodeIndices.emplace(a_node, int(m_nodes.size()));
+            if (result.second)
+                m_nodes.push_back(a_node);
+            return result.first->second;
+        }
 
     private:
-        /**
-         * \brief Adjacency list
-         * 
-         *  Allows looking up incoming edges. Edges go from value nodes towards
-         *  key nodes. If node `u` is in `m_adj[v]`, then the edge (u,v) is in
-         *  the graph.
-         */
-        std::unordered_map<Node, std::unordered_multiset<Node>> m_adj;
+        std::vector<Node> m_nodes; ///< Nodes in insertion order
+        std::unordered_map<Node, int> m_nodeIndices; ///< Node -> index into m_nodes
+        std::vector<std::pair<int, int>> m_edges; ///< (from, to) node indices in insertion order
+    };
 
-        /**
-         * \brief Reversed adjacency list
-         *
-         *  Allows looking up outgoing edges. Edges go from key nodes towards
-         *  value nodes. If node `u` is in `m_revAdj[v]`, then the edge (v,u) is
-         *  in the graph.
-         */
-        std::unordered_map<Node, std::unordered_multiset<Node>> m_revAdj; ///< Reverse adjacency list
+    /**
+     * \brief Compiled form of a Circuit's processing graph.
+     *
+     * A plan is a flat list of steps in execution order. Steps refer to units by their id within the circuit
+     * rather than by address, so every copy of a circuit (e.g. the voices created from a prototype by the
+     * VoiceManager) can share a single plan. Each circuit binds the plan to its own units and buffers.
+     *
+     * The plan also records which output ports may share storage. Two ports whose lifetimes (from the step
+     * that writes them to the last step that reads them) do not overlap are assigned the same buffer index,
+     * so a long serial chain only cycles through a handful of buffers.
+     *
+     * Units that form a cycle are grouped into feedback loops of consecutive steps. Everything else is processed
+     * a block at a time, but a loop is processed one sample at a time. Connections that point backwards within
+     * a loop act as one-sample delays.
+     *
+     * Plans compiled for a worker pool (see Circuit::setWorkerPool) are also split into waves. The steps in a wave
+     * share a dependency layer and do not read each other's outputs, so they can run concurrently.
+     */
+    struct VOSIMLIB_API CircuitPlan
+    {
+        struct Step
+        {
+            int unitId;
+            Unit::ProcessFn process;
+            Unit::LaneProcessFn processLanes; ///< see Unit::getLaneProcessFn
+        };
+
+        struct BufferAssignment
+        {
+            int unitId;
+            int outputId;
+            int buffer; ///< index into the circuit's pool of shared buffers
+        };
+
+        struct FeedbackLoop
+        {
+            int begin; ///< index of the first step in the loop
+            int end; ///< one past the index of the last step in the loop
+            std::vector<std::pair<int, int>> feedbackPorts; ///< (unit id, output id) of ports read by an earlier step in the loop
+        };
+
+        struct Wave
+        {
+            int begin; ///< index of the first step in the wave
+            int end; ///< one past the index of the last step in the wave
+        };
+
+        std::vector<Step> steps;
+        std::vector<BufferAssignment> bufferAssignments;
+        std::vector<FeedbackLoop> loops;
+        std::vector<Wave> waves; ///< empty unless the plan was compiled for a worker pool
+        int numBuffers = 0;
     };
 
     /**
@@ -195,11 +335,46 @@ namespace syn
     *
     * A Circuit is a Unit that contains other Units.
     *
+    * A circuit can run its units at 2x, 4x or 8x its own sample rate (see Circuit::pOversampling). Its inputs
+    * are then upsampled at the start of each block and its outputs downsampled at the end (see Oversampler), and
+    * the units inside see the higher rate and a proportionally larger buffer size. Nesting an oversampled circuit
+    * inside another one lets a whole nonlinear chain share a single resampling cost.
+    *
     */
     class VOSIMLIB_API Circuit : public Unit
     {
         DERIVE_UNIT(Circuit)
     public:
+        enum Param
+        {
+            pOversampling = 0 ///< Rate of the internal units relative to the circuit's own rate (1x, 2x, 4x or 8x). Changing it reallocates the circuit's buffers, so it is not real-time safe (see VoiceManager::editCircuit).
+        };
+
+        /**
+         * \brief Defers execution plan rebuilds while a batch of edits is made to a circuit.
+         *
+         * The plan is rebuilt once, when the outermost scope on the circuit is destroyed, and only if the
+         * topology actually changed. Scopes may be nested.
+         *
+         * \code
+         * {
+         *     Circuit::BulkEdit edit(circ);
+         *     for (const auto& rec : records)
+         *         circ.connectInternal(rec.from_id, rec.from_port, rec.to_id, rec.to_port);
+         * } // plan rebuilt here
+         * \endcode
+         */
+        class VOSIMLIB_API BulkEdit
+        {
+        public:
+            explicit BulkEdit(Circuit& a_circuit);
+            ~BulkEdit();
+            BulkEdit(const BulkEdit&) = delete;
+            BulkEdit& operator=(const BulkEdit&) = delete;
+        private:
+            Circuit& m_circuit;
+        };
+
         explicit Circuit(const string& a_name);
 
         Circuit(const Circuit& a_other);
@@ -238,6 +413,10 @@ namespace syn
          * \returns A vector of (unit_id, port_id) pairs.
          */
         vector<std::pair<int, int>> getConnectionsToInternalInput(int a_unitId, int a_inputId) const;
+        /**
+         * Retrieves a list of input ports connected to an output port.
+         * \returns A vector of (unit_id, port_id) pairs.
+         */
         vector<std::pair<int, int>> getConnectionsFromInternalOutput(int a_unitId, int a_outputId) const;
 
         /**
@@ -272,9 +451,65 @@ namespace syn
 
         const std::array<Unit*, MAX_UNITS + 1>& execOrder() const { return m_execOrder; }
 
+        /**
+         * The compiled execution plan currently used by this circuit. Circuits copied from one another share
+         * the same plan until one of them is edited.
+         */
+        std::shared_ptr<const CircuitPlan> plan() const { return m_plan; }
+
+        /**
+         * Runs units that share a dependency layer concurrently on the given pool. This pays off for wide
+         * circuits (e.g. a bank of oscillators or filters) when there are too few voices to keep the pool busy.
+         *
+         * Pass nullptr to process units serially, which is the default. The pool is not handed down to nested
+         * circuits. Setting the pool recompiles the plan, so this is not real-time safe.
+         */
+        void setWorkerPool(WorkerPool* a_pool);
+        WorkerPool* getWorkerPool() const { return m_workerPool; }
+
+        /**
+         * \returns The oversampling factor set by Circuit::pOversampling.
+         */
+        int getOversampling() const { return m_oversampling; }
+
+        /**
+         * Delay added by oversampling, in samples at the circuit's own rate.
+         */
+        double getOversamplingLatency() const { return m_inputResamplers[0].latency(); }
+
+        /**
+         * Ticks several circuits in lockstep, e.g. the voices of a VoiceManager. When the circuits share an
+         * execution plan, each step whose unit has a lane kernel (see Unit::getLaneProcessFn) processes that unit
+         * in every circuit with a single call. Other steps are processed one circuit at a time.
+         *
+         * Circuits that do not share a plan, that contain feedback loops, or that have a worker pool are ticked
+         * one after another instead.
+         *
+         * \param a_numLanes Number of circuits, at most MAX_LANES.
+         */
+        static void tickLanes(Circuit* const* a_circuits, int a_numLanes);
+
+        /**
+         * Takes over the running state of another copy of this circuit, e.g. a voice built from an older version
+         * of the same patch.
+         *
+         * Every unit of \p a_other that is the same unit as one of this circuit's, i.e. that has the same id and
+         * was cloned from the same original, is moved into this circuit in place of its own, which is moved to
+         * \p a_other instead. The last block of each of its outputs comes along with it, so that feedback loops
+         * carry on even if the plan changed. Nested circuits take over the units of their counterparts in the
+         * same way. Units that only exist in this circuit take on the midi state of \p a_other, and the
+         * connections of this circuit are reapplied. Afterward, \p a_other is only fit to be destroyed.
+         *
+         * Nothing is allocated as long as this circuit's plan has already been bound, so a voice built off the
+         * real-time thread can take over a playing voice without interrupting it.
+         */
+        void adoptUnits(Circuit& a_other);
+
     protected:
         void process_() override;
 
+        void onParamChange_(int a_paramId) override;
+
         void onFsChange_() override;
 
         void onTempoChange_() override;
@@ -296,10 +531,121 @@ namespace syn
         int addExternalOutput_(const string& a_name);
 
     private:
+        /**
+         * Replaces the contents of this circuit with a copy of \p a_other's: its settings, a clone of each of its
+         * units, and its connections. The connections are copied as they are and a_other's plan is reused, so the
+         * graph is never recomputed, and each clone is configured once.
+         *
+         * The clones and the shared output buffers are laid out in a single arena, which is released with the last
+         * of them. Storage the units allocate themselves (their port tables, default input rows, delay lines) is
+         * not part of it.
+         */
+        void _stampFrom(const Circuit& a_other);
+
+        /**
+         * Rebuilds the execution plan from the connection records and binds it. Inside a BulkEdit scope the
+         * rebuild is deferred until the scope ends.
+         */
         void _recomputeGraph();
 
+        /**
+         * Updates the execution plan after a single edit. The current order is kept when it is still valid
+         * (i.e. a_fromId precedes a_toId, or one of them has just become connected), otherwise the graph is
+         * relinearized.
+         * \param a_fromId,a_toId The endpoints of the added connection, or -1 if a connection was only removed.
+         */
+        void _updatePlan(int a_fromId, int a_toId);
+
+        /**
+         * Builds and binds a plan that runs the given units in the given order.
+         * \param a_loops The feedback loop index of each unit in a_order (-1 if not in a loop), or an empty
+         * vector if there are no loops.
+         * \param a_layers The dependency layer of each unit in a_order. Only used when a worker pool is set.
+         */
+        void _compilePlan(const vector<int>& a_order, const vector<int>& a_loops = {}, const vector<int>& a_layers = {});
+
+        void _addRecord(const ConnectionRecord& a_record);
+        void _eraseRecord(int a_index);
+
+        /**
+         * Rebuilds the outgoing connection index if the connection records have changed since it was built.
+         */
+        void _updateOutgoingIndex() const;
+
+        /**
+         * Assigns output ports with non-overlapping lifetimes to shared buffers (greedy interval colouring
+         * over the plan's execution order).
+         */
+        void _assignBuffers(CircuitPlan& a_plan) const;
+
+        /**
+         * \returns The distance, in samples, between the starts of consecutive shared output buffers: the inner
+         * buffer size padded to a whole number of cache lines.
+         */
+        int _bufferStride() const;
+
+        /**
+         * Points this circuit's bound steps at its own units and resolves their block spans. Must be called
+         * whenever the plan changes or unit buffers are reallocated.
+         */
+        void _bindPlan();
+
+        /**
+         * Refreshes the aliases (and block states) of the external inputs before a block is processed.
+         */
+        void _beginBlock();
+
+        /**
+         * Copies the current block to output ports that have been redirected away from their aliases, and forwards
+         * the block states of the buffers feeding the output unit.
+         */
+        void _endBlock();
+
+        /**
+         * Runs the bound steps over samples [a_offset, a_offset + a_length), processing feedback loops one
+         * sample at a time.
+         */
+        void _processSteps(int a_offset, int a_length);
+
+        /**
+         * Runs the bound waves over samples [a_offset, a_offset + a_length), spreading the tasks of each wave
+         * over the worker pool.
+         */
+        void _processWaves(int a_offset, int a_length);
+
+        /**
+         * Runs a bound feedback loop over samples [a_offset, a_offset + a_length), one sample at a time.
+         */
+        void _processLoop(int a_loop, int a_offset, int a_length);
+
+        static void _processTask(void* a_context, int a_index);
+
+        /**
+         * Points the input unit's output ports directly at the circuit's input sources, and copies their block
+         * states.
+         * \returns True if any of the aliases changed.
+         */
+        bool _updateInputAliases();
+
+        /**
+         * Points the circuit's output ports directly at the buffers feeding the output unit. Oversampled circuits
+         * keep their own output buffers instead, which are filled by downsampling in Circuit::_endBlock.
+         */
+        void _updateOutputAliases();
+
+        /**
+         * Changes the rate of the internal units and reallocates the resampling buffers. Not real-time safe.
+         */
+        void _setOversampling(int a_factor);
+
+        /**
+         * Buffer size of the internal units.
+         */
+        int _innerBufferSize() const { return getBufferSize() * m_oversampling; }
+
     private:
         friend class VoiceManager;
+        friend class CircuitBlueprint;
 
         double m_voiceIndex; ///< A number between 0 and 1 assigned to the circuit by a VoiceManager
         IntMap<Unit*, MAX_UNITS> m_units;
@@ -307,9 +653,94 @@ namespace syn
         InputUnit* m_inputUnit;
         OutputUnit* m_outputUnit;
 
-        DirectedProcGraph<Unit*> m_procGraph;
+        struct BoundStep
+        {
+            Unit::ProcessFn process;
+            Unit* unit;
+            Unit::LaneProcessFn processLanes;
+        };
+
+        struct BoundLoop
+        {
+            int begin; ///< index of the first bound step in the loop
+            int end; ///< one past the index of the last bound step in the loop
+            int bufferSize; ///< size of the port buffers, used to carry the last sample over to the next block
+            std::vector<SampleType*> feedbackBufs; ///< buffers of CircuitPlan::FeedbackLoop::feedbackPorts
+        };
+
+        /// A unit of work within a wave: either a single step, or a whole feedback loop
+        struct BoundTask
+        {
+            int step; ///< index of the bound step, or -1 for a loop
+            int loop; ///< index of the bound loop, or -1 for a step
+        };
+
+        struct BoundWave
+        {
+            int begin; ///< index of the first task in the wave
+            int end; ///< one past the index of the last task in the wave
+        };
+
+        std::shared_ptr<const CircuitPlan> m_plan;
+        std::vector<BoundStep> m_boundSteps; ///< m_plan resolved against this circuit's units
+        std::vector<BoundLoop> m_boundLoops; ///< feedback loops of m_plan, in execution order
+        std::vector<BoundTask> m_boundTasks; ///< tasks of each wave, grouped by wave
+        std::vector<BoundWave> m_boundWaves; ///< waves of m_plan, in execution order
+        WorkerPool* m_workerPool;
+        const BoundTask* m_waveTasks; ///< tasks of the wave being processed by the worker pool
+        int m_waveOffset; ///< sample range of the wave being processed by the worker pool
+        int m_waveLength;
+        std::vector<Unit*> m_inputConsumers; ///< units reading directly from the input unit
+        std::array<const SampleType*, MAX_OUTPUTS> m_outputAliases; ///< buffers feeding the output unit
+        int m_bulkEditDepth; ///< Number of open BulkEdit scopes
+        bool m_graphDirty; ///< The topology changed while a BulkEdit scope was open
+        std::array<int, MAX_UNITS> m_unitDegrees; ///< Number of connections touching each unit
+        std::array<int, MAX_UNITS * MAX_INPUTS> m_inputRecords; ///< (unit id, input port) -> index of the connection record feeding it, or -1
+        mutable std::array<int, MAX_UNITS + 1> m_outgoingOffsets; ///< unit id -> first entry in m_outgoingRecords (CSR layout)
+        mutable std::vector<int> m_outgoingRecords; ///< Connection record indices grouped by source unit
+        mutable bool m_outgoingDirty;
         std::array<Unit*, MAX_UNITS+1> m_execOrder; ///< Unit execution order
-        std::vector<std::vector<double>> m_internalBuffers;
+        std::vector<SampleType, CacheAlignedAllocator<SampleType>> m_internalBuffers; ///< Shared output buffers when they do not fit in m_voiceArena, see CircuitPlan::bufferAssignments
+        int m_bufferStride; ///< Distance between the starts of consecutive shared output buffers
+        std::shared_ptr<Arena> m_voiceArena; ///< Arena holding the units and shared output buffers laid out by _stampFrom
+        SampleType* m_arenaBuffers; ///< Shared output buffers reserved in m_voiceArena
+        size_t m_arenaBufferCapacity; ///< Number of samples at m_arenaBuffers
+        int m_oversampling; ///< see Circuit::pOversampling
+        std::array<Oversampler, MAX_INPUTS> m_inputResamplers; ///< indexed by input id
+        std::array<Oversampler, MAX_OUTPUTS> m_outputResamplers; ///< indexed by output id
+        std::array<std::vector<SampleType>, MAX_INPUTS> m_oversampledInputs; ///< upsampled input blocks, aliased by the input unit
+    };
+
+    /**
+     * \class CircuitBlueprint
+     *
+     * \brief Immutable snapshot of a circuit, from which any number of copies can be stamped out.
+     *
+     * The blueprint holds its own copy of the circuit with a compiled execution plan. Since nothing can edit that
+     * copy, circuits can be stamped from the same blueprint on several threads at once, e.g. to build the voices of
+     * a VoiceManager in parallel. Stamping clones each unit once and copies the connections and the plan as they
+     * are, which takes O(units + connections) time and never recomputes the graph.
+     */
+    class VOSIMLIB_API CircuitBlueprint
+    {
+    public:
+        explicit CircuitBlueprint(const Circuit& a_circuit);
+
+        /**
+         * Replaces the contents of \p a_target with a copy of the blueprint's circuit.
+         */
+        void stamp(Circuit& a_target) const;
+
+        /**
+         * Stamps each of the \p a_count circuits starting at \p a_targets, spreading them over \p a_pool if it is
+         * not null.
+         */
+        void stamp(Circuit* a_targets, int a_count, WorkerPool* a_pool = nullptr) const;
+
+        const Circuit& circuit() const { return m_circuit; }
+
+    private:
+        Circuit m_circuit;
     };
 };
 
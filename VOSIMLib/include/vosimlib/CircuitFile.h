@@ -0,0 +1,119 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file CircuitFile.h
+ *  \brief Compact binary form of a circuit, for fast preset loading and saving.
+ *  \details
+ *  \author Austen Satterlee
+ */
+
+#ifndef __CIRCUITFILE__
+#define __CIRCUITFILE__
+#include "vosimlib/common.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace syn
+{
+    class Circuit;
+
+    /**
+     * \brief Read-only view of a whole file, mapped into memory.
+     *
+     * Pages are read from disk as they are touched, so nothing is copied into a buffer up front.
+     */
+    class VOSIMLIB_API MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& a_path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// \returns False if the file could not be opened or mapped
+        bool isOpen() const { return m_data != nullptr; }
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        const char* m_data;
+        size_t m_size;
+#if defined(_WIN32)
+        void* m_file;
+        void* m_mapping;
+#endif
+    };
+
+    /**
+     * Version of the binary circuit format written by saveBinaryCircuit. Older versions can still be loaded.
+     */
+    const uint32_t BINARY_CIRCUIT_VERSION = 1;
+
+    /**
+     * \brief Serializes a circuit, and every circuit nested inside it, to the binary circuit format.
+     *
+     * The format stores the same information as the circuit's JSON form (see Circuit::operator json), so a circuit
+     * loaded from either one saves to the same JSON. Parameter values are stored exactly, rather than as their
+     * display strings. Units that save extra state of their own through Unit::operator json are not supported.
+     *
+     * The data is laid out as fixed-size records, so that it can be read in place without building a DOM:
+     *  - A header holding the magic bytes "VSCB", the format version, and the number of items in each array below.
+     *  - One record per unit, in depth-first order, starting with the circuit itself. Each record holds the unit's
+     *    class identifier, name, id within its parent circuit, the index of that parent's record, and the range of
+     *    its parameter records.
+     *  - One record per parameter: its raw value, range, type, and range of display text records.
+     *  - One record per display text: its value and text.
+     *  - One record per connection, holding the index of the circuit's unit record and the ConnectionRecord fields.
+     *  - A string table: the offset of each string, followed by the strings' characters. Equal strings are stored
+     *    once.
+     *
+     * Numbers are stored in little-endian order.
+     */
+    VOSIMLIB_API std::vector<char> saveBinaryCircuit(const Circuit& a_circuit);
+
+    /**
+     * \returns True if the data starts with the magic bytes of the binary circuit format.
+     */
+    VOSIMLIB_API bool isBinaryCircuit(const char* a_data, size_t a_size);
+
+    /**
+     * Constructs a circuit from its binary form (see saveBinaryCircuit). Units are created with the UnitFactory, so
+     * their classes must be registered with it. The data does not need to be aligned.
+     *
+     * \returns A newly allocated circuit (the caller is responsible for releasing the memory), or nullptr if the
+     * data is malformed, was written by a newer version, or refers to a class that is not registered.
+     */
+    VOSIMLIB_API Circuit* loadBinaryCircuit(const char* a_data, size_t a_size);
+
+    /**
+     * Writes the binary form of a circuit to a file.
+     * \returns True if the file was written.
+     */
+    VOSIMLIB_API bool saveBinaryCircuitFile(const Circuit& a_circuit, const std::string& a_path);
+
+    /**
+     * Constructs a circuit from a file holding its binary form, which is mapped into memory and read in place.
+     * \returns A newly allocated circuit, or nullptr if the file could not be read or loaded.
+     */
+    VOSIMLIB_API Circuit* loadBinaryCircuitFile(const std::string& a_path);
+}
+#endif
@@ -19,6 +19,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 #include <functional>
+#include <type_traits>
 #include "vosimlib/common.h"
 
 namespace syn {
@@ -32,9 +33,13 @@ namespace syn {
         virtual void operator()() = 0;
     };
     
+    /**
+     * Command that stores its closure inline, so that it can be constructed in a CommandPool slot without
+     * another allocation.
+     */
     template <class T>
     class VOSIMLIB_API CommandImplem : public Command {
-        std::function<void()> m_f;
+        typename std::decay<T>::type m_f;
     public:
         CommandImplem(T&& a_f)
             : m_f(std::forward<T>(a_f)) {}
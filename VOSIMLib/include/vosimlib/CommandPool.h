@@ -0,0 +1,92 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file CommandPool.h
+ *  \brief Preallocated storage for Commands.
+ *  \details
+ *  \author Austen Satterlee
+ */
+
+#ifndef __COMMANDPOOL__
+#define __COMMANDPOOL__
+#include "vosimlib/Command.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace syn
+{
+    /**
+     * \brief Fixed number of preallocated slots that Commands are constructed in.
+     *
+     * Commands whose closure fits in a slot are built in place, so making one does not touch the heap. Larger
+     * commands, and commands made while every slot is taken, fall back to `new`.
+     *
+     * The pool is not thread-safe: commands must be made and destroyed on the same thread (see
+     * VoiceManager::queueAction, which hands commands back to the GUI thread once they have run).
+     */
+    class VOSIMLIB_API CommandPool
+    {
+    public:
+        /// Size in bytes of each slot, which bounds the size of the closures that can be stored inline
+        static const int SLOT_SIZE = 128;
+
+        explicit CommandPool(int a_capacity);
+
+        CommandPool(const CommandPool&) = delete;
+        CommandPool& operator=(const CommandPool&) = delete;
+
+        /**
+         * Constructs a command that calls \p a_f.
+         */
+        template <class T>
+        Command* make(T&& a_f) {
+            typedef CommandImplem<T> Implem;
+            void* slot = sizeof(Implem) <= SLOT_SIZE && alignof(Implem) <= alignof(Slot) ? _allocate() : nullptr;
+            if (!slot) {
+                m_numHeapCommands++;
+                return new Implem(std::forward<T>(a_f));
+            }
+            return new(slot) Implem(std::forward<T>(a_f));
+        }
+
+        /**
+         * Destroys a command made by CommandPool::make, or any other heap allocated command.
+         */
+        void destroy(Command* a_command);
+
+        int capacity() const { return static_cast<int>(m_slots.size()); }
+        int numFree() const { return static_cast<int>(m_freeSlots.size()); }
+        /// Number of commands that did not fit in a slot and were allocated on the heap instead
+        int numHeapCommands() const { return m_numHeapCommands; }
+
+    private:
+        void* _allocate();
+
+    private:
+        typedef std::aligned_storage<SLOT_SIZE, alignof(std::max_align_t)>::type Slot;
+
+        std::vector<Slot> m_slots;
+        std::vector<int> m_freeSlots; ///< Stack of the indices of the unused slots
+        int m_numHeapCommands;
+    };
+}
+#endif
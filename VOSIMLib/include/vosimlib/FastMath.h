@@ -0,0 +1,372 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * \file FastMath.h
+ * \brief Branchless approximations of the math functions used in the audio path.
+ * \details
+ * Each function has an inline scalar version, and array versions for float and double (defined in
+ * FastMath.cpp) which use AVX2 or SSE2 when the library is compiled for them (see VOSIMPROJECT_EIS). Both are
+ * built from the same kernels, so they agree to within a few rounding errors.
+ *
+ * None of the functions branch on their arguments. Error bounds, as checked in tests.cpp:
+ *
+ * | Function              | Domain                   | double             | float                   |
+ * |-----------------------|--------------------------|--------------------|-------------------------|
+ * | fast_wrap             | \|x/m\| < 2^31           | rounding of x/m    | rounding of x/m         |
+ * | fast_exp2             | [-1022, 1023]            | 1e-12 relative     | 3e-7 relative           |
+ * | fast_log2             | positive, normal         | 3e-12 absolute     | 3e-7 absolute + 1 ulp   |
+ * | fast_tan              | (-pi/2, pi/2)            | 1e-11 relative     | 1e-6 relative           |
+ * | fast_tanh             | any                      | 1e-11 relative     | 2e-6 relative           |
+ * | fast_pitchToFreq      | [-1000, 1000] (double)   | 1e-12 relative     | 1e-6 relative           |
+ * |                       | [-20, 160] (float)       |                    |                         |
+ *
+ * Arguments outside of the domain give unspecified (but finite or infinite, never trapping) results. fast_exp2
+ * clamps its argument to the domain, and fast_log2 returns about -1023 (-127 for float) for zero and denormals.
+ *
+ * \author Austen Satterlee
+ */
+
+#ifndef __FASTMATH__
+#define __FASTMATH__
+#include "vosimlib/common.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace syn
+{
+    namespace fastmath
+    {
+        /**
+         * Scalar implementation of the operations that the kernels below are written in terms of. The array
+         * versions in FastMath.cpp provide the same interface for SIMD registers.
+         */
+        template <typename T>
+        struct ScalarOps;
+
+        template <>
+        struct ScalarOps<double>
+        {
+            typedef double T;
+            typedef double V;
+            typedef bool M;
+            typedef uint64_t Bits;
+
+            static V set1(double a) { return a; }
+            static V add(V a, V b) { return a + b; }
+            static V sub(V a, V b) { return a - b; }
+            static V mul(V a, V b) { return a * b; }
+            static V div(V a, V b) { return a / b; }
+            static V min(V a, V b) { return a < b ? a : b; }
+            static V max(V a, V b) { return a < b ? b : a; }
+            static V abs(V a) { return std::fabs(a); }
+            static V floor(V a) { return std::floor(a); }
+            static M cmpgt(V a, V b) { return a > b; }
+            static M cmpge(V a, V b) { return a >= b; }
+            static V select(M m, V a, V b) { return m ? a : b; }
+            static V copysign(V mag, V sgn) { return std::copysign(mag, sgn); }
+
+            /// 2^n, for integer n in [-1022, 1023]
+            static V pow2i(V n)
+            {
+                Bits bits = toBits(n + (4503599627370496.0 + 1023.0)) << 52;
+                return fromBits(bits);
+            }
+
+            /// Unbiased exponent of a positive number
+            static V exponent(V x) { return static_cast<double>(static_cast<int>(toBits(x) >> 52) - 1023); }
+
+            /// Significand of a positive number, in [1, 2)
+            static V mantissa(V x) { return fromBits((toBits(x) & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull); }
+
+            static Bits toBits(V x)
+            {
+                Bits bits;
+                std::memcpy(&bits, &x, sizeof(bits));
+                return bits;
+            }
+
+            static V fromBits(Bits bits)
+            {
+                V x;
+                std::memcpy(&x, &bits, sizeof(x));
+                return x;
+            }
+        };
+
+        template <>
+        struct ScalarOps<float>
+        {
+            typedef float T;
+            typedef float V;
+            typedef bool M;
+            typedef uint32_t Bits;
+
+            static V set1(double a) { return static_cast<float>(a); }
+            static V add(V a, V b) { return a + b; }
+            static V sub(V a, V b) { return a - b; }
+            static V mul(V a, V b) { return a * b; }
+            static V div(V a, V b) { return a / b; }
+            static V min(V a, V b) { return a < b ? a : b; }
+            static V max(V a, V b) { return a < b ? b : a; }
+            static V abs(V a) { return std::fabs(a); }
+            static V floor(V a) { return std::floor(a); }
+            static M cmpgt(V a, V b) { return a > b; }
+            static M cmpge(V a, V b) { return a >= b; }
+            static V select(M m, V a, V b) { return m ? a : b; }
+            static V copysign(V mag, V sgn) { return std::copysign(mag, sgn); }
+
+            /// 2^n, for integer n in [-126, 127]
+            static V pow2i(V n)
+            {
+                Bits bits = toBits(n + (8388608.0f + 127.0f)) << 23;
+                return fromBits(bits);
+            }
+
+            /// Unbiased exponent of a positive number
+            static V exponent(V x) { return static_cast<float>(static_cast<int>(toBits(x) >> 23) - 127); }
+
+            /// Significand of a positive number, in [1, 2)
+            static V mantissa(V x) { return fromBits((toBits(x) & 0x007FFFFFu) | 0x3F800000u); }
+
+            static Bits toBits(V x)
+            {
+                Bits bits;
+                std::memcpy(&bits, &x, sizeof(bits));
+                return bits;
+            }
+
+            static V fromBits(Bits bits)
+            {
+                V x;
+                std::memcpy(&x, &bits, sizeof(x));
+                return x;
+            }
+        };
+
+        /**
+         * Evaluates the polynomial c0 + c1*x + c2*x^2 + ... with Horner's scheme.
+         */
+        template <typename O>
+        typename O::V poly(typename O::V, double c0) { return O::set1(c0); }
+
+        template <typename O, typename... Cs>
+        typename O::V poly(typename O::V x, double c0, Cs... cs) { return O::add(O::set1(c0), O::mul(x, poly<O>(x, cs...))); }
+
+        /*
+         * Near-minimax polynomial fits. The double versions are accurate to about 1e-12, and the float versions to
+         * about 1e-7, before rounding.
+         */
+
+        /// 2^f for f in [0, 1]
+        template <typename O>
+        typename O::V exp2Poly(typename O::V f, double)
+        {
+            return poly<O>(f, 1.0000000000007738, 0.6931471804261738, 0.24022651070998713, 0.0555040686217636,
+                           0.009618341221239252, 0.0013327303684927683, 0.00015510745032090711,
+                           1.4197853411224148e-05, 1.8633462874895201e-06);
+        }
+
+        template <typename O>
+        typename O::V exp2Poly(typename O::V f, float)
+        {
+            return poly<O>(f, 0.9999999250725407, 0.6931530730034062, 0.24015361815684216, 0.05582631563237428,
+                           0.008989342276646273, 0.0018775759974564155);
+        }
+
+        /// log2((1+t)/(1-t))/t as a function of t^2, for t in [0, 3-2*sqrt(2)]
+        template <typename O>
+        typename O::V log2Poly(typename O::V t2, double)
+        {
+            return poly<O>(t2, 2.885390081790091, 0.9617966733062386, 0.5770835917674556, 0.4116723401435036,
+                           0.3407365139808585);
+        }
+
+        template <typename O>
+        typename O::V log2Poly(typename O::V t2, float)
+        {
+            return poly<O>(t2, 2.8853904246973214, 0.9615880302115726, 0.5957919477674773);
+        }
+
+        /// (tan(y)-y)/y^3 as a function of y^2, for y in [0, pi/4]
+        template <typename O>
+        typename O::V tanPoly(typename O::V y2, double)
+        {
+            return poly<O>(y2, 0.33333333464131887, 0.13333324910645855, 0.053970112161148935, 0.02184952017117166,
+                           0.008983535136466304, 0.003160333855110775, 0.002388964324142437,
+                           -0.0005715352650341073, 0.0009505804841714346);
+        }
+
+        template <typename O>
+        typename O::V tanPoly(typename O::V y2, float)
+        {
+            return poly<O>(y2, 0.3333515811801917, 0.13292348496863698, 0.056904126240583254, 0.012986841747701323,
+                           0.020118482495126867);
+        }
+
+        template <typename T>
+        struct Constants;
+
+        template <>
+        struct Constants<double>
+        {
+            static constexpr double minExp = -1022.0;
+            static constexpr double maxExp = 1023.0;
+            /// pi/2 split in two, so that pi/2-x can be computed without cancellation
+            static constexpr double halfPiHi = 1.5707963267948966;
+            static constexpr double halfPiLo = 6.123233995736766e-17;
+        };
+
+        template <>
+        struct Constants<float>
+        {
+            static constexpr double minExp = -126.0;
+            static constexpr double maxExp = 127.0;
+            static constexpr double halfPiHi = 1.5707963705062866;
+            static constexpr double halfPiLo = -4.371139000186241e-08;
+        };
+
+        template <typename O>
+        typename O::V wrap(typename O::V x, typename O::V m)
+        {
+            typedef typename O::V V;
+            V r = O::sub(x, O::mul(m, O::floor(O::div(x, m))));
+            // The quotient can round up to the next integer, and the correction can round up to m
+            r = O::select(O::cmpgt(O::set1(0.0), r), O::add(r, m), r);
+            return O::select(O::cmpge(r, m), O::sub(r, m), r);
+        }
+
+        template <typename O>
+        typename O::V exp2(typename O::V x)
+        {
+            typedef typename O::T T;
+            typedef typename O::V V;
+            x = O::min(O::max(x, O::set1(Constants<T>::minExp)), O::set1(Constants<T>::maxExp));
+            const V n = O::floor(x);
+            return O::mul(exp2Poly<O>(O::sub(x, n), T()), O::pow2i(n));
+        }
+
+        template <typename O>
+        typename O::V log2(typename O::V x)
+        {
+            typedef typename O::T T;
+            typedef typename O::V V;
+            V e = O::exponent(x);
+            V m = O::mantissa(x);
+            // Center the significand on 1, so that |t| <= 3-2*sqrt(2)
+            const typename O::M high = O::cmpgt(m, O::set1(1.4142135623730951));
+            m = O::select(high, O::mul(m, O::set1(0.5)), m);
+            e = O::select(high, O::add(e, O::set1(1.0)), e);
+            const V t = O::div(O::sub(m, O::set1(1.0)), O::add(m, O::set1(1.0)));
+            return O::add(e, O::mul(t, log2Poly<O>(O::mul(t, t), T())));
+        }
+
+        template <typename O>
+        typename O::V tan(typename O::V x)
+        {
+            typedef typename O::T T;
+            typedef typename O::V V;
+            const V ax = O::abs(x);
+            // tan(x) = 1/tan(pi/2-x) above pi/4. The first subtraction is exact there.
+            const typename O::M high = O::cmpgt(ax, O::set1(0.78539816339744831));
+            const V y = O::select(high, O::add(O::sub(O::set1(Constants<T>::halfPiHi), ax), O::set1(Constants<T>::halfPiLo)), ax);
+            const V y2 = O::mul(y, y);
+            const V t = O::add(y, O::mul(O::mul(y, y2), tanPoly<O>(y2, T())));
+            return O::copysign(O::select(high, O::div(O::set1(1.0), t), t), x);
+        }
+
+        template <typename O>
+        typename O::V tanh(typename O::V x)
+        {
+            typedef typename O::V V;
+            // tanh(20) rounds to 1 in double precision
+            const V ax = O::min(O::abs(x), O::set1(20.0));
+            // (e^2x - 1)/(e^2x + 1) loses relative precision near zero, where the Taylor series is used instead
+            const V e = exp2<O>(O::mul(ax, O::set1(2.8853900817779268)));
+            const V large = O::div(O::sub(e, O::set1(1.0)), O::add(e, O::set1(1.0)));
+            const V x2 = O::mul(ax, ax);
+            const V small = O::mul(ax, poly<O>(x2, 1.0, -1.0 / 3.0, 2.0 / 15.0, -17.0 / 315.0, 62.0 / 2835.0));
+            return O::copysign(O::select(O::cmpgt(ax, O::set1(0.0625)), large, small), x);
+        }
+
+        template <typename O>
+        typename O::V pitchToFreq(typename O::V pitch)
+        {
+            return O::mul(O::set1(440.0), exp2<O>(O::mul(O::sub(pitch, O::set1(69.0)), O::set1(1.0 / 12.0))));
+        }
+    }
+
+    /**
+     * Computes x modulo m, in [0, m). Unlike WRAP, this takes the same time for any argument.
+     */
+    template <typename T>
+    T fast_wrap(T x, T m = 1.0) { return fastmath::wrap<fastmath::ScalarOps<T>>(x, m); }
+
+    /**
+     * Wraps a number to be in the range [left_m, right_m). \see WRAP2
+     */
+    template <typename T>
+    T fast_wrap2(T x, T left_m, T right_m) { return left_m + fast_wrap(x - left_m, right_m - left_m); }
+
+    template <typename T>
+    T fast_exp2(T x) { return fastmath::exp2<fastmath::ScalarOps<T>>(x); }
+
+    template <typename T>
+    T fast_log2(T x) { return fastmath::log2<fastmath::ScalarOps<T>>(x); }
+
+    /**
+     * Tangent approximation, intended for warping filter cutoffs (i.e. tan(pi*fc/fs)).
+     */
+    template <typename T>
+    T fast_tan(T x) { return fastmath::tan<fastmath::ScalarOps<T>>(x); }
+
+    template <typename T>
+    T fast_tanh(T x) { return fastmath::tanh<fastmath::ScalarOps<T>>(x); }
+
+    /**
+     * Converts pitch (midi note) to frequency. Unlike pitchToFreq, the pitch is not limited to the range of a table.
+     */
+    template <typename T>
+    T fast_pitchToFreq(T pitch) { return fastmath::pitchToFreq<fastmath::ScalarOps<T>>(pitch); }
+
+    /*
+     * Array versions. a_in and a_out may be the same array, but must not otherwise overlap.
+     */
+
+    VOSIMLIB_API void fast_wrap(const float* a_in, float* a_out, int a_n, float a_m = 1.0f);
+    VOSIMLIB_API void fast_wrap(const double* a_in, double* a_out, int a_n, double a_m = 1.0);
+    VOSIMLIB_API void fast_exp2(const float* a_in, float* a_out, int a_n);
+    VOSIMLIB_API void fast_exp2(const double* a_in, double* a_out, int a_n);
+    VOSIMLIB_API void fast_log2(const float* a_in, float* a_out, int a_n);
+    VOSIMLIB_API void fast_log2(const double* a_in, double* a_out, int a_n);
+    VOSIMLIB_API void fast_tan(const float* a_in, float* a_out, int a_n);
+    VOSIMLIB_API void fast_tan(const double* a_in, double* a_out, int a_n);
+    VOSIMLIB_API void fast_tanh(const float* a_in, float* a_out, int a_n);
+    VOSIMLIB_API void fast_tanh(const double* a_in, double* a_out, int a_n);
+    VOSIMLIB_API void fast_pitchToFreq(const float* a_in, float* a_out, int a_n);
+    VOSIMLIB_API void fast_pitchToFreq(const double* a_in, double* a_out, int a_n);
+
+    /**
+     * Name of the instruction set used by the array versions ("AVX2", "SSE2" or "scalar").
+     */
+    VOSIMLIB_API const char* fastMathInstructionSet();
+}
+
+#endif
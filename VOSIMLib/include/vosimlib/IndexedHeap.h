@@ -0,0 +1,143 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file IndexedHeap.h
+ *  \brief Fixed-capacity priority queue of small integer ids.
+ *  \details
+ *  \author Austen Satterlee
+ */
+
+#ifndef __INDEXEDHEAP__
+#define __INDEXEDHEAP__
+#include "vosimlib/common.h"
+#include <array>
+#include <cstdint>
+#include <utility>
+
+namespace syn
+{
+    /**
+     * \brief Binary max-heap of the ids in [0, MAXSIZE), each with a key.
+     *
+     * The heap keeps the position of every id, so the key of an id can be changed or the id removed in O(log n)
+     * time, which std::priority_queue cannot do. All storage is allocated up front, so none of the methods
+     * allocate.
+     *
+     * \tparam MAXSIZE One past the largest id that can be stored.
+     */
+    template <int MAXSIZE>
+    class IndexedHeap
+    {
+    public:
+        typedef int64_t key_type;
+
+        IndexedHeap() { clear(); }
+
+        void clear() {
+            m_size = 0;
+            m_positions.fill(-1);
+        }
+
+        int size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        bool contains(int a_id) const { return m_positions[a_id] >= 0; }
+
+        /**
+         * Id with the greatest key. Ties are broken arbitrarily. The heap must not be empty.
+         */
+        int top() const { return m_ids[0]; }
+
+        key_type key(int a_id) const { return m_keys[m_positions[a_id]]; }
+
+        /**
+         * Inserts an id, or changes its key if it is already in the heap.
+         */
+        void push(int a_id, key_type a_key) {
+            int pos = m_positions[a_id];
+            if (pos < 0) {
+                pos = m_size++;
+                m_ids[pos] = a_id;
+                m_positions[a_id] = pos;
+            } else if (a_key < m_keys[pos]) {
+                m_keys[pos] = a_key;
+                _siftDown(pos);
+                return;
+            }
+            m_keys[pos] = a_key;
+            _siftUp(pos);
+        }
+
+        /**
+         * Removes an id from the heap. Does nothing if it is not in the heap.
+         */
+        void remove(int a_id) {
+            const int pos = m_positions[a_id];
+            if (pos < 0)
+                return;
+            m_positions[a_id] = -1;
+            if (pos == --m_size)
+                return;
+            // Fill the hole with the last item, which may belong above or below it
+            m_ids[pos] = m_ids[m_size];
+            m_keys[pos] = m_keys[m_size];
+            m_positions[m_ids[pos]] = pos;
+            _siftUp(pos);
+            _siftDown(m_positions[m_ids[pos]]);
+        }
+
+    private:
+        void _siftUp(int a_pos) {
+            while (a_pos > 0) {
+                const int parent = (a_pos - 1) / 2;
+                if (!(m_keys[parent] < m_keys[a_pos]))
+                    break;
+                _swap(a_pos, parent);
+                a_pos = parent;
+            }
+        }
+
+        void _siftDown(int a_pos) {
+            while (true) {
+                const int left = 2 * a_pos + 1;
+                if (left >= m_size)
+                    break;
+                const int child = left + 1 < m_size && m_keys[left] < m_keys[left + 1] ? left + 1 : left;
+                if (!(m_keys[a_pos] < m_keys[child]))
+                    break;
+                _swap(a_pos, child);
+                a_pos = child;
+            }
+        }
+
+        void _swap(int a_i, int a_j) {
+            std::swap(m_ids[a_i], m_ids[a_j]);
+            std::swap(m_keys[a_i], m_keys[a_j]);
+            m_positions[m_ids[a_i]] = a_i;
+            m_positions[m_ids[a_j]] = a_j;
+        }
+
+    private:
+        std::array<int, MAXSIZE> m_ids; ///< Ids in heap order
+        std::array<key_type, MAXSIZE> m_keys; ///< Key of the id at the same position of m_ids
+        std::array<int, MAXSIZE> m_positions; ///< Position of each id in m_ids, or -1 if it is not in the heap
+        int m_size;
+    };
+}
+#endif
@@ -338,7 +338,7 @@ namespace syn {
 
     template <typename T, int MAXSIZE>
     bool IntMap<T, MAXSIZE>::add(int a_index, const T& a_item) {
-        if (a_index >= MAXSIZE)
+        if (a_index < 0 || a_index >= MAXSIZE)
             return false;
         if (_checkId(a_index)>=0)
             return false;
@@ -403,7 +403,7 @@ namespace syn {
 
     template <typename T, int MAXSIZE>
     int IntMap<T, MAXSIZE>::_checkId(int a_id) const {
-        return a_id>=0 && m_existances[a_id] ? a_id : -1;
+        return a_id>=0 && a_id<MAXSIZE && m_existances[a_id] ? a_id : -1;
     }
 
     template <typename T, int MAXSIZE>
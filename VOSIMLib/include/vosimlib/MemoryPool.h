@@ -19,7 +19,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 
 /**
  *  \file MemoryPool.h
- *  \brief
+ *  \brief Real-time safe allocator for memory that units claim while processing.
  *  \details
  *  \author Austen Satterlee
  *  \date 06/2016
@@ -28,48 +28,113 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #ifndef __MEMORYPOOL__
 #define __MEMORYPOOL__
 #include "vosimlib/common.h"
-#include <vector>
+#include <atomic>
+#include <cstddef>
 
 namespace syn
 {
+    /**
+     * \brief Two-level segregated fit (TLSF) allocator over a single block of memory.
+     *
+     * Free blocks are binned by size into power of two classes, each split into SL_COUNT linear subclasses, with a
+     * bitmap marking the non-empty bins. Allocating takes the first block from the smallest bin that is guaranteed
+     * to fit, and freeing merges the block with its free neighbours, so both run in constant time. Nothing is
+     * allocated from the system after construction, which makes the pool safe to use on the audio thread.
+     *
+     * The pool may be shared between threads. Each call holds a spin lock for its (short, bounded) duration.
+     */
     class VOSIMLIB_API MemoryPool
     {
-        struct Chunk
-        {
-            size_t size;
-            uint8_t* addr;
-            bool isFree;
-            Chunk* next;
-            Chunk* prev;
-
-            ~Chunk();
-        };
-
-        struct ChunkSortBySize
-        {
-            bool operator ()(const Chunk& a_lhs, const Chunk& a_rhs) const;
-        };
+    public:
+        /// Alignment of every allocation, and the granularity of block sizes
+        static const size_t MIN_ALIGNMENT = 16;
 
-        struct ChunkSortByAddr
+        struct Stats
         {
-            bool operator ()(const Chunk& a_lhs, const Chunk& a_rhs) const;
+            size_t capacity; ///< Bytes available to allocations when the pool is empty
+            size_t bytesUsed; ///< Bytes held by live allocations, including rounding
+            size_t peakBytesUsed; ///< Largest value bytesUsed has reached
+            size_t numAllocations; ///< Number of live allocations
+            size_t numFailedAllocations; ///< Number of allocations that could not be satisfied
+            size_t bytesFree; ///< Bytes in free blocks
+            size_t numFreeBlocks;
+            size_t largestFreeBlock; ///< Bytes in the largest free block
+            /**
+             * \returns The share of free memory that cannot be used for the largest possible allocation, from 0
+             * (all free memory is in one block) to nearly 1.
+             */
+            double fragmentation() const;
         };
 
-        std::vector<uint8_t> m_bytes;
-        std::vector<Chunk*> m_freeChunks;
-        std::vector<Chunk*> m_usedChunks;
-        Chunk m_head;
-        size_t m_bytesUsed;
-    public:
-        MemoryPool(size_t a_numBytes);
+        /**
+         * Reserves \p a_numBytes bytes of memory for the pool, which is the only system allocation it makes.
+         */
+        explicit MemoryPool(size_t a_numBytes);
 
         virtual ~MemoryPool();
 
-        void* allocate(size_t a_numBytes);
+        MemoryPool(const MemoryPool&) = delete;
+        MemoryPool& operator=(const MemoryPool&) = delete;
 
+        /**
+         * \param a_alignment A power of two. Allocations are always aligned to at least MIN_ALIGNMENT.
+         * \returns Memory for \p a_numBytes bytes, or nullptr if the pool does not have a large enough free block.
+         */
+        void* allocate(size_t a_numBytes, size_t a_alignment = MIN_ALIGNMENT);
+
+        /**
+         * Returns memory obtained from allocate to the pool. Does nothing if \p a_ptr is null.
+         */
         void free(void* a_ptr);
+
+        /**
+         * \returns True if \p a_ptr points into the pool's memory.
+         */
+        bool owns(const void* a_ptr) const;
+
+        /**
+         * Collects usage statistics. This walks the free blocks, so it is meant for diagnostics rather than the
+         * audio thread.
+         */
+        Stats stats() const;
+
+        /**
+         * Pool shared by units that need to grow their buffers while processing, e.g. NSampleDelay.
+         */
+        static MemoryPool& realtime();
+
     private:
-        void _joinFreeChunks(Chunk* a_chunk);
+        struct Block;
+
+        static const int SL_LOG2 = 4;
+        static const int SL_COUNT = 1 << SL_LOG2;
+        static const int ALIGN_LOG2 = 4;
+        static const int FL_SHIFT = SL_LOG2 + ALIGN_LOG2;
+        static const int FL_COUNT = 24; ///< Blocks smaller than 2 GiB
+        static const size_t SMALL_BLOCK_SIZE = size_t(1) << FL_SHIFT;
+        static const size_t MAX_BLOCK_SIZE = (size_t(1) << (FL_COUNT + FL_SHIFT - 1)) - 1;
+
+        static void _mapping(size_t a_size, int& a_fl, int& a_sl);
+        Block* _findFreeBlock(size_t a_size, int& a_fl, int& a_sl) const;
+        void _insertFreeBlock(Block* a_block);
+        void _removeFreeBlock(Block* a_block, int a_fl, int a_sl);
+        void _removeFreeBlock(Block* a_block);
+        Block* _splitBlock(Block* a_block, size_t a_size);
+        void _mergeWithNext(Block* a_block);
+        void _lock() const;
+        void _unlock() const;
+
+        char* m_memory; ///< Memory as allocated, before alignment
+        Block* m_firstBlock;
+        size_t m_capacity;
+        uint32_t m_flBitmap;
+        uint32_t m_slBitmaps[FL_COUNT];
+        Block* m_freeLists[FL_COUNT][SL_COUNT];
+        size_t m_bytesUsed;
+        size_t m_peakBytesUsed;
+        size_t m_numAllocations;
+        size_t m_numFailedAllocations;
+        mutable std::atomic_flag m_lock;
     };
 }
 #endif
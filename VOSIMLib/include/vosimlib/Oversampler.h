@@ -0,0 +1,129 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file Oversampler.h
+ *  \brief Polyphase halfband resampling between a base rate and 2x, 4x or 8x that rate.
+ *  \details
+ *  \author Austen Satterlee
+ */
+
+#ifndef __OVERSAMPLER__
+#define __OVERSAMPLER__
+#include "vosimlib/common.h"
+#include <vector>
+
+namespace syn
+{
+    /**
+     * \brief A single 2x halfband FIR stage, in polyphase form.
+     *
+     * Every other tap of a halfband filter is zero, except the centre tap, which is 1/2. The filter is applied as two
+     * phases: one is a pure delay, and the other is a symmetric filter with a_halfLength distinct coefficients, so
+     * each pair of samples at the high rate costs a_halfLength multiplies.
+     *
+     * The coefficients are a Kaiser-windowed sinc with 4*a_halfLength-1 taps, normalized for unity gain at DC.
+     */
+    class VOSIMLIB_API HalfbandStage
+    {
+    public:
+        HalfbandStage(int a_halfLength, double a_kaiserBeta);
+
+        void reset();
+
+        /**
+         * Turns one sample into two samples at twice the rate.
+         */
+        void upsample(SampleType a_in, SampleType* a_out);
+
+        /**
+         * Turns two consecutive samples into one sample at half the rate.
+         */
+        SampleType downsample(SampleType a_in0, SampleType a_in1);
+
+        /**
+         * Group delay of the filter, in samples at the high rate.
+         */
+        int delay() const { return 2 * m_halfLength - 1; }
+
+    private:
+        /**
+         * Pushes a sample into a delay line, and returns the last 2*m_halfLength samples (oldest first).
+         */
+        const SampleType* _push(std::vector<SampleType>& a_line, int& a_pos, SampleType a_in) const;
+
+        SampleType _convolve(const SampleType* a_window) const;
+
+    private:
+        int m_halfLength;
+        std::vector<SampleType> m_coefs; ///< coefficients of the odd taps, from the centre outwards
+        /// Delay lines of 2*m_halfLength samples, stored twice in a row so that the latest window is contiguous
+        std::vector<SampleType> m_upLine, m_evenLine, m_oddLine;
+        int m_upPos, m_evenPos, m_oddPos;
+    };
+
+    /**
+     * \brief Converts a signal to and from 2x, 4x or 8x its sample rate with a cascade of halfband stages.
+     *
+     * The first stage (closest to the base rate) has the steepest filter, and passes up to about 0.44 times the base
+     * rate with over 80 dB of image rejection. Later stages only need to reject images far above the base band, so they
+     * are much shorter.
+     *
+     * One oversampler holds the state of both directions, but a signal is usually only converted one way through
+     * it (e.g. Circuit keeps an upsampler per input port and a downsampler per output port). Nothing is allocated
+     * while processing.
+     */
+    class VOSIMLIB_API Oversampler
+    {
+    public:
+        /**
+         * \param a_factor 1, 2, 4, or 8. A factor of 1 copies samples through unchanged.
+         */
+        explicit Oversampler(int a_factor = 1);
+
+        int factor() const { return m_factor; }
+
+        void reset();
+
+        /**
+         * Upsamples a_n samples into a_n*factor() samples.
+         */
+        void upsample(const SampleType* a_in, SampleType* a_out, int a_n);
+
+        /**
+         * Downsamples a_n*factor() samples into a_n samples.
+         */
+        void downsample(const SampleType* a_in, SampleType* a_out, int a_n);
+
+        /**
+         * Delay added by upsampling and then downsampling a signal, in samples at the base rate.
+         */
+        double latency() const;
+
+    private:
+        void _upsample(int a_stage, SampleType a_in, SampleType* a_out);
+        SampleType _downsample(int a_stage, const SampleType* a_in);
+
+    private:
+        int m_factor;
+        std::vector<HalfbandStage> m_stages; ///< ordered from the base rate up
+    };
+}
+
+#endif
@@ -25,26 +25,38 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimlib/UnitParameter.h"
 #include "vosimlib/UnitFactory.h"
 #include "vosimlib/Logging.h"
+#include "vosimlib/Arena.h"
 
 #include <Eigen/Core>
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
 
 
 #define MAX_PARAMS 16
 #define MAX_INPUTS 8
 #define MAX_OUTPUTS 8
+#define MAX_LANES 4
+/// Number of samples between coefficient updates for units driven by control-rate inputs (see Unit::controlPeriod_)
+#define CONTROL_PERIOD 16
 
 #define DERIVE_UNIT(TYPE) \
     Unit *_clone() const override {return new TYPE(*this);} \
+    Unit *_cloneAt(void* a_memory) const override {return ::new(a_memory) TYPE(*this);} \
+    size_t _cloneSize() const override {return sizeof(TYPE);} \
 public: \
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW \
     const string& getClassName() const override {return TYPE::className();} \
     static const string& className() { static const std::string class_name = #TYPE; return class_name; } \
     static const syn::UnitTypeId& classIdentifier() { static const std::hash<string> hash_fn; static const syn::UnitTypeId id = static_cast<syn::UnitTypeId>(hash_fn(#TYPE)); return id; } \
     TYPE() : TYPE("") {} \
+    syn::Unit::ProcessFn getProcessFn() const override {return &TYPE::processStatic_;} \
+private: \
+    static void processStatic_(syn::Unit* a_unit) {static_cast<TYPE*>(a_unit)->TYPE::process_();} \
 private:
 
 #define BEGIN_PROC_FUNC \
-    for(m_currentBufferOffset=0;m_currentBufferOffset<getBufferSize();m_currentBufferOffset++){
+    for(m_currentBufferOffset=blockOffset_();m_currentBufferOffset<blockOffset_()+getBufferSize();m_currentBufferOffset++){
 #define END_PROC_FUNC }
 #define READ_OUTPUT(OUTPUT) \
     readOutput(OUTPUT, m_currentBufferOffset)
@@ -71,11 +83,28 @@ namespace syn
         bool isNoteOn;
     };
 
+    /**
+     * Summary of a buffer's samples over the current block (see Unit::setOutputConstant_). The samples are always
+     * written out in full, so readers that ignore the state still see the right values.
+     */
+    enum EBlockState
+    {
+        BlockVarying = 0, ///< Nothing is known about the block
+        BlockConstant, ///< Every sample in the block has the same value
+        BlockSilent ///< Every sample in the block is zero
+    };
+
     template<typename T>
     class VOSIMLIB_API Buffer {
     public:
         virtual ~Buffer() = default;
         virtual const T* buf() const = 0;
+
+        EBlockState blockState() const { return m_blockState; }
+        void setBlockState(EBlockState a_state) { m_blockState = a_state; }
+
+    private:
+        EBlockState m_blockState = BlockVarying;
     };
 
     template<typename T>
@@ -95,11 +124,13 @@ namespace syn
 
         OutputPort(T* a_targetBuf)
             : m_extBuf(a_targetBuf),
-              m_intBuf() {}
+              m_intBuf(),
+              m_snapshot(0.0) {}
 
         explicit OutputPort(int a_bufSize)
             : m_extBuf(nullptr),
-              m_intBuf(a_bufSize, 0.0) { }
+              m_intBuf(a_bufSize, 0.0),
+              m_snapshot(0.0) { }
 
         T* buf() { return hasExternalBuf() ? m_extBuf : m_intBuf.data(); }
         const T* buf() const override { return hasExternalBuf() ? m_extBuf : m_intBuf.data(); }
@@ -112,11 +143,33 @@ namespace syn
 
         bool hasExternalBuf() const { return m_extBuf != nullptr; }
 
+        /**
+         * Switches back to the port's own buffer, copying the samples of the external buffer into it.
+         */
+        void detachBuf() {
+            if (m_extBuf) {
+                std::copy_n(m_extBuf, m_intBuf.size(), m_intBuf.data());
+                m_extBuf = nullptr;
+            }
+        }
+
         void resize(int a_size) { m_intBuf.resize(a_size, 0.0); }
 
+        /**
+         * First sample of the most recent block, see Unit::readOutputSnapshot.
+         */
+        T snapshot() const { return m_snapshot; }
+
+        void takeSnapshot() {
+            const T* samples = buf();
+            if (samples)
+                m_snapshot = samples[0];
+        }
+
     private:
         T* m_extBuf;
         std::vector<T> m_intBuf;
+        T m_snapshot;
     };
 
     template<typename T>
@@ -124,9 +177,12 @@ namespace syn
         InputPort()
             : InputPort(0.0) {}
 
-        explicit InputPort(T a_defVal)
+        explicit InputPort(T a_defVal, bool a_controlRate = false)
             : defVal(a_defVal),
+              controlRate(a_controlRate),
               src(nullptr) {}
+
+        bool isControlRate() const { return controlRate; }
     
     private:
         friend class Unit;
@@ -138,6 +194,7 @@ namespace syn
         bool isConnected() const { return src != nullptr; }
 
         T defVal;
+        bool controlRate; ///< True if the unit only reads this input once per control period
         const Buffer<T>* src;
     };
 
@@ -217,11 +274,14 @@ namespace syn
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     public:
-        typedef double SampleType;
+        typedef ::syn::SampleType SampleType;
         typedef Eigen::Array<SampleType, -1, -1, Eigen::RowMajor> dynamic_buffer_t;
         typedef OutputPort<SampleType> OutputPort;
         typedef Buffer<SampleType> Buffer;
         typedef InputPort<SampleType> InputPort;
+        typedef void (*ProcessFn)(Unit*);
+        typedef void (*LaneProcessFn)(Unit* const*, int);
+        typedef Eigen::Array<double, MAX_LANES, 1> LaneArray; ///< One value per voice lane, kept in double for filter state
 
         Unit();
 
@@ -237,7 +297,38 @@ namespace syn
         /**
          * Processes as many samples as required to fill the internal buffer (see Unit::getBufferSize and Unit::setBufferSize).
          */
-        void tick() { process_(); }
+        void tick() {
+            _resolveBlockSpans();
+            process_();
+            _snapshotOutputs();
+        }
+
+        /**
+         * Processes samples [a_offset, a_offset + a_length) of the internal buffer, leaving the rest untouched. A
+         * block can be split into several ranges this way (e.g. at MIDI events, see VoiceManager::tick), as long
+         * as they are processed in order.
+         */
+        void tick(int a_offset, int a_length) {
+            _resolveBlockSpans();
+            _processRange(getProcessFn(), a_offset, a_length);
+        }
+
+        /**
+         * Returns a function that runs the derived class's Unit::process_ on a unit without going through a
+         * virtual call. Unlike Unit::tick, the block spans are not resolved first, so the caller is responsible
+         * for keeping them up to date (see Circuit).
+         */
+        virtual ProcessFn getProcessFn() const { return &Unit::processDispatch_; }
+
+        /**
+         * Returns a function that processes one block of up to MAX_LANES units of the same type at once, with
+         * each unit's state spread across the lanes of a LaneArray. It is called as `fn(units, numLanes)`, and
+         * the units must have resolved block spans and the same buffer size (see Circuit::tickLanes).
+         *
+         * Returns nullptr if the unit has no lane kernel, which is the default. Derived classes of a unit that
+         * provides one must override this again.
+         */
+        virtual LaneProcessFn getLaneProcessFn() const { return nullptr; }
 
         /**
          * Processes as many samples to fill the specified output buffer. 
@@ -358,6 +449,14 @@ namespace syn
 
         double readOutput(int a_id, int a_offset) const;
 
+        /**
+         * Returns the first sample of the output's most recent block. Inside a circuit, an output's buffer may be
+         * reused by later units in the same block (see CircuitPlan::bufferAssignments), so readOutput is only
+         * meaningful while the unit is processing. The snapshot is taken as soon as the unit has processed, and is
+         * what should be shown to the user.
+         */
+        double readOutputSnapshot(int a_id) const;
+
         const StrMap<OutputPort, MAX_OUTPUTS>& outputs() const;
 
         OutputPort& output(int a_id);
@@ -389,7 +488,8 @@ namespace syn
 
         /**
          * Copies this unit into newly allocated memory (the caller is responsible for releasing the memory).
-         * Connections to other units are not preserved in the clone.
+         * Connections to other units are not preserved in the clone. Parameter values are copied exactly, and the
+         * clone is configured and notified of its parameters once.
          */
         Unit* clone() const;
 
@@ -432,8 +532,66 @@ namespace syn
 
         virtual void process_() = 0;
 
-        int addInput_(const string& a_name, double a_default = 0.0);
-        bool addInput_(int a_id, const string& a_name, double a_default = 0.0);
+        /**
+         * Contiguous view of the current block of samples arriving at an input port.
+         *
+         * Unconnected inputs point at a buffer filled with the port's default value. The returned pointer is
+         * only valid for the duration of Unit::process_.
+         */
+        const SampleType* inputBuf_(int a_id) const { return m_inputSpans[a_id] + m_blockOffset; }
+
+        /**
+         * Contiguous view of the current block of samples of an output port. The returned pointer is only
+         * valid for the duration of Unit::process_.
+         */
+        SampleType* outputBuf_(int a_id) const { return m_outputSpans[a_id] + m_blockOffset; }
+
+        /**
+         * Position of the current block within the port buffers. This is zero unless the unit is part of a
+         * feedback loop, in which case its parent circuit processes it one sample at a time.
+         */
+        int blockOffset_() const { return m_blockOffset; }
+
+        /**
+         * State of the current block arriving at an input port. Unconnected inputs are constant at their default
+         * value.
+         */
+        EBlockState inputState_(int a_id) const;
+
+        bool isInputConstant_(int a_id) const { return inputState_(a_id) != BlockVarying; }
+
+        bool isInputSilent_(int a_id) const { return inputState_(a_id) == BlockSilent; }
+
+        /**
+         * Fills the current block of an output port with a single value, and flags it as constant (or silent) so
+         * that downstream units can take a fast path.
+         *
+         * The flag persists across blocks, so a unit that sets it must reset it with Unit::setOutputVarying_
+         * whenever it takes its regular path. Flags set while processing part of a block are discarded.
+         */
+        void setOutputConstant_(int a_id, SampleType a_value);
+
+        void setOutputVarying_(int a_id) { m_outputPorts[a_id].setBlockState(BlockVarying); }
+
+        /**
+         * Number of samples over which coefficients derived from the given inputs may be held or interpolated:
+         *  - the whole block if every input is constant over it,
+         *  - CONTROL_PERIOD if every input is either constant or declared control-rate (see Unit::addInput_),
+         *  - otherwise 1, i.e. coefficients must be recomputed every sample.
+         *
+         * Units should recompute their coefficients at the start of each period, from the inputs at the period's
+         * last sample, and ramp towards them only when the period is CONTROL_PERIOD. The other two cases are then
+         * exact.
+         */
+        int controlPeriod_(std::initializer_list<int> a_ids) const;
+
+        /**
+         * Adds an input port.
+         * \param a_controlRate Declares that the unit only needs to follow the input at control rate (see
+         * Unit::controlPeriod_), so the unit may interpolate its coefficients between control points.
+         */
+        int addInput_(const string& a_name, double a_default = 0.0, bool a_controlRate = false);
+        bool addInput_(int a_id, const string& a_name, double a_default = 0.0, bool a_controlRate = false);
 
         bool removeInput_(const string& a_name);
         bool removeInput_(int a_id);
@@ -447,10 +605,57 @@ namespace syn
         void copyFrom_(const Unit& a_other);
 
     private:
+        static void processDispatch_(Unit* a_unit) { a_unit->process_(); }
+
         void _setParent(Circuit* a_new_parent);
 
+        /**
+         * Points the block-span tables at the current input sources and output buffers.
+         */
+        void _resolveBlockSpans();
+
+        /**
+         * Refills the default-value rows used by unconnected inputs.
+         */
+        void _updateDefaultInputBufs();
+
+        /**
+         * Runs a_process over samples [a_offset, a_offset + a_length) of the unit's buffers. During the call,
+         * getBufferSize returns a_length and the block spans start at a_offset.
+         */
+        void _processRange(ProcessFn a_process, int a_offset, int a_length);
+
+        /**
+         * Records the first sample of each output, see readOutputSnapshot.
+         */
+        void _snapshotOutputs();
+
         virtual Unit* _clone() const = 0;
 
+        /**
+         * Copy constructs the unit in \p a_memory, which holds _cloneSize() bytes and is cache line aligned. Units
+         * that do not support it (e.g. ones defined in Python) return nullptr, and are cloned on the heap instead.
+         */
+        virtual Unit* _cloneAt(void* /*a_memory*/) const { return nullptr; }
+        virtual size_t _cloneSize() const { return 0; }
+
+        /**
+         * Like clone, but constructs the copy in \p a_arena, which the copy keeps alive. The copy must be destroyed
+         * with _destroy.
+         * \returns The copy, or nullptr if the unit does not support it or the arena is full.
+         */
+        Unit* _cloneInto(const std::shared_ptr<Arena>& a_arena) const;
+
+        /**
+         * Destroys a unit made by clone or _cloneInto.
+         */
+        static void _destroy(Unit* a_unit);
+
+        /**
+         * Copies the state of a freshly constructed clone from this unit.
+         */
+        void _initClone(Unit* a_clone) const;
+
     private:
         friend class UnitFactory;
         friend class Circuit;
@@ -466,6 +671,14 @@ namespace syn
         Circuit* m_parent;
         AudioConfig m_audioConfig;
         MidiData m_midiData;
+
+        std::array<const SampleType*, MAX_INPUTS> m_inputSpans;
+        std::array<SampleType*, MAX_OUTPUTS> m_outputSpans;
+        dynamic_buffer_t m_defaultInputBufs; ///< one row per input id, filled with the port's default value
+        int m_blockOffset; ///< see Unit::blockOffset_
+        bool m_isSubBlock; ///< True while inside Unit::_processRange
+        std::shared_ptr<Arena> m_arena; ///< Arena the unit was constructed in by _cloneInto, or null if it was made with new
+        uint64_t m_uid; ///< Shared by a unit and its clones, and by no other unit, see Circuit::adoptUnits
     };
 
     template <typename ID>
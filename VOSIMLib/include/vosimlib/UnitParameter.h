@@ -134,6 +134,12 @@ namespace syn
         bool isVisible() const;
 
         bool set(double a_value);
+        /**
+         * Copies the value of the same parameter of another unit, along with the settings that may have changed
+         * since it was constructed (range, shape, visibility, control type and display precision), without
+         * notifying the parent unit.
+         */
+        void copyValue(const UnitParameter& a_other);
         /**
          * Set the parameter from a number in the range (0,1)
          * \return true if the parameter value was changed
@@ -164,6 +170,11 @@ namespace syn
         const vector<DisplayText>& getDisplayTexts() const;
 
         UnitParameter& load(const json& j);
+        /**
+         * Restores a saved parameter from its raw state, e.g. from a binary circuit file (see CircuitFile.h). Unlike
+         * load, the value is restored exactly rather than parsed from its display string.
+         */
+        UnitParameter& restore(EParamType a_type, double a_min, double a_max, vector<DisplayText>&& a_displayTexts, double a_value);
 
         operator json() const;
 
@@ -21,11 +21,23 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #define __VOICEMANAGER__
 #include "vosimlib/Circuit.h"
 #include "vosimlib/Unit.h"
+#include "vosimlib/WorkerPool.h"
+#include "vosimlib/IndexedHeap.h"
+#include "vosimlib/CommandPool.h"
 #include <boost/lockfree/spsc_queue.hpp>
 #include <boost/lockfree/policies.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #define MAX_VOICEMANAGER_MSG_QUEUE_SIZE 1024
-#define MAX_VOICES 16
+#define MAX_VOICES 256
 
 using std::string;
 using boost::lockfree::spsc_queue;
@@ -35,6 +47,23 @@ namespace syn {
     
     class Command;
 
+    /**
+     * \brief A MIDI event, timestamped with the sample of the block at which it takes effect.
+     */
+    struct MidiEvent {
+        enum Type {
+            NoteOn = 0,
+            NoteOff,
+            ControlChange,
+            PitchWheel
+        };
+
+        int offset; ///< Sample of the block at which the event takes effect
+        Type type;
+        int number; ///< Note number or CC index. Unused by pitch wheel events.
+        double value; ///< Velocity, CC value, or pitch wheel position. Unused by note off events.
+    };
+
     class VOSIMLIB_API VoiceManager {
     public:
         enum VoiceStealPolicy {
@@ -47,33 +76,136 @@ namespace syn {
     public:
         VoiceManager()
             :
+            m_commandPool(MAX_VOICEMANAGER_MSG_QUEUE_SIZE),
             m_queuedActions{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_finishedActions{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_numActionsInFlight(0),
+            m_numActionOverflows(0),
+            m_readyVoiceSets{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_retiredVoiceSets{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_staleVoiceSets{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_reconfiguredVoiceSets{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_awaitingVoiceSet(false),
+            m_stopBuilder(false),
+            m_modelEvents{MAX_VOICEMANAGER_MSG_QUEUE_SIZE},
+            m_firstIdleVoice(0),
+            m_numIdleVoices(0),
             m_lastVoiceIndex(0),
             m_voiceTicks(0),
             m_bufferSize(1),
             m_internalBufferSize(1),
+            m_configVersion(0),
             m_instrument{"main"},
+            m_fs(m_instrument.fs()),
+            m_tempo(m_instrument.tempo()),
             m_voiceStealingPolicy(Oldest),
-            m_legato(false)
+            m_legato(false),
+            m_numActiveVoices(0),
+            m_numLanes(1),
+            m_numGroups(0),
+            m_leftInput(nullptr),
+            m_rightInput(nullptr),
+            m_renderOffset(0),
+            m_renderLength(0)
         {
             setBufferSize(m_bufferSize);
             setInternalBufferSize(m_internalBufferSize);
         }
 
-        void tick(const double* a_left_input, const double* a_right_input, double* a_left_output, double* a_right_output) ;
+        ~VoiceManager();
+
+        /**
+         * Renders one block of VoiceManager::setBufferSize samples.
+         *
+         * The block is split at the offsets of \p a_events, so that each event takes effect at its own sample
+         * instead of at the start of the block. The events must be sorted by offset. Events whose offset is past
+         * the end of the block are applied after it.
+         */
+        void tick(const SampleType* a_left_input, const SampleType* a_right_input, SampleType* a_left_output, SampleType* a_right_output,
+                  const MidiEvent* a_events = nullptr, int a_numEvents = 0);
 
         /**
          * Safely queue a function to be called on the real-time thread in between samples.
          * 
          * Note that this function should ONLY be called from the gui thread! This is a single-producer
          * single-consumer queue!
+         *
+         * The command is made in a preallocated CommandPool, and once it has run it is handed back to the gui
+         * thread to be destroyed, so the real-time thread neither allocates nor frees memory. If the queue is
+         * full, the command is held back and sent by a later call to queueAction or onIdle, so edits are never
+         * dropped or reordered.
          * 
-         * \returns True if the message was pushed onto the queue, false if the queue was full.
+         * \returns True if the command was sent to the real-time thread right away, false if it was held back.
+         */
+        template <class T>
+        bool queueAction(T&& a_action) { return queueAction(m_commandPool.make(std::forward<T>(a_action))); }
+
+        /**
+         * Same as above, for a command that was allocated with `new`. The VoiceManager takes ownership of it.
          */
         bool queueAction(Command* a_action);
 
+        /**
+         * Number of commands that have been sent to the real-time thread and not yet handed back.
+         */
+        int getQueuedActionCount() const { return m_numActionsInFlight; }
+
+        /**
+         * Number of commands held back on the gui thread because the queue was full.
+         */
+        int getPendingActionCount() const { return static_cast<int>(m_pendingActions.size()); }
+
+        /**
+         * Total number of commands that have been held back because the queue was full.
+         */
+        int getActionOverflowCount() const { return m_numActionOverflows; }
+
+        /**
+         * \brief Edits the patch without interrupting the voices that are playing.
+         *
+         * \p a_edit is applied to the prototype circuit right away, on the calling thread. A background thread then
+         * builds a new set of voices from the prototype, which VoiceManager::tick swaps in for the old set between
+         * two blocks. The units that survive the edit carry their state over to the new voices (see
+         * Circuit::adoptUnits), and the old voices are freed on the background thread, so the real-time thread
+         * neither allocates nor copies units.
+         *
+         * Like queueAction, this should only be called from the gui thread, which is the only thread that uses the
+         * prototype circuit. Changes the real-time thread has sent it since (see sendControlChange) are applied
+         * before the edit. Actions queued after the edit are held back until the new voices have been swapped in,
+         * so they may refer to units added by the edit.
+         */
+        void editCircuit(const std::function<void(Circuit&)>& a_edit);
+
+        /**
+         * \brief Replaces the patch, e.g. when a preset is loaded.
+         *
+         * The prototype circuit is replaced right away, and new voices are built and swapped in as with
+         * editCircuit, except that they start out idle.
+         */
+        void loadCircuit(const Circuit& a_circ);
+
+        /**
+         * Changes the number of voices without blocking the real-time thread. The new voices are built and swapped
+         * in as with loadCircuit.
+         */
+        void queueMaxVoices(int a_newMax);
+
+        /**
+         * Number of voice sets that have been requested and not yet handed to the real-time thread.
+         */
+        int getPendingBuildCount() const { return static_cast<int>(m_buildingVoiceSets.size()); }
+
+        /**
+         * Blocks until every requested voice set has been built, and hands them to the real-time thread. They are
+         * swapped in by the next call to VoiceManager::tick.
+         */
+        void waitForBuilds();
+
         /**
          * \brief The number of samples read and produced by the tick() method of the VoiceManager.
+         *
+         * Like setFs and setInternalBufferSize, this changes the voices and the prototype circuit at once, so it
+         * must not be called while VoiceManager::tick is running.
          */
         void setBufferSize(int a_bufferSize);
 
@@ -81,9 +213,26 @@ namespace syn {
          * \brief Set the number of samples read and produced by the tick() method of the internal circuits.
          */
         void setInternalBufferSize(int a_internalBufferSize);
-        int getInternalBufferSize() const { return m_internalBufferSize; }
+
+        /**
+         * Same as setInternalBufferSize, while the real-time thread is running. The prototype circuit is changed
+         * right away, and new voices are built and swapped in as with loadCircuit. Should only be called from the
+         * gui thread.
+         */
+        void queueInternalBufferSize(int a_internalBufferSize);
+
+        /**
+         * Internal buffer size of the prototype circuit. Voices take it on once the voices built by
+         * queueInternalBufferSize have been swapped in.
+         */
+        int getInternalBufferSize() const { return m_instrument.getBufferSize(); }
 
         void setFs(double a_newFs);
+
+        /*
+         * The following are called from the real-time thread. They change the voices right away, and the prototype
+         * circuit the next time the gui thread calls onIdle or editCircuit.
+         */
         void setTempo(double a_newTempo);
         void noteOn(int a_noteNumber, int a_velocity);
         void noteOff(int a_noteNumber);
@@ -92,6 +241,13 @@ namespace syn {
 
         void setMaxVoices(int a_newMax);
 
+        /**
+         * Indices of the voices that VoiceManager::tick renders, in no particular order. Unlike
+         * getActiveVoiceIndices, this does not allocate.
+         */
+        const int* getActiveVoices() const { return m_activeVoices.data(); }
+        int getNumActiveVoices() const { return m_numActiveVoices; }
+
         vector<int> getActiveVoiceIndices() const;
         vector<int> getReleasedVoiceIndices() const;
         vector<int> getIdleVoiceIndices() const;
@@ -104,7 +260,8 @@ namespace syn {
 
         /**
          * Retrieves a unit from a specific voice circuit.
-         * If \p a_voiceId is negative, the unit is retrieved from the prototype circuit.
+         * If \p a_voiceId is negative, the unit is retrieved from the prototype circuit, which only the gui thread
+         * may use.
          */
         Unit& getUnit(int a_id, int a_voiceInd = -1);
         const Unit& getUnit(int a_id, int a_voiceInd = -1) const;
@@ -121,7 +278,50 @@ namespace syn {
         void setPrototypeCircuit(const Circuit& a_circ);
 
         VoiceStealPolicy getVoiceStealPolicy() const { return m_voiceStealingPolicy; }
-        void setVoiceStealPolicy(VoiceStealPolicy a_newPolicy) { m_voiceStealingPolicy = a_newPolicy; }
+        void setVoiceStealPolicy(VoiceStealPolicy a_newPolicy);
+
+        /**
+         * \brief Set the number of threads used to render voices.
+         * 
+         * Active voices are rendered in parallel into their own buffers, and then mixed in the order of the active
+         * voice list, so the output does not depend on the number of threads. A value of 1 renders every voice on
+         * the calling thread.
+         * 
+         * This is not real-time safe, and must not be called while VoiceManager::tick is running.
+         */
+        void setNumThreads(int a_numThreads) { m_workerPool.setNumThreads(a_numThreads > 0 ? a_numThreads : 1); }
+        int getNumThreads() const { return m_workerPool.getNumThreads(); }
+
+        /**
+         * \brief Set the number of voices processed together by the units' lane kernels.
+         * 
+         * Active voices that share an execution plan are ticked in groups of up to \p a_numLanes (see
+         * Circuit::tickLanes). A value of 1, the default, ticks every voice on its own. Values are clamped to
+         * [1, MAX_LANES].
+         */
+        void setNumLanes(int a_numLanes);
+        int getNumLanes() const { return m_numLanes; }
+
+    private:
+        /**
+         * Renders samples [a_offset, a_offset + a_length) of the active voices, and adds them to the output.
+         */
+        void _renderRange(int a_offset, int a_length, SampleType* a_left_output, SampleType* a_right_output);
+
+        /**
+         * Renders the current range of the given voices into their rows of `m_voiceBuffers`, ticking them in lockstep.
+         */
+        void _renderVoices(const int* a_voiceIndices, int a_numVoices);
+
+        /**
+         * WorkerPool task that renders the a_index'th group of active voices.
+         */
+        static void _renderGroupTask(void* a_context, int a_index);
+
+        /**
+         * Resizes the per-voice render buffers to fit the current number of voices and buffer size.
+         */
+        void _resizeVoiceBuffers();
 
     private:
         /**
@@ -129,21 +329,207 @@ namespace syn {
          */
         void _flushActionQueue();
 
+        /**
+         * Destroys the commands that the real-time thread has finished with. Called from the gui thread.
+         */
+        void _collectFinishedActions();
+
+        /**
+         * Sends as many held back commands as the queue has room for. Called from the gui thread.
+         * \returns True if any command was sent.
+         */
+        bool _sendPendingActions();
+
+        bool _sendAction(Command* a_action);
+
+        void _applyEvent(const MidiEvent& a_event);
+
+        /**
+         * Puts every voice in the idle list.
+         */
+        void _resetVoiceAllocation();
+
     private:
-        spsc_queue<Command*> m_queuedActions;
+        /**
+         * A set of voices built off the real-time thread, see VoiceManager::editCircuit.
+         */
+        struct VoiceSet
+        {
+            std::unique_ptr<const CircuitBlueprint> blueprint; ///< Snapshot of the prototype circuit the voices are built from
+            int numVoices;
+            int bufferSize; ///< Number of columns of voiceBuffers
+            int internalBufferSize; ///< Buffer size of the voices
+            double fs; ///< Sampling frequency of the voices
+            int configVersion; ///< Value of VoiceManager::m_configVersion that the above were taken from
+            bool carryState; ///< Whether the voices take over the state of the ones they replace
+            std::atomic<bool> built;
+            vector<Circuit> voices;
+            vector<int> voiceBirths;
+            Eigen::Array<SampleType, -1, -1, Eigen::RowMajor> voiceBuffers;
+        };
+
+        /**
+         * A change made to the voices on the real-time thread, which the gui thread makes to the prototype circuit.
+         */
+        struct ModelEvent
+        {
+            enum Type
+            {
+                ControlChange = 0,
+                PitchWheel,
+                Tempo
+            };
+
+            Type type;
+            int number; ///< CC index. Unused by the other types.
+            double value;
+        };
+
+        /**
+         * Makes the changes sent by the real-time thread to the prototype circuit. Called from the gui thread.
+         */
+        void _applyModelEvents();
+
+        /**
+         * Sends a change to the gui thread, or drops it if the gui thread has fallen too far behind. Called from the
+         * real-time thread.
+         */
+        void _sendModelEvent(ModelEvent::Type a_type, int a_number, double a_value);
+
+        /**
+         * \returns The internal buffer size closest to \p a_internalBufferSize that the buffer size is a multiple of.
+         */
+        int _fitInternalBufferSize(int a_internalBufferSize) const;
+
+        /**
+         * Snapshots the prototype circuit and asks the builder thread for a new set of voices. Called from the gui thread.
+         */
+        void _requestBuild(int a_numVoices, bool a_carryState);
+
+        /**
+         * Swaps in the next set of voices handed over by the gui thread. Called from the real-time thread.
+         */
+        void _installVoiceSet();
+
+        /**
+         * Swaps in \p a_set, or sends it back to the builder thread if it was set up for another sampling frequency
+         * or buffer size, see VoiceManager::m_awaitingVoiceSet. Called from the real-time thread.
+         */
+        void _installVoiceSet(VoiceSet* a_set);
+
+        /**
+         * Sets up the voices and buffers of \p a_set for the sampling frequency and buffer sizes it records.
+         */
+        void _reconfigureVoiceSet(VoiceSet& a_set);
+
+        /**
+         * Body of the builder thread: builds the requested voice sets, and frees the retired ones.
+         */
+        void _builderLoop();
+
+        void _buildVoiceSet(VoiceSet& a_set);
+
+        /**
+         * Pool used to build voices, made on first use so that VoiceManagers that never build in parallel do not
+         * start its threads. Safe to call from any thread.
+         */
+        WorkerPool& _getBuildPool();
+
+        /**
+         * Replaces the circuits in \p a_voices with \p a_numVoices copies of the blueprint, built in parallel.
+         */
+        void _stampVoices(const CircuitBlueprint& a_blueprint, vector<Circuit>& a_voices, int a_numVoices);
+
+        /**
+         * Order in which voices are stolen: the active voice with the greatest priority is stolen first.
+         * Released voices always come before held ones.
+         */
+        IndexedHeap<MAX_VOICES>::key_type _stealPriority(int a_voiceIndex) const;
+
+        /**
+         * Moves a voice that is no longer active from the active list to the back of the idle list.
+         */
+        void _deactivateVoice(int a_voiceIndex);
+
+        /**
+         * Adds a voice to the list of voices holding its note, so that VoiceManager::noteOff can find it.
+         */
+        void _linkNote(int a_voiceIndex);
+        void _unlinkNote(int a_voiceIndex);
+
+    private:
+        CommandPool m_commandPool; ///< Used by the gui thread only
+        spsc_queue<Command*> m_queuedActions; ///< Commands sent from the gui thread to the real-time thread
+        spsc_queue<Command*> m_finishedActions; ///< Commands handed back to the gui thread after they have run
+        std::deque<Command*> m_pendingActions; ///< Commands held back because the queue was full
+        int m_numActionsInFlight; ///< Number of commands in m_queuedActions or m_finishedActions
+        int m_numActionOverflows;
+
+        /*
+         * Voice sets move from the gui thread to the builder thread (m_buildJobs) and back (VoiceSet::built), then
+         * to the real-time thread (m_readyVoiceSets), which hands the voices they replace to the builder thread
+         * (m_retiredVoiceSets). A null entry in m_pendingActions stands for the command that swaps in the first
+         * set of m_buildingVoiceSets, so that it is sent in order with the other actions. A set that is out of date
+         * by the time it is swapped in goes back to the builder thread (m_staleVoiceSets) to be reconfigured, and
+         * is swapped in once it returns (m_reconfiguredVoiceSets).
+         */
+        std::deque<VoiceSet*> m_buildingVoiceSets; ///< Sets requested by the gui thread and not yet sent, in order
+        std::deque<VoiceSet*> m_buildJobs; ///< Sets waiting for the builder thread, guarded by m_buildMutex
+        spsc_queue<VoiceSet*> m_readyVoiceSets; ///< Built sets sent from the gui thread to the real-time thread
+        spsc_queue<VoiceSet*> m_retiredVoiceSets; ///< Replaced voices sent from the real-time thread to the builder thread
+        spsc_queue<VoiceSet*> m_staleVoiceSets; ///< Out of date sets sent from the real-time thread to the builder thread
+        spsc_queue<VoiceSet*> m_reconfiguredVoiceSets; ///< Stale sets sent back to the real-time thread once reconfigured
+        bool m_awaitingVoiceSet; ///< Set while a stale set is away, during which the real-time thread holds back the actions that follow it
+        std::mutex m_buildMutex;
+        std::condition_variable m_buildCondition; ///< Signalled when a job is added, a set is built, or the builder is stopped
+        bool m_stopBuilder; ///< Guarded by m_buildMutex
+        spsc_queue<ModelEvent> m_modelEvents; ///< Changes sent from the real-time thread to the gui thread, see _applyModelEvents
+        std::thread m_builder; ///< Started by the first call to _requestBuild
+        std::unique_ptr<WorkerPool> m_buildPool; ///< Used to build voices, so that building never competes with rendering for m_workerPool. See _getBuildPool.
+        std::once_flag m_buildPoolFlag;
 
         vector<Circuit> m_voices;
         vector<int> m_voiceBirths; ///< value of `m_voiceTicks` recorded upon voice activation
+
+        /*
+         * Voice allocation state. Every voice is either in the idle list or in m_activeVoices, and the active
+         * voices are also in m_stealQueue. Voices that hold a note are in a doubly linked list of the voices
+         * holding notes with the same number modulo NUM_NOTE_LISTS.
+         */
+        static const int NUM_NOTE_LISTS = 128;
+        std::array<int, MAX_VOICES> m_idleVoices; ///< Ring buffer of idle voices, reused in the order they went idle
+        int m_firstIdleVoice;
+        int m_numIdleVoices;
+        std::array<int, MAX_VOICES> m_activePositions; ///< Position of each voice in m_activeVoices, or -1 if idle
+        IndexedHeap<MAX_VOICES> m_stealQueue;
+        std::array<int, NUM_NOTE_LISTS> m_noteLists; ///< First voice of each note list, or -1
+        std::array<int, MAX_VOICES> m_nextNoteVoice, m_prevNoteVoice; ///< Links of the note lists, -1 at either end
+        std::array<bool, MAX_VOICES> m_holdsNote; ///< Whether each voice is in a note list
         int m_lastVoiceIndex;
         int m_voiceTicks; ///< counts the total number of voices activated since the beginning
         int m_bufferSize; ///< size of the buffers that will be written to by VoiceManager::tick
         int m_internalBufferSize; ///< size of the voice buffers that will be read from by VoiceManager::tick
+        int m_configVersion; ///< Incremented by setFs, setBufferSize and setInternalBufferSize, so that voice sets requested before can tell they are out of date
 
-        Circuit m_instrument;
+        Circuit m_instrument; ///< The prototype circuit, only used by the gui thread
+        double m_fs; ///< Sampling frequency of the voices, only used by the real-time thread
+        double m_tempo; ///< Tempo of the voices, only used by the real-time thread
 
         VoiceStealPolicy m_voiceStealingPolicy; ///< Determines which voices are replaced when all of them are active
 
         bool m_legato; ///< When true, voices get reset upon activation only if they are in the "note off" state.
+
+        WorkerPool m_workerPool;
+        Eigen::Array<SampleType, -1, -1, Eigen::RowMajor> m_voiceBuffers; ///< Left and right output of each voice, in rows 2*i and 2*i+1
+        std::array<int, MAX_VOICES> m_activeVoices; ///< Dense list of the active voices, which VoiceManager::tick renders
+        int m_numActiveVoices;
+        int m_numLanes; ///< Maximum number of voices in a group, see VoiceManager::setNumLanes
+        std::array<int, MAX_VOICES + 1> m_groupOffsets; ///< Group i is made of m_activeVoices[m_groupOffsets[i]:m_groupOffsets[i+1]]
+        int m_numGroups;
+        const SampleType* m_leftInput;
+        const SampleType* m_rightInput;
+        int m_renderOffset; ///< Range of the block being rendered by VoiceManager::_renderRange
+        int m_renderLength;
     };
 }
 #endif
@@ -0,0 +1,110 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ *  \file WorkerPool.h
+ *  \brief Real-time safe thread pool.
+ *  \details
+ *  \author Austen Satterlee
+ */
+
+#ifndef __WORKERPOOL__
+#define __WORKERPOOL__
+#include "vosimlib/common.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace syn
+{
+    /**
+     * \brief Pool of worker threads used to process audio in parallel.
+     *
+     * Work is handed out with WorkerPool::parallelFor, which may be called from the real-time thread: it does
+     * not allocate, and it only takes a lock when a worker has gone to sleep. Idle workers spin for a while
+     * before parking, so the jobs issued during a block do not pay for a wake-up.
+     *
+     * The calling thread takes part in the work, so a pool with N threads starts N-1 workers. A pool with a
+     * single thread runs everything on the calling thread.
+     */
+    class VOSIMLIB_API WorkerPool
+    {
+    public:
+        typedef void (*TaskFn)(void* a_context, int a_index);
+
+        /// Maximum number of tasks in a single call to parallelFor
+        static const int MAX_TASKS = 0xFFFF;
+
+        explicit WorkerPool(int a_numThreads = 1);
+
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        /**
+         * Stops the current workers and starts new ones. This is not real-time safe, and must not be called while
+         * another thread is inside WorkerPool::parallelFor.
+         */
+        void setNumThreads(int a_numThreads);
+
+        int getNumThreads() const { return static_cast<int>(m_workers.size()) + 1; }
+
+        /**
+         * Calls `a_fn(a_context, i)` for every i in [0, a_count), and returns once all of the calls have finished.
+         * The order in which tasks run, and the threads they run on, are unspecified.
+         *
+         * Calls made from within a task, or while the pool is busy with another thread's job, run serially on
+         * the calling thread.
+         */
+        void parallelFor(int a_count, TaskFn a_fn, void* a_context);
+
+    private:
+        void _workerLoop();
+
+        /**
+         * Claims and runs tasks from the given job until none are left.
+         */
+        void _runTasks(uint32_t a_generation);
+
+        void _stopWorkers();
+
+    private:
+        std::vector<std::thread> m_workers;
+
+        /**
+         * Current job: the generation in the upper 32 bits, the number of tasks in the next 16 bits, and the index
+         * of the next unclaimed task in the lower 16 bits. Tasks are claimed by incrementing the ticket.
+         */
+        std::atomic<uint64_t> m_ticket;
+        std::atomic<int> m_remaining; ///< Tasks of the current job that have not finished yet
+        std::atomic<bool> m_busy; ///< True while a job is in progress
+        std::atomic<int> m_numParked;
+        std::atomic<bool> m_stop;
+        std::mutex m_parkMutex;
+        std::condition_variable m_parkCond;
+
+        TaskFn m_fn;
+        void* m_context;
+    };
+}
+
+#endif
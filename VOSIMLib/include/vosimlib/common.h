@@ -56,4 +56,14 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 
 namespace syn{
     typedef uint64_t UnitTypeId;
+
+    /**
+     * Sample type used by port buffers, lookup tables and the host interface. Define VOSIMLIB_SINGLE_PRECISION
+     * to build the engine with single precision samples. Units may still keep their internal state in double.
+     */
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    typedef float SampleType;
+#else
+    typedef double SampleType;
+#endif
 }
@@ -40,11 +40,11 @@ namespace syn {
     template <class T>
     class VOSIMLIB_API LUT {
     protected:
-        const double* m_data;
+        const SampleType* m_data;
     public:
         const int m_size;
 
-        LUT(const double* a_data, int a_size)
+        LUT(const SampleType* a_data, int a_size)
             : m_data(a_data),
               m_size(a_size) {}
 
@@ -76,7 +76,7 @@ namespace syn {
             return phase;
         }
 
-        const double* data() const {
+        const SampleType* data() const {
             return m_data;
         }
     };
@@ -84,7 +84,7 @@ namespace syn {
     class VOSIMLIB_API AffineTable : public LUT<AffineTable> {
         double m_min, m_max, m_scale;
     public:
-        AffineTable(const double* a_data, int a_size, double a_min = 0.0, double a_max = 1.0)
+        AffineTable(const SampleType* a_data, int a_size, double a_min = 0.0, double a_max = 1.0)
             : LUT<AffineTable>(a_data, a_size),
               m_min(a_min),
               m_max(a_max),
@@ -100,7 +100,7 @@ namespace syn {
 
     class VOSIMLIB_API NormalTable : public LUT<NormalTable> {
     public:
-        NormalTable(const double* a_data, int a_size)
+        NormalTable(const SampleType* a_data, int a_size)
             : LUT<NormalTable>(a_data, a_size) {}
 
         double index(double phase) const {
@@ -110,7 +110,7 @@ namespace syn {
 
     class VOSIMLIB_API BlimpTable : public LUT<BlimpTable> {
     public:
-        BlimpTable(const double* a_data, int a_size, int a_taps, int a_res)
+        BlimpTable(const SampleType* a_data, int a_size, int a_taps, int a_res)
             : LUT<BlimpTable>(a_data, a_size),
               taps(a_taps),
               res(a_res) {}
@@ -128,7 +128,7 @@ namespace syn {
      */
     class VOSIMLIB_API ResampledTable : public NormalTable {
     public:
-        ResampledTable(const double* a_table, int a_size, const BlimpTable& a_blimp_table_online,
+        ResampledTable(const SampleType* a_table, int a_size, const BlimpTable& a_blimp_table_online,
                        const BlimpTable& a_blimp_table_offline);
 
         ResampledTable(const ResampledTable& a_o)
@@ -138,7 +138,7 @@ namespace syn {
         /// Retrieve a single sample from the table at the specified phase, as if the table were resampled to have the given period.
         double getResampled(double a_phase, double a_period) const;
 
-        const std::vector<std::vector<double>>& resampledTables() const { return m_resampled_tables; }
+        const std::vector<std::vector<SampleType>>& resampledTables() const { return m_resampled_tables; }
 
     private:
         void _resample_tables();
@@ -146,7 +146,7 @@ namespace syn {
     private:
         int m_num_resampled_tables;
         std::vector<int> m_resampled_sizes;
-        std::vector<std::vector<double>> m_resampled_tables;
+        std::vector<std::vector<SampleType>> m_resampled_tables;
         const BlimpTable& m_blimp_table_online;
         const BlimpTable& m_blimp_table_offline;
     };
@@ -159,7 +159,7 @@ namespace syn {
      * \param phase Phase to sample at, in the range [0,1).
      * \param newSize Desired period of resampled table (in fractional number of samples)
      */
-    double VOSIMLIB_API getresampled_single(const double* table, int size, double phase, double new_period,
+    double VOSIMLIB_API getresampled_single(const SampleType* table, int size, double phase, double new_period,
                                             const BlimpTable& blimp_table);
     /**
      * Resample an entire table to have the specified period and store the
@@ -171,12 +171,12 @@ namespace syn {
      * \param a_newSize Desired period of resampled table (in fractional number of samples). The allocated size of the output table should be ceil(period).
      * \param a_preserve_amplitude Scales min and max of output table to match input table.
      */
-    void VOSIMLIB_API resample_table(const double* a_table, int a_size, double* a_new_table, double a_new_period,
+    void VOSIMLIB_API resample_table(const SampleType* a_table, int a_size, SampleType* a_new_table, double a_new_period,
                                      const BlimpTable& a_blimp_table, bool a_preserve_amplitude = true);
 
     /**
      * \todo
      */
-    void fft_resample_table(const double* table, int size, double* resampled_table, double period);
+    void fft_resample_table(const SampleType* table, int size, SampleType* resampled_table, double period);
 }
 #endif
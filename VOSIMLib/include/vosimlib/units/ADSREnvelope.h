@@ -47,8 +47,11 @@ namespace syn {
         bool isActive() const override;
         void reset() override;
 
+        LaneProcessFn getLaneProcessFn() const override { return &ADSREnvelope::processLanes_; }
+
     protected:
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
         void onNoteOn_() override;
         void onNoteOff_() override;
         void onParamChange_(int a_paramId) override;
@@ -56,8 +56,11 @@ namespace syn {
 
         void reset() override;
 
+        LaneProcessFn getLaneProcessFn() const override { return &DCRemoverUnit::processLanes_; }
+
     protected:
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
         void onNoteOn_() override;
 
     private:
@@ -197,9 +200,10 @@ namespace syn {
 
     protected:
         void process_() override {
-            BEGIN_PROC_FUNC
-            WRITE_OUTPUT(0, pitchToFreq(READ_INPUT(0)));
-            END_PROC_FUNC
+            const SampleType* in = inputBuf_(0);
+            SampleType* out = outputBuf_(0);
+            for (int i = 0; i < getBufferSize(); i++)
+                out[i] = pitchToFreq(in[i]);
         }
     };
 
@@ -223,9 +227,11 @@ namespace syn {
 
     protected:
         void process_() override {
-            BEGIN_PROC_FUNC
-            WRITE_OUTPUT(0, samplesToPitch(freqToSamples(READ_INPUT(0), fs()), fs()));
-            END_PROC_FUNC
+            const SampleType* in = inputBuf_(0);
+            SampleType* out = outputBuf_(0);
+            const double fs = FreqToPitchUnit::fs();
+            for (int i = 0; i < getBufferSize(); i++)
+                out[i] = samplesToPitch(freqToSamples(in[i], fs), fs);
         }
     };
 
@@ -254,12 +260,14 @@ namespace syn {
 
     protected:
         void process_() override {
-            BEGIN_PROC_FUNC
-            double in = READ_INPUT(0);
-            double comp = READ_INPUT(1);
-            WRITE_OUTPUT(0, in > comp ? 1 : 0);
-            WRITE_OUTPUT(1, in <= comp ? 1 : 0);
-            END_PROC_FUNC
+            const SampleType* in = inputBuf_(0);
+            const SampleType* comp = inputBuf_(1);
+            SampleType* gtOut = outputBuf_(0);
+            SampleType* leOut = outputBuf_(1);
+            for (int i = 0; i < getBufferSize(); i++) {
+                gtOut[i] = in[i] > comp[i] ? 1 : 0;
+                leOut[i] = in[i] <= comp[i] ? 1 : 0;
+            }
         }
     };
 
@@ -23,10 +23,15 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 namespace syn {
     /**
      * General N-Sample delay
+     *
+     * The buffer is taken from MemoryPool::realtime(), so that it can grow while processing.
      */
     class VOSIMLIB_API NSampleDelay {
     public:
         NSampleDelay();
+        NSampleDelay(const NSampleDelay& a_other);
+        NSampleDelay& operator=(const NSampleDelay& a_other);
+        ~NSampleDelay();
 
         /**
          * \brief Return the most recent output calculated by process().
@@ -54,7 +59,13 @@ namespace syn {
         void reset();
         int size() const;
     private:
-        vector<double> m_buffer;
+        /**
+         * Allocates a buffer from the real-time pool, or from the heap if the pool is exhausted.
+         */
+        static double* _allocateBuffer(int a_size);
+        static void _freeBuffer(double* a_buffer);
+
+        double* m_buffer;
         int m_arraySize;
         double m_delaySamples;
         int m_curWritePhase;
@@ -54,9 +54,7 @@ namespace syn {
 
     protected:
         void process_() override {
-            BEGIN_PROC_FUNC
-            WRITE_OUTPUT(0, velocity() * 0.0078125); // divide by 128
-            END_PROC_FUNC
+            setOutputConstant_(0, velocity() * 0.0078125); // divide by 128
         };
     };
 
@@ -145,9 +143,7 @@ namespace syn {
         void reset() override {};
     protected:
         void process_() override {
-            BEGIN_PROC_FUNC
-            WRITE_OUTPUT(0, parent() ? parent()->getVoiceIndex() : 0.0);
-            END_PROC_FUNC
+            setOutputConstant_(0, parent() ? parent()->getVoiceIndex() : 0.0);
         }
     };
 }
\ No newline at end of file
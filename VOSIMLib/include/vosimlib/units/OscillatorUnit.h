@@ -66,7 +66,7 @@ namespace syn
 
     protected:
         void process_() override;
-        virtual void tickPhase_(double a_phaseOffset) ;
+        virtual void tickPhase_(double a_phaseOffset, double a_sync) ;
         virtual void updatePhaseStep_() ;
 
     protected:
@@ -121,8 +121,11 @@ namespace syn
 
         explicit BasicOscillatorUnit(const BasicOscillatorUnit& a_rhs);
 
+        LaneProcessFn getLaneProcessFn() const override { return &BasicOscillatorUnit::processLanes_; }
+
     protected:
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
     };
 
     class VOSIMLIB_API LFOOscillatorUnit : public OscillatorUnit
@@ -27,19 +27,58 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #ifndef __STATEVARIABLEFILTER__
 #define __STATEVARIABLEFILTER__
 #include "vosimlib/Unit.h"
+#include <algorithm>
+#include <cmath>
 
 namespace syn
 {
+    /**
+     * Rate at which the filters below update their state. Each input sample is held for as many updates as it
+     * takes to reach this rate: 8 at 44.1 or 48 kHz, but fewer inside an oversampled circuit (see
+     * Circuit::pOversampling), which does the oversampling for them.
+     */
+    const double c_filterUpdateRate = 8 * 44100.0;
+
+    /**
+     * Update rate of the ladder filter's antiderivative anti-aliased mode (see LadderFilterB::ModeAdaa), which
+     * needs much less oversampling than the plain nonlinearity: 2 updates per sample at 44.1 or 48 kHz, and 1 from
+     * 88.2 kHz up.
+     */
+    const double c_adaaUpdateRate = 2 * 44100.0;
+
+    /**
+     * Number of state updates per sample needed to reach a_updateRate at the given sample rate.
+     */
+    inline int filterOversamplingFactor(double a_fs, double a_updateRate = c_filterUpdateRate) {
+        return std::max(1, int(std::ceil(a_updateRate / a_fs - 1e-6)));
+    }
+
+    /**
+     * \brief Two-pole state variable filter with lowpass, bandpass, notch and highpass outputs.
+     *
+     * The default mode is a topology-preserving transform (zero-delay feedback) SVF. It integrates with the
+     * trapezoidal rule and prewarps the cutoff, so it is stable at any cutoff and matches the analog response at the
+     * cutoff frequency all the way up to Nyquist, with a single update per sample.
+     *
+     * The Chamberlin mode is the original forward Euler SVF. It is only stable well below Nyquist, so it repeats each
+     * update on the held input until it reaches c_filterUpdateRate.
+     */
     class VOSIMLIB_API StateVariableFilter : public Unit
     {
         DERIVE_UNIT(StateVariableFilter)
     public:
-        const int c_oversamplingFactor = 8;
 
         enum Param
         {
             pFc = 0,
-            pRes
+            pRes,
+            pMode
+        };
+
+        enum EMode
+        {
+            ModeTpt = 0,
+            ModeChamberlin
         };
 
         enum Input
@@ -65,33 +104,67 @@ namespace syn
 
         void reset() override;
 
+        LaneProcessFn getLaneProcessFn() const override { return &StateVariableFilter::processLanes_; }
+
     protected:
 
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
         void onNoteOn_() override;
+        void onFsChange_() override;
+        void onParamChange_(int a_paramId) override;
+
+        /**
+         * Maps a cutoff frequency to the frequency coefficient of the current mode.
+         */
+        double _cutoffCoefficient(double a_fc) const;
+        /**
+         * Per-sample cutoff increment that takes the cutoff coefficient from a_from to a_to in a_steps steps. In TPT
+         * mode the ramp is linear in frequency rather than in the prewarped coefficient.
+         */
+        double _cutoffIncrement(double a_from, double a_to, int a_steps) const;
+        double _stepCutoff(double a_F, double a_dF) const;
+
+        void _computeCoefficients(int a_sample, double& a_F, double& a_damp) const;
+
+        /**
+         * Advances the coefficients by one sample. At the start of each control period (see Unit::controlPeriod_),
+         * new targets are computed from the inputs at the period's last sample.
+         */
+        void _tickCoefficients(int a_sample, int a_period, int a_nSamples);
+
+        void _processTpt();
+        void _processChamberlin();
+        static void _processTptLanes(StateVariableFilter* const* a_units, int a_numLanes);
+        static void _processChamberlinLanes(StateVariableFilter* const* a_units, int a_numLanes);
 
-        double m_prevBPOut, m_prevLPOut;
-        double m_F, m_damp;
+        EMode m_mode;
+        double m_ic1eq, m_ic2eq; ///< Integrator states of the TPT mode
+        double m_prevBPOut, m_prevLPOut; ///< Integrator states of the Chamberlin mode
+        double m_F, m_damp; ///< Frequency coefficient and damping (g and k in the TPT mode)
+        double m_dF, m_dDamp; ///< Per-sample coefficient increments within the current control period
+        bool m_coefficientsReady; ///< False until the coefficients are first computed after a reset
+        int m_oversamplingFactor; ///< see filterOversamplingFactor
 
         const double c_minRes = 1.0;
         const double c_maxRes = 10.0;
     };
 
+    /**
+     * The trapezoidal SVF, which is now the default (TPT) mode of StateVariableFilter. Kept as a separate type so that
+     * existing patches still load.
+     */
     class VOSIMLIB_API TrapStateVariableFilter : public StateVariableFilter
     {
         DERIVE_UNIT(TrapStateVariableFilter)
     public:
-        explicit TrapStateVariableFilter(const string& a_name);
+        explicit TrapStateVariableFilter(const string& a_name) :
+            StateVariableFilter(a_name) {}
 
         TrapStateVariableFilter(const TrapStateVariableFilter& a_rhs) :
             TrapStateVariableFilter(a_rhs.name()) {}
 
-        void reset() override;
-    protected:
-        void process_() override;
-
-    protected:
-        double m_prevInput;
+        LaneProcessFn getLaneProcessFn() const override { return &StateVariableFilter::processLanes_; }
     };
 
     /**
@@ -100,10 +173,15 @@ namespace syn
     struct VOSIMLIB_API OnePoleLP
     {
         /**
-         * Set forward gain by specifying cutoff frequency.
+         * Set forward gain by specifying cutoff frequency. The gain is only recomputed when the cutoff changes.
          */
         void setFc(double a_fc);
 
+        /**
+         * Forward gain for the specified cutoff frequency.
+         */
+        double gainForFc(double a_fc) const;
+
         /**
          * Set sampling frequency
          */
@@ -116,6 +194,7 @@ namespace syn
         double m_state = 0.0;
         double m_G = 0.0; /// feed forward gain
         double m_fcScale = 1.0;
+        double m_fc = -1.0; /// cutoff that m_G was last computed for by setFc
     };
 
 
@@ -153,11 +232,23 @@ namespace syn
 
         void reset() override;;
 
+        LaneProcessFn getLaneProcessFn() const override { return &OnePoleLPUnit::processLanes_; }
+
     protected:
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
         void onFsChange_() override;
+    private:
+        /**
+         * \see StateVariableFilter::_tickCoefficients
+         */
+        void _tickCoefficients(int a_sample, int a_period, int a_nSamples);
+        double _computeGain(int a_sample) const;
+
     private:
         OnePoleLP implem;
+        double m_dG;
+        bool m_coefficientsReady;
         double m_lastSync;
     };
 
@@ -168,14 +259,17 @@ namespace syn
 
     protected:
         void onNoteOn_() override;
+        void onFsChange_() override;
+
+        int m_oversamplingFactor; ///< Number of state updates per sample, see filterOversamplingFactor
     public:
-        const int c_oversamplingFactor = 8;
 
         enum Param
         {
             pFc = 0,
             pFb,
-            pDrv
+            pDrv,
+            NUM_PARAMS
         };
 
         enum Input
@@ -195,8 +289,10 @@ namespace syn
         explicit LadderFilterA(const string& a_name);
         LadderFilterA(const LadderFilterA& a_rhs) : LadderFilterA(a_rhs.name()) {};
         void reset() override;
+        LaneProcessFn getLaneProcessFn() const override { return &LadderFilterA::processLanes_; }
     protected:
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
     protected:
         const double VT = 0.312;
         std::array<double, 4> m_V;
@@ -204,18 +300,44 @@ namespace syn
         std::array<double, 4> m_tV;
     };
 
+    /**
+     * \brief Ladder of four trapezoidal one-pole stages, with a tanh nonlinearity on the feedback path.
+     *
+     * In the default mode, the nonlinearity is evaluated directly, and the state is updated c_filterUpdateRate times
+     * per second to keep its aliasing down. In ModeAdaa, the nonlinearity is replaced by its first-order
+     * antiderivative anti-aliased version, which averages tanh between consecutive arguments. That suppresses most of
+     * the aliasing on its own, so the state is only updated c_adaaUpdateRate times per second.
+     */
     class VOSIMLIB_API LadderFilterB : public LadderFilterBase
     {
         DERIVE_UNIT(LadderFilterB)
     public:
+        enum Param
+        {
+            pMode = LadderFilterBase::NUM_PARAMS,
+            NUM_PARAMS
+        };
+
+        enum EMode
+        {
+            ModeOversampled = 0,
+            ModeAdaa
+        };
+
         explicit LadderFilterB(const string& a_name);
         LadderFilterB(const LadderFilterB& a_rhs) : LadderFilterB(a_rhs.name()) {};
         void reset() override;
+        LaneProcessFn getLaneProcessFn() const override { return &LadderFilterB::processLanes_; }
     protected:
         void process_() override;
+        static void processLanes_(Unit* const* a_units, int a_numLanes);
         void onFsChange_() override;
+        void onParamChange_(int a_paramId) override;
     protected:
         OnePoleLP m_LP[4];
+        EMode m_mode;
+        /// Previous argument and antiderivative of the nonlinearity, in ModeAdaa
+        double m_adaaX, m_adaaF;
     };
 }
 #endif
@@ -54,6 +54,8 @@ namespace syn
     private:
         double m_pulse_step, m_pulse_tune;
         int m_num_pulses;
+        double m_pulse_freq; ///< Pulse frequency last computed by updatePhaseStep_
+        double m_pulse_min_freq, m_pulse_freq_tune; ///< Inputs that m_pulse_freq was computed from
     };
 
     class VOSIMLIB_API FormantOscillator : public TunedOscillatorUnit
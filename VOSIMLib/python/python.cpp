@@ -14,8 +14,9 @@
 
 namespace py = pybind11;
 
-typedef Eigen::Matrix<double, -1, -1, Eigen::RowMajor> MatrixXdR;
-typedef Eigen::Array<double, -1, -1, Eigen::RowMajor> ArrayXXdR;
+typedef Eigen::Matrix<syn::SampleType, -1, -1, Eigen::RowMajor> MatrixXsR;
+typedef Eigen::Array<syn::SampleType, -1, -1, Eigen::RowMajor> ArrayXXsR;
+typedef Eigen::Matrix<syn::SampleType, 1, -1> RowVectorXs;
 
 template <class Base = syn::Unit>
 class PyUnit : public Base {
@@ -77,6 +78,10 @@ public:
     syn::Unit* _clone() const override {
         PYBIND11_OVERLOAD_PURE(syn::Unit*, Base, _clone, );
     }
+
+    // Python subclasses are larger than Base, so they are always cloned on the heap
+    syn::Unit* _cloneAt(void*) const override { return nullptr; }
+    size_t _cloneSize() const override { return 0; }
 };
 
 template <class Base>
@@ -111,9 +116,9 @@ public:
     }
 
     auto data() const {
-        const double* d = static_cast<const Base*>(this)->data();
+        const syn::SampleType* d = static_cast<const Base*>(this)->data();
         auto size = static_cast<const Base*>(this)->m_size;
-        return std::vector<double>(d, d+size);
+        return std::vector<syn::SampleType>(d, d+size);
     }
 };
 
@@ -123,10 +128,10 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
 
     py::class_<syn::Unit, PyUnit<syn::Unit>> unit(m, "Unit");
     unit.def(py::init<const std::string &>())
-        .def("tick", [](syn::Unit& self, const MatrixXdR& a_inputs) {
+        .def("tick", [](syn::Unit& self, const MatrixXsR& a_inputs) {
                 if (a_inputs.rows() > self.numInputs())
                     throw std::runtime_error("Input buffer should have at most " + std::to_string(self.numOutputs()) + " rows.");
-                ArrayXXdR outputs(self.numOutputs(), a_inputs.cols());
+                ArrayXXsR outputs(self.numOutputs(), a_inputs.cols());
                 self.tick(a_inputs, outputs);
                 return outputs;
             },
@@ -178,7 +183,7 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
             })
         .def_property_readonly("outputs", [](const syn::Unit& self) {
                 auto nc_outputs = self.outputs();
-                Eigen::Matrix<double, -1, -1, Eigen::RowMajor> outputs(self.numOutputs(), self.getBufferSize());
+                MatrixXsR outputs(self.numOutputs(), self.getBufferSize());
                 for (int i = 0; i < self.numOutputs(); i++) {
                     int item_id = nc_outputs.ids()[i];
                     for (int j = 0; j < self.getBufferSize(); j++) {
@@ -249,7 +254,7 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
 
     py::class_<syn::NormalTable, PyLUT<syn::NormalTable>> normalLut(m, "NormalTable");
     normalLut.def("__init__",
-                 [](syn::NormalTable& inst, const Eigen::RowVectorXd& a_table) {
+                 [](syn::NormalTable& inst, const RowVectorXs& a_table) {
                      new(&inst) syn::NormalTable(a_table.data(), a_table.cols());
                  })
              .def("__getitem__", [](const PyLUT<syn::NormalTable>& a_self, py::array_t<int> a_index) {
@@ -266,7 +271,7 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
 
     py::class_<syn::AffineTable, PyLUT<syn::AffineTable>> affineLut(m, "AffineTable");
     affineLut.def("__init__",
-                 [](syn::AffineTable& inst, const Eigen::RowVectorXd& a_table, double a_inputMin = 0, double a_inputMax = 1) {
+                 [](syn::AffineTable& inst, const RowVectorXs& a_table, double a_inputMin = 0, double a_inputMax = 1) {
                      new(&inst) syn::AffineTable(a_table.data(), a_table.cols(), a_inputMin, a_inputMax);
                  })
              .def("__getitem__", [](const PyLUT<syn::AffineTable>& a_self, py::array_t<int> a_index) {
@@ -282,7 +287,7 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
              .def_property_readonly("size", [](const syn::AffineTable& a_self) { return a_self.m_size; });
 
     py::class_<syn::BlimpTable, PyLUT<syn::BlimpTable>> blimp(m, "BlimpTable", normalLut);
-    blimp.def("__init__", [](syn::BlimpTable& inst, const Eigen::RowVectorXd& a_table, int a_taps, int a_res) {
+    blimp.def("__init__", [](syn::BlimpTable& inst, const RowVectorXs& a_table, int a_taps, int a_res) {
                  new(&inst) syn::BlimpTable(a_table.data(), a_table.cols(), a_taps, a_res);
              })
          .def("__getitem__", [](const PyLUT<syn::BlimpTable>& a_self, py::array_t<int> a_index) {
@@ -301,7 +306,7 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
 
     py::class_<syn::ResampledTable, PyLUT<syn::ResampledTable>> rstable(m, "ResampledTable", normalLut);
     rstable.def("__init__",
-               [](syn::ResampledTable& inst, const Eigen::RowVectorXd& a_table, const syn::BlimpTable& a_blimp_table_online, const syn::BlimpTable& a_blimp_table_offline ) {
+               [](syn::ResampledTable& inst, const RowVectorXs& a_table, const syn::BlimpTable& a_blimp_table_online, const syn::BlimpTable& a_blimp_table_offline ) {
                    new(&inst) syn::ResampledTable(a_table.data(), a_table.cols(), a_blimp_table_online, a_blimp_table_offline);
                })
            .def("__getitem__", [](const PyLUT<syn::ResampledTable>& a_self, py::array_t<int> a_index) {
@@ -332,8 +337,8 @@ PYBIND11_PLUGIN(pyVOSIMLib) {
     m.def("sin_table", &syn::lut_sin_table, "Sine table.", pybind11::return_value_policy::reference);
 
     m.def("resample",
-        [](const Eigen::RowVectorXd& a_input, double a_newSize, const syn::BlimpTable& a_blimpTable, bool a_normalize = true) {
-            Eigen::RowVectorXd outputs((int)ceil(a_newSize));
+        [](const RowVectorXs& a_input, double a_newSize, const syn::BlimpTable& a_blimpTable, bool a_normalize = true) {
+            RowVectorXs outputs((int)ceil(a_newSize));
             syn::resample_table(a_input.data(), a_input.cols(), outputs.data(), a_newSize, a_blimpTable, a_normalize);
             return outputs;
         },
@@ -0,0 +1,40 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vosimlib/Arena.h"
+
+namespace syn
+{
+    Arena::Arena(size_t a_capacity)
+        : m_block(new char[a_capacity + CACHE_LINE_SIZE]),
+          m_data(reinterpret_cast<char*>(cacheAlignedSize(reinterpret_cast<size_t>(m_block)))),
+          m_capacity(a_capacity),
+          m_used(0) {}
+
+    Arena::~Arena() { delete[] m_block; }
+
+    void* Arena::allocate(size_t a_numBytes) {
+        const size_t size = cacheAlignedSize(a_numBytes);
+        if (size > m_capacity - m_used)
+            return nullptr;
+        void* ptr = m_data + m_used;
+        m_used += size;
+        return ptr;
+    }
+}
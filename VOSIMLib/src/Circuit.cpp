@@ -18,6 +18,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimlib/Circuit.h"
 #include "vosimlib/DSPMath.h"
+#include "vosimlib/WorkerPool.h"
 #include <functional>
 
 using std::vector;
@@ -26,9 +27,24 @@ namespace syn
 {
     Circuit::Circuit(const string& a_name) :
         Unit(a_name),
-        m_voiceIndex(0.0)
+        m_voiceIndex(0.0),
+        m_workerPool(nullptr),
+        m_waveTasks(nullptr),
+        m_waveOffset(0),
+        m_waveLength(0),
+        m_bulkEditDepth(0),
+        m_graphDirty(false),
+        m_outgoingDirty(true),
+        m_bufferStride(0),
+        m_arenaBuffers(nullptr),
+        m_arenaBufferCapacity(0),
+        m_oversampling(1)
     {        
+        m_unitDegrees.fill(0);
+        m_inputRecords.fill(-1);
         m_execOrder.fill(nullptr);
+        m_outputAliases.fill(nullptr);
+        m_boundSteps.reserve(MAX_UNITS);
         InputUnit* inputUnit = new InputUnit("inputs");
         OutputUnit* outputUnit = new OutputUnit("outputs");
         m_units.add(inputUnit);
@@ -39,57 +55,216 @@ namespace syn
         addExternalInput_("right in");
         addExternalOutput_("left out");
         addExternalOutput_("right out");
+        addParameter_(pOversampling, UnitParameter("oversampling", {"1x", "2x", "4x", "8x"}, {1, 2, 4, 8}));
+        _recomputeGraph();
     }
 
     Circuit::Circuit(const Circuit& a_other) :
         Circuit(a_other.name())
     {
-        const int* unitIndices = a_other.m_units.ids();
+        _stampFrom(a_other);
+    }
+
+    Circuit& Circuit::operator=(const Circuit& a_other)
+    {
+        if (this != &a_other)
+            _stampFrom(a_other);
+        return *this;
+    }
+
+    void Circuit::_stampFrom(const Circuit& a_other)
+    {
+        m_bulkEditDepth++;
+        // Drop the current units and connections wholesale, instead of disconnecting them one by one
+        m_plan.reset();
+        const int* unitIndices = m_units.ids();
+        for (int i = 0; i < m_units.size();)
+        {
+            Unit* unit = m_units[unitIndices[i]];
+            if (unit == m_inputUnit || unit == m_outputUnit) {
+                i++;
+                continue;
+            }
+            m_units.removeById(unitIndices[i]);
+            Unit::_destroy(unit);
+        }
+        const int* outputIds = m_outputUnit->m_inputPorts.ids();
+        for (int i = 0; i < m_outputUnit->m_inputPorts.size(); i++)
+            m_outputUnit->disconnectInput(outputIds[i]);
+        m_connectionRecords.clear();
+        m_unitDegrees.fill(0);
+        m_inputRecords.fill(-1);
+        m_outgoingDirty = true;
+
+        // Take on a_other's settings before adding any units, so that each unit is only configured once
+        copyFrom_(a_other);
+        const double innerFs = fs() * m_oversampling;
+        // Lay the clones out contiguously in a single arena, in the order they are processed in, followed by any
+        // units the plan does not run
+        std::array<int, MAX_UNITS> cloneOrder;
+        std::array<bool, MAX_UNITS> isOrdered{};
+        int numClones = 0;
+        size_t arenaSize = 0;
+        auto orderClone = [&](int a_id) {
+            const Unit* unit = a_other.m_units[a_id];
+            if (isOrdered[a_id] || unit == a_other.m_inputUnit || unit == a_other.m_outputUnit)
+                return;
+            isOrdered[a_id] = true;
+            cloneOrder[numClones++] = a_id;
+            arenaSize += cacheAlignedSize(unit->_cloneSize());
+        };
+        if (a_other.m_plan) {
+            for (const auto& step : a_other.m_plan->steps)
+                orderClone(step.unitId);
+        }
+        const int* otherUnitIndices = a_other.m_units.ids();
         for (int i = 0; i < a_other.m_units.size(); i++)
+            orderClone(otherUnitIndices[i]);
+        // The shared output buffers go right after the units
+        const size_t numBufferSamples = a_other.m_plan ? size_t(a_other.m_plan->numBuffers) * _bufferStride() : 0;
+        arenaSize += cacheAlignedSize(numBufferSamples * sizeof(SampleType));
+        const std::shared_ptr<Arena> arena = arenaSize ? std::make_shared<Arena>(arenaSize) : nullptr;
+        m_arenaBuffers = nullptr;
+        m_arenaBufferCapacity = 0;
+
+        for (int i = 0; i < numClones; i++)
         {
-            const Unit* unit = a_other.m_units[unitIndices[i]];
-            if (unit != a_other.m_inputUnit && unit != a_other.m_outputUnit)
-                addUnit(a_other.m_units[unitIndices[i]]->clone(), unitIndices[i]);
+            const Unit* unit = a_other.m_units[cloneOrder[i]];
+            // The clone is reset, and has the same configuration as its original, which is normally ours as well
+            Unit* clone = arena ? unit->_cloneInto(arena) : nullptr;
+            if (!clone)
+                clone = unit->clone();
+            m_units.add(cloneOrder[i], clone);
+            clone->_setParent(this);
+            clone->m_midiData = m_midiData;
+            if (clone->fs() != innerFs)
+                clone->setFs(innerFs);
+            if (clone->tempo() != tempo())
+                clone->setTempo(tempo());
+            if (clone->getBufferSize() != _innerBufferSize())
+                clone->setBufferSize(_innerBufferSize());
         }
-        for (const auto& rec : a_other.m_connectionRecords)
+        m_voiceArena = arena;
+        if (numBufferSamples) {
+            m_arenaBuffers = static_cast<SampleType*>(arena->allocate(numBufferSamples * sizeof(SampleType)));
+            std::fill_n(m_arenaBuffers, numBufferSamples, 0.0);
+            m_arenaBufferCapacity = numBufferSamples;
+        }
+
+        // The topology is identical to a_other's, so copy its connection index and reuse its plan
+        m_connectionRecords = a_other.m_connectionRecords;
+        m_unitDegrees = a_other.m_unitDegrees;
+        m_inputRecords = a_other.m_inputRecords;
+        for (const auto& rec : m_connectionRecords)
+            m_units[rec.to_id]->connectInput(rec.to_port, m_units[rec.from_id]->output(rec.from_port));
+        m_bulkEditDepth--;
+        m_graphDirty = false;
+        m_workerPool = a_other.m_workerPool;
+        m_plan = a_other.m_plan;
+        _bindPlan();
+    }
+
+    CircuitBlueprint::CircuitBlueprint(const Circuit& a_circuit) :
+        m_circuit(a_circuit)
+    {
+        // Settle the plan now, so that stamping never has to compute the graph
+        if (!m_circuit.m_plan)
+            m_circuit._recomputeGraph();
+    }
+
+    void CircuitBlueprint::stamp(Circuit& a_target) const
+    {
+        a_target._stampFrom(m_circuit);
+    }
+
+    namespace
+    {
+        struct StampJob
+        {
+            const CircuitBlueprint* blueprint;
+            Circuit* targets;
+        };
+
+        void stampTask(void* a_context, int a_index)
         {
-            connectInternal(rec.from_id, rec.from_port, rec.to_id, rec.to_port);
+            const StampJob* job = static_cast<const StampJob*>(a_context);
+            job->blueprint->stamp(job->targets[a_index]);
         }
-        copyFrom_(a_other);
     }
 
-    Circuit& Circuit::operator=(const Circuit& a_other)
+    void CircuitBlueprint::stamp(Circuit* a_targets, int a_count, WorkerPool* a_pool) const
     {
-        if (this != &a_other)
+        StampJob job{this, a_targets};
+        if (a_pool)
+            a_pool->parallelFor(a_count, &stampTask, &job);
+        else {
+            for (int i = 0; i < a_count; i++)
+                stamp(a_targets[i]);
+        }
+    }
+
+    void Circuit::adoptUnits(Circuit& a_other)
+    {
+        m_bulkEditDepth++;
+        m_midiData = a_other.m_midiData;
+        const int* unitIds = m_units.ids();
+        for (int i = 0; i < m_units.size(); i++)
         {
-            // delete old units
-            const int* unitIndices = m_units.ids();
-            for (int i = 0; i < m_units.size();)
-            {
-                const Unit* unit = m_units[unitIndices[i]];
-                if (unit != m_inputUnit && unit != m_outputUnit)
-                    removeUnit(*unit);
-                else
-                    i++;
-            }
-            // copy new units
-            const int* otherUnitIndices = a_other.m_units.ids();
-            for (int i = 0; i < a_other.m_units.size(); i++)
-            {
-                const Unit* unit = a_other.m_units[otherUnitIndices[i]];
-                if (unit != a_other.m_inputUnit && unit != a_other.m_outputUnit)
-                    addUnit(unit->clone(), otherUnitIndices[i]);
-            }
-            for (const auto& rec : a_other.m_connectionRecords)
-            {
-                connectInternal(rec.from_id, rec.from_port, rec.to_id, rec.to_port);
+            const int id = unitIds[i];
+            Unit*& unit = m_units[id];
+            if (unit == m_inputUnit || unit == m_outputUnit)
+                continue;
+            unit->m_midiData = m_midiData;
+            if (!a_other.m_units.containsId(id))
+                continue;
+            Unit*& otherUnit = a_other.m_units[id];
+            // A unit that was removed may have left its id to a new one, which must not inherit its state
+            if (otherUnit == a_other.m_inputUnit || otherUnit == a_other.m_outputUnit || unit->m_uid != otherUnit->m_uid)
+                continue;
+            // Nested circuits may have been edited themselves, so they keep their own units and plan. Units that
+            // ran at a different oversampling were set up for another rate and buffer size, so they start afresh.
+            if (Circuit* circuit = dynamic_cast<Circuit*>(unit)) {
+                Circuit* otherCircuit = static_cast<Circuit*>(otherUnit);
+                if (circuit->m_oversampling == otherCircuit->m_oversampling)
+                    circuit->adoptUnits(*otherCircuit);
+                continue;
             }
-            copyFrom_(a_other);
+            std::swap(unit, otherUnit);
+            unit->_setParent(this);
+            otherUnit->_setParent(&a_other);
+            // Drop the connections the unit had in a_other, the ones it has here are restored below
+            const int* inputIds = unit->m_inputPorts.ids();
+            for (int j = 0; j < unit->m_inputPorts.size(); j++)
+                unit->disconnectInput(inputIds[j]);
+            // Take the last block out of a_other's shared buffers, so that ports that carry state across blocks
+            // under this circuit's plan pick up where they left off
+            for (int j = 0; j < unit->numOutputs(); j++)
+                unit->m_outputPorts.getByIndex(j).detachBuf();
         }
-        return *this;
+        for (const auto& rec : m_connectionRecords)
+            m_units[rec.to_id]->connectInput(rec.to_port, m_units[rec.from_id]->output(rec.from_port));
+
+        if (m_oversampling == a_other.m_oversampling) {
+            std::swap(m_inputResamplers, a_other.m_inputResamplers);
+            std::swap(m_outputResamplers, a_other.m_outputResamplers);
+        }
+        m_bulkEditDepth--;
+        _bindPlan();
     }
 
-    Circuit::~Circuit() { for (int i = 0; i < m_units.size(); i++) { delete m_units.getByIndex(i); } }
+    Circuit::~Circuit() { for (int i = 0; i < m_units.size(); i++) { Unit::_destroy(m_units.getByIndex(i)); } }
+
+    Circuit::BulkEdit::BulkEdit(Circuit& a_circuit) :
+        m_circuit(a_circuit)
+    {
+        m_circuit.m_bulkEditDepth++;
+    }
+
+    Circuit::BulkEdit::~BulkEdit()
+    {
+        if (--m_circuit.m_bulkEditDepth == 0 && m_circuit.m_graphDirty)
+            m_circuit._recomputeGraph();
+    }
 
     bool Circuit::disconnectInternal(int a_fromId, int a_fromOutputPort, int a_toId, int a_toInputPort) {
         Unit* toUnit = m_units[a_toId];
@@ -100,13 +275,11 @@ namespace syn
 
         // Find and remove the associated connection record stored in this Circuit
         ConnectionRecord record{a_fromId, a_fromOutputPort, a_toId, a_toInputPort};
-        for (size_t i = 0; i < m_connectionRecords.size(); i++) {
-            if (m_connectionRecords[i] == record) {
-                result = true;
-                m_connectionRecords.erase(m_connectionRecords.begin() + i);
-                _recomputeGraph();
-                break;
-            }
+        int recordIndex = m_inputRecords[a_toId * MAX_INPUTS + a_toInputPort];
+        if (recordIndex >= 0 && m_connectionRecords[recordIndex] == record) {
+            result = true;
+            _eraseRecord(recordIndex);
+            _updatePlan(-1, -1);
         }
         return result;
     }
@@ -133,6 +306,7 @@ namespace syn
 
     Unit* Circuit::load(const json& j)
     {
+        BulkEdit edit(*this);
         json units = j["units"];
         Unit* inputUnit = m_inputUnit;
         Unit* outputUnit = m_outputUnit;
@@ -177,23 +351,191 @@ namespace syn
     {
         const int* unitIndices = m_units.ids();
         for (int i = 0; i < m_units.size(); i++) { m_units[unitIndices[i]]->reset(); }
+        for (auto& resampler : m_inputResamplers)
+            resampler.reset();
+        for (auto& resampler : m_outputResamplers)
+            resampler.reset();
     }
 
     void Circuit::process_()
     {
-        // tick units in processing graph
-        for (Unit** unit = m_execOrder.data(); *unit != nullptr; unit++)
+        _beginBlock();
+        if (blockOffset_() == 0)
+            m_inputUnit->_snapshotOutputs();
+
+        // run the bound execution plan, over the matching range of the internal buffers
+        const int offset = blockOffset_() * m_oversampling;
+        const int length = getBufferSize() * m_oversampling;
+        if (m_workerPool && !m_boundWaves.empty() && !m_isSubBlock)
+        {
+            _processWaves(offset, length);
+        }
+        else if (m_boundLoops.empty() && !m_isSubBlock)
+        {
+            for (const BoundStep& step : m_boundSteps)
+            {
+                step.process(step.unit);
+                step.unit->_snapshotOutputs();
+            }
+        }
+        else
+        {
+            _processSteps(offset, length);
+        }
+
+        _endBlock();
+    }
+
+    void Circuit::tickLanes(Circuit* const* a_circuits, int a_numLanes)
+    {
+        bool lockstep = a_numLanes > 1;
+        for (int i = 0; i < a_numLanes && lockstep; i++)
+        {
+            const Circuit* circuit = a_circuits[i];
+            lockstep = circuit->m_plan == a_circuits[0]->m_plan && circuit->m_boundLoops.empty() && !circuit->m_workerPool
+                && circuit->getBufferSize() == a_circuits[0]->getBufferSize()
+                && circuit->m_oversampling == a_circuits[0]->m_oversampling;
+        }
+        if (!lockstep)
+        {
+            for (int i = 0; i < a_numLanes; i++)
+                a_circuits[i]->tick();
+            return;
+        }
+
+        for (int i = 0; i < a_numLanes; i++)
+        {
+            a_circuits[i]->_resolveBlockSpans();
+            a_circuits[i]->_beginBlock();
+            a_circuits[i]->m_inputUnit->_snapshotOutputs();
+        }
+
+        Unit* units[MAX_LANES];
+        const int nSteps = int(a_circuits[0]->m_boundSteps.size());
+        for (int j = 0; j < nSteps; j++)
+        {
+            const BoundStep& step = a_circuits[0]->m_boundSteps[j];
+            if (step.processLanes)
+            {
+                for (int i = 0; i < a_numLanes; i++)
+                    units[i] = a_circuits[i]->m_boundSteps[j].unit;
+                step.processLanes(units, a_numLanes);
+            }
+            else
+            {
+                for (int i = 0; i < a_numLanes; i++)
+                    step.process(a_circuits[i]->m_boundSteps[j].unit);
+            }
+            for (int i = 0; i < a_numLanes; i++)
+                a_circuits[i]->m_boundSteps[j].unit->_snapshotOutputs();
+        }
+
+        for (int i = 0; i < a_numLanes; i++)
+        {
+            a_circuits[i]->_endBlock();
+            a_circuits[i]->_snapshotOutputs();
+        }
+    }
+
+    void Circuit::_beginBlock()
+    {
+        if (m_oversampling > 1)
         {
-            (*unit)->tick();
+            for (int i = 0; i < numInputs(); i++)
+            {
+                int id = inputs().ids()[i];
+                SampleType* target = m_oversampledInputs[id].data() + blockOffset_() * m_oversampling;
+                m_inputResamplers[id].upsample(inputBuf_(id), target, getBufferSize());
+            }
         }
 
-        /* Push internally connected output signals to circuit output ports */
+        // External input sources may be swapped between blocks (see VoiceManager::tick)
+        if (_updateInputAliases())
+        {
+            for (Unit* unit : m_inputConsumers)
+                unit->_resolveBlockSpans();
+            if (SYN_CONTAINS(m_inputConsumers, m_outputUnit))
+                _updateOutputAliases();
+        }
+    }
+
+    void Circuit::_endBlock()
+    {
+        /* Output ports alias the buffers feeding the output unit, unless they have been redirected (e.g. by
+         * Unit::tick), in which case the block is copied over */
         for (int i = 0; i < m_outputPorts.size(); i++)
         {
-            for (int j = 0; j < getBufferSize(); j++)
+            int id = m_outputPorts.ids()[i];
+            const SampleType* alias = m_outputAliases[id];
+            SampleType* target = m_outputPorts[id].buf();
+            if (m_oversampling > 1)
             {
-                writeOutput_(i, j, m_outputUnit->readOutput(i, j));
+                m_outputResamplers[id].downsample(alias + blockOffset_() * m_oversampling, target + blockOffset_(), getBufferSize());
+                m_outputPorts[id].setBlockState(BlockVarying);
+                continue;
             }
+            m_outputPorts[id].setBlockState(m_outputUnit->inputState_(id));
+            if (target != alias)
+                std::copy_n(alias + blockOffset_(), getBufferSize(), target + blockOffset_());
+        }
+    }
+
+    void Circuit::_processSteps(int a_offset, int a_length)
+    {
+        auto loop = m_boundLoops.cbegin();
+        const int nSteps = int(m_boundSteps.size());
+        for (int i = 0; i < nSteps;)
+        {
+            if (loop == m_boundLoops.cend() || i < loop->begin)
+            {
+                const BoundStep& step = m_boundSteps[i++];
+                step.unit->_processRange(step.process, a_offset, a_length);
+                continue;
+            }
+            _processLoop(int(loop - m_boundLoops.cbegin()), a_offset, a_length);
+            i = loop->end;
+            ++loop;
+        }
+    }
+
+    void Circuit::_processLoop(int a_loop, int a_offset, int a_length)
+    {
+        const BoundLoop& loop = m_boundLoops[a_loop];
+        // Carry the previous sample forward in the ports that are read before they are written, so that
+        // backward connections see a one-sample delay
+        for (int i = a_offset; i < a_offset + a_length; i++)
+        {
+            const int prev = i > 0 ? i - 1 : loop.bufferSize - 1;
+            for (SampleType* buf : loop.feedbackBufs)
+                buf[i] = buf[prev];
+            for (int j = loop.begin; j < loop.end; j++)
+                m_boundSteps[j].unit->_processRange(m_boundSteps[j].process, i, 1);
+        }
+    }
+
+    void Circuit::_processWaves(int a_offset, int a_length)
+    {
+        m_waveOffset = a_offset;
+        m_waveLength = a_length;
+        for (const BoundWave& wave : m_boundWaves)
+        {
+            m_waveTasks = &m_boundTasks[wave.begin];
+            m_workerPool->parallelFor(wave.end - wave.begin, &Circuit::_processTask, this);
+        }
+    }
+
+    void Circuit::_processTask(void* a_context, int a_index)
+    {
+        Circuit* circuit = static_cast<Circuit*>(a_context);
+        const BoundTask& task = circuit->m_waveTasks[a_index];
+        if (task.loop >= 0)
+        {
+            circuit->_processLoop(task.loop, circuit->m_waveOffset, circuit->m_waveLength);
+        }
+        else
+        {
+            const BoundStep& step = circuit->m_boundSteps[task.step];
+            step.unit->_processRange(step.process, circuit->m_waveOffset, circuit->m_waveLength);
         }
     }
 
@@ -210,13 +552,13 @@ namespace syn
         if (!retval)
             return false;
         a_unit->_setParent(this);
-        a_unit->setFs(fs());
+        a_unit->setFs(fs() * m_oversampling);
         a_unit->setTempo(tempo());
-        a_unit->setBufferSize(getBufferSize());
+        a_unit->setBufferSize(_innerBufferSize());
         a_unit->m_midiData = m_midiData;
         for (const auto& param : a_unit->m_parameters)
             a_unit->notifyParameterChanged(param.getId());
-        _recomputeGraph();
+        // An unconnected unit is not part of the execution plan, so there is nothing to rebuild
         return true;
     }
 
@@ -233,6 +575,7 @@ namespace syn
         // Don't allow deletion of input or output unit
         if (unit == m_inputUnit || unit == m_outputUnit)
             return false;
+        BulkEdit edit(*this);
         // Erase connections
         vector<ConnectionRecord> garbageList;
         for (const auto& rec : m_connectionRecords) {
@@ -242,8 +585,7 @@ namespace syn
             disconnectInternal(rec.from_id, rec.from_port, rec.to_id, rec.to_port);
         }
         m_units.removeById(a_id);
-        delete unit;
-        _recomputeGraph();
+        Unit::_destroy(unit);
         return true;
     }
 
@@ -259,23 +601,16 @@ namespace syn
             return false;
 
         // remove record of old connection
-        if (toUnit->isInputConnected(a_toInputPort)) {
-            const int nRecords = int(m_connectionRecords.size());
-            for (int i = 0; i < nRecords; i++) {
-                const ConnectionRecord& rec = m_connectionRecords[i];
-                if (rec.to_id == a_toId && rec.to_port == a_toInputPort) {
-                    m_connectionRecords.erase(m_connectionRecords.begin() + i);
-                    break;
-                }
-            }
-        }
+        int oldRecordIndex = m_inputRecords[a_toId * MAX_INPUTS + a_toInputPort];
+        if (oldRecordIndex >= 0)
+            _eraseRecord(oldRecordIndex);
 
         // make new connection
         toUnit->connectInput(a_toInputPort, fromUnit->output(a_fromOutputPort));
 
         // record the connection upon success
-        m_connectionRecords.emplace_back(a_fromId, a_fromOutputPort, a_toId, a_toInputPort);
-        _recomputeGraph();
+        _addRecord({a_fromId, a_fromOutputPort, a_toId, a_toInputPort});
+        _updatePlan(a_fromId, a_toId);
         return true;
     }
 
@@ -290,22 +625,400 @@ namespace syn
     bool Circuit::disconnectInternal(const Unit& a_fromUnit, int a_fromOutputPort, const Unit& a_toUnit, int a_toInputPort) {
         const Unit* toUnitPtr = &a_toUnit;
         const Unit* fromUnitPtr = &a_fromUnit;
-        int fromId = m_units.getIdFromItem(toUnitPtr);
-        int toId = m_units.getIdFromItem(fromUnitPtr);
+        int fromId = m_units.getIdFromItem(fromUnitPtr);
+        int toId = m_units.getIdFromItem(toUnitPtr);
         return disconnectInternal(fromId, a_fromOutputPort, toId, a_toInputPort);
     }
 
     const vector<ConnectionRecord>& Circuit::getConnections() const { return m_connectionRecords; }
 
+    void Circuit::_addRecord(const ConnectionRecord& a_record)
+    {
+        m_inputRecords[a_record.to_id * MAX_INPUTS + a_record.to_port] = int(m_connectionRecords.size());
+        m_unitDegrees[a_record.from_id]++;
+        m_unitDegrees[a_record.to_id]++;
+        m_connectionRecords.push_back(a_record);
+        m_outgoingDirty = true;
+    }
+
+    void Circuit::_eraseRecord(int a_index)
+    {
+        const ConnectionRecord record = m_connectionRecords[a_index];
+        m_inputRecords[record.to_id * MAX_INPUTS + record.to_port] = -1;
+        m_unitDegrees[record.from_id]--;
+        m_unitDegrees[record.to_id]--;
+        // Move the last record into the hole so the indices of all other records stay valid
+        const int last = int(m_connectionRecords.size()) - 1;
+        if (a_index != last) {
+            m_connectionRecords[a_index] = m_connectionRecords[last];
+            const ConnectionRecord& moved = m_connectionRecords[a_index];
+            m_inputRecords[moved.to_id * MAX_INPUTS + moved.to_port] = a_index;
+        }
+        m_connectionRecords.pop_back();
+        m_outgoingDirty = true;
+    }
+
+    void Circuit::_updateOutgoingIndex() const
+    {
+        if (!m_outgoingDirty)
+            return;
+        m_outgoingOffsets.fill(0);
+        for (const auto& cr : m_connectionRecords)
+            m_outgoingOffsets[cr.from_id + 1]++;
+        for (int i = 0; i < MAX_UNITS; i++)
+            m_outgoingOffsets[i + 1] += m_outgoingOffsets[i];
+        std::array<int, MAX_UNITS> next;
+        std::copy_n(m_outgoingOffsets.begin(), MAX_UNITS, next.begin());
+        m_outgoingRecords.resize(m_connectionRecords.size());
+        for (int i = 0; i < int(m_connectionRecords.size()); i++)
+            m_outgoingRecords[next[m_connectionRecords[i].from_id]++] = i;
+        m_outgoingDirty = false;
+    }
+
     void Circuit::_recomputeGraph()
     {
-        m_procGraph.reset();
-        m_execOrder.fill(nullptr);
+        if (m_bulkEditDepth > 0) {
+            m_graphDirty = true;
+            return;
+        }
+        m_graphDirty = false;
+        DirectedProcGraph<int> procGraph;
         for(const auto& cr : m_connectionRecords) {
-            m_procGraph.connect(m_units[cr.from_id], m_units[cr.to_id]);
+            procGraph.connect(cr.from_id, cr.to_id);
+        }
+        auto execOrder = procGraph.linearize();
+
+        vector<int> order(execOrder.size());
+        vector<int> loops(execOrder.size());
+        vector<int> layers(execOrder.size());
+        std::transform(execOrder.begin(), execOrder.end(), order.begin(), [](const auto& p) { return p.first; });
+        std::transform(execOrder.begin(), execOrder.end(), loops.begin(), [](const auto& p) { return p.second.loop; });
+        std::transform(execOrder.begin(), execOrder.end(), layers.begin(), [](const auto& p) { return p.second.layer; });
+        _compilePlan(order, loops, layers);
+    }
+
+    void Circuit::_updatePlan(int a_fromId, int a_toId)
+    {
+        // Edits can merge or split feedback loops, or move units between layers, so the graph is always
+        // relinearized when there are loops or the plan is split into waves
+        if (m_bulkEditDepth > 0 || !m_plan || !m_plan->loops.empty() || m_workerPool) {
+            _recomputeGraph();
+            return;
+        }
+
+        // Removing connections never invalidates the order, units that are no longer connected just drop out
+        vector<int> order;
+        order.reserve(m_plan->steps.size() + 2);
+        for (const auto& step : m_plan->steps) {
+            if (m_unitDegrees[step.unitId] > 0)
+                order.push_back(step.unitId);
+        }
+
+        if (a_fromId >= 0) {
+            auto fromPos = std::find(order.begin(), order.end(), a_fromId);
+            auto toPos = std::find(order.begin(), order.end(), a_toId);
+            bool hasFrom = fromPos != order.end();
+            bool hasTo = toPos != order.end();
+            if (hasFrom && hasTo) {
+                if (fromPos >= toPos) {
+                    _recomputeGraph();
+                    return;
+                }
+            } else if ((!hasFrom && m_unitDegrees[a_fromId] > 1) || (!hasTo && m_unitDegrees[a_toId] > 1)) {
+                // The unit already had connections that the current order does not account for
+                _recomputeGraph();
+                return;
+            } else {
+                // A unit whose only connection is the new one can go at either end of the order
+                if (!hasTo)
+                    order.push_back(a_toId);
+                if (!hasFrom)
+                    order.insert(order.begin(), a_fromId);
+            }
+        }
+        _compilePlan(order);
+    }
+
+    void Circuit::_compilePlan(const vector<int>& a_order, const vector<int>& a_loops, const vector<int>& a_layers)
+    {
+        auto plan = std::make_shared<CircuitPlan>();
+        const int nSteps = int(a_order.size());
+        const bool useWaves = m_workerPool && int(a_layers.size()) == nSteps;
+
+        // Group the steps by layer, deepest first. Units feeding each other are in different layers, except
+        // within loops, whose members all share a layer and stay adjacent because the sort is stable.
+        vector<int> permutation(nSteps);
+        for (int i = 0; i < nSteps; i++)
+            permutation[i] = i;
+        if (useWaves) {
+            std::stable_sort(permutation.begin(), permutation.end(), [&a_layers](int a, int b) { return a_layers[a] > a_layers[b]; });
+        }
+        vector<int> loops(a_loops.size());
+        plan->steps.reserve(nSteps);
+        for (int i = 0; i < nSteps; i++) {
+            int unitId = a_order[permutation[i]];
+            plan->steps.push_back({unitId, m_units[unitId]->getProcessFn(), m_units[unitId]->getLaneProcessFn()});
+            if (!a_loops.empty())
+                loops[i] = a_loops[permutation[i]];
+        }
+        if (useWaves) {
+            for (int i = 0; i < nSteps;) {
+                int end = i + 1;
+                while (end < nSteps && a_layers[permutation[end]] == a_layers[permutation[i]])
+                    end++;
+                plan->waves.push_back({i, end});
+                i = end;
+            }
+        }
+
+        // Units in the same loop are adjacent in the order
+        for (int i = 0; i < int(loops.size());) {
+            int end = i + 1;
+            if (loops[i] >= 0) {
+                while (end < nSteps && loops[end] == loops[i])
+                    end++;
+                plan->loops.push_back({i, end, {}});
+            }
+            i = end;
+        }
+        if (!plan->loops.empty()) {
+            std::array<int, MAX_UNITS> stepIndex;
+            stepIndex.fill(-1);
+            for (int i = 0; i < nSteps; i++)
+                stepIndex[plan->steps[i].unitId] = i;
+            for (const auto& cr : m_connectionRecords) {
+                int fromStep = stepIndex[cr.from_id];
+                int toStep = stepIndex[cr.to_id];
+                if (toStep < 0 || toStep > fromStep)
+                    continue;
+                for (auto& loop : plan->loops) {
+                    if (fromStep < loop.begin || fromStep >= loop.end)
+                        continue;
+                    std::pair<int, int> port{cr.from_id, cr.from_port};
+                    if (!(SYN_CONTAINS(loop.feedbackPorts, port)))
+                        loop.feedbackPorts.push_back(port);
+                    break;
+                }
+            }
+        }
+        _assignBuffers(*plan);
+        m_plan = plan;
+        _bindPlan();
+    }
+
+    void Circuit::_assignBuffers(CircuitPlan& a_plan) const
+    {
+        const int nSteps = int(a_plan.steps.size());
+        std::array<int, MAX_UNITS> stepIndex;
+        stepIndex.fill(-1);
+        for (int i = 0; i < nSteps; i++)
+            stepIndex[a_plan.steps[i].unitId] = i;
+        // Steps in the same wave may run concurrently, so lifetimes are measured in waves when there are any
+        vector<int> stepTimes(nSteps);
+        for (int i = 0; i < nSteps; i++)
+            stepTimes[i] = i;
+        for (int i = 0; i < int(a_plan.waves.size()); i++) {
+            for (int j = a_plan.waves[i].begin; j < a_plan.waves[i].end; j++)
+                stepTimes[j] = i;
+        }
+        const int endTime = a_plan.waves.empty() ? nSteps : int(a_plan.waves.size());
+
+        // Lifetime of each output port, measured in steps. Ports read before (or by) the step that writes
+        // them carry state across blocks and keep their own buffer. The input and output units are aliases
+        // and nested circuits alias their own outputs, so none of those take part.
+        struct Interval { int unitId, outputId, start, end; bool pinned; };
+        vector<Interval> intervals;
+        const int outputUnitId = getOutputUnitId();
+        _updateOutgoingIndex();
+        for (int i = 0; i < nSteps; i++) {
+            int unitId = a_plan.steps[i].unitId;
+            const Unit* unit = m_units[unitId];
+            if (unit == m_inputUnit || unit == m_outputUnit || dynamic_cast<const Circuit*>(unit))
+                continue;
+            for (int j = 0; j < unit->numOutputs(); j++) {
+                Interval interval{unitId, unit->outputs().ids()[j], stepTimes[i], stepTimes[i], false};
+                for (int k = m_outgoingOffsets[unitId]; k < m_outgoingOffsets[unitId + 1]; k++) {
+                    const ConnectionRecord& cr = m_connectionRecords[m_outgoingRecords[k]];
+                    if (cr.from_port != interval.outputId)
+                        continue;
+                    // The circuit's output ports alias the buffers feeding the output unit, so they must stay
+                    // intact until the end of the block
+                    if (cr.to_id == outputUnitId)
+                        interval.end = endTime;
+                    else if (stepIndex[cr.to_id] <= i)
+                        interval.pinned = true;
+                    else
+                        interval.end = MAX(interval.end, stepTimes[stepIndex[cr.to_id]]);
+                }
+                intervals.push_back(interval);
+            }
+        }
+
+        // Intervals are already sorted by start, so a greedy first-fit colouring is optimal. A buffer is
+        // only reused strictly after its last reader, so a unit never writes into one of its own inputs, nor
+        // into the inputs of another unit in the same wave.
+        vector<int> bufferEnds;
+        a_plan.bufferAssignments.clear();
+        for (const auto& interval : intervals) {
+            if (interval.pinned)
+                continue;
+            int buffer = 0;
+            while (buffer < int(bufferEnds.size()) && bufferEnds[buffer] >= interval.start)
+                buffer++;
+            if (buffer == int(bufferEnds.size()))
+                bufferEnds.push_back(interval.end);
+            else
+                bufferEnds[buffer] = interval.end;
+            a_plan.bufferAssignments.push_back({interval.unitId, interval.outputId, buffer});
+        }
+        a_plan.numBuffers = int(bufferEnds.size());
+    }
+
+    int Circuit::_bufferStride() const
+    {
+        return int(cacheAlignedSize(_innerBufferSize() * sizeof(SampleType)) / sizeof(SampleType));
+    }
+
+    void Circuit::_bindPlan()
+    {
+        // Point output ports at their shared buffers, which are laid out back to back in a single block. Each one
+        // is padded to a whole number of cache lines, so that they are all aligned and can be processed with full
+        // SIMD registers.
+        const int stride = _bufferStride();
+        const size_t numSamples = size_t(m_plan->numBuffers) * stride;
+        SampleType* buffers;
+        if (numSamples <= m_arenaBufferCapacity) {
+            // Stamped circuits keep them in their arena, right after their units, for as long as they fit
+            if (stride != m_bufferStride)
+                std::fill_n(m_arenaBuffers, numSamples, 0.0);
+            m_internalBuffers.clear();
+            m_internalBuffers.shrink_to_fit();
+            buffers = m_arenaBuffers;
+        } else if (stride != m_bufferStride) {
+            m_internalBuffers.assign(numSamples, 0.0);
+            buffers = m_internalBuffers.data();
+        } else {
+            m_internalBuffers.resize(numSamples, 0.0);
+            buffers = m_internalBuffers.data();
+        }
+        m_bufferStride = stride;
+        for (int i = 0; i < m_units.size(); i++) {
+            Unit* unit = m_units.getByIndex(i);
+            if (unit == m_inputUnit || dynamic_cast<Circuit*>(unit))
+                continue;
+            for (int j = 0; j < unit->numOutputs(); j++)
+                unit->m_outputPorts.getByIndex(j).unsetBuf();
+        }
+        for (const auto& assignment : m_plan->bufferAssignments)
+            m_units[assignment.unitId]->m_outputPorts[assignment.outputId].setBuf(buffers + assignment.buffer * stride);
+
+        _updateInputAliases();
+
+        // The input and output units are pure aliases and are never ticked
+        const int inputUnitId = getInputUnitId();
+        const int nSteps = int(m_plan->steps.size());
+        m_execOrder.fill(nullptr);
+        m_boundSteps.clear();
+        m_inputConsumers.clear();
+        std::array<int, MAX_UNITS + 1> boundIndices;
+        for (int i = 0; i < nSteps; i++) {
+            const auto& step = m_plan->steps[i];
+            Unit* unit = m_units[step.unitId];
+            unit->_resolveBlockSpans();
+            boundIndices[i] = int(m_boundSteps.size());
+            if (unit != m_inputUnit && unit != m_outputUnit)
+                m_boundSteps.push_back({step.process, unit, step.processLanes});
+            m_execOrder[i] = unit;
+        }
+        boundIndices[nSteps] = int(m_boundSteps.size());
+        // Reuse the existing loops' storage, so that rebinding the same plan does not allocate
+        m_boundLoops.resize(m_plan->loops.size());
+        for (int i = 0; i < int(m_plan->loops.size()); i++) {
+            const auto& loop = m_plan->loops[i];
+            BoundLoop& boundLoop = m_boundLoops[i];
+            boundLoop.begin = boundIndices[loop.begin];
+            boundLoop.end = boundIndices[loop.end];
+            boundLoop.bufferSize = _innerBufferSize();
+            boundLoop.feedbackBufs.clear();
+            for (const auto& port : loop.feedbackPorts)
+                boundLoop.feedbackBufs.push_back(m_units[port.first]->m_outputPorts[port.second].buf());
+        }
+        m_boundTasks.clear();
+        m_boundWaves.clear();
+        int loopIndex = 0;
+        for (const auto& wave : m_plan->waves) {
+            BoundWave boundWave{int(m_boundTasks.size()), 0};
+            for (int i = boundIndices[wave.begin]; i < boundIndices[wave.end];) {
+                while (loopIndex < int(m_boundLoops.size()) && m_boundLoops[loopIndex].end <= i)
+                    loopIndex++;
+                if (loopIndex < int(m_boundLoops.size()) && m_boundLoops[loopIndex].begin == i) {
+                    m_boundTasks.push_back({-1, loopIndex});
+                    i = m_boundLoops[loopIndex].end;
+                } else {
+                    m_boundTasks.push_back({i, -1});
+                    i++;
+                }
+            }
+            boundWave.end = int(m_boundTasks.size());
+            if (boundWave.end > boundWave.begin)
+                m_boundWaves.push_back(boundWave);
+        }
+        for (const auto& cr : m_connectionRecords) {
+            Unit* consumer = m_units[cr.to_id];
+            if (cr.from_id == inputUnitId && !(SYN_CONTAINS(m_inputConsumers, consumer)))
+                m_inputConsumers.push_back(consumer);
+        }
+
+        m_outputUnit->_resolveBlockSpans();
+        _updateOutputAliases();
+
+        // Units downstream of this circuit in the parent resolved their spans against our old aliases
+        Circuit* parentCircuit = parent();
+        if (parentCircuit && parentCircuit->m_plan && parentCircuit->m_bulkEditDepth == 0)
+            parentCircuit->_bindPlan();
+    }
+
+    bool Circuit::_updateInputAliases()
+    {
+        // InputUnit never writes to its outputs, so they can safely point at read-only input buffers
+        m_inputUnit->_resolveBlockSpans();
+        bool changed = false;
+        for (int i = 0; i < m_inputUnit->numOutputs(); i++) {
+            int id = m_inputUnit->outputs().ids()[i];
+            SampleType* source = const_cast<SampleType*>(m_inputUnit->inputBuf_(id));
+            OutputPort& port = m_inputUnit->m_outputPorts[id];
+            port.setBlockState(m_inputUnit->inputState_(id));
+            if (m_oversampling > 1) {
+                source = m_oversampledInputs[id].data();
+                port.setBlockState(BlockVarying);
+            }
+            if (port.buf() != source) {
+                port.setBuf(source);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    void Circuit::_updateOutputAliases()
+    {
+        for (int i = 0; i < numOutputs(); i++) {
+            int id = outputs().ids()[i];
+            m_outputAliases[id] = m_outputUnit->inputBuf_(id);
+            // OutputUnit never writes to the buffers feeding it, so the alias is only ever read through
+            if (m_oversampling > 1)
+                m_outputPorts[id].unsetBuf();
+            else
+                m_outputPorts[id].setBuf(const_cast<SampleType*>(m_outputAliases[id]));
         }
-        auto execOrder = m_procGraph.linearize();
-        std::transform(execOrder.begin(), execOrder.end(), m_execOrder.begin(), [](auto&& p) { return p.first; });
+    }
+
+    void Circuit::setWorkerPool(WorkerPool* a_pool)
+    {
+        if (a_pool == m_workerPool)
+            return;
+        m_workerPool = a_pool;
+        _recomputeGraph();
     }
 
     bool Circuit::isActive() const {
@@ -320,10 +1033,29 @@ namespace syn
 
     double Circuit::getVoiceIndex() const { return m_voiceIndex; }
 
+    void Circuit::onParamChange_(int a_paramId)
+    {
+        if (a_paramId == pOversampling)
+            _setOversampling(int(param(pOversampling).getEnum()));
+    }
+
+    void Circuit::_setOversampling(int a_factor)
+    {
+        if (a_factor == m_oversampling)
+            return;
+        m_oversampling = a_factor;
+        for (auto& resampler : m_inputResamplers)
+            resampler = Oversampler(a_factor);
+        for (auto& resampler : m_outputResamplers)
+            resampler = Oversampler(a_factor);
+        onFsChange_();
+        setBufferSize(getBufferSize());
+    }
+
     void Circuit::onFsChange_()
     {
         const int* unitIndices = m_units.ids();
-        for (int i = 0; i < m_units.size(); i++) { m_units[unitIndices[i]]->setFs(fs()); }
+        for (int i = 0; i < m_units.size(); i++) { m_units[unitIndices[i]]->setFs(fs() * m_oversampling); }
     }
 
     void Circuit::onTempoChange_()
@@ -393,26 +1125,28 @@ namespace syn
     {
         Unit::setBufferSize(a_bufferSize);
 
-        for(auto&& buf : m_internalBuffers) {
-            buf.resize(a_bufferSize);
-        }
-
         /* Update buffer sizes of internal units */
         const int* unitIndices = m_units.ids();
         for (int i = 0; i < m_units.size(); i++)
         {
-            m_units[unitIndices[i]]->setBufferSize(a_bufferSize);
+            m_units[unitIndices[i]]->setBufferSize(_innerBufferSize());
         }
+        for (auto& buf : m_oversampledInputs)
+            buf.assign(m_oversampling > 1 ? _innerBufferSize() : 0, 0.0);
+        if (m_plan)
+            _bindPlan();
     }
 
     vector<std::pair<int, int>> Circuit::getConnectionsToInternalInput(int a_unitId, int a_inputId) const
     {
         vector<std::pair<int, int>> connectedPorts;
-        for (const auto& conn : m_connectionRecords)
-        {
-            if (conn.to_id == a_unitId && conn.to_port == a_inputId) {
-                connectedPorts.emplace_back(std::make_pair(conn.from_id, conn.from_port));
-            }
+        if (a_unitId < 0 || a_unitId >= MAX_UNITS || a_inputId < 0 || a_inputId >= MAX_INPUTS)
+            return connectedPorts;
+        // An input port has at most one source
+        int recordIndex = m_inputRecords[a_unitId * MAX_INPUTS + a_inputId];
+        if (recordIndex >= 0) {
+            const ConnectionRecord& conn = m_connectionRecords[recordIndex];
+            connectedPorts.emplace_back(conn.from_id, conn.from_port);
         }
         return connectedPorts;
     }
@@ -420,10 +1154,14 @@ namespace syn
     vector<std::pair<int, int>> Circuit::getConnectionsFromInternalOutput(int a_unitId, int a_outputId) const
     {
         vector<std::pair<int, int>> connectedPorts;
-        for (const auto& conn : m_connectionRecords)
+        if (a_unitId < 0 || a_unitId >= MAX_UNITS)
+            return connectedPorts;
+        _updateOutgoingIndex();
+        for (int i = m_outgoingOffsets[a_unitId]; i < m_outgoingOffsets[a_unitId + 1]; i++)
         {
-            if (conn.from_id == a_unitId && conn.from_port == a_outputId) {
-                connectedPorts.emplace_back(std::make_pair(conn.from_id, conn.from_port));
+            const ConnectionRecord& conn = m_connectionRecords[m_outgoingRecords[i]];
+            if (conn.from_port == a_outputId) {
+                connectedPorts.emplace_back(conn.to_id, conn.to_port);
             }
         }
         return connectedPorts;
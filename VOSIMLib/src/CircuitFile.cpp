@@ -0,0 +1,436 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vosimlib/CircuitFile.h"
+#include "vosimlib/Circuit.h"
+#include "vosimlib/UnitFactory.h"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace syn
+{
+    namespace
+    {
+        const char c_magic[4] = { 'V', 'S', 'C', 'B' };
+
+        // Records are copied to and from the file as they are laid out in memory. Every platform the library is
+        // built for is little-endian, and the fields are ordered so that none of the records need any padding.
+
+        struct FileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t numUnits;
+            uint32_t numParams;
+            uint32_t numDisplayTexts;
+            uint32_t numConnections;
+            uint32_t numStrings;
+            uint32_t numStringBytes;
+        };
+
+        struct UnitRecord
+        {
+            uint64_t classId;
+            uint32_t name;
+            int32_t id; ///< Id within the parent circuit
+            int32_t parent; ///< Index of the parent circuit's record, or -1 for the outermost circuit
+            uint32_t firstParam;
+            uint32_t numParams;
+            uint32_t padding;
+        };
+
+        struct ParamRecord
+        {
+            double value;
+            double min;
+            double max;
+            int32_t id;
+            int32_t type;
+            uint32_t firstDisplayText;
+            uint32_t numDisplayTexts;
+        };
+
+        struct DisplayTextRecord
+        {
+            double value;
+            uint32_t text;
+            uint32_t padding;
+        };
+
+        struct ConnectionFileRecord
+        {
+            int32_t circuit; ///< Index of the circuit's unit record
+            int32_t fromId;
+            int32_t fromPort;
+            int32_t toId;
+            int32_t toPort;
+        };
+
+        static_assert(sizeof(FileHeader) == 32, "FileHeader must not be padded");
+        static_assert(sizeof(UnitRecord) == 32, "UnitRecord must not be padded");
+        static_assert(sizeof(ParamRecord) == 40, "ParamRecord must not be padded");
+        static_assert(sizeof(DisplayTextRecord) == 16, "DisplayTextRecord must not be padded");
+        static_assert(sizeof(ConnectionFileRecord) == 20, "ConnectionFileRecord must not be padded");
+
+        class CircuitWriter
+        {
+        public:
+            void addUnit(const Unit& a_unit, int a_id, int a_parent) {
+                const int index = static_cast<int>(m_units.size());
+                UnitRecord rec{};
+                rec.classId = a_unit.getClassIdentifier();
+                rec.name = _addString(a_unit.name());
+                rec.id = a_id;
+                rec.parent = a_parent;
+                rec.firstParam = static_cast<uint32_t>(m_params.size());
+                rec.numParams = static_cast<uint32_t>(a_unit.numParams());
+                m_units.push_back(rec);
+
+                const auto& params = a_unit.parameters();
+                const int* paramIds = params.ids();
+                for (int i = 0; i < params.size(); i++) {
+                    const UnitParameter& param = params[paramIds[i]];
+                    ParamRecord paramRec{};
+                    paramRec.value = param.getDouble();
+                    paramRec.min = param.getMin();
+                    paramRec.max = param.getMax();
+                    paramRec.id = paramIds[i];
+                    paramRec.type = param.getType();
+                    paramRec.firstDisplayText = static_cast<uint32_t>(m_displayTexts.size());
+                    paramRec.numDisplayTexts = static_cast<uint32_t>(param.getDisplayTexts().size());
+                    m_params.push_back(paramRec);
+                    for (const auto& displayText : param.getDisplayTexts())
+                        m_displayTexts.push_back({ displayText.m_value, _addString(displayText.m_text), 0 });
+                }
+
+                const Circuit* circuit = dynamic_cast<const Circuit*>(&a_unit);
+                if (!circuit)
+                    return;
+                const auto& units = circuit->getUnits();
+                const int* unitIds = units.ids();
+                for (int i = 0; i < units.size(); i++)
+                    addUnit(*units[unitIds[i]], unitIds[i], index);
+                for (const auto& cr : circuit->getConnections())
+                    m_connections.push_back({ index, cr.from_id, cr.from_port, cr.to_id, cr.to_port });
+            }
+
+            std::vector<char> finish() const {
+                FileHeader header;
+                std::memcpy(header.magic, c_magic, sizeof(c_magic));
+                header.version = BINARY_CIRCUIT_VERSION;
+                header.numUnits = static_cast<uint32_t>(m_units.size());
+                header.numParams = static_cast<uint32_t>(m_params.size());
+                header.numDisplayTexts = static_cast<uint32_t>(m_displayTexts.size());
+                header.numConnections = static_cast<uint32_t>(m_connections.size());
+                header.numStrings = static_cast<uint32_t>(m_stringOffsets.size());
+                header.numStringBytes = static_cast<uint32_t>(m_stringBytes.size());
+
+                std::vector<char> data;
+                data.reserve(sizeof(header) + _bytes(m_units) + _bytes(m_params) + _bytes(m_displayTexts)
+                    + _bytes(m_connections) + _bytes(m_stringOffsets) + sizeof(uint32_t) + m_stringBytes.size());
+                _append(data, &header, sizeof(header));
+                _append(data, m_units.data(), _bytes(m_units));
+                _append(data, m_params.data(), _bytes(m_params));
+                _append(data, m_displayTexts.data(), _bytes(m_displayTexts));
+                _append(data, m_connections.data(), _bytes(m_connections));
+                // Each string ends where the next one begins, so the end of the last one is stored as well
+                _append(data, m_stringOffsets.data(), _bytes(m_stringOffsets));
+                _append(data, &header.numStringBytes, sizeof(uint32_t));
+                _append(data, m_stringBytes.data(), m_stringBytes.size());
+                return data;
+            }
+
+        private:
+            uint32_t _addString(const string& a_str) {
+                auto result = m_stringIds.emplace(a_str, static_cast<uint32_t>(m_stringOffsets.size()));
+                if (result.second) {
+                    m_stringOffsets.push_back(static_cast<uint32_t>(m_stringBytes.size()));
+                    m_stringBytes += a_str;
+                }
+                return result.first->second;
+            }
+
+            template <typename T>
+            static size_t _bytes(const std::vector<T>& a_records) { return a_records.size() * sizeof(T); }
+
+            static void _append(std::vector<char>& a_data, const void* a_src, size_t a_size) {
+                const char* src = static_cast<const char*>(a_src);
+                a_data.insert(a_data.end(), src, src + a_size);
+            }
+
+        private:
+            std::vector<UnitRecord> m_units;
+            std::vector<ParamRecord> m_params;
+            std::vector<DisplayTextRecord> m_displayTexts;
+            std::vector<ConnectionFileRecord> m_connections;
+            std::unordered_map<string, uint32_t> m_stringIds;
+            std::vector<uint32_t> m_stringOffsets;
+            string m_stringBytes;
+        };
+
+        /**
+         * Bounds-checked access to the arrays of a binary circuit, read in place.
+         */
+        class CircuitReader
+        {
+        public:
+            CircuitReader(const char* a_data, size_t a_size)
+                : m_header{},
+                  m_valid(false) {
+                if (!isBinaryCircuit(a_data, a_size) || a_size < sizeof(FileHeader))
+                    return;
+                std::memcpy(&m_header, a_data, sizeof(FileHeader));
+                if (m_header.version == 0 || m_header.version > BINARY_CIRCUIT_VERSION)
+                    return;
+                // Sizes are summed in 64 bits, so that a corrupt header cannot wrap them around
+                uint64_t offset = sizeof(FileHeader);
+                m_units = a_data + offset;
+                offset += uint64_t(m_header.numUnits) * sizeof(UnitRecord);
+                m_params = a_data + offset;
+                offset += uint64_t(m_header.numParams) * sizeof(ParamRecord);
+                m_displayTexts = a_data + offset;
+                offset += uint64_t(m_header.numDisplayTexts) * sizeof(DisplayTextRecord);
+                m_connections = a_data + offset;
+                offset += uint64_t(m_header.numConnections) * sizeof(ConnectionFileRecord);
+                m_stringOffsets = a_data + offset;
+                offset += (uint64_t(m_header.numStrings) + 1) * sizeof(uint32_t);
+                m_stringBytes = a_data + offset;
+                offset += m_header.numStringBytes;
+                m_valid = offset <= a_size;
+            }
+
+            bool isValid() const { return m_valid; }
+            const FileHeader& header() const { return m_header; }
+
+            UnitRecord unit(uint32_t a_index) const { return _read<UnitRecord>(m_units, a_index); }
+            ParamRecord param(uint32_t a_index) const { return _read<ParamRecord>(m_params, a_index); }
+            DisplayTextRecord displayText(uint32_t a_index) const { return _read<DisplayTextRecord>(m_displayTexts, a_index); }
+            ConnectionFileRecord connection(uint32_t a_index) const { return _read<ConnectionFileRecord>(m_connections, a_index); }
+
+            bool readString(uint32_t a_index, string& a_str) const {
+                if (a_index >= m_header.numStrings)
+                    return false;
+                const uint32_t begin = _read<uint32_t>(m_stringOffsets, a_index);
+                const uint32_t end = _read<uint32_t>(m_stringOffsets, a_index + 1);
+                if (begin > end || end > m_header.numStringBytes)
+                    return false;
+                a_str.assign(m_stringBytes + begin, end - begin);
+                return true;
+            }
+
+        private:
+            template <typename T>
+            static T _read(const char* a_array, uint32_t a_index) {
+                // The data may come from anywhere (e.g. a host's state chunk), so it is not assumed to be aligned
+                T record;
+                std::memcpy(&record, a_array + size_t(a_index) * sizeof(T), sizeof(T));
+                return record;
+            }
+
+        private:
+            FileHeader m_header;
+            bool m_valid;
+            const char* m_units = nullptr;
+            const char* m_params = nullptr;
+            const char* m_displayTexts = nullptr;
+            const char* m_connections = nullptr;
+            const char* m_stringOffsets = nullptr;
+            const char* m_stringBytes = nullptr;
+        };
+
+        bool loadUnits(const CircuitReader& a_reader, std::unique_ptr<Circuit>& a_root, std::vector<std::unique_ptr<Circuit::BulkEdit>>& a_edits) {
+            const FileHeader& header = a_reader.header();
+            UnitFactory& factory = UnitFactory::instance();
+            // Circuit created for each unit record, so that their units and connections can be added to them
+            std::vector<Circuit*> circuits(header.numUnits, nullptr);
+            string name;
+            for (uint32_t i = 0; i < header.numUnits; i++) {
+                const UnitRecord rec = a_reader.unit(i);
+                Circuit* parent = nullptr;
+                if (i == 0) {
+                    if (rec.parent != -1)
+                        return false;
+                } else {
+                    if (rec.parent < 0 || uint32_t(rec.parent) >= i || !circuits[rec.parent])
+                        return false;
+                    parent = circuits[rec.parent];
+                    // Every circuit makes its own input and output units
+                    if (rec.id == parent->getInputUnitId() || rec.id == parent->getOutputUnitId())
+                        continue;
+                }
+                if (!a_reader.readString(rec.name, name))
+                    return false;
+                std::unique_ptr<Unit> unit(factory.createUnit(rec.classId, name));
+                if (!unit)
+                    return false;
+
+                if (uint64_t(rec.firstParam) + rec.numParams > header.numParams)
+                    return false;
+                for (uint32_t p = rec.firstParam; p < rec.firstParam + rec.numParams; p++) {
+                    const ParamRecord paramRec = a_reader.param(p);
+                    if (uint64_t(paramRec.firstDisplayText) + paramRec.numDisplayTexts > header.numDisplayTexts)
+                        return false;
+                    if (!unit->hasParam(paramRec.id))
+                        continue;
+                    // Units rely on the kind of their parameters, e.g. on an enum's options, which a class never changes
+                    const UnitParameter& param = unit->param(paramRec.id);
+                    if (paramRec.type != param.getType() || paramRec.numDisplayTexts != param.getDisplayTexts().size())
+                        return false;
+                    vector<UnitParameter::DisplayText> displayTexts;
+                    displayTexts.reserve(paramRec.numDisplayTexts);
+                    for (uint32_t t = paramRec.firstDisplayText; t < paramRec.firstDisplayText + paramRec.numDisplayTexts; t++) {
+                        const DisplayTextRecord textRec = a_reader.displayText(t);
+                        if (!a_reader.readString(textRec.text, name))
+                            return false;
+                        displayTexts.emplace_back(textRec.value, name);
+                    }
+                    unit->param(paramRec.id).restore(static_cast<UnitParameter::EParamType>(paramRec.type),
+                        paramRec.min, paramRec.max, std::move(displayTexts), paramRec.value);
+                }
+
+                Circuit* circuit = dynamic_cast<Circuit*>(unit.get());
+                if (!parent) {
+                    if (!circuit)
+                        return false;
+                    a_root.reset(circuit);
+                } else if (!parent->addUnit(unit.get(), rec.id)) {
+                    return false;
+                }
+                unit.release();
+                if (circuit) {
+                    circuits[i] = circuit;
+                    a_edits.emplace_back(new Circuit::BulkEdit(*circuit));
+                }
+            }
+
+            for (uint32_t i = 0; i < header.numConnections; i++) {
+                const ConnectionFileRecord rec = a_reader.connection(i);
+                if (rec.circuit < 0 || uint32_t(rec.circuit) >= header.numUnits || !circuits[rec.circuit])
+                    return false;
+                if (!circuits[rec.circuit]->connectInternal(rec.fromId, rec.fromPort, rec.toId, rec.toPort))
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    MappedFile::MappedFile(const std::string& a_path)
+        : m_data(nullptr),
+          m_size(0)
+#if defined(_WIN32)
+          , m_file(INVALID_HANDLE_VALUE),
+          m_mapping(nullptr)
+#endif
+    {
+#if defined(_WIN32)
+        m_file = CreateFileA(a_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+            return;
+        m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!m_mapping)
+            return;
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data)
+            m_size = static_cast<size_t>(size.QuadPart);
+#else
+        const int fd = open(a_path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                m_data = static_cast<const char*>(data);
+                m_size = static_cast<size_t>(info.st_size);
+            }
+        }
+        // The mapping stays valid after the file is closed
+        close(fd);
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+#if defined(_WIN32)
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+#else
+        if (m_data)
+            munmap(const_cast<char*>(m_data), m_size);
+#endif
+    }
+
+    std::vector<char> saveBinaryCircuit(const Circuit& a_circuit) {
+        CircuitWriter writer;
+        writer.addUnit(a_circuit, -1, -1);
+        return writer.finish();
+    }
+
+    bool isBinaryCircuit(const char* a_data, size_t a_size) {
+        return a_size >= sizeof(c_magic) && std::memcmp(a_data, c_magic, sizeof(c_magic)) == 0;
+    }
+
+    Circuit* loadBinaryCircuit(const char* a_data, size_t a_size) {
+        const CircuitReader reader(a_data, a_size);
+        if (!reader.isValid() || reader.header().numUnits == 0)
+            return nullptr;
+        std::unique_ptr<Circuit> root;
+        std::vector<std::unique_ptr<Circuit::BulkEdit>> edits;
+        const bool success = loadUnits(reader, root, edits);
+        // Rebuild the plans of the innermost circuits first
+        while (!edits.empty())
+            edits.pop_back();
+        return success ? root.release() : nullptr;
+    }
+
+    bool saveBinaryCircuitFile(const Circuit& a_circuit, const std::string& a_path) {
+        const std::vector<char> data = saveBinaryCircuit(a_circuit);
+        std::ofstream outfile(a_path, std::ios::binary | std::ios::trunc);
+        if (!outfile.is_open())
+            return false;
+        outfile.write(data.data(), data.size());
+        return outfile.good();
+    }
+
+    Circuit* loadBinaryCircuitFile(const std::string& a_path) {
+        const MappedFile file(a_path);
+        if (!file.isOpen())
+            return nullptr;
+        return loadBinaryCircuit(file.data(), file.size());
+    }
+}
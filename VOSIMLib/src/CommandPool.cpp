@@ -0,0 +1,52 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vosimlib/CommandPool.h"
+
+namespace syn
+{
+    CommandPool::CommandPool(int a_capacity)
+        : m_slots(a_capacity),
+          m_numHeapCommands(0)
+    {
+        m_freeSlots.reserve(a_capacity);
+        for (int i = a_capacity - 1; i >= 0; i--)
+            m_freeSlots.push_back(i);
+    }
+
+    void CommandPool::destroy(Command* a_command) {
+        // Commands live at the start of their slot, but the Command base may be at an offset within them
+        const char* begin = reinterpret_cast<const char*>(m_slots.data());
+        const char* address = reinterpret_cast<const char*>(a_command);
+        if (address < begin || address >= begin + m_slots.size() * sizeof(Slot)) {
+            delete a_command;
+            return;
+        }
+        a_command->~Command();
+        m_freeSlots.push_back(static_cast<int>((address - begin) / sizeof(Slot)));
+    }
+
+    void* CommandPool::_allocate() {
+        if (m_freeSlots.empty())
+            return nullptr;
+        const int index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return &m_slots[index];
+    }
+}
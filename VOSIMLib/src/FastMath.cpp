@@ -0,0 +1,322 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vosimlib/FastMath.h"
+
+#if defined(__AVX2__)
+#define SYN_FASTMATH_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SYN_FASTMATH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    using namespace syn::fastmath;
+
+#if defined(SYN_FASTMATH_AVX2)
+    struct SimdDouble
+    {
+        typedef double T;
+        typedef __m256d V;
+        typedef __m256d M;
+        static const int N = 4;
+
+        static V load(const T* p) { return _mm256_loadu_pd(p); }
+        static void store(T* p, V a) { _mm256_storeu_pd(p, a); }
+        static V set1(double a) { return _mm256_set1_pd(a); }
+        static V add(V a, V b) { return _mm256_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm256_div_pd(a, b); }
+        static V min(V a, V b) { return _mm256_min_pd(a, b); }
+        static V max(V a, V b) { return _mm256_max_pd(a, b); }
+        static V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        static V floor(V a) { return _mm256_floor_pd(a); }
+        static M cmpgt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+        static M cmpge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+        static V select(M m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+        static V copysign(V mag, V sgn) { return _mm256_or_pd(abs(mag), _mm256_and_pd(_mm256_set1_pd(-0.0), sgn)); }
+
+        static V pow2i(V n)
+        {
+            const __m256i bits = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(4503599627370496.0 + 1023.0)));
+            return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+        }
+
+        static V exponent(V x)
+        {
+            const __m256i e = _mm256_srli_epi64(_mm256_castpd_si256(x), 52);
+            const V biased = _mm256_castsi256_pd(_mm256_or_si256(e, _mm256_castpd_si256(_mm256_set1_pd(4503599627370496.0))));
+            return _mm256_sub_pd(biased, _mm256_set1_pd(4503599627370496.0 + 1023.0));
+        }
+
+        static V mantissa(V x)
+        {
+            const V m = _mm256_and_pd(x, _mm256_castsi256_pd(_mm256_set1_epi64x(0x000FFFFFFFFFFFFFll)));
+            return _mm256_or_pd(m, _mm256_set1_pd(1.0));
+        }
+    };
+
+    struct SimdFloat
+    {
+        typedef float T;
+        typedef __m256 V;
+        typedef __m256 M;
+        static const int N = 8;
+
+        static V load(const T* p) { return _mm256_loadu_ps(p); }
+        static void store(T* p, V a) { _mm256_storeu_ps(p, a); }
+        static V set1(double a) { return _mm256_set1_ps(static_cast<float>(a)); }
+        static V add(V a, V b) { return _mm256_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm256_div_ps(a, b); }
+        static V min(V a, V b) { return _mm256_min_ps(a, b); }
+        static V max(V a, V b) { return _mm256_max_ps(a, b); }
+        static V abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static V floor(V a) { return _mm256_floor_ps(a); }
+        static M cmpgt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static M cmpge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+        static V copysign(V mag, V sgn) { return _mm256_or_ps(abs(mag), _mm256_and_ps(_mm256_set1_ps(-0.0f), sgn)); }
+
+        static V pow2i(V n)
+        {
+            const __m256i bits = _mm256_castps_si256(_mm256_add_ps(n, _mm256_set1_ps(8388608.0f + 127.0f)));
+            return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+        }
+
+        static V exponent(V x)
+        {
+            const __m256i e = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+            const V biased = _mm256_castsi256_ps(_mm256_or_si256(e, _mm256_castps_si256(_mm256_set1_ps(8388608.0f))));
+            return _mm256_sub_ps(biased, _mm256_set1_ps(8388608.0f + 127.0f));
+        }
+
+        static V mantissa(V x)
+        {
+            const V m = _mm256_and_ps(x, _mm256_castsi256_ps(_mm256_set1_epi32(0x007FFFFF)));
+            return _mm256_or_ps(m, _mm256_set1_ps(1.0f));
+        }
+    };
+#elif defined(SYN_FASTMATH_SSE2)
+    struct SimdDouble
+    {
+        typedef double T;
+        typedef __m128d V;
+        typedef __m128d M;
+        static const int N = 2;
+
+        static V load(const T* p) { return _mm_loadu_pd(p); }
+        static void store(T* p, V a) { _mm_storeu_pd(p, a); }
+        static V set1(double a) { return _mm_set1_pd(a); }
+        static V add(V a, V b) { return _mm_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm_div_pd(a, b); }
+        static V min(V a, V b) { return _mm_min_pd(a, b); }
+        static V max(V a, V b) { return _mm_max_pd(a, b); }
+        static V abs(V a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+        static M cmpgt(V a, V b) { return _mm_cmpgt_pd(a, b); }
+        static M cmpge(V a, V b) { return _mm_cmpge_pd(a, b); }
+        static V select(M m, V a, V b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+        static V copysign(V mag, V sgn) { return _mm_or_pd(abs(mag), _mm_and_pd(_mm_set1_pd(-0.0), sgn)); }
+
+        /// SSE2 has no rounding instruction, so truncate through int32 and correct negative numbers
+        static V floor(V a)
+        {
+            const V t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+            return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, a), _mm_set1_pd(1.0)));
+        }
+
+        static V pow2i(V n)
+        {
+            const __m128i bits = _mm_castpd_si128(_mm_add_pd(n, _mm_set1_pd(4503599627370496.0 + 1023.0)));
+            return _mm_castsi128_pd(_mm_slli_epi64(bits, 52));
+        }
+
+        static V exponent(V x)
+        {
+            const __m128i e = _mm_srli_epi64(_mm_castpd_si128(x), 52);
+            const V biased = _mm_castsi128_pd(_mm_or_si128(e, _mm_castpd_si128(_mm_set1_pd(4503599627370496.0))));
+            return _mm_sub_pd(biased, _mm_set1_pd(4503599627370496.0 + 1023.0));
+        }
+
+        static V mantissa(V x)
+        {
+            const V m = _mm_and_pd(x, _mm_castsi128_pd(_mm_set1_epi64x(0x000FFFFFFFFFFFFFll)));
+            return _mm_or_pd(m, _mm_set1_pd(1.0));
+        }
+    };
+
+    struct SimdFloat
+    {
+        typedef float T;
+        typedef __m128 V;
+        typedef __m128 M;
+        static const int N = 4;
+
+        static V load(const T* p) { return _mm_loadu_ps(p); }
+        static void store(T* p, V a) { _mm_storeu_ps(p, a); }
+        static V set1(double a) { return _mm_set1_ps(static_cast<float>(a)); }
+        static V add(V a, V b) { return _mm_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm_div_ps(a, b); }
+        static V min(V a, V b) { return _mm_min_ps(a, b); }
+        static V max(V a, V b) { return _mm_max_ps(a, b); }
+        static V abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static M cmpgt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+        static M cmpge(V a, V b) { return _mm_cmpge_ps(a, b); }
+        static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static V copysign(V mag, V sgn) { return _mm_or_ps(abs(mag), _mm_and_ps(_mm_set1_ps(-0.0f), sgn)); }
+
+        /// \see SimdDouble::floor
+        static V floor(V a)
+        {
+            const V t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+        }
+
+        static V pow2i(V n)
+        {
+            const __m128i bits = _mm_castps_si128(_mm_add_ps(n, _mm_set1_ps(8388608.0f + 127.0f)));
+            return _mm_castsi128_ps(_mm_slli_epi32(bits, 23));
+        }
+
+        static V exponent(V x)
+        {
+            const __m128i e = _mm_srli_epi32(_mm_castps_si128(x), 23);
+            const V biased = _mm_castsi128_ps(_mm_or_si128(e, _mm_castps_si128(_mm_set1_ps(8388608.0f))));
+            return _mm_sub_ps(biased, _mm_set1_ps(8388608.0f + 127.0f));
+        }
+
+        static V mantissa(V x)
+        {
+            const V m = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x007FFFFF)));
+            return _mm_or_ps(m, _mm_set1_ps(1.0f));
+        }
+    };
+#endif
+
+    /**
+     * Applies a kernel to every element of an array, a SIMD register at a time, and finishes the remainder with
+     * the scalar version of the kernel.
+     */
+#if defined(SYN_FASTMATH_AVX2) || defined(SYN_FASTMATH_SSE2)
+    template <typename T>
+    struct SimdOps;
+
+    template <>
+    struct SimdOps<double> { typedef SimdDouble Type; };
+
+    template <>
+    struct SimdOps<float> { typedef SimdFloat Type; };
+
+    template <typename T, typename Kernel>
+    void apply(const T* a_in, T* a_out, int a_n, Kernel a_kernel)
+    {
+        typedef typename SimdOps<T>::Type O;
+        int i = 0;
+        for (; i + O::N <= a_n; i += O::N)
+            O::store(a_out + i, a_kernel(O(), O::load(a_in + i)));
+        for (; i < a_n; i++)
+            a_out[i] = a_kernel(ScalarOps<T>(), a_in[i]);
+    }
+#else
+    template <typename T, typename Kernel>
+    void apply(const T* a_in, T* a_out, int a_n, Kernel a_kernel)
+    {
+        for (int i = 0; i < a_n; i++)
+            a_out[i] = a_kernel(ScalarOps<T>(), a_in[i]);
+    }
+#endif
+
+    /*
+     * Kernel functors, which pick the kernel instantiation from the type of the operations they are called with.
+     */
+
+    struct Exp2Kernel
+    {
+        template <typename O>
+        typename O::V operator()(O, typename O::V x) const { return syn::fastmath::exp2<O>(x); }
+    };
+
+    struct Log2Kernel
+    {
+        template <typename O>
+        typename O::V operator()(O, typename O::V x) const { return syn::fastmath::log2<O>(x); }
+    };
+
+    struct TanKernel
+    {
+        template <typename O>
+        typename O::V operator()(O, typename O::V x) const { return syn::fastmath::tan<O>(x); }
+    };
+
+    struct TanhKernel
+    {
+        template <typename O>
+        typename O::V operator()(O, typename O::V x) const { return syn::fastmath::tanh<O>(x); }
+    };
+
+    struct PitchToFreqKernel
+    {
+        template <typename O>
+        typename O::V operator()(O, typename O::V x) const { return syn::fastmath::pitchToFreq<O>(x); }
+    };
+
+    template <typename T>
+    struct WrapKernel
+    {
+        T m;
+
+        template <typename O>
+        typename O::V operator()(O, typename O::V x) const { return syn::fastmath::wrap<O>(x, O::set1(m)); }
+    };
+}
+
+namespace syn
+{
+    void fast_wrap(const float* a_in, float* a_out, int a_n, float a_m) { apply(a_in, a_out, a_n, WrapKernel<float>{a_m}); }
+    void fast_wrap(const double* a_in, double* a_out, int a_n, double a_m) { apply(a_in, a_out, a_n, WrapKernel<double>{a_m}); }
+    void fast_exp2(const float* a_in, float* a_out, int a_n) { apply(a_in, a_out, a_n, Exp2Kernel()); }
+    void fast_exp2(const double* a_in, double* a_out, int a_n) { apply(a_in, a_out, a_n, Exp2Kernel()); }
+    void fast_log2(const float* a_in, float* a_out, int a_n) { apply(a_in, a_out, a_n, Log2Kernel()); }
+    void fast_log2(const double* a_in, double* a_out, int a_n) { apply(a_in, a_out, a_n, Log2Kernel()); }
+    void fast_tan(const float* a_in, float* a_out, int a_n) { apply(a_in, a_out, a_n, TanKernel()); }
+    void fast_tan(const double* a_in, double* a_out, int a_n) { apply(a_in, a_out, a_n, TanKernel()); }
+    void fast_tanh(const float* a_in, float* a_out, int a_n) { apply(a_in, a_out, a_n, TanhKernel()); }
+    void fast_tanh(const double* a_in, double* a_out, int a_n) { apply(a_in, a_out, a_n, TanhKernel()); }
+    void fast_pitchToFreq(const float* a_in, float* a_out, int a_n) { apply(a_in, a_out, a_n, PitchToFreqKernel()); }
+    void fast_pitchToFreq(const double* a_in, double* a_out, int a_n) { apply(a_in, a_out, a_n, PitchToFreqKernel()); }
+
+    const char* fastMathInstructionSet()
+    {
+#if defined(SYN_FASTMATH_AVX2)
+        return "AVX2";
+#elif defined(SYN_FASTMATH_SSE2)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+}
@@ -1,105 +1,311 @@
 #include "vosimlib/MemoryPool.h"
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
-syn::MemoryPool::Chunk::~Chunk() {
-    if (next)
-        next->prev = prev;
-    if (prev)
-        prev->next = next;
-}
+namespace
+{
+    const size_t FREE_BIT = 1;
+
+    size_t alignUp(size_t a_value, size_t a_alignment) { return (a_value + a_alignment - 1) & ~(a_alignment - 1); }
+
+    char* alignUp(char* a_ptr, size_t a_alignment) {
+        return reinterpret_cast<char*>(alignUp(reinterpret_cast<size_t>(a_ptr), a_alignment));
+    }
+
+    /// Index of the least significant set bit of a_word, which must not be zero
+    int findFirstSet(uint32_t a_word) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, a_word);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(a_word);
+#endif
+    }
 
-bool syn::MemoryPool::ChunkSortBySize::operator()(const Chunk& a_lhs, const Chunk& a_rhs) const {
-    return a_lhs.size < a_rhs.size;
+    /// Index of the most significant set bit of a_word, which must not be zero
+    int findLastSet(uint32_t a_word) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse(&index, a_word);
+        return static_cast<int>(index);
+#else
+        return 31 - __builtin_clz(a_word);
+#endif
+    }
 }
 
-bool syn::MemoryPool::ChunkSortByAddr::operator()(const Chunk& a_lhs, const Chunk& a_rhs) const {
-    return a_lhs.addr < a_rhs.addr;
+/**
+ * Header at the start of each block. The payload starts at nextFree, and the next block in memory right after the
+ * payload.
+ */
+struct syn::MemoryPool::Block
+{
+    Block* prevPhys; ///< Block before this one in memory, or null for the first block
+    size_t rawSize; ///< Payload size, with FREE_BIT set while the block is free
+    // Links to the neighbouring blocks in the free list, only valid while the block is free
+    alignas(MIN_ALIGNMENT) Block* nextFree;
+    Block* prevFree;
+
+    size_t size() const { return rawSize & ~FREE_BIT; }
+    bool isFree() const { return (rawSize & FREE_BIT) != 0; }
+    void setSize(size_t a_size, bool a_isFree) { rawSize = a_size | (a_isFree ? FREE_BIT : 0); }
+    char* payload() { return reinterpret_cast<char*>(&nextFree); }
+    Block* nextPhys() { return reinterpret_cast<Block*>(payload() + size()); }
+    static Block* fromPayload(void* a_ptr) { return reinterpret_cast<Block*>(static_cast<char*>(a_ptr) - HEADER_SIZE); }
+
+    static const size_t HEADER_SIZE;
+    /// Smallest payload a block can have, so that it can hold its free list links once freed
+    static const size_t MIN_SIZE;
+};
+
+const size_t syn::MemoryPool::Block::HEADER_SIZE = offsetof(Block, nextFree);
+const size_t syn::MemoryPool::Block::MIN_SIZE = sizeof(Block) - offsetof(Block, nextFree);
+
+double syn::MemoryPool::Stats::fragmentation() const {
+    return bytesFree ? 1.0 - static_cast<double>(largestFreeBlock) / bytesFree : 0.0;
 }
 
-syn::MemoryPool::MemoryPool(size_t a_numBytes):
-    m_head{0, nullptr, false, nullptr, nullptr},
-    m_bytesUsed(0)
+syn::MemoryPool::MemoryPool(size_t a_numBytes) :
+    m_memory(nullptr),
+    m_firstBlock(nullptr),
+    m_capacity(0),
+    m_flBitmap(0),
+    m_slBitmaps{},
+    m_freeLists{},
+    m_bytesUsed(0),
+    m_peakBytesUsed(0),
+    m_numAllocations(0),
+    m_numFailedAllocations(0)
 {
-    m_bytes.resize(a_numBytes);
-    Chunk* freechunk = new Chunk{a_numBytes, &m_bytes[0], true, nullptr, &m_head};
-    m_head.next = freechunk;
-    m_freeChunks.push_back(freechunk);
+    m_lock.clear();
+    // One free block covering the whole pool, followed by an empty block that is never freed, which marks the end
+    const size_t usableBytes = a_numBytes & ~(MIN_ALIGNMENT - 1);
+    if (usableBytes < 2 * Block::HEADER_SIZE + Block::MIN_SIZE || usableBytes - 2 * Block::HEADER_SIZE > MAX_BLOCK_SIZE)
+        throw std::invalid_argument("Unsupported memory pool size");
+    m_memory = new char[usableBytes + MIN_ALIGNMENT];
+    m_firstBlock = reinterpret_cast<Block*>(alignUp(m_memory, MIN_ALIGNMENT));
+    m_capacity = usableBytes - 2 * Block::HEADER_SIZE;
+    m_firstBlock->prevPhys = nullptr;
+    m_firstBlock->setSize(m_capacity, true);
+    Block* sentinel = m_firstBlock->nextPhys();
+    sentinel->prevPhys = m_firstBlock;
+    sentinel->setSize(0, false);
+    _insertFreeBlock(m_firstBlock);
 }
 
 syn::MemoryPool::~MemoryPool() {
-    Chunk* tmp = m_head.next;
-    while (tmp) {
-        delete tmp;
-        tmp = m_head.next;
-    }
+    delete[] m_memory;
 }
 
-void* syn::MemoryPool::allocate(size_t a_numBytes) {
-    // Find best free chunk
-    int minSizeDiff = -1;
-    Chunk* bestChunk = nullptr;
-    for (Chunk* chunk : m_freeChunks) {
-        int size_dist = static_cast<int>(chunk->size) - static_cast<int>(a_numBytes);
-        if (size_dist < 0)
-            continue;
-        if (minSizeDiff == -1 || size_dist < minSizeDiff) {
-            minSizeDiff = size_dist;
-            bestChunk = chunk;
-        }
+void* syn::MemoryPool::allocate(size_t a_numBytes, size_t a_alignment) {
+    assert(a_alignment && (a_alignment & (a_alignment - 1)) == 0);
+    if (a_numBytes > MAX_BLOCK_SIZE || a_alignment > MAX_BLOCK_SIZE) {
+        _lock();
+        m_numFailedAllocations++;
+        _unlock();
+        return nullptr;
     }
-    if (!bestChunk)
-        throw std::runtime_error("Insufficient memory in pool");
-
-    m_bytesUsed += a_numBytes;
-    // Create new used chunk
-    Chunk* usedChunk = new Chunk;
-    usedChunk->size = a_numBytes;
-    usedChunk->addr = bestChunk->addr;
-    usedChunk->isFree = false;
-    usedChunk->next = bestChunk;
-    usedChunk->prev = bestChunk->prev;
-    bestChunk->prev->next = usedChunk;
-    bestChunk->prev = usedChunk;
-    m_usedChunks.push_back(usedChunk);
-
-    // Update free chunk
-    if (minSizeDiff > 0) {
-        bestChunk->addr = bestChunk->addr + a_numBytes;
-        bestChunk->size = bestChunk->size - a_numBytes;
-    } else {
-        m_freeChunks.erase(find(m_freeChunks.begin(), m_freeChunks.end(), bestChunk));
-        delete bestChunk;
+    if (a_alignment < MIN_ALIGNMENT)
+        a_alignment = MIN_ALIGNMENT;
+    const size_t size = a_numBytes > Block::MIN_SIZE ? alignUp(a_numBytes, MIN_ALIGNMENT) : Block::MIN_SIZE;
+    // Stricter alignments need room for a free block to be split off in front of the aligned payload
+    const size_t gapSize = Block::HEADER_SIZE + Block::MIN_SIZE;
+    const size_t searchSize = a_alignment > MIN_ALIGNMENT ? size + a_alignment + gapSize : size;
+
+    _lock();
+    int fl, sl;
+    Block* block = _findFreeBlock(searchSize, fl, sl);
+    if (!block) {
+        m_numFailedAllocations++;
+        _unlock();
+        return nullptr;
+    }
+    _removeFreeBlock(block, fl, sl);
+
+    if (a_alignment > MIN_ALIGNMENT) {
+        char* aligned = alignUp(block->payload(), a_alignment);
+        if (aligned != block->payload() && static_cast<size_t>(aligned - block->payload()) < gapSize)
+            aligned = alignUp(block->payload() + gapSize, a_alignment);
+        const size_t gap = aligned - block->payload();
+        if (gap) {
+            // Give the space in front of the aligned payload back as a free block. The block before it is not free,
+            // since free blocks are always merged.
+            Block* alignedBlock = Block::fromPayload(aligned);
+            alignedBlock->prevPhys = block;
+            alignedBlock->setSize(block->size() - gap, false);
+            alignedBlock->nextPhys()->prevPhys = alignedBlock;
+            block->setSize(gap - Block::HEADER_SIZE, true);
+            _insertFreeBlock(block);
+            block = alignedBlock;
+        }
     }
 
-    return usedChunk->addr;
+    Block* remainder = _splitBlock(block, size);
+    if (remainder)
+        _insertFreeBlock(remainder);
+    block->setSize(block->size(), false);
+
+    m_bytesUsed += block->size();
+    if (m_bytesUsed > m_peakBytesUsed)
+        m_peakBytesUsed = m_bytesUsed;
+    m_numAllocations++;
+    _unlock();
+    return block->payload();
 }
 
 void syn::MemoryPool::free(void* a_ptr) {
-    size_t numUsedChunks = m_usedChunks.size();
-    for (int i = 0; i < numUsedChunks; i++) {
-        Chunk* chunk = m_usedChunks[i];
-        if (chunk->addr == a_ptr) {
-            m_usedChunks.erase(m_usedChunks.begin() + i);
-            chunk->isFree = true;
-            m_freeChunks.push_back(chunk);
-            m_bytesUsed -= chunk->size;
-            _joinFreeChunks(chunk);
-            break;
+    if (!a_ptr)
+        return;
+    assert(owns(a_ptr));
+    _lock();
+    Block* block = Block::fromPayload(a_ptr);
+    assert(!block->isFree());
+    m_bytesUsed -= block->size();
+    m_numAllocations--;
+    block->setSize(block->size(), true);
+    if (block->prevPhys && block->prevPhys->isFree()) {
+        block = block->prevPhys;
+        _removeFreeBlock(block);
+        _mergeWithNext(block);
+    }
+    if (block->nextPhys()->isFree()) {
+        _removeFreeBlock(block->nextPhys());
+        _mergeWithNext(block);
+    }
+    _insertFreeBlock(block);
+    _unlock();
+}
+
+bool syn::MemoryPool::owns(const void* a_ptr) const {
+    const char* ptr = static_cast<const char*>(a_ptr);
+    const char* begin = reinterpret_cast<const char*>(m_firstBlock);
+    return ptr >= begin && ptr < begin + 2 * Block::HEADER_SIZE + m_capacity;
+}
+
+syn::MemoryPool::Stats syn::MemoryPool::stats() const {
+    Stats stats{};
+    _lock();
+    stats.capacity = m_capacity;
+    stats.bytesUsed = m_bytesUsed;
+    stats.peakBytesUsed = m_peakBytesUsed;
+    stats.numAllocations = m_numAllocations;
+    stats.numFailedAllocations = m_numFailedAllocations;
+    for (int fl = 0; fl < FL_COUNT; fl++) {
+        for (int sl = 0; sl < SL_COUNT; sl++) {
+            for (const Block* block = m_freeLists[fl][sl]; block; block = block->nextFree) {
+                stats.bytesFree += block->size();
+                stats.numFreeBlocks++;
+                if (block->size() > stats.largestFreeBlock)
+                    stats.largestFreeBlock = block->size();
+            }
         }
     }
+    _unlock();
+    return stats;
 }
 
-void syn::MemoryPool::_joinFreeChunks(Chunk* a_chunk) {
-    if (!a_chunk->isFree)
-        return;
-    while (a_chunk->prev && a_chunk->prev->isFree) {
-        a_chunk->prev->size += a_chunk->size;
-        a_chunk = a_chunk->prev;
-        m_freeChunks.erase(find(m_freeChunks.begin(), m_freeChunks.end(), a_chunk->next));
-        delete a_chunk->next;
+syn::MemoryPool& syn::MemoryPool::realtime() {
+    // Never destroyed, since units held by other static objects (e.g. UnitFactory prototypes) may outlive it
+    static MemoryPool* pool = new MemoryPool(64 << 20);
+    return *pool;
+}
+
+void syn::MemoryPool::_mapping(size_t a_size, int& a_fl, int& a_sl) {
+    if (a_size < SMALL_BLOCK_SIZE) {
+        // Small blocks get one bin per MIN_ALIGNMENT bytes
+        a_fl = 0;
+        a_sl = static_cast<int>(a_size / (SMALL_BLOCK_SIZE / SL_COUNT));
+    } else {
+        const int log2Size = findLastSet(static_cast<uint32_t>(a_size));
+        a_sl = static_cast<int>(a_size >> (log2Size - SL_LOG2)) ^ SL_COUNT;
+        a_fl = log2Size - (FL_SHIFT - 1);
     }
-    while (a_chunk->next && a_chunk->next->isFree) {
-        a_chunk->size += a_chunk->next->size;
-        m_freeChunks.erase(find(m_freeChunks.begin(), m_freeChunks.end(), a_chunk->next));
-        delete a_chunk->next;
+}
+
+syn::MemoryPool::Block* syn::MemoryPool::_findFreeBlock(size_t a_size, int& a_fl, int& a_sl) const {
+    // Round up to the next bin, so that any block in the bin that is found is large enough
+    if (a_size >= SMALL_BLOCK_SIZE)
+        a_size += (size_t(1) << (findLastSet(static_cast<uint32_t>(a_size)) - SL_LOG2)) - 1;
+    _mapping(a_size, a_fl, a_sl);
+    if (a_fl >= FL_COUNT)
+        return nullptr;
+
+    uint32_t slMap = m_slBitmaps[a_fl] & (~0u << a_sl);
+    if (!slMap) {
+        // Take the smallest non-empty bin of a larger class instead
+        const uint32_t flMap = a_fl + 1 < FL_COUNT ? m_flBitmap & (~0u << (a_fl + 1)) : 0;
+        if (!flMap)
+            return nullptr;
+        a_fl = findFirstSet(flMap);
+        slMap = m_slBitmaps[a_fl];
     }
+    a_sl = findFirstSet(slMap);
+    return m_freeLists[a_fl][a_sl];
+}
+
+void syn::MemoryPool::_insertFreeBlock(Block* a_block) {
+    int fl, sl;
+    _mapping(a_block->size(), fl, sl);
+    Block* head = m_freeLists[fl][sl];
+    a_block->nextFree = head;
+    a_block->prevFree = nullptr;
+    if (head)
+        head->prevFree = a_block;
+    m_freeLists[fl][sl] = a_block;
+    m_flBitmap |= 1u << fl;
+    m_slBitmaps[fl] |= 1u << sl;
+}
+
+void syn::MemoryPool::_removeFreeBlock(Block* a_block, int a_fl, int a_sl) {
+    if (a_block->nextFree)
+        a_block->nextFree->prevFree = a_block->prevFree;
+    if (a_block->prevFree)
+        a_block->prevFree->nextFree = a_block->nextFree;
+    if (m_freeLists[a_fl][a_sl] == a_block) {
+        m_freeLists[a_fl][a_sl] = a_block->nextFree;
+        if (!a_block->nextFree) {
+            m_slBitmaps[a_fl] &= ~(1u << a_sl);
+            if (!m_slBitmaps[a_fl])
+                m_flBitmap &= ~(1u << a_fl);
+        }
+    }
+}
+
+void syn::MemoryPool::_removeFreeBlock(Block* a_block) {
+    int fl, sl;
+    _mapping(a_block->size(), fl, sl);
+    _removeFreeBlock(a_block, fl, sl);
+}
+
+syn::MemoryPool::Block* syn::MemoryPool::_splitBlock(Block* a_block, size_t a_size) {
+    if (a_block->size() < a_size + Block::HEADER_SIZE + Block::MIN_SIZE)
+        return nullptr;
+    // The block after a_block is not free, since free blocks are always merged
+    Block* remainder = reinterpret_cast<Block*>(a_block->payload() + a_size);
+    remainder->prevPhys = a_block;
+    remainder->setSize(a_block->size() - a_size - Block::HEADER_SIZE, true);
+    remainder->nextPhys()->prevPhys = remainder;
+    a_block->setSize(a_size, a_block->isFree());
+    return remainder;
+}
+
+void syn::MemoryPool::_mergeWithNext(Block* a_block) {
+    Block* next = a_block->nextPhys();
+    a_block->setSize(a_block->size() + Block::HEADER_SIZE + next->size(), a_block->isFree());
+    a_block->nextPhys()->prevPhys = a_block;
+}
+
+void syn::MemoryPool::_lock() const {
+    while (m_lock.test_and_set(std::memory_order_acquire))
+        std::this_thread::yield();
+}
+
+void syn::MemoryPool::_unlock() const {
+    m_lock.clear(std::memory_order_release);
 }
@@ -0,0 +1,175 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vosimlib/Oversampler.h"
+#include "vosimlib/DSPMath.h"
+#include <cmath>
+#include <cassert>
+
+namespace
+{
+    /**
+     * Zeroth order modified Bessel function of the first kind (power series).
+     */
+    double besselI0(double a_x)
+    {
+        double sum = 1.0, term = 1.0;
+        const double halfX = 0.5 * a_x;
+        for (int k = 1; k < 64 && term > 1e-16 * sum; k++)
+        {
+            term *= (halfX / k) * (halfX / k);
+            sum += term;
+        }
+        return sum;
+    }
+
+    /// (half length, Kaiser beta) of each stage, from the base rate up
+    const std::pair<int, double> c_stageDesigns[] = {{16, 8.0}, {6, 6.0}, {4, 6.0}};
+}
+
+namespace syn
+{
+    HalfbandStage::HalfbandStage(int a_halfLength, double a_kaiserBeta) :
+        m_halfLength(a_halfLength),
+        m_coefs(a_halfLength),
+        m_upLine(4 * a_halfLength, 0.0),
+        m_evenLine(4 * a_halfLength, 0.0),
+        m_oddLine(4 * a_halfLength, 0.0),
+        m_upPos(0),
+        m_evenPos(0),
+        m_oddPos(0)
+    {
+        // Odd taps at distance d from the centre are 0.5*sinc(d/2) = (-1)^j/(pi*d), for d = 2j+1
+        const double center = delay();
+        const double norm = besselI0(a_kaiserBeta);
+        double sum = 0.0;
+        std::vector<double> coefs(a_halfLength);
+        for (int j = 0; j < a_halfLength; j++)
+        {
+            const double d = 2 * j + 1;
+            const double window = besselI0(a_kaiserBeta * std::sqrt(1.0 - (d / center) * (d / center))) / norm;
+            coefs[j] = (j % 2 ? -1.0 : 1.0) / (SYN_PI * d) * window;
+            sum += coefs[j];
+        }
+        // Each phase should have a DC gain of 1/2
+        for (int j = 0; j < a_halfLength; j++)
+            m_coefs[j] = static_cast<SampleType>(coefs[j] * (0.25 / sum));
+    }
+
+    void HalfbandStage::reset()
+    {
+        std::fill(m_upLine.begin(), m_upLine.end(), 0.0);
+        std::fill(m_evenLine.begin(), m_evenLine.end(), 0.0);
+        std::fill(m_oddLine.begin(), m_oddLine.end(), 0.0);
+        m_upPos = m_evenPos = m_oddPos = 0;
+    }
+
+    void HalfbandStage::upsample(SampleType a_in, SampleType* a_out)
+    {
+        // The zero-stuffed input is scaled by 2 to keep unity gain
+        const SampleType* window = _push(m_upLine, m_upPos, a_in);
+        a_out[0] = 2 * _convolve(window);
+        a_out[1] = window[m_halfLength];
+    }
+
+    SampleType HalfbandStage::downsample(SampleType a_in0, SampleType a_in1)
+    {
+        const SampleType* even = _push(m_evenLine, m_evenPos, a_in0);
+        const SampleType* odd = _push(m_oddLine, m_oddPos, a_in1);
+        return _convolve(even) + SampleType(0.5) * odd[m_halfLength - 1];
+    }
+
+    const SampleType* HalfbandStage::_push(std::vector<SampleType>& a_line, int& a_pos, SampleType a_in) const
+    {
+        const int length = 2 * m_halfLength;
+        a_line[a_pos] = a_line[a_pos + length] = a_in;
+        a_pos = a_pos + 1 == length ? 0 : a_pos + 1;
+        return a_line.data() + a_pos;
+    }
+
+    SampleType HalfbandStage::_convolve(const SampleType* a_window) const
+    {
+        // The window is symmetric about the centre of the filter, which sits between its two middle samples
+        const SampleType* after = a_window + m_halfLength;
+        const SampleType* before = a_window + m_halfLength - 1;
+        SampleType sum = 0.0;
+        for (int j = 0; j < m_halfLength; j++)
+            sum += m_coefs[j] * (after[j] + before[-j]);
+        return sum;
+    }
+
+    Oversampler::Oversampler(int a_factor) :
+        m_factor(a_factor)
+    {
+        assert(a_factor == 1 || a_factor == 2 || a_factor == 4 || a_factor == 8);
+        for (int factor = 1, stage = 0; factor < a_factor; factor *= 2, stage++)
+            m_stages.emplace_back(c_stageDesigns[stage].first, c_stageDesigns[stage].second);
+    }
+
+    void Oversampler::reset()
+    {
+        for (auto& stage : m_stages)
+            stage.reset();
+    }
+
+    void Oversampler::upsample(const SampleType* a_in, SampleType* a_out, int a_n)
+    {
+        for (int i = 0; i < a_n; i++)
+            _upsample(0, a_in[i], a_out + i * m_factor);
+    }
+
+    void Oversampler::downsample(const SampleType* a_in, SampleType* a_out, int a_n)
+    {
+        for (int i = 0; i < a_n; i++)
+            a_out[i] = _downsample(0, a_in + i * m_factor);
+    }
+
+    double Oversampler::latency() const
+    {
+        // Each stage delays both directions by its group delay, at twice the rate of the stage below it
+        double latency = 0.0;
+        for (int i = 0; i < int(m_stages.size()); i++)
+            latency += m_stages[i].delay() / double(1 << i);
+        return latency;
+    }
+
+    void Oversampler::_upsample(int a_stage, SampleType a_in, SampleType* a_out)
+    {
+        if (a_stage == int(m_stages.size()))
+        {
+            *a_out = a_in;
+            return;
+        }
+        SampleType pair[2];
+        m_stages[a_stage].upsample(a_in, pair);
+        const int stride = m_factor >> (a_stage + 1);
+        _upsample(a_stage + 1, pair[0], a_out);
+        _upsample(a_stage + 1, pair[1], a_out + stride);
+    }
+
+    SampleType Oversampler::_downsample(int a_stage, const SampleType* a_in)
+    {
+        if (a_stage == int(m_stages.size()))
+            return *a_in;
+        const int stride = m_factor >> (a_stage + 1);
+        const SampleType in0 = _downsample(a_stage + 1, a_in);
+        const SampleType in1 = _downsample(a_stage + 1, a_in + stride);
+        return m_stages[a_stage].downsample(in0, in1);
+    }
+}
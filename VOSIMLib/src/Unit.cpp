@@ -19,11 +19,17 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include "vosimlib/Unit.h"
 #include "vosimlib/DSPMath.h"
 #include "vosimlib/Circuit.h"
+#include <atomic>
 
 using std::hash;
 
 namespace syn
 {
+    namespace
+    {
+        std::atomic<uint64_t> nextUnitUid{0};
+    }
+
     Unit::Unit() : Unit("") {}
 
     Unit::Unit(const std::string& a_name) :
@@ -31,7 +37,14 @@ namespace syn
         m_name{ a_name },
         m_parent{ nullptr },
         m_audioConfig{ 44.1e3, 120, 1 },
-        m_midiData{} {}
+        m_midiData{},
+        m_inputSpans{},
+        m_outputSpans{},
+        m_blockOffset(0),
+        m_isSubBlock(false),
+        m_uid(nextUnitUid++) {
+        _updateDefaultInputBufs();
+    }
 
     void Unit::setName(const string& a_name) { m_name = a_name; }
 
@@ -74,6 +87,7 @@ namespace syn
         for (auto& output : m_outputPorts) {
             output.resize(a_bufferSize);
         }
+        _updateDefaultInputBufs();
     }
 
     int Unit::getBufferSize() const { return m_audioConfig.bufferSize; }
@@ -104,41 +118,63 @@ namespace syn
 
     const StrMap<UnitParameter, MAX_PARAMS>& Unit::parameters() const { return m_parameters; }
 
-    void Unit::tick(const Eigen::Array<double, -1, -1, Eigen::RowMajor>& a_inputs, Eigen::Array<double, -1, -1, Eigen::RowMajor>& a_outputs)
+    void Unit::tick(const dynamic_buffer_t& a_inputs, dynamic_buffer_t& a_outputs)
     {
         int nSamples = a_inputs.cols();
         int nInputs = MIN<int>(a_inputs.rows(), m_inputPorts.size());
         int nOutputs = MIN<int>(a_outputs.rows(), m_outputPorts.size());
         const Buffer* oldInputSources[MAX_INPUTS];
         std::vector<ReadOnlyBuffer<SampleType>> newInputSources(nInputs);
-        double* oldOutputTargets[MAX_OUTPUTS];
+        SampleType* oldOutputTargets[MAX_OUTPUTS];
+
+        // record original input sources
+        for (int i = 0; i < nInputs; i++) { oldInputSources[i] = m_inputPorts.getByIndex(i).src; }
+        // record original output targets (internal buffers may be reallocated below, so only external ones are kept)
+        for (int i = 0; i < nOutputs; i++) {
+            OutputPort& port = m_outputPorts.getByIndex(i);
+            oldOutputTargets[i] = port.hasExternalBuf() ? port.buf() : nullptr;
+        }
+
         // set new buffer size
         int oldBufferSize = m_audioConfig.bufferSize;
         setBufferSize(nSamples);
 
-        // record original input sources
-        for (int i = 0; i < nInputs; i++) { oldInputSources[i] = m_inputPorts.getByIndex(i).src; }
         // set new input sources
         for (int i = 0; i < nInputs; i++) { newInputSources[i] = { &a_inputs(i, 0) }; m_inputPorts.getByIndex(i).connect(&newInputSources[i]); }
-        // record original output sources
-        for (int i = 0; i < nOutputs; i++) { oldOutputTargets[i] = m_outputPorts.getByIndex(i).buf(); }
         // set new output sources
         for (int i = 0; i < nOutputs; i++) { m_outputPorts.getByIndex(i).setBuf(&a_outputs(i, 0)); }
 
         tick();
 
-        // restore original buffer size
-        setBufferSize(oldBufferSize);
-
         // restore original input sources
         for (int i = 0; i < nInputs; i++) { m_inputPorts.getByIndex(i).connect(oldInputSources[i]); }
         // restore original output sources
-        for (int i = 0; i < nOutputs; i++) { m_outputPorts.getByIndex(i).setBuf(oldOutputTargets[i]); }
+        for (int i = 0; i < nOutputs; i++) {
+            if (oldOutputTargets[i])
+                m_outputPorts.getByIndex(i).setBuf(oldOutputTargets[i]);
+            else
+                m_outputPorts.getByIndex(i).unsetBuf();
+        }
+
+        // restore original buffer size
+        setBufferSize(oldBufferSize);
     }
 
-    int Unit::addInput_(const string& a_name, double a_default) { return m_inputPorts.add(a_name, InputPort{ a_default }); }
+    int Unit::addInput_(const string& a_name, double a_default, bool a_controlRate)
+    {
+        int id = m_inputPorts.add(a_name, InputPort{ a_default, a_controlRate });
+        if (id >= 0)
+            _updateDefaultInputBufs();
+        return id;
+    }
 
-    bool Unit::addInput_(int a_id, const string& a_name, double a_default) { return m_inputPorts.add(a_name, a_id, InputPort{ a_default }); }
+    bool Unit::addInput_(int a_id, const string& a_name, double a_default, bool a_controlRate)
+    {
+        bool retval = m_inputPorts.add(a_name, a_id, InputPort{ a_default, a_controlRate });
+        if (retval)
+            _updateDefaultInputBufs();
+        return retval;
+    }
 
     bool Unit::removeInput_(const string& a_name) { return m_inputPorts.removeByName(a_name); }
     bool Unit::removeInput_(int a_id) { return m_inputPorts.removeById(a_id); }
@@ -171,6 +207,82 @@ namespace syn
 
     void Unit::_setParent(Circuit* a_new_parent) { m_parent = a_new_parent; }
 
+    void Unit::_resolveBlockSpans()
+    {
+        const int* inputIds = m_inputPorts.ids();
+        for (int i = 0; i < m_inputPorts.size(); i++) {
+            int id = inputIds[i];
+            const Buffer* src = m_inputPorts[id].src;
+            m_inputSpans[id] = src ? src->buf() : &m_defaultInputBufs(id, 0);
+        }
+        const int* outputIds = m_outputPorts.ids();
+        for (int i = 0; i < m_outputPorts.size(); i++) {
+            int id = outputIds[i];
+            m_outputSpans[id] = m_outputPorts[id].buf();
+        }
+    }
+
+    void Unit::_processRange(ProcessFn a_process, int a_offset, int a_length)
+    {
+        const int bufferSize = m_audioConfig.bufferSize;
+        const int blockOffset = m_blockOffset;
+        const bool isSubBlock = m_isSubBlock;
+        m_audioConfig.bufferSize = a_length;
+        m_blockOffset = a_offset;
+        m_isSubBlock = true;
+        a_process(this);
+        if (a_offset == 0)
+            _snapshotOutputs();
+        // Flags only describe whole blocks
+        if (a_offset != 0 || a_length != bufferSize) {
+            for (auto& output : m_outputPorts)
+                output.setBlockState(BlockVarying);
+        }
+        m_audioConfig.bufferSize = bufferSize;
+        m_blockOffset = blockOffset;
+        m_isSubBlock = isSubBlock;
+    }
+
+    EBlockState Unit::inputState_(int a_id) const
+    {
+        const InputPort& port = m_inputPorts[a_id];
+        if (port.src)
+            return port.src->blockState();
+        return port.defVal == 0 ? BlockSilent : BlockConstant;
+    }
+
+    int Unit::controlPeriod_(std::initializer_list<int> a_ids) const
+    {
+        int period = getBufferSize();
+        for (int id : a_ids) {
+            if (isInputConstant_(id))
+                continue;
+            if (!m_inputPorts[id].controlRate)
+                return 1;
+            period = CONTROL_PERIOD;
+        }
+        return period;
+    }
+
+    void Unit::setOutputConstant_(int a_id, SampleType a_value)
+    {
+        std::fill_n(outputBuf_(a_id), getBufferSize(), a_value);
+        m_outputPorts[a_id].setBlockState(a_value == 0 ? BlockSilent : BlockConstant);
+    }
+
+    void Unit::_updateDefaultInputBufs()
+    {
+        const int* inputIds = m_inputPorts.ids();
+        int nRows = 0;
+        for (int i = 0; i < m_inputPorts.size(); i++)
+            nRows = MAX(nRows, inputIds[i] + 1);
+        m_defaultInputBufs.resize(nRows, m_audioConfig.bufferSize);
+        for (int i = 0; i < m_inputPorts.size(); i++) {
+            int id = inputIds[i];
+            m_defaultInputBufs.row(id).setConstant(m_inputPorts[id].defVal);
+        }
+    }
+
     void Unit::connectInput(int a_inputPort, const Buffer& a_output)
     {
         m_inputPorts[a_inputPort].connect(&a_output);
@@ -202,27 +314,75 @@ namespace syn
         m_name = a_other.m_name;
         // Copy midi status
         m_midiData = a_other.m_midiData;
-        // Copy audio config data
-        setFs(a_other.m_audioConfig.fs);
-        setTempo(a_other.m_audioConfig.tempo);
-        setBufferSize(a_other.m_audioConfig.bufferSize);
-        // Copy parameter values
-        const string* paramNames = m_parameters.names();
-        for (int i = 0; i < m_parameters.size(); i++)
-        {
-            const string& paramName = paramNames[i];
-            if (a_other.hasParam(paramName))
-                m_parameters[paramName].setFromString(a_other.m_parameters[paramName].getValueString());
+        if (getClassName() != a_other.getClassName()) {
+            // Copy audio config data
+            setFs(a_other.m_audioConfig.fs);
+            setTempo(a_other.m_audioConfig.tempo);
+            setBufferSize(a_other.m_audioConfig.bufferSize);
+            // Copy parameter values by name
+            const string* paramNames = m_parameters.names();
+            for (int i = 0; i < m_parameters.size(); i++)
+            {
+                const string& paramName = paramNames[i];
+                if (a_other.hasParam(paramName))
+                    m_parameters[paramName].setFromString(a_other.m_parameters[paramName].getValueString());
+            }
+            return;
         }
+        // A unit of the same class has the same parameters, so their values are copied exactly by id. The unit is
+        // then configured once, and told about each parameter once, with every value already in place.
+        const int* paramIds = m_parameters.ids();
+        for (int i = 0; i < m_parameters.size(); i++)
+            m_parameters[paramIds[i]].copyValue(a_other.m_parameters[paramIds[i]]);
+        if (m_audioConfig.bufferSize != a_other.m_audioConfig.bufferSize)
+            setBufferSize(a_other.m_audioConfig.bufferSize);
+        m_audioConfig.fs = a_other.m_audioConfig.fs;
+        m_audioConfig.tempo = a_other.m_audioConfig.tempo;
+        reset();
+        onFsChange_();
+        onTempoChange_();
+        for (int i = 0; i < m_parameters.size(); i++)
+            onParamChange_(paramIds[i]);
     }
 
     Unit* Unit::clone() const
     {
         Unit* unit = _clone();
-        unit->copyFrom_(*this);
+        _initClone(unit);
         return unit;
     }
 
+    Unit* Unit::_cloneInto(const std::shared_ptr<Arena>& a_arena) const
+    {
+        const size_t size = _cloneSize();
+        void* memory = size ? a_arena->allocate(size) : nullptr;
+        if (!memory)
+            return nullptr;
+        Unit* unit = _cloneAt(memory);
+        unit->m_arena = a_arena;
+        _initClone(unit);
+        return unit;
+    }
+
+    void Unit::_destroy(Unit* a_unit)
+    {
+        if (!a_unit->m_arena) {
+            delete a_unit;
+            return;
+        }
+        // The arena is released once the last unit constructed in it is gone
+        std::shared_ptr<Arena> arena = std::move(a_unit->m_arena);
+        a_unit->~Unit();
+    }
+
+    void Unit::_initClone(Unit* a_clone) const
+    {
+        a_clone->m_uid = m_uid;
+        // A circuit's copy constructor already copies its state, along with that of all of its units
+        if (!dynamic_cast<Circuit*>(a_clone))
+            a_clone->copyFrom_(*this);
+    }
+
     Unit::operator json() const
     {
         json j;
@@ -276,6 +436,14 @@ namespace syn
 
     double Unit::readOutput(int a_id, int a_offset) const { return m_outputPorts[a_id].read(a_offset); }
 
+    double Unit::readOutputSnapshot(int a_id) const { return m_outputPorts[a_id].snapshot(); }
+
+    void Unit::_snapshotOutputs()
+    {
+        for (auto& output : m_outputPorts)
+            output.takeSnapshot();
+    }
+
     const StrMap<Unit::OutputPort, MAX_OUTPUTS>& Unit::outputs() const { return m_outputPorts; }
 
     Unit::OutputPort& Unit::output(int a_id) { return m_outputPorts[a_id]; }
@@ -93,9 +93,8 @@ syn::UnitFactory::FactoryPrototype& syn::UnitFactory::getPrototype(UnitTypeId a_
 }
 
 const syn::UnitFactory::FactoryPrototype& syn::UnitFactory::getPrototype(UnitTypeId a_classIdentifier) const {
-    for (const FactoryPrototype& prototype : m_prototypes) {
-        if (prototype.classIdentifier == a_classIdentifier)
-            return prototype;
-    }
-    throw std::runtime_error("Prototype not found.");
+    auto it = m_class_identifiers.find(a_classIdentifier);
+    if (it == m_class_identifiers.end())
+        throw std::runtime_error("Prototype not found.");
+    return m_prototypes[it->second];
 }
@@ -220,6 +220,16 @@ namespace syn {
         return false;
     }
 
+    void UnitParameter::copyValue(const UnitParameter& a_other) {
+        m_value = a_other.m_value;
+        m_min = a_other.m_min;
+        m_max = a_other.m_max;
+        m_shape = a_other.m_shape;
+        m_isVisible = a_other.m_isVisible;
+        m_controlType = a_other.m_controlType;
+        m_displayPrecision = a_other.m_displayPrecision;
+    }
+
     double UnitParameter::getNorm() const {
         return getNorm(m_value);
     }
@@ -336,6 +346,15 @@ namespace syn {
         return *this;
     }
 
+    UnitParameter& UnitParameter::restore(EParamType a_type, double a_min, double a_max, vector<DisplayText>&& a_displayTexts, double a_value) {
+        m_type = a_type;
+        m_min = a_min;
+        m_max = a_max;
+        m_displayTexts = std::move(a_displayTexts);
+        set(a_value);
+        return *this;
+    }
+
     UnitParameter::operator json() const {
         json j;
         j["value"] = getValueString();
@@ -18,6 +18,9 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimlib/VoiceManager.h"
 #include "vosimlib/Command.h"
+#include "vosimlib/DSPMath.h"
+#include <algorithm>
+#include <chrono>
 
 namespace syn
 {
@@ -26,7 +29,9 @@ namespace syn
         for (int i = 0; i < m_voices.size(); i++) {
             m_voices[i].setFs(a_newFs);
         }
+        m_fs = a_newFs;
         m_instrument.setFs(a_newFs);
+        m_configVersion++;
     }
 
     void VoiceManager::setTempo(double a_newTempo) {
@@ -34,71 +39,125 @@ namespace syn
         for (int i = 0; i < m_voices.size(); i++) {
             m_voices[i].setTempo(a_newTempo);
         }
-        m_instrument.setTempo(a_newTempo);
+        m_tempo = a_newTempo;
+        _sendModelEvent(ModelEvent::Tempo, 0, a_newTempo);
     }
 
     void VoiceManager::noteOn(int a_noteNumber, int a_velocity) {
-        int currVoiceIndex = m_lastVoiceIndex;
-        int bestVoiceIndex = -1;
-        int bestVoiceScore = 0;
-        do {
-            auto& voice = m_voices[currVoiceIndex];
-            if (!voice.isActive()) {
-                voice.noteOn(a_noteNumber, a_velocity);
-                m_lastVoiceIndex = currVoiceIndex;
-                m_voiceBirths[currVoiceIndex] = m_voiceTicks;
-                m_voiceTicks++;
-                return;
-            }
-
-            int voiceAge = m_voiceTicks - m_voiceBirths[currVoiceIndex];
-            int currVoiceScore = 0;
-            switch(m_voiceStealingPolicy) {
-            case Highest:
-                currVoiceScore -= voice.note();
-                break;
-            case Lowest:
-                currVoiceScore += voice.note();
-                break;
-            case Newest:
-                currVoiceScore -= voiceAge;
-                break;
-            case Oldest:
-            default:
-                currVoiceScore += voiceAge;
-                break;
-            }
-            currVoiceScore += voice.isNoteOn() ? 0 : 1;
-
-            if(currVoiceScore>bestVoiceScore || bestVoiceIndex==-1) {
-                bestVoiceIndex = currVoiceIndex;
-                bestVoiceScore = currVoiceScore;
-            }
-
-            currVoiceIndex++;
-            if (currVoiceIndex == m_voices.size())
-                currVoiceIndex = 0;
-        } while (currVoiceIndex != m_lastVoiceIndex);
+        int voiceIndex;
+        if (m_numIdleVoices) {
+            voiceIndex = m_idleVoices[m_firstIdleVoice];
+            m_firstIdleVoice = (m_firstIdleVoice + 1) % MAX_VOICES;
+            m_numIdleVoices--;
+            m_activePositions[voiceIndex] = m_numActiveVoices;
+            m_activeVoices[m_numActiveVoices++] = voiceIndex;
+        } else {
+            voiceIndex = m_stealQueue.top();
+            _unlinkNote(voiceIndex);
+        }
 
-        m_voices[bestVoiceIndex].noteOn(a_noteNumber, a_velocity);
-        m_lastVoiceIndex = bestVoiceIndex;
-        m_voiceBirths[bestVoiceIndex] = m_voiceTicks;
+        m_voices[voiceIndex].noteOn(a_noteNumber, a_velocity);
+        m_lastVoiceIndex = voiceIndex;
+        m_voiceBirths[voiceIndex] = m_voiceTicks;
         m_voiceTicks++;
+        _linkNote(voiceIndex);
+        m_stealQueue.push(voiceIndex, _stealPriority(voiceIndex));
     }
 
     void VoiceManager::noteOff(int a_noteNumber) {
-        for(auto& voice : m_voices) {
-            if(voice.note() == a_noteNumber)
+        int voiceIndex = m_noteLists[a_noteNumber & (NUM_NOTE_LISTS - 1)];
+        while (voiceIndex >= 0) {
+            const int nextVoiceIndex = m_nextNoteVoice[voiceIndex];
+            auto& voice = m_voices[voiceIndex];
+            if (voice.note() == a_noteNumber) {
                 voice.noteOff();
+                _unlinkNote(voiceIndex);
+                // Voices without a release phase finish immediately
+                if (!voice.isActive())
+                    _deactivateVoice(voiceIndex);
+                else
+                    m_stealQueue.push(voiceIndex, _stealPriority(voiceIndex));
+            }
+            voiceIndex = nextVoiceIndex;
         }
     }
 
+    IndexedHeap<MAX_VOICES>::key_type VoiceManager::_stealPriority(int a_voiceIndex) const {
+        typedef IndexedHeap<MAX_VOICES>::key_type key_type;
+        const key_type note = m_voices[a_voiceIndex].note();
+        const key_type birth = m_voiceBirths[a_voiceIndex];
+        key_type priority;
+        switch (m_voiceStealingPolicy) {
+        case Highest:
+            priority = -(note << 32) - birth;
+            break;
+        case Lowest:
+            priority = (note << 32) - birth;
+            break;
+        case Newest:
+            priority = birth;
+            break;
+        case Oldest:
+        default:
+            priority = -birth;
+            break;
+        }
+        if (!m_voices[a_voiceIndex].isNoteOn())
+            priority += key_type(1) << 48;
+        return priority;
+    }
+
+    void VoiceManager::_deactivateVoice(int a_voiceIndex) {
+        _unlinkNote(a_voiceIndex);
+        m_stealQueue.remove(a_voiceIndex);
+
+        // Swap the last active voice into the vacated slot
+        const int pos = m_activePositions[a_voiceIndex];
+        const int lastVoiceIndex = m_activeVoices[--m_numActiveVoices];
+        m_activeVoices[pos] = lastVoiceIndex;
+        m_activePositions[lastVoiceIndex] = pos;
+        m_activePositions[a_voiceIndex] = -1;
+
+        m_idleVoices[(m_firstIdleVoice + m_numIdleVoices) % MAX_VOICES] = a_voiceIndex;
+        m_numIdleVoices++;
+    }
+
+    void VoiceManager::_linkNote(int a_voiceIndex) {
+        int& head = m_noteLists[m_voices[a_voiceIndex].note() & (NUM_NOTE_LISTS - 1)];
+        m_prevNoteVoice[a_voiceIndex] = -1;
+        m_nextNoteVoice[a_voiceIndex] = head;
+        if (head >= 0)
+            m_prevNoteVoice[head] = a_voiceIndex;
+        head = a_voiceIndex;
+        m_holdsNote[a_voiceIndex] = true;
+    }
+
+    void VoiceManager::_unlinkNote(int a_voiceIndex) {
+        if (!m_holdsNote[a_voiceIndex])
+            return;
+        const int prev = m_prevNoteVoice[a_voiceIndex];
+        const int next = m_nextNoteVoice[a_voiceIndex];
+        if (prev >= 0)
+            m_nextNoteVoice[prev] = next;
+        else
+            m_noteLists[m_voices[a_voiceIndex].note() & (NUM_NOTE_LISTS - 1)] = next;
+        if (next >= 0)
+            m_prevNoteVoice[next] = prev;
+        m_holdsNote[a_voiceIndex] = false;
+    }
+
+    void VoiceManager::setVoiceStealPolicy(VoiceStealPolicy a_newPolicy) {
+        m_voiceStealingPolicy = a_newPolicy;
+        for (int i = 0; i < m_numActiveVoices; i++)
+            m_stealQueue.push(m_activeVoices[i], _stealPriority(m_activeVoices[i]));
+    }
+
     void VoiceManager::sendControlChange(int a_cc, double a_value) {
         // Send control change to all voices
         for (int i = 0; i < m_voices.size(); i++) {
             m_voices[i].notifyMidiControlChange(a_cc, a_value);
         }
-        m_instrument.notifyMidiControlChange(a_cc, a_value);
+        _sendModelEvent(ModelEvent::ControlChange, a_cc, a_value);
     }
 
     void VoiceManager::sendPitchWheelChange(double a_value) {
@@ -106,7 +165,28 @@ namespace syn
         for (int i = 0; i < m_voices.size(); i++) {
             m_voices[i].notifyPitchWheelChange(a_value);
         }
-        m_instrument.notifyPitchWheelChange(a_value);
+        _sendModelEvent(ModelEvent::PitchWheel, 0, a_value);
+    }
+
+    void VoiceManager::_sendModelEvent(ModelEvent::Type a_type, int a_number, double a_value) {
+        m_modelEvents.push(ModelEvent{a_type, a_number, a_value});
+    }
+
+    void VoiceManager::_applyModelEvents() {
+        ModelEvent event;
+        while (m_modelEvents.pop(event)) {
+            switch (event.type) {
+            case ModelEvent::ControlChange:
+                m_instrument.notifyMidiControlChange(event.number, event.value);
+                break;
+            case ModelEvent::PitchWheel:
+                m_instrument.notifyPitchWheelChange(event.value);
+                break;
+            case ModelEvent::Tempo:
+                m_instrument.setTempo(event.value);
+                break;
+            }
+        }
     }
 
     void VoiceManager::setMaxVoices(int a_newMax) {
@@ -115,74 +195,341 @@ namespace syn
         if (a_newMax > MAX_VOICES)
             a_newMax = MAX_VOICES;
 
-        m_voices.clear();
         m_voiceBirths.clear();
-        m_lastVoiceIndex = 0;
         m_voiceTicks = 0;
 
         // Construct new voices
-        m_voices.resize(a_newMax);
+        _stampVoices(CircuitBlueprint{m_instrument}, m_voices, a_newMax);
         m_voiceBirths.resize(a_newMax, -1);
 
-        for(int i=0;i<a_newMax;i++)
+        _resetVoiceAllocation();
+        _resizeVoiceBuffers();
+    }
+
+    void VoiceManager::_resetVoiceAllocation() {
+        // Every voice starts out idle
+        const int numVoices = int(m_voices.size());
+        m_lastVoiceIndex = 0;
+        m_numActiveVoices = 0;
+        m_activePositions.fill(-1);
+        m_stealQueue.clear();
+        m_noteLists.fill(-1);
+        m_holdsNote.fill(false);
+        m_firstIdleVoice = 0;
+        m_numIdleVoices = numVoices;
+        for (int i = 0; i < numVoices; i++)
+            m_idleVoices[i] = i;
+    }
+
+    void VoiceManager::editCircuit(const std::function<void(Circuit&)>& a_edit) {
+        _applyModelEvents();
+        a_edit(m_instrument);
+        _requestBuild(getMaxVoices(), true);
+    }
+
+    void VoiceManager::loadCircuit(const Circuit& a_circ) {
+        m_instrument = a_circ;
+        _requestBuild(getMaxVoices(), false);
+    }
+
+    void VoiceManager::queueMaxVoices(int a_newMax) {
+        _requestBuild(CLAMP(a_newMax, 1, MAX_VOICES), false);
+    }
+
+    void VoiceManager::_requestBuild(int a_numVoices, bool a_carryState) {
+        _applyModelEvents();
+        std::unique_ptr<const CircuitBlueprint> blueprint{new CircuitBlueprint(m_instrument)};
+        {
+            std::lock_guard<std::mutex> lock(m_buildMutex);
+            // Successive edits with no actions in between are merged into the build that has not started yet
+            VoiceSet* set = nullptr;
+            if (!m_buildJobs.empty() && !m_pendingActions.empty() && m_pendingActions.back() == nullptr) {
+                set = m_buildJobs.back();
+                if (set->numVoices != a_numVoices || set->carryState != a_carryState)
+                    set = nullptr;
+            }
+            const bool merged = set != nullptr;
+            if (!merged) {
+                set = new VoiceSet;
+                set->numVoices = a_numVoices;
+                set->carryState = a_carryState;
+                set->built = false;
+                m_buildJobs.push_back(set);
+                m_buildingVoiceSets.push_back(set);
+            }
+            set->blueprint.swap(blueprint);
+            set->bufferSize = m_bufferSize;
+            set->internalBufferSize = m_instrument.getBufferSize();
+            set->fs = m_instrument.fs();
+            set->configVersion = m_configVersion;
+            if (merged)
+                return;
+        }
+        if (!m_builder.joinable())
+            m_builder = std::thread(&VoiceManager::_builderLoop, this);
+        m_buildCondition.notify_all();
+        m_pendingActions.push_back(nullptr);
+    }
+
+    void VoiceManager::waitForBuilds() {
         {
-            m_voices[i] = m_instrument;
-            m_voices[i].setVoiceIndex(a_newMax>1 ? (i+1) * 1.0 / a_newMax : 1.0);
+            std::unique_lock<std::mutex> lock(m_buildMutex);
+            // Sets are built in order, so the last one is built last
+            m_buildCondition.wait(lock, [this]() { return m_buildingVoiceSets.empty() || m_buildingVoiceSets.back()->built; });
         }
+        _collectFinishedActions();
+        _sendPendingActions();
+    }
+
+    void VoiceManager::_buildVoiceSet(VoiceSet& a_set) {
+        _stampVoices(*a_set.blueprint, a_set.voices, a_set.numVoices);
+        a_set.voiceBirths.assign(a_set.numVoices, -1);
+        a_set.voiceBuffers.setZero(2 * a_set.numVoices, a_set.bufferSize);
+    }
+
+    void VoiceManager::_stampVoices(const CircuitBlueprint& a_blueprint, vector<Circuit>& a_voices, int a_numVoices) {
+        a_voices.clear();
+        a_voices.resize(a_numVoices);
+        a_blueprint.stamp(a_voices.data(), a_numVoices, &_getBuildPool());
+        for (int i = 0; i < a_numVoices; i++)
+            a_voices[i].setVoiceIndex(a_numVoices > 1 ? (i + 1) * 1.0 / a_numVoices : 1.0);
+    }
+
+    WorkerPool& VoiceManager::_getBuildPool() {
+        std::call_once(m_buildPoolFlag, [this]() {
+            m_buildPool.reset(new WorkerPool(std::max(1, int(std::thread::hardware_concurrency()))));
+        });
+        return *m_buildPool;
+    }
+
+    void VoiceManager::_reconfigureVoiceSet(VoiceSet& a_set) {
+        for (Circuit& voice : a_set.voices) {
+            voice.setFs(a_set.fs);
+            voice.setBufferSize(a_set.internalBufferSize);
+        }
+        a_set.voiceBuffers.setZero(2 * a_set.numVoices, a_set.bufferSize);
+    }
+
+    void VoiceManager::_builderLoop() {
+        std::unique_lock<std::mutex> lock(m_buildMutex);
+        while (true) {
+            VoiceSet* set;
+            while (m_retiredVoiceSets.pop(set)) {
+                lock.unlock();
+                delete set;
+                lock.lock();
+            }
+            if (m_staleVoiceSets.pop(set)) {
+                lock.unlock();
+                _reconfigureVoiceSet(*set);
+                // Cannot fail, as only one set is away at a time
+                m_reconfiguredVoiceSets.push(set);
+                lock.lock();
+                continue;
+            }
+            if (!m_buildJobs.empty()) {
+                set = m_buildJobs.front();
+                m_buildJobs.pop_front();
+                lock.unlock();
+                _buildVoiceSet(*set);
+                lock.lock();
+                set->built = true;
+                m_buildCondition.notify_all();
+                continue;
+            }
+            if (m_stopBuilder)
+                break;
+            // The real-time thread does not signal retired sets, so they are picked up periodically
+            m_buildCondition.wait_for(lock, std::chrono::milliseconds(50));
+        }
+    }
+
+    void VoiceManager::_installVoiceSet() {
+        VoiceSet* set;
+        if (m_readyVoiceSets.pop(set))
+            _installVoiceSet(set);
+    }
+
+    void VoiceManager::_installVoiceSet(VoiceSet* a_set) {
+        // The sampling frequency or buffer size may have changed while the set was on its way, and setting them up
+        // again allocates, so that is left to the builder thread
+        if (a_set->configVersion != m_configVersion) {
+            a_set->fs = m_fs;
+            a_set->bufferSize = m_bufferSize;
+            a_set->internalBufferSize = m_internalBufferSize;
+            a_set->configVersion = m_configVersion;
+            // Cannot fail, as only one set is away at a time
+            m_staleVoiceSets.push(a_set);
+            m_awaitingVoiceSet = true;
+            return;
+        }
+        for (Circuit& voice : a_set->voices) {
+            if (voice.tempo() != m_tempo)
+                voice.setTempo(m_tempo);
+        }
+
+        // Units set up for another internal buffer size cannot be taken over
+        const bool carryState = a_set->carryState && a_set->voices.size() == m_voices.size()
+                && a_set->internalBufferSize == m_internalBufferSize;
+        m_internalBufferSize = a_set->internalBufferSize;
+        if (carryState) {
+            for (int i = 0; i < int(m_voices.size()); i++)
+                a_set->voices[i].adoptUnits(m_voices[i]);
+        }
+        m_voices.swap(a_set->voices);
+        m_voiceBuffers.swap(a_set->voiceBuffers);
+        if (!carryState) {
+            m_voiceBirths.swap(a_set->voiceBirths);
+            m_voiceTicks = 0;
+            _resetVoiceAllocation();
+        }
+        // Cannot fail, as there are never more sets in flight than there are commands
+        m_retiredVoiceSets.push(a_set);
     }
 
     vector<int> VoiceManager::getActiveVoiceIndices() const
     {
-        vector<int> voiceIndices;
-        for (int i = 0; i < m_voices.size(); i++) {
-            if (m_voices[i].isActive())
-                voiceIndices.push_back(i);
-        }
+        vector<int> voiceIndices(m_activeVoices.begin(), m_activeVoices.begin() + m_numActiveVoices);
+        std::sort(voiceIndices.begin(), voiceIndices.end());
         return voiceIndices;
     }
 
     vector<int> VoiceManager::getReleasedVoiceIndices() const {
         vector<int> voiceIndices;
-        for (int i = 0; i < m_voices.size(); i++) {
-            if (m_voices[i].isActive() && !m_voices[i].isNoteOn())
-                voiceIndices.push_back(i);
+        for (int i = 0; i < m_numActiveVoices; i++) {
+            if (!m_voices[m_activeVoices[i]].isNoteOn())
+                voiceIndices.push_back(m_activeVoices[i]);
         }
+        std::sort(voiceIndices.begin(), voiceIndices.end());
         return voiceIndices;
     }
 
     vector<int> VoiceManager::getIdleVoiceIndices() const {
         vector<int> voiceIndices;
-        for (int i = 0; i < m_voices.size(); i++) {
-            if (!m_voices[i].isActive())
-                voiceIndices.push_back(i);
-        }
+        for (int i = 0; i < m_numIdleVoices; i++)
+            voiceIndices.push_back(m_idleVoices[(m_firstIdleVoice + i) % MAX_VOICES]);
+        std::sort(voiceIndices.begin(), voiceIndices.end());
         return voiceIndices;
     }
 
-    void VoiceManager::tick(const double* a_left_input, const double* a_right_input, double* a_left_output, double* a_right_output) {
+    void VoiceManager::tick(const SampleType* a_left_input, const SampleType* a_right_input, SampleType* a_left_output, SampleType* a_right_output,
+                            const MidiEvent* a_events, int a_numEvents) {
         _flushActionQueue();
 
-        for (int j = 0; j < m_bufferSize; j++) {
-            a_left_output[j] = 0;
-            a_right_output[j] = 0;
-        }
-
-        for (auto& voice : m_voices) {
-            if (voice.isActive()) {
-                for (int sample = 0; sample < m_bufferSize; sample += m_internalBufferSize) {
-                    ReadOnlyBuffer<double> left{a_left_input}, right{a_right_input};
-                    voice.connectInput(0, left);
-                    voice.connectInput(1, right);
-                    voice.tick();
-                    for (int j = 0; j < m_internalBufferSize; j++) {
-                        a_left_output[sample + j] += voice.readOutput(0, j);
-                        a_right_output[sample + j] += voice.readOutput(1, j);
-                    }
+        m_leftInput = a_left_input;
+        m_rightInput = a_right_input;
+        std::fill_n(a_left_output, m_bufferSize, 0.0);
+        std::fill_n(a_right_output, m_bufferSize, 0.0);
+
+        // Apply the events due at each sample, then render up to the next event
+        int event = 0;
+        for (int sample = 0; sample < m_bufferSize;) {
+            while (event < a_numEvents && a_events[event].offset <= sample)
+                _applyEvent(a_events[event++]);
+            const int end = event < a_numEvents ? MIN(a_events[event].offset, m_bufferSize) : m_bufferSize;
+            _renderRange(sample, end - sample, a_left_output, a_right_output);
+            sample = end;
+        }
+        while (event < a_numEvents)
+            _applyEvent(a_events[event++]);
+
+        // Return the voices that finished during this block to the idle list
+        for (int i = m_numActiveVoices - 1; i >= 0; i--) {
+            if (!m_voices[m_activeVoices[i]].isActive())
+                _deactivateVoice(m_activeVoices[i]);
+        }
+    }
+
+    void VoiceManager::_renderRange(int a_offset, int a_length, SampleType* a_left_output, SampleType* a_right_output) {
+        // Group the active voices that can be ticked in lockstep
+        m_numGroups = 0;
+        for (int i = 0; i < m_numActiveVoices; i++) {
+            const int groupStart = m_numGroups ? m_groupOffsets[m_numGroups - 1] : 0;
+            if (!m_numGroups || i - groupStart == m_numLanes || m_voices[m_activeVoices[groupStart]].m_plan != m_voices[m_activeVoices[i]].m_plan)
+                m_groupOffsets[m_numGroups++] = i;
+        }
+        m_groupOffsets[m_numGroups] = m_numActiveVoices;
+
+        m_renderOffset = a_offset;
+        m_renderLength = a_length;
+        m_workerPool.parallelFor(m_numGroups, &VoiceManager::_renderGroupTask, this);
+
+        // Mix the voices in a fixed order, so the result does not depend on which thread rendered which voice
+        Eigen::Map<Eigen::Array<SampleType, -1, 1>> left{a_left_output + a_offset, a_length};
+        Eigen::Map<Eigen::Array<SampleType, -1, 1>> right{a_right_output + a_offset, a_length};
+        for (int i = 0; i < m_numActiveVoices; i++) {
+            int voiceIndex = m_activeVoices[i];
+            left += m_voiceBuffers.row(2 * voiceIndex).segment(a_offset, a_length).transpose();
+            right += m_voiceBuffers.row(2 * voiceIndex + 1).segment(a_offset, a_length).transpose();
+        }
+    }
+
+    void VoiceManager::_renderVoices(const int* a_voiceIndices, int a_numVoices) {
+        Circuit* voices[MAX_LANES];
+        for (int i = 0; i < a_numVoices; i++)
+            voices[i] = &m_voices[a_voiceIndices[i]];
+        const int end = m_renderOffset + m_renderLength;
+        for (int sample = m_renderOffset; sample < end;) {
+            // Split the range at the boundaries of the voices' internal buffers
+            const int chunk = sample - sample % m_internalBufferSize;
+            const int offset = sample - chunk;
+            const int length = MIN(end, chunk + m_internalBufferSize) - sample;
+            ReadOnlyBuffer<SampleType> leftIn{m_leftInput + chunk}, rightIn{m_rightInput + chunk};
+            for (int i = 0; i < a_numVoices; i++) {
+                voices[i]->connectInput(0, leftIn);
+                voices[i]->connectInput(1, rightIn);
+            }
+            if (length < m_internalBufferSize) {
+                for (int i = 0; i < a_numVoices; i++)
+                    voices[i]->tick(offset, length);
+            } else if (a_numVoices == 1) {
+                voices[0]->tick();
+            } else {
+                Circuit::tickLanes(voices, a_numVoices);
+            }
+            for (int i = 0; i < a_numVoices; i++) {
+                SampleType* left = &m_voiceBuffers(2 * a_voiceIndices[i], chunk);
+                SampleType* right = &m_voiceBuffers(2 * a_voiceIndices[i] + 1, chunk);
+                for (int j = offset; j < offset + length; j++) {
+                    left[j] = voices[i]->readOutput(0, j);
+                    right[j] = voices[i]->readOutput(1, j);
                 }
             }
+            sample += length;
+        }
+    }
+
+    void VoiceManager::_applyEvent(const MidiEvent& a_event) {
+        switch (a_event.type) {
+        case MidiEvent::NoteOn:
+            noteOn(a_event.number, int(a_event.value));
+            break;
+        case MidiEvent::NoteOff:
+            noteOff(a_event.number);
+            break;
+        case MidiEvent::ControlChange:
+            sendControlChange(a_event.number, a_event.value);
+            break;
+        case MidiEvent::PitchWheel:
+            sendPitchWheelChange(a_event.value);
+            break;
         }
     }
 
+    void VoiceManager::_renderGroupTask(void* a_context, int a_index) {
+        VoiceManager* vm = static_cast<VoiceManager*>(a_context);
+        const int begin = vm->m_groupOffsets[a_index];
+        vm->_renderVoices(&vm->m_activeVoices[begin], vm->m_groupOffsets[a_index + 1] - begin);
+    }
+
+    void VoiceManager::setNumLanes(int a_numLanes) {
+        m_numLanes = CLAMP(a_numLanes, 1, MAX_LANES);
+    }
+
+    void VoiceManager::_resizeVoiceBuffers() {
+        m_voiceBuffers.setZero(2 * m_voices.size(), m_bufferSize);
+    }
+
     int VoiceManager::getNewestVoiceIndex() const {
         return m_lastVoiceIndex;
     }
@@ -192,23 +539,117 @@ namespace syn
     }
 
     void VoiceManager::onIdle() {
-        _flushActionQueue();
+        _applyModelEvents();
+        _collectFinishedActions();
+        // The commands run here are already on the gui thread, so they are destroyed right away
+        do {
+            Command* msg;
+            while (m_queuedActions.pop(msg)) {
+                (*msg)();
+                m_commandPool.destroy(msg);
+                m_numActionsInFlight--;
+            }
+        } while (_sendPendingActions());
     }
 
     bool VoiceManager::queueAction(Command* a_msg) {
-        if(!m_queuedActions.write_available()){
-            return false;
-        }
-        m_queuedActions.push(a_msg);
-        return true;
+        _collectFinishedActions();
+        _sendPendingActions();
+        if (m_pendingActions.empty() && _sendAction(a_msg))
+            return true;
+        m_pendingActions.push_back(a_msg);
+        // Actions waiting on a build are held back on purpose, not because the queue overflowed
+        if (m_buildingVoiceSets.empty())
+            m_numActionOverflows++;
+        return false;
     }
 
     void VoiceManager::_flushActionQueue() {
+        // The actions that follow a stale voice set may refer to its units, so they wait until it is swapped in
+        if (m_awaitingVoiceSet) {
+            VoiceSet* set;
+            if (!m_reconfiguredVoiceSets.pop(set))
+                return;
+            m_awaitingVoiceSet = false;
+            _installVoiceSet(set);
+        }
         Command* msg;
-        while (m_queuedActions.pop(msg)) {
+        while (!m_awaitingVoiceSet && m_queuedActions.pop(msg)) {
             (*msg)();
-            delete msg;
+            // Cannot fail, as there are never more commands in flight than the queue can hold
+            m_finishedActions.push(msg);
+        }
+    }
+
+    void VoiceManager::_collectFinishedActions() {
+        Command* msg;
+        while (m_finishedActions.pop(msg)) {
+            m_commandPool.destroy(msg);
+            m_numActionsInFlight--;
+        }
+    }
+
+    bool VoiceManager::_sendPendingActions() {
+        bool sent = false;
+        while (!m_pendingActions.empty()) {
+            Command* action = m_pendingActions.front();
+            if (action) {
+                if (!_sendAction(action))
+                    break;
+            } else {
+                // Send the next voice set once it has been built, followed by the command that swaps it in
+                VoiceSet* set = m_buildingVoiceSets.front();
+                if (!set->built)
+                    break;
+                action = m_commandPool.make([this]() { _installVoiceSet(); });
+                if (!_sendAction(action)) {
+                    m_commandPool.destroy(action);
+                    break;
+                }
+                m_readyVoiceSets.push(set);
+                m_buildingVoiceSets.pop_front();
+            }
+            m_pendingActions.pop_front();
+            sent = true;
+        }
+        return sent;
+    }
+
+    bool VoiceManager::_sendAction(Command* a_action) {
+        if (m_numActionsInFlight >= MAX_VOICEMANAGER_MSG_QUEUE_SIZE || !m_queuedActions.push(a_action))
+            return false;
+        m_numActionsInFlight++;
+        return true;
+    }
+
+    VoiceManager::~VoiceManager() {
+        {
+            std::lock_guard<std::mutex> lock(m_buildMutex);
+            m_stopBuilder = true;
+        }
+        m_buildCondition.notify_all();
+        if (m_builder.joinable())
+            m_builder.join();
+
+        _collectFinishedActions();
+        Command* msg;
+        while (m_queuedActions.pop(msg))
+            m_commandPool.destroy(msg);
+        for (Command* action : m_pendingActions) {
+            if (action)
+                m_commandPool.destroy(action);
         }
+        for (VoiceSet* set : m_buildingVoiceSets)
+            delete set;
+        VoiceSet* set;
+        while (m_readyVoiceSets.pop(set))
+            delete set;
+        while (m_retiredVoiceSets.pop(set))
+            delete set;
+        while (m_staleVoiceSets.pop(set))
+            delete set;
+        while (m_reconfiguredVoiceSets.pop(set))
+            delete set;
     }
 
     Circuit& VoiceManager::getPrototypeCircuit() {
@@ -230,7 +671,7 @@ namespace syn
     }
 
     void VoiceManager::setPrototypeCircuit(const Circuit& a_circ) {
-        m_instrument = Circuit{ a_circ };
+        m_instrument = a_circ;
         setMaxVoices(int(m_voices.size()));
     }
 
@@ -250,35 +691,44 @@ namespace syn
 
     void VoiceManager::setBufferSize(int a_bufferSize) {
         m_bufferSize = a_bufferSize > 0 ? a_bufferSize : 1;
+        m_configVersion++;
         setInternalBufferSize(m_internalBufferSize);
+        _resizeVoiceBuffers();
     }
 
-    void VoiceManager::setInternalBufferSize(int a_internalBufferSize)
+    int VoiceManager::_fitInternalBufferSize(int a_internalBufferSize) const
     {
         // Force internal buffer size to a multiple of the final buffer size
         a_internalBufferSize = a_internalBufferSize > 0 ? a_internalBufferSize : 1;
         int u = a_internalBufferSize;
         int d = a_internalBufferSize;
-        m_internalBufferSize = m_bufferSize;
+        int internalBufferSize = m_bufferSize;
         bool stop = false;
         while (!stop)
         {
             if (u < m_bufferSize) {
                 if (m_bufferSize%u == 0) {
-                    m_internalBufferSize = u;
+                    internalBufferSize = u;
                     break;
                 }
                 u++;
             }
             if (d > 0) {
                 if (m_bufferSize%d == 0) {
-                    m_internalBufferSize = d;
+                    internalBufferSize = d;
                     break;
                 }
                 d--;
             }
             stop = !(u < m_bufferSize || d>0);
         }
+        return internalBufferSize;
+    }
+
+    void VoiceManager::setInternalBufferSize(int a_internalBufferSize)
+    {
+        m_internalBufferSize = _fitInternalBufferSize(a_internalBufferSize);
+        m_configVersion++;
 
         // Propogate the new buffer size   
         for (int i = 0; i < m_voices.size(); i++) {
@@ -286,4 +736,11 @@ namespace syn
         }
         m_instrument.setBufferSize(m_internalBufferSize);
     }
+
+    void VoiceManager::queueInternalBufferSize(int a_internalBufferSize)
+    {
+        // Resizing the voices allocates, so new ones are built at the new size instead
+        m_instrument.setBufferSize(_fitInternalBufferSize(a_internalBufferSize));
+        _requestBuild(getMaxVoices(), true);
+    }
 }
\ No newline at end of file
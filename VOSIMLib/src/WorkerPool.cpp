@@ -0,0 +1,147 @@
+/*
+Copyright 2016, Austen Satterlee
+
+This file is part of VOSIMProject.
+
+VOSIMProject is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+VOSIMProject is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "vosimlib/WorkerPool.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYN_CPU_RELAX() _mm_pause()
+#else
+#define SYN_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace
+{
+    /// Number of polls an idle worker makes before it parks
+    const int WORKER_SPIN_COUNT = 1 << 14;
+
+    /// True while the current thread is running a task, so that nested jobs run serially
+    thread_local bool t_inTask = false;
+
+    uint32_t ticketGeneration(uint64_t a_ticket) { return static_cast<uint32_t>(a_ticket >> 32); }
+    uint32_t ticketCount(uint64_t a_ticket) { return static_cast<uint32_t>(a_ticket >> 16) & 0xFFFF; }
+    uint32_t ticketIndex(uint64_t a_ticket) { return static_cast<uint32_t>(a_ticket) & 0xFFFF; }
+}
+
+namespace syn
+{
+    WorkerPool::WorkerPool(int a_numThreads) :
+        m_ticket(0),
+        m_remaining(0),
+        m_busy(false),
+        m_numParked(0),
+        m_stop(false),
+        m_fn(nullptr),
+        m_context(nullptr)
+    {
+        setNumThreads(a_numThreads);
+    }
+
+    WorkerPool::~WorkerPool() { _stopWorkers(); }
+
+    void WorkerPool::setNumThreads(int a_numThreads)
+    {
+        _stopWorkers();
+        m_stop.store(false);
+        for (int i = 1; i < a_numThreads; i++)
+            m_workers.emplace_back(&WorkerPool::_workerLoop, this);
+    }
+
+    void WorkerPool::parallelFor(int a_count, TaskFn a_fn, void* a_context)
+    {
+        if (a_count <= 0)
+            return;
+        if (m_workers.empty() || a_count == 1 || a_count > MAX_TASKS || t_inTask || m_busy.exchange(true, std::memory_order_acquire)) {
+            bool inTask = t_inTask;
+            t_inTask = true;
+            for (int i = 0; i < a_count; i++)
+                a_fn(a_context, i);
+            t_inTask = inTask;
+            return;
+        }
+
+        // Publish the job. Workers only read m_fn and m_context after claiming a task of this generation.
+        m_fn = a_fn;
+        m_context = a_context;
+        m_remaining.store(a_count, std::memory_order_relaxed);
+        uint32_t generation = ticketGeneration(m_ticket.load(std::memory_order_relaxed)) + 1;
+        m_ticket.store(uint64_t(generation) << 32 | uint64_t(a_count) << 16);
+        if (m_numParked.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_parkMutex);
+            m_parkCond.notify_all();
+        }
+
+        _runTasks(generation);
+        while (m_remaining.load(std::memory_order_acquire) > 0)
+            SYN_CPU_RELAX();
+        m_busy.store(false, std::memory_order_release);
+    }
+
+    void WorkerPool::_runTasks(uint32_t a_generation)
+    {
+        uint64_t ticket = m_ticket.load(std::memory_order_acquire);
+        while (ticketGeneration(ticket) == a_generation && ticketIndex(ticket) < ticketCount(ticket)) {
+            if (!m_ticket.compare_exchange_weak(ticket, ticket + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+                continue;
+            t_inTask = true;
+            m_fn(m_context, static_cast<int>(ticketIndex(ticket)));
+            t_inTask = false;
+            m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+            ticket = m_ticket.load(std::memory_order_acquire);
+        }
+    }
+
+    void WorkerPool::_workerLoop()
+    {
+        uint32_t seen = ticketGeneration(m_ticket.load(std::memory_order_acquire));
+        while (true) {
+            uint32_t generation = ticketGeneration(m_ticket.load(std::memory_order_acquire));
+            for (int spins = 0; generation == seen && !m_stop.load(std::memory_order_relaxed); spins++) {
+                if (spins < WORKER_SPIN_COUNT) {
+                    SYN_CPU_RELAX();
+                } else {
+                    // Park. The counter is bumped before the ticket is re-checked, so parallelFor either sees a
+                    // parked worker and notifies it, or the worker sees the new job.
+                    std::unique_lock<std::mutex> lock(m_parkMutex);
+                    m_numParked.fetch_add(1);
+                    m_parkCond.wait(lock, [this, seen]() { return ticketGeneration(m_ticket.load()) != seen || m_stop.load(); });
+                    m_numParked.fetch_sub(1);
+                    spins = 0;
+                }
+                generation = ticketGeneration(m_ticket.load(std::memory_order_acquire));
+            }
+            if (m_stop.load())
+                return;
+            seen = generation;
+            _runTasks(generation);
+        }
+    }
+
+    void WorkerPool::_stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_parkMutex);
+            m_stop.store(true);
+        }
+        m_parkCond.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+        m_workers.clear();
+    }
+}
@@ -3,13 +3,13 @@
 
 namespace syn {
     /*::table_decl::*/
-    extern double BLIMP_TABLE_OFFLINE[];
-    extern double BLIMP_TABLE_ONLINE[];
-    extern double PITCH_TABLE[];
-    extern double BL_SAW_TABLE[];
-    extern double BL_SQUARE_TABLE[];
-    extern double BL_TRI_TABLE[];
-    extern double SIN_TABLE[];
+    extern SampleType BLIMP_TABLE_OFFLINE[];
+    extern SampleType BLIMP_TABLE_ONLINE[];
+    extern SampleType PITCH_TABLE[];
+    extern SampleType BL_SAW_TABLE[];
+    extern SampleType BL_SQUARE_TABLE[];
+    extern SampleType BL_TRI_TABLE[];
+    extern SampleType SIN_TABLE[];
     /*::/table_decl::*/
 
     /*::lut_defs::*/
@@ -21,7 +21,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 
 namespace syn
 {
-    ResampledTable::ResampledTable(const double* a_data, int a_size, const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline) :
+    ResampledTable::ResampledTable(const SampleType* a_data, int a_size, const BlimpTable& a_blimp_table_online, const BlimpTable& a_blimp_table_offline) :
         NormalTable(a_data, a_size),
         m_num_resampled_tables(0),
         m_resampled_sizes(0),
@@ -38,7 +38,7 @@ namespace syn
         m_resampled_sizes.resize(m_num_resampled_tables);
         m_resampled_tables.resize(m_num_resampled_tables);
         m_resampled_sizes[0] = m_size;
-        m_resampled_tables[0] = std::vector<double>(m_data, m_data + m_size);
+        m_resampled_tables[0] = std::vector<SampleType>(m_data, m_data + m_size);
         int currsize = m_size/2;
         for (int i = 1; i < m_num_resampled_tables; i++) {
             m_resampled_sizes[i] = currsize;
@@ -54,7 +54,7 @@ namespace syn
         return getresampled_single(&m_resampled_tables[table_index][0], m_resampled_sizes[table_index], a_phase, a_period, m_blimp_table_online);
     }
 
-    void resample_table(const double* a_table, int a_size, double* a_new_table, double a_new_period, const BlimpTable& a_blimp_table, bool a_preserve_amplitude) {
+    void resample_table(const SampleType* a_table, int a_size, SampleType* a_new_table, double a_new_period, const BlimpTable& a_blimp_table, bool a_preserve_amplitude) {
         double phase_step = 1. / a_new_period;
         double input_max = 0.0, input_min = 0.0;
         double output_max = 0.0, output_min = 0.0;
@@ -62,16 +62,16 @@ namespace syn
         for (int i = 0; i < new_size; i++) {
             a_new_table[i] = getresampled_single(a_table, a_size, phase_step*i, a_new_period, a_blimp_table);
             if (a_preserve_amplitude) {
-                output_min = i == 0 ? a_new_table[i] : syn::MIN(output_min, a_new_table[i]);
-                output_max = i == 0 ? a_new_table[i] : syn::MAX(output_max, a_new_table[i]);
+                output_min = i == 0 ? a_new_table[i] : syn::MIN<double>(output_min, a_new_table[i]);
+                output_max = i == 0 ? a_new_table[i] : syn::MAX<double>(output_max, a_new_table[i]);
             }
         }
         /* normalize */
         if (a_preserve_amplitude) {
             for (int i = 0; i < a_size; i++)
             {
-                input_min = i == 0 ? a_table[i] : syn::MIN(input_min, a_table[i]);
-                input_max = i == 0 ? a_table[i] : syn::MAX(input_max, a_table[i]);
+                input_min = i == 0 ? a_table[i] : syn::MIN<double>(input_min, a_table[i]);
+                input_max = i == 0 ? a_table[i] : syn::MAX<double>(input_max, a_table[i]);
             }
             double scale = (output_max - output_min) / (input_max - input_min);
             for (int i = 0; i < new_size; i++) {
@@ -80,11 +80,11 @@ namespace syn
         }
     }
 
-    void fft_resample_table(const double* table, int size, double* resampled_table, double period)
+    void fft_resample_table(const SampleType* table, int size, SampleType* resampled_table, double period)
     {
     }
 
-    double getresampled_single(const double* table, int size, double phase, double new_period, const BlimpTable& blimp_table) {
+    double getresampled_single(const SampleType* table, int size, double phase, double new_period, const BlimpTable& blimp_table) {
         double ratio = new_period / size;
         phase = WRAP(phase, 1.0) * size;
 
@@ -42,6 +42,16 @@ namespace syn {
         ADSREnvelope(a_rhs.name()) {}
 
     void ADSREnvelope::process_() {
+        // The Off state and a settled Sustain state hold their output until the gate changes
+        const bool gateIdle = !isInputConnected(iGate)
+            || (isInputConstant_(iGate) && (inputBuf_(iGate)[0] > 0.5) == m_lastGate);
+        if (gateIdle && (m_currState == Off || (m_currState == Sustain && m_lastOutput <= m_sustain))) {
+            m_lastOutput = m_currState == Off ? 0.0 : m_sustain;
+            setOutputConstant_(0, m_lastOutput);
+            return;
+        }
+
+        setOutputVarying_(0);
         BEGIN_PROC_FUNC
 
         double output = 0.0;
@@ -101,6 +111,95 @@ namespace syn {
         END_PROC_FUNC
     }
 
+    void ADSREnvelope::processLanes_(Unit* const* a_units, int a_numLanes) {
+        // Unused lanes repeat the last unit, and their results are discarded
+        ADSREnvelope* units[MAX_LANES];
+        const SampleType* gateIn[MAX_LANES];
+        SampleType* out[MAX_LANES];
+        LaneArray atkBias, atkFb, decBias, decFb, relBias, relFb, sustain, lastOutput;
+        for (int l = 0; l < MAX_LANES; l++) {
+            ADSREnvelope* unit = units[l] = static_cast<ADSREnvelope*>(a_units[MIN(l, a_numLanes - 1)]);
+            gateIn[l] = unit->isInputConnected(iGate) ? unit->inputBuf_(iGate) : nullptr;
+            out[l] = unit->outputBuf_(0);
+            atkBias[l] = unit->m_atkBias;
+            atkFb[l] = unit->m_atkFb;
+            decBias[l] = unit->m_decBias;
+            decFb[l] = unit->m_decFb;
+            relBias[l] = unit->m_relBias;
+            relFb[l] = unit->m_relFb;
+            sustain[l] = unit->m_sustain;
+            lastOutput[l] = unit->m_lastOutput;
+        }
+
+        const int nSamples = units[0]->getBufferSize();
+        for (int i = 0; i < nSamples; i++) {
+            // Every segment's next value is computed in all lanes; each lane then keeps the one for its state
+            const LaneArray attack = atkBias + lastOutput * atkFb;
+            const LaneArray decay = decBias + lastOutput * decFb;
+            const LaneArray release = relBias + lastOutput * relFb;
+            const LaneArray retrigger = -1.376e-2 + lastOutput * 0.9862;
+
+            for (int l = 0; l < a_numLanes; l++) {
+                ADSREnvelope* unit = units[l];
+                double output = 0.0;
+                switch (unit->m_currState) {
+                case Off:
+                    break;
+                case Attack:
+                    output = attack[l];
+                    if (output >= 1.0) {
+                        output = 1.0;
+                        unit->m_currState = Decay;
+                    }
+                    break;
+                case Decay:
+                    output = decay[l];
+                    if (output <= sustain[l]) {
+                        output = sustain[l];
+                        unit->m_currState = Sustain;
+                    }
+                    break;
+                case Sustain:
+                    output = lastOutput[l] > sustain[l] ? decay[l] : sustain[l];
+                    break;
+                case Release:
+                    output = release[l];
+                    if (output <= 0.0) {
+                        output = 0.0;
+                        unit->m_currState = Off;
+                    }
+                    break;
+                case Retrigger:
+                    output = retrigger[l];
+                    if (output <= 0.0) {
+                        output = 0.0;
+                        unit->m_currState = Attack;
+                    }
+                    break;
+                }
+
+                lastOutput[l] = output;
+                out[l][i] = output;
+
+                /* Handle transitions caused by external gate */
+                if (gateIn[l]) {
+                    bool gate = gateIn[l][i] > 0.5;
+                    if (gate && !unit->m_lastGate) {
+                        unit->m_currState = Attack;
+                    } else if (!gate && unit->m_lastGate) {
+                        unit->m_currState = Release;
+                    }
+                    unit->m_lastGate = gate;
+                }
+            }
+        }
+
+        for (int l = 0; l < a_numLanes; l++) {
+            units[l]->m_lastOutput = lastOutput[l];
+            units[l]->setOutputVarying_(0);
+        }
+    }
+
     void ADSREnvelope::onNoteOn_() {
         if (!isInputConnected(iGate)) {
             if (m_currState != Off && !m_legato)
@@ -47,17 +47,54 @@ syn::DCRemoverUnit::DCRemoverUnit(const DCRemoverUnit& a_rhs) :
 
 void syn::DCRemoverUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(0);
-        double alpha = param(m_pAlpha).getDouble();
-        double gain = 0.5 * (1 + alpha);
+    const SampleType* in = inputBuf_(0);
+    SampleType* out = outputBuf_(0);
+    const double alpha = param(m_pAlpha).getDouble();
+    const double gain = 0.5 * (1 + alpha);
+    const int nSamples = getBufferSize();
+    for (int i = 0; i < nSamples; i++) {
         // dc removal
-        input = input * gain;
+        double input = in[i] * gain;
         double output = input - m_lastInput + alpha * m_lastOutput;
         m_lastInput = input;
         m_lastOutput = output;
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+        out[i] = output;
+    }
+}
+
+void syn::DCRemoverUnit::processLanes_(Unit* const* a_units, int a_numLanes)
+{
+    // Unused lanes repeat the last unit, and their results are discarded
+    DCRemoverUnit* units[MAX_LANES];
+    const SampleType* in[MAX_LANES];
+    SampleType* out[MAX_LANES];
+    LaneArray alpha, lastInput, lastOutput;
+    for (int l = 0; l < MAX_LANES; l++) {
+        DCRemoverUnit* unit = units[l] = static_cast<DCRemoverUnit*>(a_units[MIN(l, a_numLanes - 1)]);
+        in[l] = unit->inputBuf_(0);
+        out[l] = unit->outputBuf_(0);
+        alpha[l] = unit->param(unit->m_pAlpha).getDouble();
+        lastInput[l] = unit->m_lastInput;
+        lastOutput[l] = unit->m_lastOutput;
+    }
+    const LaneArray gain = 0.5 * (1 + alpha);
+    const int nSamples = units[0]->getBufferSize();
+    for (int i = 0; i < nSamples; i++) {
+        LaneArray input;
+        for (int l = 0; l < MAX_LANES; l++)
+            input[l] = in[l][i];
+        // dc removal
+        input *= gain;
+        LaneArray output = input - lastInput + alpha * lastOutput;
+        lastInput = input;
+        lastOutput = output;
+        for (int l = 0; l < a_numLanes; l++)
+            out[l][i] = output[l];
+    }
+    for (int l = 0; l < a_numLanes; l++) {
+        units[l]->m_lastInput = lastInput[l];
+        units[l]->m_lastOutput = lastOutput[l];
+    }
 }
 
 void syn::DCRemoverUnit::reset()
@@ -84,21 +121,21 @@ syn::RectifierUnit::RectifierUnit(const RectifierUnit& a_rhs) :
 
 void syn::RectifierUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(0);
-        double output;
-        switch (param(m_pRectType).getInt())
-        {
-        case 1: // half
-            output = input > 0 ? input : 0;
-            break;
-        case 0: // full
-        default:
-            output = abs(input);
-            break;
-        }
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    const SampleType* in = inputBuf_(0);
+    SampleType* out = outputBuf_(0);
+    const int nSamples = getBufferSize();
+    switch (param(m_pRectType).getInt())
+    {
+    case 1: // half
+        for (int i = 0; i < nSamples; i++)
+            out[i] = in[i] > 0 ? in[i] : 0;
+        break;
+    case 0: // full
+    default:
+        for (int i = 0; i < nSamples; i++)
+            out[i] = abs(in[i]);
+        break;
+    }
 }
 
 syn::SummerUnit::SummerUnit(const string& a_name) :
@@ -116,15 +153,34 @@ syn::SummerUnit::SummerUnit(const SummerUnit& a_rhs) :
 
 void syn::SummerUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double output = param(m_pBias).getDouble();
-        for (int i = 0; i < numInputs(); i++) {
-            int id = inputs().ids()[i];
+    bool isConstant = true;
+    for (int j = 0; j < numInputs() && isConstant; j++) {
+        int id = inputs().ids()[j];
+        isConstant = !isInputConnected(id) || isInputConstant_(id);
+    }
+    if (isConstant) {
+        SampleType value = param(m_pBias).getDouble();
+        for (int j = 0; j < numInputs(); j++) {
+            int id = inputs().ids()[j];
             if (isInputConnected(id))
-                output += READ_INPUT(id);
+                value += inputBuf_(id)[0];
         }
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+        setOutputConstant_(0, value);
+        return;
+    }
+
+    setOutputVarying_(0);
+    SampleType* out = outputBuf_(0);
+    const int nSamples = getBufferSize();
+    std::fill_n(out, nSamples, param(m_pBias).getDouble());
+    for (int j = 0; j < numInputs(); j++) {
+        int id = inputs().ids()[j];
+        if (!isInputConnected(id) || isInputSilent_(id))
+            continue;
+        const SampleType* in = inputBuf_(id);
+        for (int i = 0; i < nSamples; i++)
+            out[i] += in[i];
+    }
 }
 
 syn::GainUnit::GainUnit(const string& a_name) :
@@ -142,15 +198,42 @@ syn::GainUnit::GainUnit(const GainUnit& a_rhs) :
 
 void syn::GainUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double output = param(m_pGain).getDouble();
-        for (int i = 0; i < numInputs(); i++) {
-            int id = inputs().ids()[i];
+    // A silent input mutes the output without any of the other inputs being read
+    bool isConstant = true;
+    for (int j = 0; j < numInputs(); j++) {
+        int id = inputs().ids()[j];
+        if (!isInputConnected(id))
+            continue;
+        EBlockState state = inputState_(id);
+        if (state == BlockSilent) {
+            setOutputConstant_(0, 0.0);
+            return;
+        }
+        isConstant = isConstant && state == BlockConstant;
+    }
+    if (isConstant || param(m_pGain).getDouble() == 0.0) {
+        SampleType value = param(m_pGain).getDouble();
+        for (int j = 0; j < numInputs() && value != 0.0; j++) {
+            int id = inputs().ids()[j];
             if (isInputConnected(id))
-                output *= READ_INPUT(id);
+                value *= inputBuf_(id)[0];
         }
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+        setOutputConstant_(0, value);
+        return;
+    }
+
+    setOutputVarying_(0);
+    SampleType* out = outputBuf_(0);
+    const int nSamples = getBufferSize();
+    std::fill_n(out, nSamples, param(m_pGain).getDouble());
+    for (int j = 0; j < numInputs(); j++) {
+        int id = inputs().ids()[j];
+        if (!isInputConnected(id))
+            continue;
+        const SampleType* in = inputBuf_(id);
+        for (int i = 0; i < nSamples; i++)
+            out[i] *= in[i];
+    }
 }
 
 syn::ConstantUnit::ConstantUnit(const string& a_name) :
@@ -166,10 +249,7 @@ syn::ConstantUnit::ConstantUnit(const ConstantUnit& a_rhs) :
 
 void syn::ConstantUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double output = param(0).getDouble();
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    setOutputConstant_(0, param(0).getDouble());
 }
 
 syn::PanningUnit::PanningUnit(const string& a_name) :
@@ -190,16 +270,23 @@ syn::PanningUnit::PanningUnit(const PanningUnit& a_rhs) :
 
 void syn::PanningUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double in1 = READ_INPUT(0);
-        double in2 = READ_INPUT(1);
-        double bal1 = param(m_pBalance1).getDouble() + READ_INPUT(2);
-        double bal2 = param(m_pBalance2).getDouble() + READ_INPUT(3);
+    const SampleType* in1 = inputBuf_(0);
+    const SampleType* in2 = inputBuf_(1);
+    const SampleType* balIn1 = inputBuf_(2);
+    const SampleType* balIn2 = inputBuf_(3);
+    SampleType* out1 = outputBuf_(0);
+    SampleType* out2 = outputBuf_(1);
+    const double balParam1 = param(m_pBalance1).getDouble();
+    const double balParam2 = param(m_pBalance2).getDouble();
+    const int nSamples = getBufferSize();
+    for (int i = 0; i < nSamples; i++) {
+        double bal1 = balParam1 + balIn1[i];
+        double bal2 = balParam2 + balIn2[i];
         bal1 = 0.5 * (1 + CLAMP(bal1, -1.0, 1.0));
         bal2 = 0.5 * (1 + CLAMP(bal2, -1.0, 1.0));
-        WRITE_OUTPUT(0, (1 - bal1) * in1 + (1 - bal2) * in2);
-        WRITE_OUTPUT(1, bal1 * in1 + bal2 * in2);
-    END_PROC_FUNC
+        out1[i] = (1 - bal1) * in1[i] + (1 - bal2) * in2[i];
+        out2[i] = bal1 * in1[i] + bal2 * in2[i];
+    }
 }
 
 syn::LerpUnit::LerpUnit(const string& a_name) :
@@ -219,18 +306,23 @@ syn::LerpUnit::LerpUnit(const LerpUnit& a_rhs) :
 
 void syn::LerpUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(0);
-        double aIn = param(m_pMinInput).getDouble();
-        double bIn = param(m_pMaxInput).getDouble();
-        double aOut = param(m_pMinOutput).getDouble();
-        double bOut = param(m_pMaxOutput).getDouble();
-        double inputNorm = INVLERP(aIn, bIn, input);
-        double output = LERP(aOut, bOut, inputNorm);
-        if (param(m_pClip).getBool())
-            output = CLAMP(output, MIN(aOut, bOut), MAX(aOut, bOut));
-        WRITE_OUTPUT(0, output);
-    END_PROC_FUNC
+    const SampleType* in = inputBuf_(0);
+    SampleType* out = outputBuf_(0);
+    const double aIn = param(m_pMinInput).getDouble();
+    const double bIn = param(m_pMaxInput).getDouble();
+    const double aOut = param(m_pMinOutput).getDouble();
+    const double bOut = param(m_pMaxOutput).getDouble();
+    const int nSamples = getBufferSize();
+    for (int i = 0; i < nSamples; i++) {
+        double inputNorm = INVLERP<double>(aIn, bIn, in[i]);
+        out[i] = LERP(aOut, bOut, inputNorm);
+    }
+    if (param(m_pClip).getBool()) {
+        const double minOut = MIN(aOut, bOut);
+        const double maxOut = MAX(aOut, bOut);
+        for (int i = 0; i < nSamples; i++)
+            out[i] = CLAMP<double>(out[i], minOut, maxOut);
+    }
 }
 
 
@@ -243,11 +335,13 @@ syn::TanhUnit::TanhUnit(const string& a_name) : Unit(a_name) {
 syn::TanhUnit::TanhUnit(const TanhUnit& a_rhs) : TanhUnit(a_rhs.name()) {}
 
 void syn::TanhUnit::process_() {
-    BEGIN_PROC_FUNC
-    double input = READ_INPUT(0);
-    double sat = param(pSat).getDouble();
-    WRITE_OUTPUT(0, fast_tanh_rat(input * sat) / fast_tanh_rat(sat));
-    END_PROC_FUNC
+    const SampleType* in = inputBuf_(0);
+    SampleType* out = outputBuf_(0);
+    const double sat = param(pSat).getDouble();
+    const double norm = 1.0 / fast_tanh_rat(sat);
+    const int nSamples = getBufferSize();
+    for (int i = 0; i < nSamples; i++)
+        out[i] = fast_tanh_rat(in[i] * sat) * norm;
 }
 
 syn::QuantizerUnit::QuantizerUnit(const string& a_name) : Unit(a_name) {
@@ -258,10 +352,15 @@ syn::QuantizerUnit::QuantizerUnit(const string& a_name) : Unit(a_name) {
 }
 
 void syn::QuantizerUnit::process_() {
-    BEGIN_PROC_FUNC
-        double in = READ_INPUT(iIn);
-    double quantStep = CLAMP(param(pStep).getDouble() + READ_INPUT(iStep), param(pStep).getMin(), param(pStep).getMax());
-    double out = quantStep>0 ? quantStep * std::floor(in / quantStep + 0.5) : in;
-    WRITE_OUTPUT(0, out);
-    END_PROC_FUNC
-}
\ No newline at end of file
+    const SampleType* in = inputBuf_(iIn);
+    const SampleType* stepIn = inputBuf_(iStep);
+    SampleType* out = outputBuf_(0);
+    const double step = param(pStep).getDouble();
+    const double minStep = param(pStep).getMin();
+    const double maxStep = param(pStep).getMax();
+    const int nSamples = getBufferSize();
+    for (int i = 0; i < nSamples; i++) {
+        double quantStep = CLAMP(step + stepIn[i], minStep, maxStep);
+        out[i] = quantStep>0 ? quantStep * std::floor(in[i] / quantStep + 0.5) : in[i];
+    }
+}
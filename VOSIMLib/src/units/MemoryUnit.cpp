@@ -26,6 +26,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "vosimlib/units/MemoryUnit.h"
 #include "vosimlib/DSPMath.h"
+#include "vosimlib/MemoryPool.h"
 
 namespace syn
 {
@@ -33,7 +34,7 @@ namespace syn
     // NSampleDelay
     //---------------------
     NSampleDelay::NSampleDelay() :
-        m_buffer(1),
+        m_buffer(_allocateBuffer(1)),
         m_arraySize(1),
         m_delaySamples(1.0),
         m_curWritePhase(0),
@@ -42,6 +43,54 @@ namespace syn
         resizeBuffer(1);
     }
 
+    NSampleDelay::NSampleDelay(const NSampleDelay& a_other) :
+        m_buffer(_allocateBuffer(a_other.m_arraySize)),
+        m_arraySize(a_other.m_arraySize),
+        m_delaySamples(a_other.m_delaySamples),
+        m_curWritePhase(a_other.m_curWritePhase),
+        m_lastOutput(a_other.m_lastOutput)
+    {
+        std::copy_n(a_other.m_buffer, m_arraySize, m_buffer);
+    }
+
+    NSampleDelay& NSampleDelay::operator=(const NSampleDelay& a_other)
+    {
+        if (this == &a_other)
+            return *this;
+        if (m_arraySize != a_other.m_arraySize) {
+            _freeBuffer(m_buffer);
+            m_buffer = _allocateBuffer(a_other.m_arraySize);
+            m_arraySize = a_other.m_arraySize;
+        }
+        std::copy_n(a_other.m_buffer, m_arraySize, m_buffer);
+        m_delaySamples = a_other.m_delaySamples;
+        m_curWritePhase = a_other.m_curWritePhase;
+        m_lastOutput = a_other.m_lastOutput;
+        return *this;
+    }
+
+    NSampleDelay::~NSampleDelay()
+    {
+        _freeBuffer(m_buffer);
+    }
+
+    double* NSampleDelay::_allocateBuffer(int a_size)
+    {
+        double* buffer = static_cast<double*>(MemoryPool::realtime().allocate(a_size * sizeof(double)));
+        if (!buffer)
+            buffer = static_cast<double*>(::operator new(a_size * sizeof(double)));
+        std::fill_n(buffer, a_size, 0.0);
+        return buffer;
+    }
+
+    void NSampleDelay::_freeBuffer(double* a_buffer)
+    {
+        if (MemoryPool::realtime().owns(a_buffer))
+            MemoryPool::realtime().free(a_buffer);
+        else
+            ::operator delete(a_buffer);
+    }
+
     double NSampleDelay::getLastOutput() const
     {
         return m_lastOutput;
@@ -60,22 +109,26 @@ namespace syn
         if (m_delaySamples == a_delaySamples || a_delaySamples <= 0)
             return;
         int requiredBufSize = ceil(a_delaySamples);
-        if (requiredBufSize > m_buffer.size())
-            m_buffer.resize(requiredBufSize);
-        m_arraySize = static_cast<int>(m_buffer.size());
+        if (requiredBufSize > m_arraySize) {
+            double* buffer = _allocateBuffer(requiredBufSize);
+            std::copy_n(m_buffer, m_arraySize, buffer);
+            _freeBuffer(m_buffer);
+            m_buffer = buffer;
+            m_arraySize = requiredBufSize;
+        }
         m_delaySamples = a_delaySamples;
     }
 
     void NSampleDelay::reset()
     {
-        std::fill(&m_buffer.front(), &m_buffer.back(), 0.0);
+        std::fill_n(m_buffer, m_arraySize, 0.0);
         m_curWritePhase = 0.0;
         m_lastOutput = 0.0;
     }
 
     int NSampleDelay::size() const
     {
-        return static_cast<int>(m_buffer.size());
+        return m_arraySize;
     }
 
     double NSampleDelay::process(double a_input)
@@ -3,23 +3,28 @@
 
 void syn::MidiNoteUnit::process_()
 {
-    BEGIN_PROC_FUNC
-        WRITE_OUTPUT(oPitch, note());
-        WRITE_OUTPUT(oFreq, pitchToFreq(note()));
-        WRITE_OUTPUT(oPitchWheel, m_pitchWheelValue);
-    END_PROC_FUNC
+    // Midi events arrive between blocks, so the outputs are constant over a block
+    setOutputConstant_(oPitch, note());
+    setOutputConstant_(oFreq, pitchToFreq(note()));
+    setOutputConstant_(oPitchWheel, m_pitchWheelValue);
 }
 
 void syn::GateUnit::process_() {
+    // Both outputs are constant unless a trigger or a queued note off falls within the block
+    if (!m_queuedNoteOff && (m_triggerFired || !isNoteOn())) {
+        setOutputConstant_(oGate, isNoteOn() ? 1.0 : 0.0);
+        setOutputConstant_(oTrig, 0.0);
+        return;
+    }
+    setOutputVarying_(oGate);
+    setOutputVarying_(oTrig);
     BEGIN_PROC_FUNC
         // Trigger sends a 1 and then turns off.
-        if (isNoteOn()) {
-            if (!m_triggerFired) {
-                WRITE_OUTPUT(oTrig, 1.0);
-                m_triggerFired = true;
-            } else {
-                WRITE_OUTPUT(oTrig, 0.0);
-            }
+        if (isNoteOn() && !m_triggerFired) {
+            WRITE_OUTPUT(oTrig, 1.0);
+            m_triggerFired = true;
+        } else {
+            WRITE_OUTPUT(oTrig, 0.0);
         }
         // Gate sends a 0 first, then 1s until note off.
         if (m_queuedNoteOff) {
@@ -43,9 +48,7 @@ void syn::GateUnit::onNoteOff_() {
 }
 
 void syn::MidiCCUnit::process_() {
-    BEGIN_PROC_FUNC
-        WRITE_OUTPUT(0, m_value);
-    END_PROC_FUNC
+    setOutputConstant_(0, m_value);
 }
 
 void syn::MidiCCUnit::onParamChange_(int a_paramId) {
@@ -63,15 +63,14 @@ namespace syn
         }
     }
 
-    void OscillatorUnit::tickPhase_(double a_phaseOffset)
+    void OscillatorUnit::tickPhase_(double a_phaseOffset, double a_sync)
     {        
         // sync
-        double sync = READ_INPUT(iSync);
-        if (m_lastSync - sync > 0.5)
+        if (m_lastSync - a_sync > 0.5)
         {
             reset();
         }
-        m_lastSync = READ_INPUT(iSync);
+        m_lastSync = a_sync;
 
         m_basePhase += m_phase_step;
         if (m_basePhase >= 1)
@@ -95,7 +94,7 @@ namespace syn
             m_bias = m_gain;
         }
         updatePhaseStep_();
-        tickPhase_(phase_offset);
+        tickPhase_(phase_offset, READ_INPUT(iSync));
 
         WRITE_OUTPUT(oPhase, m_phase);
     }
@@ -141,27 +140,180 @@ namespace syn
 
     void BasicOscillatorUnit::process_()
     {
-        BEGIN_PROC_FUNC
-        TunedOscillatorUnit::process_();
-        double output = 0.0;
-        WaveShape shape = static_cast<WaveShape>(param(pWaveform).getInt());
-        switch (shape)
+        const SampleType* gainMul = inputBuf_(iGainMul);
+        const SampleType* phaseAdd = inputBuf_(iPhaseAdd);
+        const SampleType* sync = inputBuf_(iSync);
+        const SampleType* note = inputBuf_(iNote);
+        SampleType* out = outputBuf_(oOut);
+        SampleType* phaseOut = outputBuf_(oPhase);
+
+        const double tune = param(pTune).getDouble();
+        const double oct = param(pOctave).getInt();
+        const double phaseOffset = param(pPhaseOffset).getDouble();
+        const double gain = param(pGain).getDouble();
+        const bool unipolar = param(pUnipolar).getBool();
+        const WaveShape shape = static_cast<WaveShape>(param(pWaveform).getInt());
+        const int nSamples = getBufferSize();
+
+        // A muted oscillator only advances its phase, and skips the table lookups
+        if (gain == 0.0 || isInputSilent_(iGainMul))
         {
-            case SAW_WAVE:
-                output = lut_bl_saw_table().getResampled(m_phase, m_period);
-                break;
-            case SINE_WAVE:
-                output = lut_sin_table().plerp(m_phase);
-                break;
-            case TRI_WAVE:
-                output = lut_bl_tri_table().getResampled(m_phase, m_period);
-                break;
-            case SQUARE_WAVE:
-                output = lut_bl_square_table().getResampled(m_phase, m_period);
-                break;
+            m_gain = 0.0;
+            m_bias = 0.0;
+            for (int i = 0; i < nSamples; i++)
+            {
+                m_pitch = tune + note[i] + oct * 12;
+                TunedOscillatorUnit::updatePhaseStep_();
+                OscillatorUnit::tickPhase_(phaseOffset + phaseAdd[i], sync[i]);
+                phaseOut[i] = m_phase;
+            }
+            setOutputConstant_(oOut, 0.0);
+            return;
+        }
+
+        setOutputVarying_(oOut);
+        for (int i = 0; i < nSamples; i++)
+        {
+            m_pitch = tune + note[i] + oct * 12;
+            m_gain = gain * gainMul[i];
+            m_bias = 0;
+            if (unipolar)
+            {
+                // make signal unipolar
+                m_gain *= 0.5;
+                m_bias = m_gain;
+            }
+            TunedOscillatorUnit::updatePhaseStep_();
+            OscillatorUnit::tickPhase_(phaseOffset + phaseAdd[i], sync[i]);
+
+            double output = 0.0;
+            switch (shape)
+            {
+                case SAW_WAVE:
+                    output = lut_bl_saw_table().getResampled(m_phase, m_period);
+                    break;
+                case SINE_WAVE:
+                    output = lut_sin_table().plerp(m_phase);
+                    break;
+                case TRI_WAVE:
+                    output = lut_bl_tri_table().getResampled(m_phase, m_period);
+                    break;
+                case SQUARE_WAVE:
+                    output = lut_bl_square_table().getResampled(m_phase, m_period);
+                    break;
+            }
+            out[i] = m_gain * output + m_bias;
+            phaseOut[i] = m_phase;
+        }
+    }
+
+    void BasicOscillatorUnit::processLanes_(Unit* const* a_units, int a_numLanes)
+    {
+        // Unused lanes repeat the last unit, and their results are discarded
+        BasicOscillatorUnit* units[MAX_LANES];
+        const SampleType *gainMul[MAX_LANES], *phaseAdd[MAX_LANES], *sync[MAX_LANES], *note[MAX_LANES];
+        SampleType *out[MAX_LANES], *phaseOut[MAX_LANES];
+        WaveShape shape[MAX_LANES];
+        LaneArray tune, octave, phaseOffset, gain, gainScale, unipolar;
+        LaneArray basePhase, lastSync, phase, pitch, freq, period, phaseStep, oscGain, bias;
+        for (int l = 0; l < MAX_LANES; l++)
+        {
+            BasicOscillatorUnit* unit = units[l] = static_cast<BasicOscillatorUnit*>(a_units[MIN(l, a_numLanes - 1)]);
+            gainMul[l] = unit->inputBuf_(iGainMul);
+            phaseAdd[l] = unit->inputBuf_(iPhaseAdd);
+            sync[l] = unit->inputBuf_(iSync);
+            note[l] = unit->inputBuf_(iNote);
+            out[l] = unit->outputBuf_(oOut);
+            phaseOut[l] = unit->outputBuf_(oPhase);
+            shape[l] = static_cast<WaveShape>(unit->param(pWaveform).getInt());
+            tune[l] = unit->param(pTune).getDouble();
+            octave[l] = unit->param(pOctave).getInt();
+            phaseOffset[l] = unit->param(pPhaseOffset).getDouble();
+            gain[l] = unit->param(pGain).getDouble();
+            // make signal unipolar
+            unipolar[l] = unit->param(pUnipolar).getBool();
+            gainScale[l] = unipolar[l] ? 0.5 : 1.0;
+            basePhase[l] = unit->m_basePhase;
+            lastSync[l] = unit->m_lastSync;
+            phase[l] = unit->m_phase;
+            pitch[l] = unit->m_pitch;
+            freq[l] = unit->m_freq;
+            period[l] = unit->m_period;
+            phaseStep[l] = unit->m_phase_step;
+            oscGain[l] = unit->m_gain;
+            bias[l] = unit->m_bias;
+        }
+
+        const double fs = units[0]->fs();
+        const int nSamples = units[0]->getBufferSize();
+
+        for (int i = 0; i < nSamples; i++)
+        {
+            LaneArray noteIn, gainIn, phaseIn, syncIn;
+            for (int l = 0; l < MAX_LANES; l++)
+            {
+                noteIn[l] = note[l][i];
+                gainIn[l] = gainMul[l][i];
+                phaseIn[l] = phaseAdd[l][i];
+                syncIn[l] = sync[l][i];
+            }
+            pitch = tune + noteIn + octave * 12;
+            oscGain = gain * gainIn * gainScale;
+            bias = (unipolar != 0.0).select(oscGain, LaneArray::Zero());
+            for (int l = 0; l < MAX_LANES; l++)
+                freq[l] = pitchToFreq(pitch[l]);
+
+            // see OscillatorUnit::updatePhaseStep_
+            const auto hasFreq = freq != 0.0;
+            period = hasFreq.select((fs / freq).max(2.0), LaneArray::Zero());
+            phaseStep = hasFreq.select(1. / period, LaneArray::Zero());
+
+            // see OscillatorUnit::tickPhase_
+            basePhase = (lastSync - syncIn > 0.5).select(LaneArray::Zero(), basePhase);
+            lastSync = syncIn;
+            basePhase += phaseStep;
+            basePhase = (basePhase >= 1).select(basePhase - 1, basePhase);
+            phase = basePhase + (phaseOffset + phaseIn);
+
+            for (int l = 0; l < a_numLanes; l++)
+            {
+                phase[l] = WRAP(phase[l], 1.0);
+                double output = 0.0;
+                switch (shape[l])
+                {
+                    case SAW_WAVE:
+                        output = lut_bl_saw_table().getResampled(phase[l], period[l]);
+                        break;
+                    case SINE_WAVE:
+                        output = lut_sin_table().plerp(phase[l]);
+                        break;
+                    case TRI_WAVE:
+                        output = lut_bl_tri_table().getResampled(phase[l], period[l]);
+                        break;
+                    case SQUARE_WAVE:
+                        output = lut_bl_square_table().getResampled(phase[l], period[l]);
+                        break;
+                }
+                out[l][i] = oscGain[l] * output + bias[l];
+                phaseOut[l][i] = phase[l];
+            }
+        }
+
+        for (int l = 0; l < a_numLanes; l++)
+        {
+            BasicOscillatorUnit* unit = units[l];
+            unit->m_basePhase = basePhase[l];
+            unit->m_lastSync = lastSync[l];
+            unit->m_phase = phase[l];
+            unit->m_last_phase = phase[l];
+            unit->m_pitch = pitch[l];
+            unit->m_freq = freq[l];
+            unit->m_period = period[l];
+            unit->m_phase_step = phaseStep[l];
+            unit->m_gain = oscGain[l];
+            unit->m_bias = bias[l];
+            unit->setOutputVarying_(oOut);
         }
-        WRITE_OUTPUT(oOut, m_gain * output + m_bias);
-        END_PROC_FUNC
     }
 
     LFOOscillatorUnit::LFOOscillatorUnit(const string& a_name) :
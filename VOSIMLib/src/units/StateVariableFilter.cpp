@@ -18,23 +18,32 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimlib/units/StateVariableFilter.h"
 #include "vosimlib/tables.h"
+#include "vosimlib/FastMath.h"
 
 #include "vosimlib/common.h"
 
 syn::StateVariableFilter::StateVariableFilter(const string& a_name)
     :
     Unit(a_name),
+    m_mode(ModeTpt),
+    m_ic1eq(0.0),
+    m_ic2eq(0.0),
     m_prevBPOut(0.0),
     m_prevLPOut(0.0),
     m_F(0.0),
-    m_damp(0.0) {
+    m_damp(0.0),
+    m_dF(0.0),
+    m_dDamp(0.0),
+    m_coefficientsReady(false),
+    m_oversamplingFactor(filterOversamplingFactor(fs())) {
     addParameter_(pFc, UnitParameter("fc", 0.01, 20000.0, 10000.0, UnitParameter::Freq));
     addParameter_(pRes, UnitParameter("res", 0.0, 1.0, 0.0));
+    addParameter_(pMode, UnitParameter("mode", {"tpt", "chamberlin"}));
     addInput_(iAudioIn, "in");
-    addInput_(iFcAdd, "fc");
-    addInput_(iFcMul, "fc[x]", 1.0);
-    addInput_(iResAdd, "res");
-    addInput_(iResMul, "res[x]", 1.0);
+    addInput_(iFcAdd, "fc", 0.0, true);
+    addInput_(iFcMul, "fc[x]", 1.0, true);
+    addInput_(iResAdd, "res", 0.0, true);
+    addInput_(iResMul, "res[x]", 1.0, true);
     addOutput_(oLP, "LP");
     addOutput_(oHP, "HP");
     addOutput_(oBP, "BP");
@@ -42,24 +51,125 @@ syn::StateVariableFilter::StateVariableFilter(const string& a_name)
 }
 
 void syn::StateVariableFilter::reset() {
+    m_ic1eq = 0.0;
+    m_ic2eq = 0.0;
     m_prevBPOut = 0.0;
     m_prevLPOut = 0.0;
+    m_coefficientsReady = false;
+}
+
+double syn::StateVariableFilter::_cutoffCoefficient(double a_fc) const {
+    if (m_mode == ModeChamberlin)
+        return 2 * lut_sin_table().plerp(a_fc * (0.5 / (fs() * m_oversamplingFactor)));
+    // Prewarped so that the cutoff lands exactly on a_fc, which must stay below Nyquist
+    return fast_tan(MIN(a_fc, 0.4999 * fs()) * (SYN_PI / fs()));
+}
+
+void syn::StateVariableFilter::_computeCoefficients(int a_sample, double& a_F, double& a_damp) const {
+    double fc = inputBuf_(iFcMul)[a_sample] * (param(pFc).getDouble() + inputBuf_(iFcAdd)[a_sample]);
+    fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
+    a_F = _cutoffCoefficient(fc);
+
+    double input_res = inputBuf_(iResMul)[a_sample] * param(pRes).getDouble() + inputBuf_(iResAdd)[a_sample];
+    input_res = CLAMP<double>(input_res, 0, 1);
+    double res = LERP(c_minRes, c_maxRes, input_res);
+    a_damp = 1.0 / res;
+}
+
+double syn::StateVariableFilter::_cutoffIncrement(double a_from, double a_to, int a_steps) const {
+    if (m_mode == ModeChamberlin)
+        return (a_to - a_from) / a_steps;
+    // The prewarped cutoff is tan(theta), so the ramp steps theta linearly: the increment is tan(dtheta), applied
+    // with the tangent addition formula
+    return std::tan(std::atan((a_to - a_from) / (1.0 + a_from * a_to)) / a_steps);
+}
+
+double syn::StateVariableFilter::_stepCutoff(double a_F, double a_dF) const {
+    if (m_mode == ModeChamberlin)
+        return a_F + a_dF;
+    return (a_F + a_dF) / (1.0 - a_F * a_dF);
+}
+
+void syn::StateVariableFilter::_tickCoefficients(int a_sample, int a_period, int a_nSamples) {
+    if (a_sample % a_period == 0) {
+        const int length = MIN(a_period, a_nSamples - a_sample);
+        double F, damp;
+        _computeCoefficients(a_sample + length - 1, F, damp);
+        if (a_period != CONTROL_PERIOD || length == 1) {
+            m_F = F;
+            m_damp = damp;
+            m_dF = m_dDamp = 0.0;
+        } else if (m_coefficientsReady) {
+            m_dF = _cutoffIncrement(m_F, F, length);
+            m_dDamp = (damp - m_damp) / length;
+        } else {
+            // There is no previous control point after a reset, so the ramp starts at the current sample
+            _computeCoefficients(a_sample, m_F, m_damp);
+            m_dF = _cutoffIncrement(m_F, F, length - 1);
+            m_dDamp = (damp - m_damp) / (length - 1);
+            m_F = _stepCutoff(m_F, -m_dF);
+            m_damp -= m_dDamp;
+        }
+        m_coefficientsReady = true;
+    }
+    m_F = _stepCutoff(m_F, m_dF);
+    m_damp += m_dDamp;
 }
 
 void syn::StateVariableFilter::process_() {
-    BEGIN_PROC_FUNC
-        double fc = READ_INPUT(iFcMul) * (param(pFc).getDouble() + READ_INPUT(iFcAdd));
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        m_F = 2 * lut_sin_table().plerp(0.5 * fc / (fs() * c_oversamplingFactor));
+    if (m_mode == ModeChamberlin)
+        _processChamberlin();
+    else
+        _processTpt();
+}
+
+void syn::StateVariableFilter::_processTpt() {
+    const SampleType* in = inputBuf_(iAudioIn);
+    SampleType* lpOut = outputBuf_(oLP);
+    SampleType* hpOut = outputBuf_(oHP);
+    SampleType* bpOut = outputBuf_(oBP);
+    SampleType* nOut = outputBuf_(oN);
+
+    const int period = controlPeriod_({iFcAdd, iFcMul, iResAdd, iResMul});
+    const int nSamples = getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        _tickCoefficients(s, period, nSamples);
+
+        const double input = in[s];
+        const double a1 = 1.0 / (1.0 + m_F * (m_F + m_damp));
+        const double a2 = m_F * a1;
+        const double a3 = m_F * a2;
+        const double v3 = input - m_ic2eq;
+        const double BPOut = a1 * m_ic1eq + a2 * v3;
+        const double LPOut = m_ic2eq + a2 * m_ic1eq + a3 * v3;
+        m_ic1eq = 2 * BPOut - m_ic1eq;
+        m_ic2eq = 2 * LPOut - m_ic2eq;
+
+        const double HPOut = input - m_damp * BPOut - LPOut;
+        lpOut[s] = LPOut;
+        hpOut[s] = HPOut;
+        bpOut[s] = BPOut;
+        nOut[s] = HPOut + LPOut;
+    }
+}
+
+void syn::StateVariableFilter::_processChamberlin() {
+    const SampleType* in = inputBuf_(iAudioIn);
+    SampleType* lpOut = outputBuf_(oLP);
+    SampleType* hpOut = outputBuf_(oHP);
+    SampleType* bpOut = outputBuf_(oBP);
+    SampleType* nOut = outputBuf_(oN);
 
-        double input_res = READ_INPUT(iResMul) * param(pRes).getDouble() + READ_INPUT(iResAdd);
-        input_res = CLAMP<double>(input_res, 0, 1);
-        double res = LERP(c_minRes, c_maxRes, input_res);
-        m_damp = 1.0 / res;
+    const int period = controlPeriod_({iFcAdd, iFcMul, iResAdd, iResMul});
+    const int nSamples = getBufferSize();
 
-        double input = READ_INPUT(iAudioIn);
+    for (int s = 0; s < nSamples; s++) {
+        _tickCoefficients(s, period, nSamples);
+
+        double input = in[s];
         double LPOut = 0, HPOut = 0, BPOut = 0;
-        int i = c_oversamplingFactor;
+        int i = m_oversamplingFactor;
         while (i--) {
             LPOut = m_prevLPOut + m_F * m_prevBPOut;
             HPOut = input - LPOut - m_damp * m_prevBPOut;
@@ -68,67 +178,175 @@ void syn::StateVariableFilter::process_() {
             m_prevBPOut = BPOut;
             m_prevLPOut = LPOut;
         }
-        double NOut = HPOut + LPOut;
 
-        WRITE_OUTPUT(oLP, LPOut);
-        WRITE_OUTPUT(oHP, HPOut);
-        WRITE_OUTPUT(oBP, BPOut);
-        WRITE_OUTPUT(oN, NOut);
-    END_PROC_FUNC
+        lpOut[s] = LPOut;
+        hpOut[s] = HPOut;
+        bpOut[s] = BPOut;
+        nOut[s] = HPOut + LPOut;
+    }
 }
 
-void syn::StateVariableFilter::onNoteOn_() {
-    reset();
+void syn::StateVariableFilter::processLanes_(Unit* const* a_units, int a_numLanes) {
+    StateVariableFilter* units[MAX_LANES];
+    bool sameMode = true;
+    for (int l = 0; l < a_numLanes; l++) {
+        units[l] = static_cast<StateVariableFilter*>(a_units[l]);
+        sameMode = sameMode && units[l]->m_mode == units[0]->m_mode;
+    }
+    if (!sameMode) {
+        for (int l = 0; l < a_numLanes; l++)
+            units[l]->process_();
+    } else if (units[0]->m_mode == ModeChamberlin) {
+        _processChamberlinLanes(units, a_numLanes);
+    } else {
+        _processTptLanes(units, a_numLanes);
+    }
 }
 
-syn::TrapStateVariableFilter::TrapStateVariableFilter(const string& a_name)
-    : StateVariableFilter(a_name),
-      m_prevInput(0.0) {}
+void syn::StateVariableFilter::_processTptLanes(StateVariableFilter* const* a_units, int a_numLanes) {
+    // Unused lanes repeat the last unit, and their results are discarded
+    StateVariableFilter* units[MAX_LANES];
+    const SampleType* in[MAX_LANES];
+    SampleType *lpOut[MAX_LANES], *hpOut[MAX_LANES], *bpOut[MAX_LANES], *nOut[MAX_LANES];
+    int period[MAX_LANES];
+    LaneArray ic1eq, ic2eq, F, damp;
+    for (int l = 0; l < MAX_LANES; l++) {
+        StateVariableFilter* unit = units[l] = a_units[MIN(l, a_numLanes - 1)];
+        in[l] = unit->inputBuf_(iAudioIn);
+        period[l] = unit->controlPeriod_({iFcAdd, iFcMul, iResAdd, iResMul});
+        lpOut[l] = unit->outputBuf_(oLP);
+        hpOut[l] = unit->outputBuf_(oHP);
+        bpOut[l] = unit->outputBuf_(oBP);
+        nOut[l] = unit->outputBuf_(oN);
+        ic1eq[l] = unit->m_ic1eq;
+        ic2eq[l] = unit->m_ic2eq;
+    }
+
+    const int nSamples = units[0]->getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        LaneArray input;
+        for (int l = 0; l < MAX_LANES; l++) {
+            if (l < a_numLanes)
+                units[l]->_tickCoefficients(s, period[l], nSamples);
+            F[l] = units[l]->m_F;
+            damp[l] = units[l]->m_damp;
+            input[l] = in[l][s];
+        }
 
-void syn::TrapStateVariableFilter::reset() {
-    StateVariableFilter::reset();
-    m_prevInput = 0.0;
-}
+        const LaneArray a1 = 1.0 / (1.0 + F * (F + damp));
+        const LaneArray a2 = F * a1;
+        const LaneArray a3 = F * a2;
+        const LaneArray v3 = input - ic2eq;
+        const LaneArray BPOut = a1 * ic1eq + a2 * v3;
+        const LaneArray LPOut = ic2eq + a2 * ic1eq + a3 * v3;
+        ic1eq = 2 * BPOut - ic1eq;
+        ic2eq = 2 * LPOut - ic2eq;
+        const LaneArray HPOut = input - damp * BPOut - LPOut;
+
+        for (int l = 0; l < a_numLanes; l++) {
+            lpOut[l][s] = LPOut[l];
+            hpOut[l][s] = HPOut[l];
+            bpOut[l][s] = BPOut[l];
+            nOut[l][s] = HPOut[l] + LPOut[l];
+        }
+    }
 
-void syn::TrapStateVariableFilter::process_() {
-    BEGIN_PROC_FUNC
-        double fc = READ_INPUT(iFcMul) * (param(pFc).getDouble() + READ_INPUT(iFcAdd));
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        m_F = tan(SYN_PI * fc / (fs() * c_oversamplingFactor));
+    for (int l = 0; l < a_numLanes; l++) {
+        units[l]->m_ic1eq = ic1eq[l];
+        units[l]->m_ic2eq = ic2eq[l];
+    }
+}
 
-        double input_res = READ_INPUT(iResMul) * param(pRes).getDouble() + READ_INPUT(iResAdd);
-        input_res = CLAMP<double>(input_res, 0, 1);
-        double res = LERP(c_minRes, c_maxRes, input_res);
-        m_damp = 1.0 / res;
+void syn::StateVariableFilter::_processChamberlinLanes(StateVariableFilter* const* a_units, int a_numLanes) {
+    // Unused lanes repeat the last unit, and their results are discarded
+    StateVariableFilter* units[MAX_LANES];
+    const SampleType* in[MAX_LANES];
+    SampleType *lpOut[MAX_LANES], *hpOut[MAX_LANES], *bpOut[MAX_LANES], *nOut[MAX_LANES];
+    int period[MAX_LANES];
+    LaneArray prevBPOut, prevLPOut, F, damp;
+    for (int l = 0; l < MAX_LANES; l++) {
+        StateVariableFilter* unit = units[l] = a_units[MIN(l, a_numLanes - 1)];
+        in[l] = unit->inputBuf_(iAudioIn);
+        period[l] = unit->controlPeriod_({iFcAdd, iFcMul, iResAdd, iResMul});
+        lpOut[l] = unit->outputBuf_(oLP);
+        hpOut[l] = unit->outputBuf_(oHP);
+        bpOut[l] = unit->outputBuf_(oBP);
+        nOut[l] = unit->outputBuf_(oN);
+        prevBPOut[l] = unit->m_prevBPOut;
+        prevLPOut[l] = unit->m_prevLPOut;
+    }
+
+    const StateVariableFilter& first = *units[0];
+    const int nSamples = first.getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        LaneArray input;
+        for (int l = 0; l < MAX_LANES; l++) {
+            if (l < a_numLanes)
+                units[l]->_tickCoefficients(s, period[l], nSamples);
+            F[l] = units[l]->m_F;
+            damp[l] = units[l]->m_damp;
+            input[l] = in[l][s];
+        }
 
-        double input = READ_INPUT(0);
-        double LPOut = 0, BPOut = 0;
-        const double denom = 1 + m_F * (m_F + m_damp);
-        int i = c_oversamplingFactor;
+        LaneArray LPOut = LaneArray::Zero(), HPOut = LaneArray::Zero(), BPOut = LaneArray::Zero();
+        int i = first.m_oversamplingFactor;
         while (i--) {
-            BPOut = (m_prevBPOut + m_F * (-2 * m_prevLPOut + input + m_prevInput - m_prevBPOut * (m_F + m_damp))) /
-                    denom;
-            LPOut = (m_prevLPOut + m_F * (2 * m_prevBPOut + m_F * (input + m_prevInput) - m_prevLPOut * (m_F - m_damp)))
-                    / denom;
-            m_prevInput = input;
-            m_prevBPOut = BPOut;
-            m_prevLPOut = LPOut;
+            LPOut = prevLPOut + F * prevBPOut;
+            HPOut = input - LPOut - damp * prevBPOut;
+            BPOut = F * HPOut + prevBPOut;
+
+            prevBPOut = BPOut;
+            prevLPOut = LPOut;
         }
-        double HPOut = input - m_damp * BPOut - LPOut;
-        double NOut = HPOut + LPOut;
-        WRITE_OUTPUT(oLP, LPOut);
-        WRITE_OUTPUT(oHP, HPOut);
-        WRITE_OUTPUT(oBP, BPOut);
-        WRITE_OUTPUT(oN, NOut);
-    END_PROC_FUNC
+
+        for (int l = 0; l < a_numLanes; l++) {
+            lpOut[l][s] = LPOut[l];
+            hpOut[l][s] = HPOut[l];
+            bpOut[l][s] = BPOut[l];
+            nOut[l][s] = HPOut[l] + LPOut[l];
+        }
+    }
+
+    for (int l = 0; l < a_numLanes; l++) {
+        units[l]->m_prevBPOut = prevBPOut[l];
+        units[l]->m_prevLPOut = prevLPOut[l];
+    }
+}
+
+void syn::StateVariableFilter::onNoteOn_() {
+    reset();
+}
+
+void syn::StateVariableFilter::onFsChange_() {
+    m_oversamplingFactor = filterOversamplingFactor(fs());
+}
+
+void syn::StateVariableFilter::onParamChange_(int a_paramId) {
+    if (a_paramId == pMode) {
+        m_mode = static_cast<EMode>(param(pMode).getInt());
+        // The two modes keep different state
+        reset();
+    }
 }
 
 void syn::OnePoleLP::setFc(double a_fc) {
+    if (a_fc == m_fc)
+        return;
+    m_fc = a_fc;
+    m_G = gainForFc(a_fc);
+}
+
+double syn::OnePoleLP::gainForFc(double a_fc) const {
     double g = tan(m_fcScale * a_fc);
-    m_G = g / (1 + g);
+    return g / (1 + g);
 }
 
-void syn::OnePoleLP::setFs(double a_fs) { m_fcScale = SYN_PI / a_fs; }
+void syn::OnePoleLP::setFs(double a_fs) {
+    m_fcScale = SYN_PI / a_fs;
+    m_fc = -1.0;
+}
 
 double syn::OnePoleLP::process(double a_input) {
     double trap_in = m_G * (a_input - m_state);
@@ -144,11 +362,13 @@ void syn::OnePoleLP::reset() {
 syn::OnePoleLPUnit::OnePoleLPUnit(const string& a_name)
     :
     Unit(a_name),
+    m_dG(0.0),
+    m_coefficientsReady(false),
     m_lastSync(0.0) {
     addParameter_(pFc, UnitParameter("fc", 0.01, 20000.0, 1.0, UnitParameter::Freq));
     addInput_(iAudioIn, "in");
-    addInput_(iFcAdd, "fc");
-    addInput_(iFcMul, "fc[x]", 1.0);
+    addInput_(iFcAdd, "fc", 0.0, true);
+    addInput_(iFcMul, "fc[x]", 1.0, true);
     addInput_(iSync, "rst");
     addOutput_(oLP, "LP");
     addOutput_(oHP, "HP");
@@ -160,15 +380,42 @@ double syn::OnePoleLPUnit::getState() const {
 
 void syn::OnePoleLPUnit::reset() {
     implem.reset();
+    m_coefficientsReady = false;
     m_lastSync = 0.0;
 }
 
+double syn::OnePoleLPUnit::_computeGain(int a_sample) const {
+    // Calculate gain for specified cutoff
+    double fc = (param(pFc).getDouble() + inputBuf_(iFcAdd)[a_sample]) * inputBuf_(iFcMul)[a_sample]; // freq cutoff
+    fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
+    return implem.gainForFc(fc);
+}
+
+void syn::OnePoleLPUnit::_tickCoefficients(int a_sample, int a_period, int a_nSamples) {
+    if (a_sample % a_period == 0) {
+        const int length = MIN(a_period, a_nSamples - a_sample);
+        const double G = _computeGain(a_sample + length - 1);
+        if (a_period != CONTROL_PERIOD || length == 1) {
+            implem.m_G = G;
+            m_dG = 0.0;
+        } else if (m_coefficientsReady) {
+            m_dG = (G - implem.m_G) / length;
+        } else {
+            // see StateVariableFilter::_tickCoefficients
+            implem.m_G = _computeGain(a_sample);
+            m_dG = (G - implem.m_G) / (length - 1);
+            implem.m_G -= m_dG;
+        }
+        m_coefficientsReady = true;
+    }
+    implem.m_G += m_dG;
+}
+
 void syn::OnePoleLPUnit::process_() {
+    const int period = controlPeriod_({iFcAdd, iFcMul});
+    const int nSamples = getBufferSize();
     BEGIN_PROC_FUNC
-        // Calculate gain for specified cutoff
-        double fc = (param(pFc).getDouble() + READ_INPUT(iFcAdd)) * READ_INPUT(iFcMul); // freq cutoff
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        implem.setFc(fc);
+        _tickCoefficients(m_currentBufferOffset - blockOffset_(), period, nSamples);
 
         // sync
         double sync = READ_INPUT(iSync);
@@ -184,12 +431,101 @@ void syn::OnePoleLPUnit::process_() {
     END_PROC_FUNC
 }
 
+void syn::OnePoleLPUnit::processLanes_(Unit* const* a_units, int a_numLanes) {
+    // Unused lanes repeat the last unit, and their results are discarded
+    OnePoleLPUnit* units[MAX_LANES];
+    const SampleType *in[MAX_LANES], *sync[MAX_LANES];
+    SampleType *lpOut[MAX_LANES], *hpOut[MAX_LANES];
+    int period[MAX_LANES];
+    LaneArray state, lastSync, G;
+    for (int l = 0; l < MAX_LANES; l++) {
+        OnePoleLPUnit* unit = units[l] = static_cast<OnePoleLPUnit*>(a_units[MIN(l, a_numLanes - 1)]);
+        in[l] = unit->inputBuf_(iAudioIn);
+        period[l] = unit->controlPeriod_({iFcAdd, iFcMul});
+        sync[l] = unit->inputBuf_(iSync);
+        lpOut[l] = unit->outputBuf_(oLP);
+        hpOut[l] = unit->outputBuf_(oHP);
+        state[l] = unit->implem.m_state;
+        lastSync[l] = unit->m_lastSync;
+    }
+
+    const int nSamples = units[0]->getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        LaneArray input, syncIn;
+        for (int l = 0; l < MAX_LANES; l++) {
+            if (l < a_numLanes)
+                units[l]->_tickCoefficients(s, period[l], nSamples);
+            G[l] = units[l]->implem.m_G;
+            input[l] = in[l][s];
+            syncIn[l] = sync[l][s];
+        }
+
+        // sync
+        state = (lastSync - syncIn > 0.5).select(LaneArray::Zero(), state);
+        lastSync = syncIn;
+
+        const LaneArray trap_in = G * (input - state);
+        const LaneArray output = trap_in + state;
+        state = trap_in + output;
+
+        for (int l = 0; l < a_numLanes; l++) {
+            lpOut[l][s] = output[l];
+            hpOut[l][s] = input[l] - output[l];
+        }
+    }
+
+    for (int l = 0; l < a_numLanes; l++) {
+        units[l]->implem.m_state = state[l];
+        units[l]->m_lastSync = lastSync[l];
+    }
+}
+
 void syn::OnePoleLPUnit::onFsChange_() {
     implem.setFs(fs());
 }
 
+namespace
+{
+    typedef syn::Unit::LaneArray LaneArray;
+
+    /// fast_tanh_rat on every lane
+    LaneArray laneTanhRat(const LaneArray& x) {
+        const LaneArray ax = x.abs();
+        const LaneArray x2 = x * x;
+        const LaneArray z = x * (0.773062670268356 + ax + (0.757118539838817 + 0.0139332362248817 * x2 * x2) * x2 * ax);
+        return z / (0.795956503022967 + z.abs());
+    }
+
+    /// log(cosh(x)), the antiderivative of tanh, written as |x| + log(1 + e^-2|x|) - log(2) so that it does not overflow
+    LaneArray laneLogCosh(const LaneArray& x) {
+        const LaneArray ax = x.abs();
+        LaneArray t = -2.0 * 1.4426950408889634 * ax; // log2(e)
+        syn::fast_exp2(t.data(), t.data(), MAX_LANES);
+        t += 1.0;
+        syn::fast_log2(t.data(), t.data(), MAX_LANES);
+        return ax + 0.69314718055994531 * (t - 1.0); // log(2)
+    }
+
+    /**
+     * First-order antiderivative anti-aliased tanh, i.e. the mean of tanh between the previous argument and a_x.
+     * Arguments that are too close for the antiderivatives' difference to be accurate use tanh of their midpoint.
+     */
+    LaneArray laneAdaaTanh(const LaneArray& a_x, LaneArray& a_prevX, LaneArray& a_prevF) {
+        const LaneArray F = laneLogCosh(a_x);
+        const LaneArray dx = a_x - a_prevX;
+        LaneArray mid = 0.5 * (a_x + a_prevX);
+        syn::fast_tanh(mid.data(), mid.data(), MAX_LANES);
+        const LaneArray y = (dx.abs() > 1e-5).select((F - a_prevF) / dx, mid);
+        a_prevX = a_x;
+        a_prevF = F;
+        return y;
+    }
+}
+
 syn::LadderFilterBase::LadderFilterBase(const string& a_name)
-    : Unit(a_name) {
+    : Unit(a_name),
+      m_oversamplingFactor(filterOversamplingFactor(fs())) {
     addParameter_(pFc, UnitParameter("fc", 0.01, 20000.0, 10000.0, UnitParameter::Freq));
     addParameter_(pFb, UnitParameter("res", 0.0, 1.0, 0.0));
     addParameter_(pDrv, UnitParameter("drv", 0.0, 1.0, 0.0));
@@ -205,6 +541,10 @@ void syn::LadderFilterBase::onNoteOn_() {
     reset();
 }
 
+void syn::LadderFilterBase::onFsChange_() {
+    m_oversamplingFactor = filterOversamplingFactor(fs());
+}
+
 syn::LadderFilterA::LadderFilterA(const string& a_name)
     :
     LadderFilterBase(a_name) {
@@ -218,24 +558,37 @@ void syn::LadderFilterA::reset() {
 }
 
 void syn::LadderFilterA::process_() {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(iAudioIn);
-        // Calculate gain for specified cutoff
-        double fs = LadderFilterA::fs() * c_oversamplingFactor;
-
-        double fc = (param(pFc).getDouble() + READ_INPUT(iFcAdd)) * READ_INPUT(iFcMul); // freq cutoff
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
+    const SampleType* in = inputBuf_(iAudioIn);
+    const SampleType* fcAdd = inputBuf_(iFcAdd);
+    const SampleType* fcMul = inputBuf_(iFcMul);
+    const SampleType* fbAdd = inputBuf_(iFbAdd);
+    const SampleType* drvAdd = inputBuf_(iDrvAdd);
+    SampleType* out = outputBuf_(0);
+
+    const double paramFc = param(pFc).getDouble();
+    const double minFc = param(pFc).getMin();
+    const double maxFc = param(pFc).getMax();
+    const double paramDrv = param(pDrv).getDouble();
+    const double paramFb = param(pFb).getDouble();
+    // Calculate gain for specified cutoff
+    const double fs = LadderFilterA::fs() * m_oversamplingFactor;
+    const double stage_gain = 1.0 / (2.0 * VT);
+    const double dt = 1.0 / (2.0 * fs);
+    const int nSamples = getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        double input = in[s];
+        double fc = (paramFc + fcAdd[s]) * fcMul[s]; // freq cutoff
+        fc = CLAMP(fc, minFc, maxFc);
 
         double wd = SYN_PI * fc / fs;
 
         // Prepare parameter values and insert them into each stage.
         double g = 4 * SYN_PI * VT * fc * (1.0 - wd) / (1.0 + wd);
-        double drive = 1 + 3 * (param(pDrv).getDouble() + READ_INPUT(iDrvAdd));
-        double res = 3.9 * (param(pFb).getDouble() + READ_INPUT(iFbAdd));
-        double stage_gain = 1.0 / (2.0 * VT);
-        double dt = 1.0 / (2.0 * fs);
+        double drive = 1 + 3 * (paramDrv + drvAdd[s]);
+        double res = 3.9 * (paramFb + fbAdd[s]);
 
-        for (int i = 0; i < c_oversamplingFactor; i++) {
+        for (int i = 0; i < m_oversamplingFactor; i++) {
             double dV0 = -g * (fast_tanh_rat((drive * input + res * m_V[3]) * stage_gain) + m_tV[0]);
             m_V[0] += (dV0 + m_dV[0]) * dt;
             m_dV[0] = dV0;
@@ -256,30 +609,140 @@ void syn::LadderFilterA::process_() {
             m_dV[3] = dV3;
             m_tV[3] = fast_tanh_rat(m_V[3] * stage_gain);
         }
-        WRITE_OUTPUT(0, m_V[3]);
-    END_PROC_FUNC
+        out[s] = m_V[3];
+    }
+}
+
+void syn::LadderFilterA::processLanes_(Unit* const* a_units, int a_numLanes) {
+    // Unused lanes repeat the last unit, and their results are discarded
+    LadderFilterA* units[MAX_LANES];
+    const SampleType *in[MAX_LANES], *fcAdd[MAX_LANES], *fcMul[MAX_LANES], *fbAdd[MAX_LANES], *drvAdd[MAX_LANES];
+    SampleType* out[MAX_LANES];
+    LaneArray paramFc, paramDrv, paramFb;
+    LaneArray V[4], dV[4], tV[4];
+    for (int l = 0; l < MAX_LANES; l++) {
+        LadderFilterA* unit = units[l] = static_cast<LadderFilterA*>(a_units[MIN(l, a_numLanes - 1)]);
+        in[l] = unit->inputBuf_(iAudioIn);
+        fcAdd[l] = unit->inputBuf_(iFcAdd);
+        fcMul[l] = unit->inputBuf_(iFcMul);
+        fbAdd[l] = unit->inputBuf_(iFbAdd);
+        drvAdd[l] = unit->inputBuf_(iDrvAdd);
+        out[l] = unit->outputBuf_(0);
+        paramFc[l] = unit->param(pFc).getDouble();
+        paramDrv[l] = unit->param(pDrv).getDouble();
+        paramFb[l] = unit->param(pFb).getDouble();
+        for (int i = 0; i < 4; i++) {
+            V[i][l] = unit->m_V[i];
+            dV[i][l] = unit->m_dV[i];
+            tV[i][l] = unit->m_tV[i];
+        }
+    }
+
+    const LadderFilterA& first = *units[0];
+    const int nSteps = first.m_oversamplingFactor;
+    const double minFc = first.param(pFc).getMin();
+    const double maxFc = first.param(pFc).getMax();
+    const double fs = first.fs() * nSteps;
+    const double stage_gain = 1.0 / (2.0 * first.VT);
+    const double dt = 1.0 / (2.0 * fs);
+    const int nSamples = first.getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        LaneArray input, fc, drive, res;
+        for (int l = 0; l < MAX_LANES; l++) {
+            input[l] = in[l][s];
+            fc[l] = (paramFc[l] + fcAdd[l][s]) * fcMul[l][s];
+            drive[l] = drvAdd[l][s];
+            res[l] = fbAdd[l][s];
+        }
+        fc = fc.max(minFc).min(maxFc);
+        drive = 1 + 3 * (paramDrv + drive);
+        res = 3.9 * (paramFb + res);
+
+        const LaneArray wd = SYN_PI * fc / fs;
+        const LaneArray g = 4 * SYN_PI * first.VT * fc * (1.0 - wd) / (1.0 + wd);
+
+        for (int i = 0; i < nSteps; i++) {
+            const LaneArray dV0 = -g * (laneTanhRat((drive * input + res * V[3]) * stage_gain) + tV[0]);
+            V[0] += (dV0 + dV[0]) * dt;
+            dV[0] = dV0;
+            tV[0] = laneTanhRat(V[0] * stage_gain);
+
+            const LaneArray dV1 = g * (tV[0] - tV[1]);
+            V[1] += (dV1 + dV[1]) * dt;
+            dV[1] = dV1;
+            tV[1] = laneTanhRat(V[1] * stage_gain);
+
+            const LaneArray dV2 = g * (tV[1] - tV[2]);
+            V[2] += (dV2 + dV[2]) * dt;
+            dV[2] = dV2;
+            tV[2] = laneTanhRat(V[2] * stage_gain);
+
+            const LaneArray dV3 = g * (tV[2] - tV[3]);
+            V[3] += (dV3 + dV[3]) * dt;
+            dV[3] = dV3;
+            tV[3] = laneTanhRat(V[3] * stage_gain);
+        }
+
+        for (int l = 0; l < a_numLanes; l++)
+            out[l][s] = V[3][l];
+    }
+
+    for (int l = 0; l < a_numLanes; l++) {
+        for (int i = 0; i < 4; i++) {
+            units[l]->m_V[i] = V[i][l];
+            units[l]->m_dV[i] = dV[i][l];
+            units[l]->m_tV[i] = tV[i][l];
+        }
+    }
 }
 
 syn::LadderFilterB::LadderFilterB(const string& a_name)
-    : LadderFilterBase(a_name) {}
+    : LadderFilterBase(a_name),
+      m_mode(ModeOversampled),
+      m_adaaX(0.0),
+      m_adaaF(0.0) {
+    addParameter_(pMode, UnitParameter("mode", {"oversampled", "adaa"}));
+}
 
 void syn::LadderFilterB::reset() {
     m_LP[0].reset();
     m_LP[1].reset();
     m_LP[2].reset();
     m_LP[3].reset();
+    m_adaaX = 0.0;
+    m_adaaF = 0.0;
 }
 
 void syn::LadderFilterB::process_() {
-    BEGIN_PROC_FUNC
-        double input = READ_INPUT(iAudioIn);
+    if (m_mode == ModeAdaa) {
+        // The antiderivative anti-aliased nonlinearity is only written for lanes, so a single voice uses one lane
+        Unit* self = this;
+        processLanes_(&self, 1);
+        return;
+    }
+
+    const SampleType* in = inputBuf_(iAudioIn);
+    const SampleType* fcAdd = inputBuf_(iFcAdd);
+    const SampleType* fcMul = inputBuf_(iFcMul);
+    const SampleType* fbAdd = inputBuf_(iFbAdd);
+    const SampleType* drvAdd = inputBuf_(iDrvAdd);
+    SampleType* out = outputBuf_(0);
+
+    const double paramFc = param(pFc).getDouble();
+    const double minFc = param(pFc).getMin();
+    const double maxFc = param(pFc).getMax();
+    const double paramDrv = param(pDrv).getDouble();
+    const double paramFb = param(pFb).getDouble();
+    const int nSamples = getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        double input = in[s];
         // Calculate gain for specified cutoff
-        double fs = LadderFilterB::fs() * c_oversamplingFactor;
-
-        double fc = (param(pFc).getDouble() + READ_INPUT(iFcAdd)) * READ_INPUT(iFcMul); // freq cutoff
-        fc = CLAMP(fc, param(pFc).getMin(), param(pFc).getMax());
-        double drive = 1.0 + 3.0 * (param(pDrv).getDouble() + READ_INPUT(iDrvAdd));
-        double res = 3.9 * (param(pFb).getDouble() + READ_INPUT(iFbAdd));
+        double fc = (paramFc + fcAdd[s]) * fcMul[s]; // freq cutoff
+        fc = CLAMP(fc, minFc, maxFc);
+        double drive = 1.0 + 3.0 * (paramDrv + drvAdd[s]);
+        double res = 3.9 * (paramFb + fbAdd[s]);
 
         m_LP[0].setFc(fc);
         m_LP[1].m_G = m_LP[0].m_G;
@@ -295,9 +758,9 @@ void syn::LadderFilterB::process_() {
         double G4 = m_LP[0].m_G * m_LP[0].m_G * m_LP[0].m_G * m_LP[0].m_G;
         double out_fb_gain = 1.0 / (1.0 + res * G4);
 
-        double out_states[5];
+        double out_states[5] = {};
         input *= drive;
-        for (int i = 0; i < c_oversamplingFactor; i++) {
+        for (int i = 0; i < m_oversamplingFactor; i++) {
             double out_fb = lp0_fb_gain * m_LP[0].m_state + lp1_fb_gain * m_LP[1].m_state + lp2_fb_gain * m_LP[2].
                             m_state + lp3_fb_gain * m_LP[3].m_state;
 
@@ -307,14 +770,116 @@ void syn::LadderFilterB::process_() {
             out_states[3] = m_LP[2].process(out_states[2]);
             out_states[4] = m_LP[3].process(out_states[3]);
         }
-        double out = out_states[4];
-        WRITE_OUTPUT(0, out);
-    END_PROC_FUNC
+        out[s] = out_states[4];
+    }
+}
+
+void syn::LadderFilterB::processLanes_(Unit* const* a_units, int a_numLanes) {
+    // Unused lanes repeat the last unit, and their results are discarded
+    LadderFilterB* units[MAX_LANES];
+    const SampleType *in[MAX_LANES], *fcAdd[MAX_LANES], *fcMul[MAX_LANES], *fbAdd[MAX_LANES], *drvAdd[MAX_LANES];
+    SampleType* out[MAX_LANES];
+    LaneArray paramFc, paramDrv, paramFb;
+    LaneArray state[4], adaaX, adaaF;
+    for (int l = 0; l < MAX_LANES; l++) {
+        LadderFilterB* unit = units[l] = static_cast<LadderFilterB*>(a_units[MIN(l, a_numLanes - 1)]);
+        if (unit->m_mode != units[0]->m_mode) {
+            // The lanes must share an update rate
+            for (int v = 0; v < a_numLanes; v++)
+                static_cast<LadderFilterB*>(a_units[v])->process_();
+            return;
+        }
+        in[l] = unit->inputBuf_(iAudioIn);
+        fcAdd[l] = unit->inputBuf_(iFcAdd);
+        fcMul[l] = unit->inputBuf_(iFcMul);
+        fbAdd[l] = unit->inputBuf_(iFbAdd);
+        drvAdd[l] = unit->inputBuf_(iDrvAdd);
+        out[l] = unit->outputBuf_(0);
+        paramFc[l] = unit->param(pFc).getDouble();
+        paramDrv[l] = unit->param(pDrv).getDouble();
+        paramFb[l] = unit->param(pFb).getDouble();
+        for (int i = 0; i < 4; i++)
+            state[i][l] = unit->m_LP[i].m_state;
+        adaaX[l] = unit->m_adaaX;
+        adaaF[l] = unit->m_adaaF;
+    }
+
+    const LadderFilterB& first = *units[0];
+    const bool adaa = first.m_mode == ModeAdaa;
+    const int nSteps = first.m_oversamplingFactor;
+    const double minFc = first.param(pFc).getMin();
+    const double maxFc = first.param(pFc).getMax();
+    const int nSamples = first.getBufferSize();
+
+    for (int s = 0; s < nSamples; s++) {
+        LaneArray input, G, drive, res;
+        for (int l = 0; l < MAX_LANES; l++) {
+            double fc = (paramFc[l] + fcAdd[l][s]) * fcMul[l][s];
+            fc = CLAMP(fc, minFc, maxFc);
+            // The stage gain is cached by the first stage of each unit
+            units[l]->m_LP[0].setFc(fc);
+            G[l] = units[l]->m_LP[0].m_G;
+            input[l] = in[l][s];
+            drive[l] = drvAdd[l][s];
+            res[l] = fbAdd[l][s];
+        }
+        drive = 1.0 + 3.0 * (paramDrv + drive);
+        res = 3.9 * (paramFb + res);
+
+        const LaneArray g = G / (1 - G);
+        const LaneArray lp3_fb_gain = 1.0 / (1.0 + g);
+        const LaneArray lp2_fb_gain = G * lp3_fb_gain;
+        const LaneArray lp1_fb_gain = G * lp2_fb_gain;
+        const LaneArray lp0_fb_gain = G * lp1_fb_gain;
+
+        const LaneArray G4 = G * G * G * G;
+        const LaneArray out_fb_gain = 1.0 / (1.0 + res * G4);
+
+        LaneArray stageIn;
+        input *= drive;
+        for (int i = 0; i < nSteps; i++) {
+            const LaneArray out_fb = lp0_fb_gain * state[0] + lp1_fb_gain * state[1] + lp2_fb_gain * state[2]
+                                     + lp3_fb_gain * state[3];
+
+            const LaneArray x = (input - res * (out_fb - input)) * out_fb_gain;
+            stageIn = adaa ? laneAdaaTanh(x, adaaX, adaaF) : laneTanhRat(x);
+            // see OnePoleLP::process
+            for (int j = 0; j < 4; j++) {
+                const LaneArray trap_in = G * (stageIn - state[j]);
+                stageIn = trap_in + state[j];
+                state[j] = trap_in + stageIn;
+            }
+        }
+
+        for (int l = 0; l < a_numLanes; l++)
+            out[l][s] = stageIn[l];
+    }
+
+    for (int l = 0; l < a_numLanes; l++) {
+        for (int i = 0; i < 4; i++) {
+            units[l]->m_LP[i].m_G = units[l]->m_LP[0].m_G;
+            units[l]->m_LP[i].m_state = state[i][l];
+        }
+        units[l]->m_adaaX = adaaX[l];
+        units[l]->m_adaaF = adaaF[l];
+    }
 }
 
 void syn::LadderFilterB::onFsChange_() {
-    m_LP[0].setFs(fs());
-    m_LP[1].setFs(fs());
-    m_LP[2].setFs(fs());
-    m_LP[3].setFs(fs());
+    m_oversamplingFactor = filterOversamplingFactor(fs(), m_mode == ModeAdaa ? c_adaaUpdateRate : c_filterUpdateRate);
+    // The stages are updated m_oversamplingFactor times per sample
+    const double fs = LadderFilterB::fs() * m_oversamplingFactor;
+    m_LP[0].setFs(fs);
+    m_LP[1].setFs(fs);
+    m_LP[2].setFs(fs);
+    m_LP[3].setFs(fs);
+}
+
+void syn::LadderFilterB::onParamChange_(int a_paramId) {
+    if (a_paramId == pMode) {
+        m_mode = static_cast<EMode>(param(pMode).getInt());
+        // The update rate depends on the mode
+        onFsChange_();
+        reset();
+    }
 }
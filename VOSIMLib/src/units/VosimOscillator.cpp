@@ -25,13 +25,16 @@ namespace syn
         TunedOscillatorUnit(name),
         m_pulse_step(0.0),
         m_pulse_tune(0),
-        m_num_pulses(1)
+        m_num_pulses(1),
+        m_pulse_freq(0.0),
+        m_pulse_min_freq(-1.0),
+        m_pulse_freq_tune(0.0)
     {
         addParameter_(pPulseTune, {"fp", 0.0, 1.0, 0.0});
         addParameter_(pNumPulses, {"num", 1, 8, 1});
         addParameter_(pPulseDecay, {"dec", 0.0, 1.0, 0.0});
-        addInput_(iPulseTuneAdd, "fp");
-        addInput_(iPulseTuneMul, "fp[x]", 1.0);
+        addInput_(iPulseTuneAdd, "fp", 0.0, true);
+        addInput_(iPulseTuneMul, "fp[x]", 1.0, true);
         addInput_(iDecayMul, "dec[x]", 1.0);
     }
 
@@ -40,9 +43,12 @@ namespace syn
 
     void VosimOscillator::process_()
     {
+        // The pulse tune is held for each control period, so that the pulse frequency is recomputed at most once per period
+        const int period = controlPeriod_({iPulseTuneAdd, iPulseTuneMul});
         BEGIN_PROC_FUNC
             m_num_pulses = param(pNumPulses).getInt();
-            m_pulse_tune = CLAMP<double>(READ_INPUT(iPulseTuneMul) * (param(pPulseTune).getDouble() + READ_INPUT(iPulseTuneAdd)), 0, 1);
+            if ((m_currentBufferOffset - blockOffset_()) % period == 0)
+                m_pulse_tune = CLAMP<double>(READ_INPUT(iPulseTuneMul) * (param(pPulseTune).getDouble() + READ_INPUT(iPulseTuneAdd)), 0, 1);
             TunedOscillatorUnit::process_();
             double pulse_decay = CLAMP<double>(READ_INPUT(iDecayMul) * param(pPulseDecay).getDouble(), 0, 1);
 
@@ -73,18 +79,22 @@ namespace syn
     void VosimOscillator::updatePhaseStep_()
     {
         TunedOscillatorUnit::updatePhaseStep_();
-        double pulse_freq;
         double min_freq = m_num_pulses * m_freq;
-        int MAX_PULSE_FREQ = 3000;
-        if (min_freq > MAX_PULSE_FREQ)
+        if (min_freq != m_pulse_min_freq || m_pulse_tune != m_pulse_freq_tune)
         {
-            pulse_freq = min_freq;
-        }
-        else
-        {
-            pulse_freq = pow(2.0, LERP<double>(log2(min_freq), log2(MAX_PULSE_FREQ), m_pulse_tune));
+            m_pulse_min_freq = min_freq;
+            m_pulse_freq_tune = m_pulse_tune;
+            int MAX_PULSE_FREQ = 3000;
+            if (min_freq > MAX_PULSE_FREQ)
+            {
+                m_pulse_freq = min_freq;
+            }
+            else
+            {
+                m_pulse_freq = pow(2.0, LERP<double>(log2(min_freq), log2(MAX_PULSE_FREQ), m_pulse_tune));
+            }
         }
-        m_pulse_step = pulse_freq / fs();
+        m_pulse_step = m_pulse_freq / fs();
     }
 
     FormantOscillator::FormantOscillator(string name) :
@@ -2,14 +2,22 @@
 #include <vosimlib/Unit.h>
 #include <vosimlib/Circuit.h>
 #include <vosimlib/DSPMath.h>
+#include <vosimlib/FastMath.h>
 #include <vosimlib/units/StateVariableFilter.h>
 #include <vosimlib/units/OscillatorUnit.h>
 #include <vosimlib/units/MemoryUnit.h>
 #include <vosimlib/VoiceManager.h>
+#include <vosimlib/CircuitFile.h>
+#include <vosimlib/MemoryPool.h>
+#include <vosimlib/WorkerPool.h>
 #include <vosimlib/common_serial.h>
 
+#include <cstdio>
+#include <memory>
 #include <sstream>
 #include <random>
+#include <thread>
+#include <chrono>
 #include <vosimlib/units/MidiUnits.h>
 #include <vosimlib/units/ADSREnvelope.h>
 #include <vosimlib/units/MathUnits.h>
@@ -63,6 +71,65 @@ TEST_CASE("Check that serializer can load what it saves", "[serialization]") {
         string circuit_str2 = ss2.str();
         REQUIRE(circuit_str1 == circuit_str2);
     }
+
+    SECTION("Binary round trip") {
+        syn::Circuit circ("main");
+        int oscId = circ.addUnit(new syn::BasicOscillatorUnit("oscUnit"));
+        int ladderId = circ.addUnit(new syn::LadderFilterB("ladderUnit"));
+        circ.getUnit(ladderId).param(syn::LadderFilterB::pDrv).set(0.123456789);
+        circ.getUnit(ladderId).param(syn::LadderFilterB::pMode).set(syn::LadderFilterB::ModeAdaa);
+        syn::Circuit* inner = new syn::Circuit("inner");
+        inner->param(syn::Circuit::pOversampling).set(1);
+        int innerSvfId = inner->addUnit(new syn::StateVariableFilter("svfUnit"));
+        inner->connectInternal(inner->getInputUnitId(), 0, innerSvfId, 0);
+        inner->connectInternal(innerSvfId, 0, inner->getOutputUnitId(), 0);
+        int innerId = circ.addUnit(inner);
+        circ.connectInternal(oscId, 0, innerId, 0);
+        circ.connectInternal(innerId, 0, ladderId, 0);
+        circ.connectInternal(ladderId, 0, circ.getOutputUnitId(), 0);
+
+        const std::vector<char> data = syn::saveBinaryCircuit(circ);
+        REQUIRE(syn::isBinaryCircuit(data.data(), data.size()));
+        std::unique_ptr<syn::Circuit> loaded(syn::loadBinaryCircuit(data.data(), data.size()));
+        REQUIRE(loaded != nullptr);
+        // Both forms hold the same information
+        REQUIRE(loaded->operator json().dump() == circ.operator json().dump());
+        REQUIRE(syn::saveBinaryCircuit(*loaded) == data);
+        // Values are restored exactly, rather than from their display strings
+        REQUIRE(loaded->getUnit(ladderId).param(syn::LadderFilterB::pDrv).getDouble() == 0.123456789);
+        REQUIRE(loaded->getUnit(innerId).param(syn::Circuit::pOversampling).getInt() == 1);
+
+        // A circuit loaded from JSON saves to the same JSON through the binary form
+        std::unique_ptr<syn::Unit> fromJson(syn::Unit::fromJSON(circ.operator json()));
+        const std::vector<char> jsonData = syn::saveBinaryCircuit(*static_cast<syn::Circuit*>(fromJson.get()));
+        std::unique_ptr<syn::Circuit> fromJsonData(syn::loadBinaryCircuit(jsonData.data(), jsonData.size()));
+        REQUIRE(fromJsonData != nullptr);
+        REQUIRE(fromJsonData->operator json().dump() == fromJson->operator json().dump());
+
+        // The data does not need to be aligned
+        std::vector<char> unaligned(data.size() + 1);
+        std::copy(data.begin(), data.end(), unaligned.begin() + 1);
+        std::unique_ptr<syn::Circuit> fromUnaligned(syn::loadBinaryCircuit(unaligned.data() + 1, data.size()));
+        REQUIRE(fromUnaligned != nullptr);
+        REQUIRE(fromUnaligned->operator json().dump() == circ.operator json().dump());
+
+        // Memory-mapped file
+        const string path = "vosimlib_tests_circuit.bin";
+        REQUIRE(syn::saveBinaryCircuitFile(circ, path));
+        std::unique_ptr<syn::Circuit> fromFile(syn::loadBinaryCircuitFile(path));
+        std::remove(path.c_str());
+        REQUIRE(fromFile != nullptr);
+        REQUIRE(fromFile->operator json().dump() == circ.operator json().dump());
+
+        // Malformed data is rejected
+        REQUIRE(syn::loadBinaryCircuit(data.data(), data.size() - 1) == nullptr);
+        std::vector<char> badMagic = data;
+        badMagic[0] = 'X';
+        REQUIRE(syn::loadBinaryCircuit(badMagic.data(), badMagic.size()) == nullptr);
+        std::vector<char> newerVersion = data;
+        newerVersion[4]++;
+        REQUIRE(syn::loadBinaryCircuit(newerVersion.data(), newerVersion.size()) == nullptr);
+    }
 }
 
 TEST_CASE("Check proc graph linearization", "[proc-graph]") {
@@ -83,7 +150,7 @@ TEST_CASE("Check proc graph linearization", "[proc-graph]") {
         circ->connectInternal(*oscUnit, 0, *svfUnit, syn::StateVariableFilter::Input::iAudioIn);
         circ->connectInternal(*oscUnit, 0, *gainUnit, 0);
         circ->connectInternal(*oscUnit, 1, *svfUnit, syn::StateVariableFilter::Input::iFcAdd);
-        circ->connectInternal(*noteUnit, 0, *oscUnit, syn::TunedOscillatorUnit::Input::iNote);
+        circ->connectInternal(*noteUnit, 0, *oscUnit, syn::BasicOscillatorUnit::iNote);
         circ->connectInternal(*envUnit, 0, *oscUnit, syn::OscillatorUnit::Input::iGainMul);
         auto&& execOrder = circ->execOrder();
         int execOrderSize = std::count_if(execOrder.begin(), execOrder.end(), [](auto&& ptr) { return ptr != nullptr; });
@@ -116,6 +183,328 @@ TEST_CASE("Check proc graph linearization", "[proc-graph]") {
         REQUIRE(oscUnit->output(1).buf() != svfUnit->output(0).buf());
     }
 
+    SECTION("Voices share the prototype's execution plan") {
+        syn::Circuit proto("proto");
+        int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+        int svfId = proto.addUnit(new syn::StateVariableFilter("svf"));
+        proto.connectInternal(oscId, 0, svfId, 0);
+        proto.connectInternal(svfId, 0, proto.getOutputUnitId(), 0);
+
+        syn::VoiceManager vm;
+        vm.setPrototypeCircuit(proto);
+        vm.setMaxVoices(4);
+        auto plan = vm.getPrototypeCircuit().plan();
+        REQUIRE(plan->steps.size() == 3);
+        for (int i = 0; i < vm.getMaxVoices(); i++) {
+            const syn::Circuit& voice = vm.getVoiceCircuit(i);
+            REQUIRE(voice.plan() == plan);
+            REQUIRE(voice.execOrder()[1] == &voice.getUnit(svfId));
+        }
+
+        // Editing a voice gives it a plan of its own
+        syn::Circuit& voice0 = vm.getVoiceCircuit(0);
+        voice0.disconnectInternal(svfId, 0, voice0.getOutputUnitId(), 0);
+        REQUIRE(voice0.plan() != plan);
+        REQUIRE(vm.getVoiceCircuit(1).plan() == plan);
+    }
+
+    SECTION("Output buffers are shared between non-overlapping lifetimes") {
+        const int nFilters = 32;
+        const int bufSize = 16;
+        syn::Circuit circ("chain");
+        circ.setBufferSize(bufSize);
+        int prevId = circ.getInputUnitId();
+        std::vector<int> ids;
+        for (int i = 0; i < nFilters; i++) {
+            int id = circ.addUnit(new syn::OnePoleLPUnit("lp"));
+            circ.getUnit(id).param(syn::OnePoleLPUnit::pFc).set(1000.0 + 100 * i);
+            circ.connectInternal(prevId, 0, id, 0);
+            prevId = id;
+            ids.push_back(id);
+        }
+        circ.connectInternal(prevId, 0, circ.getOutputUnitId(), 0);
+        // one buffer for the chain link being read, one for each output of the unit being ticked
+        REQUIRE(circ.plan()->numBuffers <= 3);
+
+        syn::Unit::dynamic_buffer_t input(1, bufSize);
+        for (int i = 0; i < bufSize; i++)
+            input(0, i) = i % 2 ? 1.0 : -0.5;
+        syn::ReadOnlyBuffer<syn::SampleType> src{&input(0, 0)};
+        circ.connectInput(0, src);
+        circ.tick();
+
+        // Compare against the same chain run unit by unit
+        syn::Unit::dynamic_buffer_t ins(4, bufSize), outs(2, bufSize);
+        ins.setZero();
+        ins.row(2).setOnes(); // fc[x]
+        ins.row(0) = input;
+        REQUIRE(circ.getUnit(circ.getInputUnitId()).readOutputSnapshot(0) == input(0, 0));
+        for (int i = 0; i < nFilters; i++) {
+            syn::OnePoleLPUnit lp("lp");
+            lp.setFs(circ.fs());
+            lp.param(syn::OnePoleLPUnit::pFc).set(1000.0 + 100 * i);
+            lp.tick(ins, outs);
+            ins.row(0) = outs.row(0);
+            // The unit's buffer has since been reused by the rest of the chain, but its snapshot has not
+            REQUIRE(circ.getUnit(ids[i]).readOutputSnapshot(0) == Approx(outs(0, 0)));
+        }
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == Approx(ins(0, i)));
+    }
+
+    SECTION("Input and output units alias their buffers") {
+        const int bufSize = 8;
+        syn::Circuit circ("alias");
+        circ.setBufferSize(bufSize);
+        int gainId = circ.addUnit(new syn::GainUnit("gain"));
+        circ.getUnit(gainId).param(0).set(2.0);
+        circ.connectInternal(circ.getInputUnitId(), 0, gainId, 0);
+        circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 0);
+        circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 1);
+
+        syn::SampleType input[bufSize] = {1, 2, 3, 4, 5, 6, 7, 8};
+        syn::ReadOnlyBuffer<syn::SampleType> src{input};
+        circ.connectInput(0, src);
+        circ.tick();
+        REQUIRE(circ.getUnit(circ.getInputUnitId()).outputs()[0].buf() == input);
+        REQUIRE(circ.output(0).buf() == circ.getUnit(gainId).output(0).buf());
+        REQUIRE(circ.output(1).buf() == circ.output(0).buf());
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(1, i) == 2 * input[i]);
+
+        // A new input buffer is picked up on the next block
+        syn::SampleType input2[bufSize] = {8, 7, 6, 5, 4, 3, 2, 1};
+        syn::ReadOnlyBuffer<syn::SampleType> src2{input2};
+        circ.connectInput(0, src2);
+        circ.tick();
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(circ.readOutput(0, i) == 2 * input2[i]);
+    }
+
+    SECTION("Edits update the plan incrementally") {
+        syn::Circuit circ("edits");
+        int oscId = circ.addUnit(new syn::BasicOscillatorUnit("osc"));
+        int svfId = circ.addUnit(new syn::StateVariableFilter("svf"));
+        int gainId = circ.addUnit(new syn::GainUnit("gain"));
+        circ.connectInternal(oscId, 0, svfId, 0);
+        circ.connectInternal(svfId, 0, circ.getOutputUnitId(), 0);
+        REQUIRE(circ.getConnectionsToInternalInput(svfId, 0) == (std::vector<std::pair<int, int>>{{oscId, 0}}));
+        REQUIRE(circ.getConnectionsFromInternalOutput(oscId, 0) == (std::vector<std::pair<int, int>>{{svfId, 0}}));
+        REQUIRE(circ.getConnectionsToInternalInput(gainId, 0).empty());
+
+        // Edges that respect the current order keep it
+        auto stepIds = [&circ]() {
+            std::vector<int> ids;
+            for (const auto& step : circ.plan()->steps)
+                ids.push_back(step.unitId);
+            return ids;
+        };
+        std::vector<int> before = stepIds();
+        circ.connectInternal(oscId, 1, svfId, syn::StateVariableFilter::Input::iFcAdd);
+        REQUIRE(stepIds() == before);
+
+        // Edges that break it trigger a full relinearization
+        circ.connectInternal(svfId, 0, gainId, 0);
+        circ.connectInternal(gainId, 0, oscId, syn::OscillatorUnit::Input::iGainMul);
+        std::vector<int> after = stepIds();
+        REQUIRE(SYN_VEC_FIND(after, gainId) < SYN_VEC_FIND(after, oscId));
+
+        // Bulk edits defer the rebuild until the scope closes
+        auto plan = circ.plan();
+        {
+            syn::Circuit::BulkEdit edit(circ);
+            circ.disconnectInternal(gainId, 0, oscId, syn::OscillatorUnit::Input::iGainMul);
+            circ.connectInternal(gainId, 0, circ.getOutputUnitId(), 1);
+            REQUIRE(circ.plan() == plan);
+        }
+        REQUIRE(circ.plan() != plan);
+        after = stepIds();
+        REQUIRE(SYN_VEC_FIND(after, oscId) < SYN_VEC_FIND(after, svfId));
+        REQUIRE(SYN_VEC_FIND(after, svfId) < SYN_VEC_FIND(after, gainId));
+        REQUIRE(circ.getConnectionsFromInternalOutput(gainId, 0) == (std::vector<std::pair<int, int>>{{circ.getOutputUnitId(), 1}}));
+    }
+
+    SECTION("Feedback loops are processed one sample at a time") {
+        const int bufSize = 16;
+        syn::Circuit circ("feedback");
+        circ.setBufferSize(bufSize);
+        int sumId = circ.addUnit(new syn::SummerUnit("sum"));
+        int fbId = circ.addUnit(new syn::GainUnit("fb"));
+        int outGainId = circ.addUnit(new syn::GainUnit("out"));
+        circ.getUnit(fbId).param(0).set(0.5);
+        circ.getUnit(outGainId).param(0).set(2.0);
+        circ.connectInternal(circ.getInputUnitId(), 0, sumId, 0);
+        circ.connectInternal(sumId, 0, fbId, 0);
+        circ.connectInternal(fbId, 0, sumId, 1);
+        circ.connectInternal(sumId, 0, outGainId, 0);
+        circ.connectInternal(outGainId, 0, circ.getOutputUnitId(), 0);
+        REQUIRE(circ.plan()->loops.size() == 1);
+        const auto& loop = circ.plan()->loops[0];
+        REQUIRE(loop.end - loop.begin == 2);
+
+        syn::SampleType input[bufSize];
+        for (int i = 0; i < bufSize; i++)
+            input[i] = i % 3 ? 0.0 : 1.0;
+        syn::ReadOnlyBuffer<syn::SampleType> src{input};
+        circ.connectInput(0, src);
+
+        // y[n] = x[n] + 0.5*y[n-1], carried across blocks
+        double y = 0.0;
+        for (int block = 0; block < 2; block++) {
+            circ.tick();
+            for (int i = 0; i < bufSize; i++) {
+                y = input[i] + 0.5 * y;
+                REQUIRE(circ.readOutput(0, i) == Approx(2 * y));
+            }
+        }
+    }
+
+    SECTION("Units in the same layer can run concurrently") {
+        const int bufSize = 32;
+        syn::Circuit serial("wide");
+        serial.setBufferSize(bufSize);
+        int noteId = serial.addUnit(new syn::MidiNoteUnit("note"));
+        int sumId = serial.addUnit(new syn::SummerUnit("sum"));
+        for (int i = 0; i < 7; i++) {
+            int oscId = serial.addUnit(new syn::BasicOscillatorUnit("osc"));
+            serial.getUnit(oscId).param(syn::TunedOscillatorUnit::pTune).set(0.1 * i);
+            serial.connectInternal(noteId, 0, oscId, syn::BasicOscillatorUnit::iNote);
+            serial.connectInternal(oscId, 0, sumId, i);
+        }
+        // A feedback loop sharing a layer with a plain filter
+        int lpId = serial.addUnit(new syn::OnePoleLPUnit("lp"));
+        int fbSumId = serial.addUnit(new syn::SummerUnit("fbsum"));
+        int fbGainId = serial.addUnit(new syn::GainUnit("fbgain"));
+        serial.getUnit(fbGainId).param(0).set(-0.25);
+        serial.connectInternal(sumId, 0, lpId, 0);
+        serial.connectInternal(sumId, 0, fbSumId, 0);
+        serial.connectInternal(fbSumId, 0, fbGainId, 0);
+        serial.connectInternal(fbGainId, 0, fbSumId, 1);
+        serial.connectInternal(lpId, 0, serial.getOutputUnitId(), 0);
+        serial.connectInternal(fbSumId, 0, serial.getOutputUnitId(), 1);
+
+        syn::WorkerPool pool(4);
+        syn::Circuit parallel(serial);
+        parallel.setWorkerPool(&pool);
+        auto plan = parallel.plan();
+        REQUIRE(!plan->waves.empty());
+        REQUIRE(plan->loops.size() == 1);
+        auto oscWave = std::find_if(plan->waves.begin(), plan->waves.end(), [](auto& w) { return w.end - w.begin >= 7; });
+        REQUIRE(oscWave != plan->waves.end());
+        for (const auto& loop : plan->loops) {
+            auto wave = std::find_if(plan->waves.begin(), plan->waves.end(), [&loop](auto& w) { return w.begin <= loop.begin && loop.begin < w.end; });
+            REQUIRE(wave != plan->waves.end());
+            REQUIRE(loop.end <= wave->end);
+        }
+
+        serial.noteOn(60, 127);
+        parallel.noteOn(60, 127);
+        for (int block = 0; block < 4; block++) {
+            serial.tick();
+            parallel.tick();
+            for (int i = 0; i < bufSize; i++) {
+                REQUIRE(parallel.readOutput(0, i) == serial.readOutput(0, i));
+                REQUIRE(parallel.readOutput(1, i) == serial.readOutput(1, i));
+            }
+        }
+    }
+
+    SECTION("Circuits stamped from a blueprint match their source") {
+        const int bufSize = 32;
+        syn::Circuit source("source");
+        source.setFs(48e3);
+        source.setBufferSize(bufSize);
+        int noteId = source.addUnit(new syn::MidiNoteUnit("note"));
+        int oscId = source.addUnit(new syn::BasicOscillatorUnit("osc"));
+        int envId = source.addUnit(new syn::ADSREnvelope("env"));
+        int gainId = source.addUnit(new syn::GainUnit("gain"));
+        int fbSumId = source.addUnit(new syn::SummerUnit("fbsum"));
+        int fbGainId = source.addUnit(new syn::GainUnit("fbgain"));
+        // Parameters are copied exactly, not rounded to their display precision
+        source.getUnit(envId).param(syn::ADSREnvelope::pSustain).set(0.707);
+        // Along with ranges changed after construction
+        source.getUnit(envId).param(syn::ADSREnvelope::pSustain).setMin(0.5);
+        source.getUnit(fbGainId).param(0).set(-0.25);
+        source.connectInternal(noteId, 0, oscId, syn::BasicOscillatorUnit::iNote);
+        source.connectInternal(oscId, 0, gainId, 0);
+        source.connectInternal(envId, 0, gainId, 1);
+        source.connectInternal(gainId, 0, fbSumId, 0);
+        source.connectInternal(fbSumId, 0, fbGainId, 0);
+        source.connectInternal(fbGainId, 0, fbSumId, 1);
+        source.connectInternal(fbSumId, 0, source.getOutputUnitId(), 0);
+
+        const syn::CircuitBlueprint blueprint(source);
+        std::vector<syn::Circuit> stamped(6);
+        // Stamping replaces whatever the target held before
+        stamped[0].addUnit(new syn::GainUnit("stale"));
+        syn::WorkerPool pool(4);
+        blueprint.stamp(stamped.data(), int(stamped.size()), &pool);
+
+        syn::Circuit reference(source);
+        reference.noteOn(60, 127);
+        for (auto& circuit : stamped) {
+            REQUIRE(circuit.getNumUnits() == source.getNumUnits());
+            REQUIRE(circuit.getConnections().size() == source.getConnections().size());
+            REQUIRE(circuit.plan() == blueprint.circuit().plan());
+            REQUIRE(circuit.getUnit(envId).param(syn::ADSREnvelope::pSustain).getDouble() == 0.707);
+            REQUIRE(circuit.getUnit(envId).param(syn::ADSREnvelope::pSustain).getMin() == 0.5);
+            REQUIRE(circuit.getUnit(envId).param(syn::ADSREnvelope::pSustain).getNorm() ==
+                source.getUnit(envId).param(syn::ADSREnvelope::pSustain).getNorm());
+            circuit.noteOn(60, 127);
+        }
+        for (int block = 0; block < 4; block++) {
+            reference.tick();
+            for (auto& circuit : stamped) {
+                circuit.tick();
+                for (int i = 0; i < bufSize; i++)
+                    REQUIRE(circuit.readOutput(0, i) == reference.readOutput(0, i));
+            }
+        }
+    }
+
+    SECTION("Copies lay their units and buffers out contiguously") {
+        syn::Circuit source("source");
+        source.setBufferSize(13);
+        int prevId = source.addUnit(new syn::MidiNoteUnit("note"));
+        for (int i = 0; i < 8; i++) {
+            int oscId = source.addUnit(new syn::BasicOscillatorUnit("osc"));
+            int gainId = source.addUnit(new syn::GainUnit("gain"));
+            source.connectInternal(prevId, 0, oscId, syn::BasicOscillatorUnit::iNote);
+            source.connectInternal(oscId, 0, gainId, 0);
+            prevId = gainId;
+        }
+        source.connectInternal(prevId, 0, source.getOutputUnitId(), 0);
+
+        syn::Circuit copy(source);
+        const syn::Unit* prevUnit = nullptr;
+        for (const syn::Unit* unit : copy.execOrder()) {
+            if (!unit || unit == &copy.getUnit(copy.getInputUnitId()) || unit == &copy.getUnit(copy.getOutputUnitId()))
+                continue;
+            // Units follow one another in the order they are processed in, each on its own cache line
+            REQUIRE(reinterpret_cast<size_t>(unit) % syn::CACHE_LINE_SIZE == 0);
+            if (prevUnit)
+                REQUIRE(unit > prevUnit);
+            prevUnit = unit;
+        }
+        REQUIRE(prevUnit != nullptr);
+        // The shared output buffers follow the last unit in the same block, each starting on a cache line
+        size_t firstBuf = SIZE_MAX;
+        for (const syn::Unit* unit : copy.execOrder()) {
+            if (!unit || unit == &copy.getUnit(copy.getInputUnitId()) || unit == &copy.getUnit(copy.getOutputUnitId()))
+                continue;
+            for (int j = 0; j < unit->numOutputs(); j++) {
+                const size_t buf = reinterpret_cast<size_t>(unit->outputs().getByIndex(j).buf());
+                REQUIRE(buf % syn::CACHE_LINE_SIZE == 0);
+                firstBuf = std::min(firstBuf, buf);
+            }
+        }
+        REQUIRE(firstBuf == reinterpret_cast<size_t>(prevUnit) + syn::cacheAlignedSize(sizeof(syn::GainUnit)));
+
+        // Removing units from the copy frees nothing that other units rely on
+        copy.removeUnit(prevId);
+        copy.tick();
+    }
+
     SECTION("Linearization") {
         syn::DirectedProcGraph<int> pg;
         pg.connect(0, 1);
@@ -174,11 +563,73 @@ TEST_CASE("Measure error for rational approximation of tanh", "[fast_tanh]") {
     }
 }
 
+/**
+ * Largest error of both the scalar and the array version of a fast math function against a reference, over [a, b].
+ */
+template<typename T, typename Scalar, typename Array, typename Ref>
+static double measure_fast_math_error(Scalar a_scalar, Array a_array, Ref a_ref, double a, double b, bool a_relative) {
+    const int N = 20001; // not a multiple of any SIMD width, so the scalar remainder is covered too
+    std::vector<T> in(N), out(N);
+    for (int i = 0; i < N; i++)
+        in[i] = static_cast<T>(a + i * (b - a) / (N - 1));
+    a_array(in.data(), out.data(), N);
+    double max_error = 0;
+    for (int i = 0; i < N; i++) {
+        const double expected = a_ref(static_cast<double>(in[i]));
+        const double scale = a_relative && expected != 0 ? std::abs(expected) : 1.0;
+        max_error = std::max(max_error, std::abs(out[i] - expected) / scale);
+        max_error = std::max(max_error, std::abs(a_scalar(in[i]) - expected) / scale);
+    }
+    return max_error;
+}
+
+#define FAST_MATH_ERROR(T, FUNC, REF, A, B, RELATIVE) measure_fast_math_error<T>([](T x) { return syn::FUNC(x); }, \
+    [](const T* in, T* out, int n) { syn::FUNC(in, out, n); }, REF, A, B, RELATIVE)
+
+TEST_CASE("Measure error of the fast math approximations", "[FastMath]") {
+    INFO("Instruction set: " << syn::fastMathInstructionSet());
+    SECTION("fast_wrap") {
+        auto ref = [](double x) { return x - std::floor(x); };
+        REQUIRE(FAST_MATH_ERROR(double, fast_wrap, ref, -1000.0, 1000.0, false) < 1e-12);
+        REQUIRE(FAST_MATH_ERROR(float, fast_wrap, ref, -1000.0, 1000.0, false) < 1e-4);
+        REQUIRE(syn::fast_wrap(-1e-20) < 1.0);
+        REQUIRE(syn::fast_wrap(3.0) == 0.0);
+        REQUIRE(syn::fast_wrap2(7.5, -1.0, 1.0) == Approx(-0.5));
+    }
+    SECTION("fast_exp2") {
+        auto ref = [](double x) { return std::exp2(x); };
+        REQUIRE(FAST_MATH_ERROR(double, fast_exp2, ref, -1022.0, 1023.0, true) < 1e-12);
+        REQUIRE(FAST_MATH_ERROR(float, fast_exp2, ref, -126.0, 127.0, true) < 3e-7);
+    }
+    SECTION("fast_log2") {
+        auto ref = [](double x) { return std::log2(x); };
+        REQUIRE(FAST_MATH_ERROR(double, fast_log2, ref, 1e-6, 1e6, false) < 3e-12);
+        REQUIRE(FAST_MATH_ERROR(float, fast_log2, ref, 0.5, 2.0, false) < 3e-7);
+        REQUIRE(FAST_MATH_ERROR(float, fast_log2, ref, 1e-6, 1e6, false) < 3e-7 + 2e-6);
+    }
+    SECTION("fast_tan") {
+        auto ref = [](double x) { return std::tan(x); };
+        REQUIRE(FAST_MATH_ERROR(double, fast_tan, ref, -1.5707, 1.5707, true) < 1e-11);
+        REQUIRE(FAST_MATH_ERROR(float, fast_tan, ref, -1.5707, 1.5707, true) < 1e-6);
+    }
+    SECTION("fast_tanh") {
+        auto ref = [](double x) { return std::tanh(x); };
+        REQUIRE(FAST_MATH_ERROR(double, fast_tanh, ref, -30.0, 30.0, true) < 1e-11);
+        REQUIRE(FAST_MATH_ERROR(float, fast_tanh, ref, -30.0, 30.0, true) < 2e-6);
+        REQUIRE(FAST_MATH_ERROR(double, fast_tanh, ref, -0.1, 0.1, true) < 1e-11);
+    }
+    SECTION("fast_pitchToFreq") {
+        auto ref = [](double x) { return syn::naive_pitchToFreq(x); };
+        REQUIRE(FAST_MATH_ERROR(double, fast_pitchToFreq, ref, -1000.0, 1000.0, true) < 1e-12);
+        REQUIRE(FAST_MATH_ERROR(float, fast_pitchToFreq, ref, -20.0, 160.0, true) < 1e-6);
+    }
+}
+
 TEST_CASE("Check that units are ticked correctly", "[Unit]") {
     SECTION("1-sample buffer solo unit") {
         syn::MemoryUnit mu("mu0");
-        double input = 1.0;
-        mu.connectInput(0, syn::ReadOnlyBuffer<double>{&input});
+        syn::SampleType input = 1.0;
+        mu.connectInput(0, syn::ReadOnlyBuffer<syn::SampleType>{&input});
         mu.tick();
         double out1 = mu.readOutput(0, 0);
         mu.tick();
@@ -189,7 +640,7 @@ TEST_CASE("Check that units are ticked correctly", "[Unit]") {
 
     SECTION("10-sample buffer solo unit") {
         syn::MemoryUnit mu("mu0");
-        typedef Eigen::Array<double, -1, -1, Eigen::RowMajor> io_type;
+        typedef syn::Unit::dynamic_buffer_t io_type;
         io_type inputs(1, 10);
         io_type outputs(1, 10);
         for (int i = 0; i < 10; i++) {
@@ -210,7 +661,7 @@ TEST_CASE("Check that units are ticked correctly", "[Unit]") {
 
     SECTION("10-sample buffer circuit") {
         const int bufSize = 10;
-        Eigen::Array<double, 1, bufSize, Eigen::RowMajor> inputs;
+        Eigen::Array<syn::SampleType, 1, bufSize, Eigen::RowMajor> inputs;
         for (int i = 0; i < 10; i++) {
             inputs(0, i) = i;
         }
@@ -218,25 +669,741 @@ TEST_CASE("Check that units are ticked correctly", "[Unit]") {
         syn::Circuit circ;
         circ.setBufferSize(bufSize);
         int circ_svf_id = circ.addUnit(new syn::StateVariableFilter("circ_svf"));
-        circ.connectInput(0, syn::ReadOnlyBuffer<double>{&inputs(0, 0)});
+        circ.connectInput(0, syn::ReadOnlyBuffer<syn::SampleType>{&inputs(0, 0)});
         circ.connectInternal(circ.getInputUnitId(), 0, circ_svf_id, 0);
         circ.connectInternal(circ_svf_id, 0, circ.getOutputUnitId(), 0);
         circ.tick();
-        Eigen::Array<double, 1, bufSize, Eigen::RowMajor> circ_output;
+        Eigen::Array<syn::SampleType, 1, bufSize, Eigen::RowMajor> circ_output;
         std::copy(circ.output(0).buf(), circ.output(0).buf() + bufSize, &circ_output(0, 0));
 
         syn::StateVariableFilter svf;
         svf.setBufferSize(bufSize);
         REQUIRE(svf.inputName(0) == "in");
-        Eigen::Array<double, -1, -1, Eigen::RowMajor> outputs(4, bufSize);
+        syn::Unit::dynamic_buffer_t outputs(4, bufSize);
         svf.tick(inputs, outputs);
         for (int i = 0; i<bufSize; i++)
-            REQUIRE(outputs(0, i) == circ_output(0, i));        
+            REQUIRE(outputs(0, i) == circ_output(0, i));
+    }
+
+    SECTION("Block spans match sample-by-sample processing") {
+        const int bufSize = 16;
+        syn::Unit::dynamic_buffer_t inputs(5, bufSize);
+        inputs.setZero();
+        for (int i = 0; i < bufSize; i++) {
+            inputs(0, i) = (i % 4) - 1.5;
+            inputs(2, i) = 0.25; // fc[x]
+        }
+
+        syn::LadderFilterB blockLadder("block");
+        syn::Unit::dynamic_buffer_t blockOutputs(1, bufSize);
+        blockLadder.tick(inputs, blockOutputs);
+
+        syn::LadderFilterB sampleLadder("sample");
+        syn::Unit::dynamic_buffer_t sampleInput(5, 1), sampleOutput(1, 1);
+        for (int i = 0; i < bufSize; i++) {
+            sampleInput = inputs.col(i);
+            sampleLadder.tick(sampleInput, sampleOutput);
+            REQUIRE(sampleOutput(0, 0) == blockOutputs(0, i));
+        }
+
+        // Unconnected inputs read their default value
+        syn::GainUnit gain("gain");
+        gain.setBufferSize(bufSize);
+        gain.param(0).set(0.5);
+        syn::SampleType twos[bufSize];
+        std::fill_n(twos, bufSize, 2.0);
+        syn::ReadOnlyBuffer<syn::SampleType> src{twos};
+        gain.connectInput(1, src);
+        gain.tick();
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(gain.readOutput(0, i) == 1.0);
+
+        // The LFO reads its gain and frequency multipliers every sample, and both default to 1
+        syn::LFOOscillatorUnit lfo("lfo");
+        lfo.setFs(48e3);
+        lfo.setBufferSize(bufSize);
+        lfo.param(syn::LFOOscillatorUnit::pFreq).set(1000.0);
+        std::unique_ptr<syn::Unit> explicitLfo(lfo.clone());
+        syn::SampleType ones[bufSize];
+        std::fill_n(ones, bufSize, 1.0);
+        syn::ReadOnlyBuffer<syn::SampleType> onesSrc{ones};
+        explicitLfo->connectInput(syn::LFOOscillatorUnit::iGainMul, onesSrc);
+        explicitLfo->connectInput(syn::LFOOscillatorUnit::iFreqMul, onesSrc);
+        REQUIRE(!lfo.isInputConnected(syn::LFOOscillatorUnit::iGainMul));
+        REQUIRE(!lfo.isInputConnected(syn::LFOOscillatorUnit::iFreqMul));
+        lfo.tick();
+        explicitLfo->tick();
+        bool varies = false;
+        for (int i = 0; i < bufSize; i++) {
+            REQUIRE(lfo.readOutput(0, i) == explicitLfo->readOutput(0, i));
+            varies = varies || lfo.readOutput(0, i) != lfo.readOutput(0, 0);
+        }
+        REQUIRE(varies);
+    }
+
+    SECTION("Clones copy parameters exactly and process like their original") {
+        const int bufSize = 32;
+        syn::Unit::dynamic_buffer_t inputs(5, bufSize);
+        inputs.setZero();
+        for (int i = 0; i < bufSize; i++) {
+            inputs(0, i) = (i % 8) * 0.25 - 1.0;
+            inputs(2, i) = 0.3; // fc[x]
+        }
+
+        syn::LadderFilterB ladder("ladder");
+        ladder.setFs(96e3);
+        ladder.setBufferSize(bufSize);
+        ladder.param(syn::LadderFilterB::pMode).set(syn::LadderFilterB::ModeAdaa);
+        ladder.param(syn::LadderFilterB::pDrv).set(0.123456789);
+        std::unique_ptr<syn::Unit> clone(ladder.clone());
+        REQUIRE(clone->fs() == ladder.fs());
+        REQUIRE(clone->getBufferSize() == bufSize);
+        REQUIRE(clone->param(syn::LadderFilterB::pDrv).getDouble() == 0.123456789);
+
+        syn::Unit::dynamic_buffer_t outputs(1, bufSize), cloneOutputs(1, bufSize);
+        ladder.tick(inputs, outputs);
+        clone->tick(inputs, cloneOutputs);
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(cloneOutputs(0, i) == outputs(0, i));
+    }
+
+    SECTION("Constant and silent blocks are flagged") {
+        const int bufSize = 16;
+        syn::Circuit circ("flags");
+        circ.setBufferSize(bufSize);
+        int constId = circ.addUnit(new syn::ConstantUnit("const"));
+        int oscId = circ.addUnit(new syn::BasicOscillatorUnit("osc"));
+        int envId = circ.addUnit(new syn::ADSREnvelope("env"));
+        int mutedId = circ.addUnit(new syn::GainUnit("muted"));
+        int scaledId = circ.addUnit(new syn::GainUnit("scaled"));
+        circ.getUnit(constId).param(0).set(2.0);
+        circ.getUnit(scaledId).param(0).set(0.5);
+        circ.connectInternal(oscId, 0, mutedId, 0);
+        circ.connectInternal(envId, 0, mutedId, 1);
+        circ.connectInternal(constId, 0, scaledId, 0);
+        circ.connectInternal(mutedId, 0, circ.getOutputUnitId(), 0);
+        circ.connectInternal(scaledId, 0, circ.getOutputUnitId(), 1);
+        circ.tick();
+
+        // The envelope is off, so the product is silent, and the constant passes through the circuit's outputs
+        REQUIRE(circ.getUnit(envId).output(0).blockState() == syn::BlockSilent);
+        REQUIRE(circ.getUnit(oscId).output(0).blockState() == syn::BlockVarying);
+        REQUIRE(circ.output(0).blockState() == syn::BlockSilent);
+        REQUIRE(circ.output(1).blockState() == syn::BlockConstant);
+        for (int i = 0; i < bufSize; i++) {
+            REQUIRE(circ.readOutput(0, i) == 0.0);
+            REQUIRE(circ.readOutput(1, i) == 1.0);
+        }
+
+        // Once the envelope starts, the flags are cleared
+        circ.noteOn(60, 127);
+        circ.tick();
+        REQUIRE(circ.getUnit(envId).output(0).blockState() == syn::BlockVarying);
+        REQUIRE(circ.output(0).blockState() == syn::BlockVarying);
+        REQUIRE(circ.output(1).blockState() == syn::BlockConstant);
+
+        // A muted oscillator keeps its phase running
+        syn::BasicOscillatorUnit muted("muted"), reference("reference");
+        for (syn::BasicOscillatorUnit* osc : {&muted, &reference}) {
+            osc->setBufferSize(bufSize);
+            osc->noteOn(60, 127);
+        }
+        muted.param(syn::OscillatorUnit::pGain).set(0.0);
+        muted.tick();
+        reference.tick();
+        REQUIRE(muted.output(syn::OscillatorUnit::oOut).blockState() == syn::BlockSilent);
+        muted.param(syn::OscillatorUnit::pGain).set(1.0);
+        muted.tick();
+        reference.tick();
+        REQUIRE(muted.output(syn::OscillatorUnit::oOut).blockState() == syn::BlockVarying);
+        for (int i = 0; i < bufSize; i++) {
+            REQUIRE(muted.readOutput(syn::OscillatorUnit::oOut, i) == reference.readOutput(syn::OscillatorUnit::oOut, i));
+            REQUIRE(muted.readOutput(syn::OscillatorUnit::oPhase, i) == reference.readOutput(syn::OscillatorUnit::oPhase, i));
+        }
+    }
+
+    SECTION("Control-rate inputs interpolate coefficients") {
+        const int bufSize = 64;
+        const int nBlocks = 4;
+        syn::TrapStateVariableFilter tsvf("tsvf");
+        syn::OnePoleLPUnit lp("lp");
+        REQUIRE(tsvf.inputs()[syn::TrapStateVariableFilter::iFcMul].isControlRate());
+        REQUIRE(!tsvf.inputs()[syn::TrapStateVariableFilter::iAudioIn].isControlRate());
+        tsvf.param(syn::TrapStateVariableFilter::pRes).set(0.5);
+        lp.param(syn::OnePoleLPUnit::pFc).set(2000.0);
+
+        // Compares block processing against a copy of the unit ticked one sample at a time, with fc[x] either held
+        // for each block (and flagged as such) or swept across it
+        for (syn::Unit* proto : {static_cast<syn::Unit*>(&tsvf), static_cast<syn::Unit*>(&lp)}) {
+            for (bool sweep : {false, true}) {
+                std::unique_ptr<syn::Unit> block(proto->clone()), sample(proto->clone());
+                block->setBufferSize(bufSize);
+                syn::Unit::dynamic_buffer_t inputs(block->numInputs(), bufSize);
+                for (int i = 0; i < block->numInputs(); i++)
+                    inputs.row(i).setConstant(i == 2 || i == 4 ? 1.0 : 0.0); // fc[x] and res[x]
+                syn::ReadOnlyBuffer<syn::SampleType> audioSrc{&inputs(0, 0)}, fcMulSrc{&inputs(2, 0)};
+                fcMulSrc.setBlockState(sweep ? syn::BlockVarying : syn::BlockConstant);
+                block->connectInput(0, audioSrc);
+                block->connectInput(2, fcMulSrc);
+
+                syn::Unit::dynamic_buffer_t sampleInput(block->numInputs(), 1), sampleOutput(1, 1);
+                for (int b = 0; b < nBlocks; b++) {
+                    for (int i = 0; i < bufSize; i++) {
+                        const int t = b * bufSize + i;
+                        inputs(0, i) = (t % 20) / 10.0 - 1.0;
+                        inputs(2, i) = sweep ? 0.25 + t / 512.0 : 0.25 + b / 8.0;
+                    }
+                    block->tick();
+                    for (int i = 0; i < bufSize; i++) {
+                        sampleInput = inputs.col(i);
+                        sample->tick(sampleInput, sampleOutput);
+                        REQUIRE(block->readOutput(0, i) == Approx(sampleOutput(0, 0)).margin(sweep ? 1e-4 : 1e-12));
+                    }
+                }
+            }
+        }
+    }
+
+    SECTION("Zero-delay-feedback SVF stays tuned up to Nyquist") {
+        const int bufSize = 100;
+        const double fs = 44100.0, fc = 0.45 * fs;
+        syn::StateVariableFilter svf("svf");
+        svf.setFs(fs);
+        svf.setBufferSize(bufSize);
+        svf.param(syn::StateVariableFilter::pFc).set(fc);
+        svf.param(syn::StateVariableFilter::pRes).set(0.5);
+        syn::SampleType audio[bufSize];
+        syn::ReadOnlyBuffer<syn::SampleType> src{audio};
+        svf.connectInput(syn::StateVariableFilter::iAudioIn, src);
+
+        // A sine at the cutoff is scaled by Q on the low- and band-pass outputs and removed by the notch. Amplitudes
+        // are measured by correlation over a whole number of periods, after the filter has settled.
+        const int nSettle = 20, nMeasure = 9;
+        const int outputs[] = {syn::StateVariableFilter::oLP, syn::StateVariableFilter::oBP, syn::StateVariableFilter::oN};
+        double re[3] = {0, 0, 0}, im[3] = {0, 0, 0};
+        for (int b = 0; b < nSettle + nMeasure; b++) {
+            for (int i = 0; i < bufSize; i++)
+                audio[i] = std::sin(2 * SYN_PI * fc * (b * bufSize + i) / fs);
+            svf.tick();
+            for (int o = 0; b >= nSettle && o < 3; o++) {
+                for (int i = 0; i < bufSize; i++) {
+                    const double phase = 2 * SYN_PI * fc * (b * bufSize + i) / fs;
+                    re[o] += svf.readOutput(outputs[o], i) * std::cos(phase);
+                    im[o] += svf.readOutput(outputs[o], i) * std::sin(phase);
+                }
+            }
+        }
+        const double Q = 5.5;
+        for (int o = 0; o < 3; o++) {
+            const double amplitude = 2 * std::sqrt(re[o] * re[o] + im[o] * im[o]) / (nMeasure * bufSize);
+            REQUIRE(amplitude == Approx(o < 2 ? Q : 0.0).margin(1e-3 * Q));
+        }
+    }
+}
+
+TEST_CASE("Check that voices render identically on any number of threads", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int svfId = proto.addUnit(new syn::StateVariableFilter("svf"));
+    proto.connectInternal(oscId, 0, svfId, 0);
+    proto.connectInternal(svfId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(oscId, 0, proto.getOutputUnitId(), 1);
+
+    const int bufSize = 64;
+    const int nBlocks = 8;
+    std::vector<syn::SampleType> inputs(bufSize, 0.0);
+    std::vector<syn::SampleType> expected[2], actual[2], left(bufSize), right(bufSize);
+    for (int nThreads : {1, 4}) {
+        syn::VoiceManager vm;
+        vm.setNumThreads(nThreads);
+        REQUIRE(vm.getNumThreads() == nThreads);
+        vm.setPrototypeCircuit(proto);
+        vm.setFs(48e3);
+        vm.setMaxVoices(8);
+        vm.setBufferSize(bufSize);
+        vm.setInternalBufferSize(16);
+        for (int note = 60; note < 66; note++)
+            vm.noteOn(note, 127);
+
+        std::vector<syn::SampleType>* out = nThreads == 1 ? expected : actual;
+        for (int block = 0; block < nBlocks; block++) {
+            vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+            out[0].insert(out[0].end(), left.begin(), left.end());
+            out[1].insert(out[1].end(), right.begin(), right.end());
+        }
+    }
+    REQUIRE(expected[0] == actual[0]);
+    REQUIRE(expected[1] == actual[1]);
+    REQUIRE(std::any_of(expected[0].begin(), expected[0].end(), [](double x) { return x != 0.0; }));
+}
+
+TEST_CASE("Check that voice lanes match per-voice processing", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int noteId = proto.addUnit(new syn::MidiNoteUnit("note"));
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int svfId = proto.addUnit(new syn::StateVariableFilter("svf"));
+    int tsvfId = proto.addUnit(new syn::TrapStateVariableFilter("tsvf"));
+    int ladderAId = proto.addUnit(new syn::LadderFilterA("ladderA"));
+    int ladderBId = proto.addUnit(new syn::LadderFilterB("ladderB"));
+    int lpId = proto.addUnit(new syn::OnePoleLPUnit("lp"));
+    int dcId = proto.addUnit(new syn::DCRemoverUnit("dc"));
+    int envId = proto.addUnit(new syn::ADSREnvelope("env"));
+    int gainId = proto.addUnit(new syn::GainUnit("gain"));
+    proto.getUnit(svfId).setParam(syn::StateVariableFilter::pRes, 0.7);
+    proto.getUnit(svfId).setParam(syn::StateVariableFilter::pMode, syn::StateVariableFilter::ModeChamberlin);
+    proto.getUnit(ladderAId).setParam(syn::LadderFilterA::pFb, 0.5);
+    proto.getUnit(ladderBId).setParam(syn::LadderFilterB::pMode, syn::LadderFilterB::ModeAdaa);
+    proto.getUnit(ladderBId).setParam(syn::LadderFilterB::pDrv, 0.5);
+    proto.getUnit(lpId).setParam(syn::OnePoleLPUnit::pFc, 5000.0);
+    proto.getUnit(envId).setParam(syn::ADSREnvelope::pAtkTime, 0.001);
+    proto.connectInternal(noteId, 0, oscId, syn::BasicOscillatorUnit::iNote);
+    proto.connectInternal(oscId, 0, svfId, 0);
+    proto.connectInternal(svfId, 0, tsvfId, 0);
+    proto.connectInternal(tsvfId, 0, ladderAId, 0);
+    proto.connectInternal(ladderAId, 0, ladderBId, 0);
+    proto.connectInternal(ladderBId, 0, lpId, 0);
+    proto.connectInternal(lpId, 0, dcId, 0);
+    proto.connectInternal(dcId, 0, gainId, 0);
+    proto.connectInternal(envId, 0, gainId, 1);
+    // Varying control-rate inputs, so that the lanes interpolate their coefficients
+    proto.connectInternal(envId, 0, svfId, syn::StateVariableFilter::iFcMul);
+    proto.connectInternal(envId, 0, lpId, syn::OnePoleLPUnit::iFcMul);
+    proto.connectInternal(envId, 0, ladderAId, syn::LadderFilterA::iFcMul);
+    proto.connectInternal(envId, 0, ladderBId, syn::LadderFilterB::iFcMul);
+    proto.connectInternal(gainId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(svfId, syn::StateVariableFilter::oBP, proto.getOutputUnitId(), 1);
+
+    const int bufSize = 32;
+    const int nBlocks = 16;
+    std::vector<syn::SampleType> inputs(bufSize, 0.0);
+    std::vector<syn::SampleType> expected[2], actual[2], left(bufSize), right(bufSize);
+    for (int nLanes : {1, 4}) {
+        syn::VoiceManager vm;
+        vm.setNumLanes(nLanes);
+        REQUIRE(vm.getNumLanes() == nLanes);
+        vm.setPrototypeCircuit(proto);
+        vm.setFs(48e3);
+        vm.setMaxVoices(8);
+        vm.setBufferSize(bufSize);
+        vm.setInternalBufferSize(bufSize);
+        // Six voices make one full group of four lanes and one partial group
+        for (int note = 60; note < 66; note++)
+            vm.noteOn(note, 127);
+
+        std::vector<syn::SampleType>* out = nLanes == 1 ? expected : actual;
+        for (int block = 0; block < nBlocks; block++) {
+            if (block == nBlocks / 2)
+                vm.noteOff(62);
+            vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+            out[0].insert(out[0].end(), left.begin(), left.end());
+            out[1].insert(out[1].end(), right.begin(), right.end());
+        }
+    }
+    REQUIRE(std::any_of(expected[0].begin(), expected[0].end(), [](double x) { return x != 0.0; }));
+    for (int c = 0; c < 2; c++) {
+        for (size_t i = 0; i < expected[c].size(); i++)
+            REQUIRE(actual[c][i] == Approx(expected[c][i]).margin(1e-12));
+    }
+}
+
+TEST_CASE("Check voice allocation and stealing", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int envId = proto.addUnit(new syn::ADSREnvelope("env"));
+    proto.getUnit(envId).setParam(syn::ADSREnvelope::pRelTime, 0.01);
+    proto.connectInternal(envId, 0, proto.getOutputUnitId(), 0);
+
+    const int bufSize = 64;
+    std::vector<syn::SampleType> inputs(bufSize, 0.0), left(bufSize), right(bufSize);
+    syn::VoiceManager vm;
+    vm.setPrototypeCircuit(proto);
+    vm.setFs(48e3);
+    vm.setMaxVoices(MAX_VOICES);
+    REQUIRE(vm.getMaxVoices() == MAX_VOICES);
+    vm.setBufferSize(bufSize);
+
+    SECTION("Every voice can be held at once, and note offs find their voices") {
+        for (int i = 0; i < MAX_VOICES; i++)
+            vm.noteOn(i % 128, 127);
+        REQUIRE(vm.getNumActiveVoices() == MAX_VOICES);
+        REQUIRE(vm.getIdleVoiceIndices().empty());
+        vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+        vm.noteOff(5);
+        std::vector<int> released = vm.getReleasedVoiceIndices();
+        REQUIRE(released.size() == MAX_VOICES / 128);
+        for (int i : released)
+            REQUIRE(vm.getVoiceCircuit(i).note() == 5);
+
+        // Released voices go idle once their envelopes finish, and are reused first
+        for (int block = 0; block < 20; block++)
+            vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+        REQUIRE(vm.getNumActiveVoices() == MAX_VOICES - released.size());
+        REQUIRE(vm.getIdleVoiceIndices() == released);
+        vm.noteOn(100, 127);
+        REQUIRE(std::count(released.begin(), released.end(), vm.getNewestVoiceIndex()) == 1);
+    }
+
+    SECTION("Stealing follows the voice stealing policy") {
+        vm.setMaxVoices(4);
+        for (int note : {60, 72, 48, 67})
+            vm.noteOn(note, 127);
+        REQUIRE(vm.getVoiceCircuit(vm.getNewestVoiceIndex()).note() == 67);
+
+        vm.setVoiceStealPolicy(syn::VoiceManager::Lowest);
+        vm.noteOn(50, 127);
+        REQUIRE(vm.getNumActiveVoices() == 4);
+        std::vector<int> notes;
+        for (int i : vm.getActiveVoiceIndices())
+            notes.push_back(vm.getVoiceCircuit(i).note());
+        std::sort(notes.begin(), notes.end());
+        REQUIRE(notes == std::vector<int>({48, 50, 60, 67}));
+
+        vm.setVoiceStealPolicy(syn::VoiceManager::Highest);
+        vm.noteOn(80, 127);
+        notes.clear();
+        for (int i : vm.getActiveVoiceIndices())
+            notes.push_back(vm.getVoiceCircuit(i).note());
+        std::sort(notes.begin(), notes.end());
+        REQUIRE(notes == std::vector<int>({50, 60, 67, 80}));
+
+        // Released voices are stolen before held ones, oldest first
+        vm.setVoiceStealPolicy(syn::VoiceManager::Oldest);
+        vm.noteOff(80);
+        vm.noteOff(67);
+        vm.noteOn(90, 127);
+        notes.clear();
+        for (int i : vm.getActiveVoiceIndices())
+            notes.push_back(vm.getVoiceCircuit(i).note());
+        std::sort(notes.begin(), notes.end());
+        REQUIRE(notes == std::vector<int>({50, 60, 80, 90}));
+    }
+}
+
+TEST_CASE("Check that queued actions are never dropped", "[VoiceManager]") {
+    syn::VoiceManager vm;
+    vm.setMaxVoices(1);
+    std::vector<int> order;
+    const int nActions = MAX_VOICEMANAGER_MSG_QUEUE_SIZE + 100;
+    for (int i = 0; i < nActions; i++) {
+        auto f = [&order, i]() { order.push_back(i); };
+        vm.queueAction(f);
+    }
+    // A closure too large for a pool slot still goes through
+    std::array<double, 64> big{};
+    big[0] = nActions;
+    vm.queueAction([&order, big]() { order.push_back(int(big[0])); });
+    REQUIRE(vm.getPendingActionCount() == 101);
+    REQUIRE(vm.getActionOverflowCount() == 101);
+
+    std::vector<syn::SampleType> buf(1, 0.0);
+    vm.tick(buf.data(), buf.data(), buf.data(), buf.data());
+    REQUIRE(order.size() == MAX_VOICEMANAGER_MSG_QUEUE_SIZE);
+    REQUIRE(vm.getQueuedActionCount() == MAX_VOICEMANAGER_MSG_QUEUE_SIZE);
+
+    // Finished commands are handed back and the held back ones are sent when the gui thread queues more
+    vm.queueAction([&order]() { order.push_back(-1); });
+    REQUIRE(vm.getPendingActionCount() == 0);
+    vm.tick(buf.data(), buf.data(), buf.data(), buf.data());
+    REQUIRE(order.size() == nActions + 2);
+    for (int i = 0; i <= nActions; i++)
+        REQUIRE(order[i] == i);
+    REQUIRE(order.back() == -1);
+}
+
+TEST_CASE("Check that MIDI events take effect at their own sample", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int noteId = proto.addUnit(new syn::MidiNoteUnit("note"));
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int envId = proto.addUnit(new syn::ADSREnvelope("env"));
+    int gainId = proto.addUnit(new syn::GainUnit("gain"));
+    proto.getUnit(envId).setParam(syn::ADSREnvelope::pAtkTime, 0.001);
+    proto.getUnit(envId).setParam(syn::ADSREnvelope::pRelTime, 0.001);
+    proto.connectInternal(noteId, 0, oscId, syn::BasicOscillatorUnit::iNote);
+    proto.connectInternal(oscId, 0, gainId, 0);
+    proto.connectInternal(envId, 0, gainId, 1);
+    proto.connectInternal(gainId, 0, proto.getOutputUnitId(), 0);
+    proto.connectInternal(envId, 0, proto.getOutputUnitId(), 1);
+
+    const int bufSize = 64;
+    const int nBlocks = 8;
+    const std::vector<syn::MidiEvent> events = {
+        {5, syn::MidiEvent::NoteOn, 60, 127}, {37, syn::MidiEvent::NoteOn, 64, 100}, {37, syn::MidiEvent::NoteOn, 67, 90},
+        {130, syn::MidiEvent::PitchWheel, 0, 0.5}, {200, syn::MidiEvent::NoteOff, 60, 0}, {301, syn::MidiEvent::NoteOff, 64, 0},
+    };
+    std::vector<syn::SampleType> inputs(bufSize, 0.0);
+    std::vector<syn::SampleType> expected[2], actual[2], left(bufSize), right(bufSize);
+
+    // Reference: one sample per block, with each event applied before the block it falls on
+    syn::VoiceManager ref;
+    ref.setPrototypeCircuit(proto);
+    ref.setFs(48e3);
+    ref.setMaxVoices(8);
+    ref.setBufferSize(1);
+    ref.setInternalBufferSize(1);
+    size_t event = 0;
+    for (int sample = 0; sample < bufSize * nBlocks; sample++) {
+        for (; event < events.size() && events[event].offset == sample; event++) {
+            const syn::MidiEvent& e = events[event];
+            if (e.type == syn::MidiEvent::NoteOn) ref.noteOn(e.number, int(e.value));
+            else if (e.type == syn::MidiEvent::NoteOff) ref.noteOff(e.number);
+            else ref.sendPitchWheelChange(e.value);
+        }
+        ref.tick(inputs.data(), inputs.data(), left.data(), right.data());
+        expected[0].push_back(left[0]);
+        expected[1].push_back(right[0]);
+    }
+
+    for (int nLanes : {1, 4}) {
+        syn::VoiceManager vm;
+        vm.setNumLanes(nLanes);
+        vm.setPrototypeCircuit(proto);
+        vm.setFs(48e3);
+        vm.setMaxVoices(8);
+        vm.setBufferSize(bufSize);
+        vm.setInternalBufferSize(16);
+        actual[0].clear();
+        actual[1].clear();
+        for (int block = 0; block < nBlocks; block++) {
+            std::vector<syn::MidiEvent> blockEvents;
+            for (syn::MidiEvent e : events) {
+                if (e.offset / bufSize != block)
+                    continue;
+                e.offset -= block * bufSize;
+                blockEvents.push_back(e);
+            }
+            vm.tick(inputs.data(), inputs.data(), left.data(), right.data(), blockEvents.data(), int(blockEvents.size()));
+            actual[0].insert(actual[0].end(), left.begin(), left.end());
+            actual[1].insert(actual[1].end(), right.begin(), right.end());
+        }
+        REQUIRE(std::any_of(actual[0].begin(), actual[0].end(), [](double x) { return x != 0.0; }));
+        for (int c = 0; c < 2; c++) {
+            for (size_t i = 0; i < expected[c].size(); i++)
+                REQUIRE(actual[c][i] == Approx(expected[c][i]).margin(1e-9));
+        }
     }
 }
 
+TEST_CASE("Check that circuit edits keep playing voices running", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int noteId = proto.addUnit(new syn::MidiNoteUnit("note"));
+    int oscId = proto.addUnit(new syn::BasicOscillatorUnit("osc"));
+    int envId = proto.addUnit(new syn::ADSREnvelope("env"));
+    int gainId = proto.addUnit(new syn::GainUnit("gain"));
+    proto.connectInternal(noteId, 0, oscId, syn::BasicOscillatorUnit::iNote);
+    proto.connectInternal(oscId, 0, gainId, 0);
+    proto.connectInternal(envId, 0, gainId, 1);
+    proto.connectInternal(gainId, 0, proto.getOutputUnitId(), 0);
+
+    const int bufSize = 64;
+    std::vector<syn::SampleType> inputs(bufSize, 0.0), left(bufSize), right(bufSize), refLeft(bufSize), refRight(bufSize);
+    syn::VoiceManager vm, ref;
+    for (syn::VoiceManager* m : {&vm, &ref}) {
+        m->setPrototypeCircuit(proto);
+        m->setFs(48e3);
+        m->setMaxVoices(4);
+        m->setBufferSize(bufSize);
+        m->noteOn(60, 127);
+        for (int block = 0; block < 4; block++)
+            m->tick(inputs.data(), inputs.data(), left.data(), right.data());
+    }
+
+    // Add a unit and wire it up without touching the signal path
+    int newId = -1;
+    vm.editCircuit([&newId, envId](syn::Circuit& a_circuit) {
+        newId = a_circuit.addUnit(new syn::GainUnit("new gain"));
+        a_circuit.connectInternal(envId, 0, newId, 0);
+    });
+    REQUIRE(vm.getPrototypeCircuit().getNumUnits() == proto.getNumUnits() + 1);
+    REQUIRE(vm.getVoiceCircuit(0).getNumUnits() == proto.getNumUnits());
+    REQUIRE(vm.getPendingBuildCount() == 1);
+
+    // Actions queued after the edit may refer to the new unit
+    bool sawNewUnit = false;
+    vm.queueAction([&vm, &sawNewUnit, newId]() { sawNewUnit = vm.getVoiceCircuit(0).getUnits().containsId(newId); });
+    REQUIRE(vm.getActionOverflowCount() == 0);
+
+    vm.waitForBuilds();
+    REQUIRE(vm.getPendingBuildCount() == 0);
+    for (int block = 0; block < 4; block++) {
+        vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+        ref.tick(inputs.data(), inputs.data(), refLeft.data(), refRight.data());
+        REQUIRE(std::any_of(left.begin(), left.end(), [](double x) { return x != 0.0; }));
+        for (int i = 0; i < bufSize; i++)
+            REQUIRE(left[i] == refLeft[i]);
+    }
+    REQUIRE(sawNewUnit);
+    REQUIRE(vm.getNumActiveVoices() == 1);
+    REQUIRE(vm.getVoiceCircuit(0).getNumUnits() == proto.getNumUnits() + 1);
+
+    // Loading a patch starts over with idle voices
+    vm.loadCircuit(proto);
+    vm.queueMaxVoices(6);
+    vm.waitForBuilds();
+    vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+    REQUIRE(vm.getMaxVoices() == 6);
+    REQUIRE(vm.getNumActiveVoices() == 0);
+    REQUIRE(vm.getVoiceCircuit(5).getNumUnits() == proto.getNumUnits());
+}
+
+TEST_CASE("Check that rebuilt voices only take over the state of the same units", "[VoiceManager]") {
+    const int bufSize = 16;
+    syn::Circuit proto("proto");
+    proto.setBufferSize(bufSize);
+    int constId = proto.addUnit(new syn::ConstantUnit("const"));
+    int sumId = proto.addUnit(new syn::SummerUnit("sum"));
+    int gainId = proto.addUnit(new syn::GainUnit("gain"));
+    proto.getUnit(constId).param("out").set(1.0);
+    proto.connectInternal(constId, 0, sumId, 0);
+    proto.connectInternal(sumId, 0, gainId, 0);
+    proto.connectInternal(gainId, 0, proto.getOutputUnitId(), 0);
+
+    syn::Circuit voice(proto);
+    voice.tick();
+    REQUIRE(voice.getUnit(sumId).readOutput(0, bufSize - 1) == 1.0);
+    const syn::Unit* oldConst = &voice.getUnit(constId);
+    const syn::Unit* oldGain = &voice.getUnit(gainId);
+
+    // Feed the summer back into itself, and replace the gain with a new one that takes over its id
+    proto.connectInternal(sumId, 0, sumId, 1);
+    proto.removeUnit(gainId);
+    REQUIRE(proto.addUnit(new syn::GainUnit("gain")) == gainId);
+    proto.connectInternal(sumId, 0, gainId, 0);
+    proto.connectInternal(gainId, 0, proto.getOutputUnitId(), 0);
+
+    syn::Circuit rebuilt(proto);
+    rebuilt.adoptUnits(voice);
+    REQUIRE(&rebuilt.getUnit(constId) == oldConst);
+    REQUIRE(&rebuilt.getUnit(gainId) != oldGain);
+    REQUIRE(&voice.getUnit(gainId) == oldGain);
+    // The summer's output now carries state across blocks, and picks up from the last block it wrote elsewhere
+    REQUIRE(rebuilt.getUnit(sumId).readOutput(0, bufSize - 1) == 1.0);
+}
+
+TEST_CASE("Check that the real-time thread leaves the prototype circuit to the gui thread", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int ccId = proto.addUnit(new syn::MidiCCUnit("cc"));
+    proto.connectInternal(ccId, 0, proto.getOutputUnitId(), 0);
+
+    const int bufSize = 16;
+    std::vector<syn::SampleType> inputs(bufSize, 0.0), left(bufSize), right(bufSize);
+    syn::VoiceManager vm;
+    vm.setPrototypeCircuit(proto);
+    vm.setMaxVoices(2);
+    vm.setBufferSize(bufSize);
+    vm.setInternalBufferSize(bufSize);
+    // Learning is turned off in copies, so it is turned on in each of them
+    for (int i = -1; i < vm.getMaxVoices(); i++)
+        vm.getUnit(ccId, i).param("learn").set(true);
+
+    // MIDI and tempo changes reach the voices right away, and the prototype once the gui thread is idle
+    const syn::MidiEvent event{0, syn::MidiEvent::ControlChange, 7, 0.5};
+    vm.tick(inputs.data(), inputs.data(), left.data(), right.data(), &event, 1);
+    vm.setTempo(90);
+    REQUIRE(vm.getUnit(ccId, 1).param("CC").getInt() == 7);
+    REQUIRE(vm.getVoiceCircuit(1).tempo() == 90);
+    REQUIRE(vm.getUnit(ccId).param("CC").getInt() == 0);
+    REQUIRE(vm.getPrototypeCircuit().tempo() != 90);
+    vm.onIdle();
+    REQUIRE(vm.getUnit(ccId).param("CC").getInt() == 7);
+    REQUIRE(vm.getPrototypeCircuit().tempo() == 90);
+
+    // The internal buffer size of the voices is changed by swapping in voices built at the new size
+    vm.queueInternalBufferSize(4);
+    REQUIRE(vm.getInternalBufferSize() == 4);
+    REQUIRE(vm.getVoiceCircuit(0).getBufferSize() == bufSize);
+    vm.waitForBuilds();
+    vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+    REQUIRE(vm.getVoiceCircuit(0).getBufferSize() == 4);
+    REQUIRE(vm.getVoiceCircuit(1).getBufferSize() == 4);
+}
+
+TEST_CASE("Check that voices built for an old audio configuration are reconfigured off the real-time thread", "[VoiceManager]") {
+    syn::Circuit proto("proto");
+    int constId = proto.addUnit(new syn::ConstantUnit("const"));
+    proto.getUnit(constId).param("out").set(1.0);
+    proto.connectInternal(constId, 0, proto.getOutputUnitId(), 0);
+
+    const int bufSize = 32;
+    std::vector<syn::SampleType> inputs(bufSize, 0.0), left(bufSize), right(bufSize);
+    syn::VoiceManager vm;
+    vm.setPrototypeCircuit(proto);
+    vm.setFs(48e3);
+    vm.setMaxVoices(2);
+    vm.setBufferSize(bufSize / 2);
+    vm.setInternalBufferSize(bufSize / 2);
+
+    // The audio configuration changes after the new voices are sent, but before they are swapped in
+    int newId = -1;
+    vm.editCircuit([&newId](syn::Circuit& a_circuit) { newId = a_circuit.addUnit(new syn::GainUnit("gain")); });
+    vm.waitForBuilds();
+    int sawNewUnit = -1;
+    vm.queueAction([&vm, &sawNewUnit, newId]() { sawNewUnit = vm.getVoiceCircuit(0).getUnits().containsId(newId); });
+    vm.setFs(44.1e3);
+    vm.setBufferSize(bufSize);
+    vm.setInternalBufferSize(8);
+    vm.noteOn(60, 127);
+
+    // The voices go back to the builder thread, and the action that follows them waits until they are swapped in
+    vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+    REQUIRE(sawNewUnit == -1);
+    REQUIRE(!vm.getVoiceCircuit(0).getUnits().containsId(newId));
+    for (int i = 0; i < 500 && sawNewUnit == -1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+    }
+    REQUIRE(sawNewUnit == 1);
+    REQUIRE(vm.getNumActiveVoices() == 1);
+    for (int i = 0; i < vm.getMaxVoices(); i++) {
+        REQUIRE(vm.getVoiceCircuit(i).fs() == 44.1e3);
+        REQUIRE(vm.getVoiceCircuit(i).getBufferSize() == 8);
+    }
+    vm.tick(inputs.data(), inputs.data(), left.data(), right.data());
+    REQUIRE(left[bufSize - 1] != 0.0);
+}
+
+TEST_CASE("Check that the ladder filter's ADAA mode keeps aliasing down", "[LadderFilter]") {
+    // A sine on an exact DFT bin, so that its harmonics fall on multiples of that bin and everything else is aliasing
+    const int bufSize = 4410;
+    const int bin = 273;
+    const double fs = 44100.0;
+    std::vector<syn::SampleType> audio(bufSize);
+    syn::ReadOnlyBuffer<syn::SampleType> src{audio.data()};
+
+    double fundamental[2], aliasRatio[2];
+    for (int mode : {syn::LadderFilterB::ModeOversampled, syn::LadderFilterB::ModeAdaa}) {
+        syn::LadderFilterB ladder("ladder");
+        ladder.setFs(fs);
+        ladder.setBufferSize(bufSize);
+        ladder.param(syn::LadderFilterB::pMode).set(mode);
+        ladder.param(syn::LadderFilterB::pFc).set(5000.0);
+        ladder.param(syn::LadderFilterB::pFb).set(0.7);
+        ladder.param(syn::LadderFilterB::pDrv).set(1.0);
+        ladder.connectInput(syn::LadderFilterB::iAudioIn, src);
+        // The first block lets the filter settle
+        for (int b = 0; b < 2; b++) {
+            for (int i = 0; i < bufSize; i++)
+                audio[i] = std::sin(2 * SYN_PI * bin * (b * bufSize + i) / bufSize);
+            ladder.tick();
+        }
+
+        double harmonicPower = 0, aliasPower = 0;
+        for (int k = 1; k < bufSize / 2; k++) {
+            double re = 0, im = 0;
+            for (int i = 0; i < bufSize; i++) {
+                re += ladder.readOutput(0, i) * std::cos(2 * SYN_PI * k * i / bufSize);
+                im += ladder.readOutput(0, i) * std::sin(2 * SYN_PI * k * i / bufSize);
+            }
+            if (k == bin)
+                fundamental[mode] = 2 * std::sqrt(re * re + im * im) / bufSize;
+            (k % bin == 0 ? harmonicPower : aliasPower) += re * re + im * im;
+        }
+        aliasRatio[mode] = aliasPower / harmonicPower;
+    }
+    REQUIRE(fundamental[syn::LadderFilterB::ModeAdaa] == Approx(fundamental[syn::LadderFilterB::ModeOversampled]).epsilon(0.02));
+    REQUIRE(aliasRatio[syn::LadderFilterB::ModeAdaa] < aliasRatio[syn::LadderFilterB::ModeOversampled]);
+}
+
 TEST_CASE("Test resampler", "[Resample]") {
-    Eigen::Matrix<double, 128, 1> original_table = Eigen::Array<double, 128, 1>::LinSpaced(0, 2 * SYN_PI).sin();
+    Eigen::Matrix<syn::SampleType, 128, 1> original_table = Eigen::Array<syn::SampleType, 128, 1>::LinSpaced(0, 2 * SYN_PI).sin();
 
     Eigen::Matrix<double, 128, 1> identical_table;
     Eigen::Matrix<double, 250, 1> upsampled_table;
@@ -262,6 +1429,82 @@ TEST_CASE("Test resampler", "[Resample]") {
     std::cout << "downsampled=array(" << downsampled_table.format(listFmt) << ")" << std::endl;
 }
 
+TEST_CASE("Check that oversampled circuits resample their inputs and outputs", "[Oversampler]") {
+    SECTION("Halfband cascades pass the base band and reject images") {
+        const int n = 1024;
+        for (int factor : {2, 4, 8}) {
+            // Round trip of a tone in the base band
+            syn::Oversampler up(factor), down(factor);
+            std::vector<syn::SampleType> in(n), high(n * factor), out(n);
+            for (int i = 0; i < n; i++)
+                in[i] = std::sin(2 * SYN_PI * 0.05 * i);
+            up.upsample(in.data(), high.data(), n);
+            down.downsample(high.data(), out.data(), n);
+            const double latency = up.latency();
+            for (int i = 256; i < n; i++)
+                REQUIRE(out[i] == Approx(std::sin(2 * SYN_PI * 0.05 * (i - latency))).margin(1e-3));
+
+            // A tone above the base rate's Nyquist frequency must not alias back down
+            syn::Oversampler aliasDown(factor);
+            for (int i = 0; i < n * factor; i++)
+                high[i] = std::sin(2 * SYN_PI * 0.75 * i / factor);
+            aliasDown.downsample(high.data(), out.data(), n);
+            for (int i = 256; i < n; i++)
+                REQUIRE(std::abs(out[i]) < 1e-3);
+        }
+    }
+
+    SECTION("Oversampled sub-circuit") {
+        const int bufSize = 16;
+        const int nBlocks = 32;
+        syn::Circuit circ("main");
+        circ.setFs(48e3);
+        circ.setBufferSize(bufSize);
+        syn::Circuit* sub = new syn::Circuit("sub");
+        int gainId = sub->addUnit(new syn::GainUnit("gain"));
+        sub->connectInternal(sub->getInputUnitId(), 0, gainId, 0);
+        sub->connectInternal(gainId, 0, sub->getOutputUnitId(), 0);
+        int subId = circ.addUnit(sub);
+        circ.connectInternal(circ.getInputUnitId(), 0, subId, 0);
+        circ.connectInternal(subId, 0, circ.getOutputUnitId(), 0);
+
+        sub->setParam(syn::Circuit::pOversampling, 2);
+        REQUIRE(sub->getOversampling() == 4);
+        const syn::Unit& gain = sub->getUnit(gainId);
+        REQUIRE(gain.fs() == 4 * 48e3);
+        REQUIRE(gain.getBufferSize() == 4 * bufSize);
+
+        std::vector<syn::SampleType> in(bufSize);
+        syn::ReadOnlyBuffer<syn::SampleType> src{in.data()};
+        circ.connectInput(0, src);
+        const double latency = sub->getOversamplingLatency();
+        for (int block = 0; block < nBlocks; block++) {
+            for (int i = 0; i < bufSize; i++)
+                in[i] = std::sin(2 * SYN_PI * 0.02 * (block * bufSize + i));
+            circ.tick();
+            if (block < 8)
+                continue;
+            for (int i = 0; i < bufSize; i++)
+                REQUIRE(circ.readOutput(0, i) == Approx(std::sin(2 * SYN_PI * 0.02 * (block * bufSize + i - latency))).margin(1e-3));
+        }
+
+        // Copies keep the oversampling factor
+        syn::Circuit copy(circ);
+        REQUIRE(static_cast<const syn::Circuit&>(copy.getUnit(subId)).getOversampling() == 4);
+        REQUIRE(copy.getUnit(subId).fs() == 48e3);
+        REQUIRE(static_cast<const syn::Circuit&>(copy.getUnit(subId)).getUnit(gainId).getBufferSize() == 4 * bufSize);
+
+        // A rebuilt copy at another oversampling keeps its own units, which are set up for the new rate
+        sub->setParam(syn::Circuit::pOversampling, 1);
+        syn::Circuit rebuilt(circ);
+        const syn::Unit* oldGain = &static_cast<const syn::Circuit&>(copy.getUnit(subId)).getUnit(gainId);
+        rebuilt.adoptUnits(copy);
+        const syn::Unit& newGain = static_cast<const syn::Circuit&>(rebuilt.getUnit(subId)).getUnit(gainId);
+        REQUIRE(&newGain != oldGain);
+        REQUIRE(newGain.getBufferSize() == 2 * bufSize);
+    }
+}
+
 TEST_CASE("Check IntMap use cases", "[IntMap]") {
     syn::IntMap<int, 8> nc;
     std::array<int, 8> nc_vec{};
@@ -316,3 +1559,87 @@ TEST_CASE("Check IntMap use cases", "[IntMap]") {
         REQUIRE(i == nc.size());
     }
 }
+
+TEST_CASE("Check that the memory pool hands out disjoint, aligned blocks and merges them back", "[MemoryPool]") {
+    syn::MemoryPool pool(1 << 20);
+    const syn::MemoryPool::Stats empty = pool.stats();
+    REQUIRE(empty.numFreeBlocks == 1);
+    REQUIRE(empty.largestFreeBlock == empty.capacity);
+
+    SECTION("Random allocations") {
+        std::mt19937 rng(1234);
+        struct Allocation { unsigned char* ptr; size_t size; unsigned char fill; };
+        std::vector<Allocation> live;
+        for (int i = 0; i < 20000; i++) {
+            if (live.empty() || rng() % 3) {
+                const size_t size = 1 + rng() % (rng() % 8 ? 256 : 16384);
+                const size_t alignment = size_t(1) << (rng() % 9);
+                auto* ptr = static_cast<unsigned char*>(pool.allocate(size, alignment));
+                if (!ptr)
+                    continue;
+                REQUIRE(pool.owns(ptr));
+                REQUIRE(reinterpret_cast<size_t>(ptr) % std::max(alignment, syn::MemoryPool::MIN_ALIGNMENT) == 0);
+                const auto fill = static_cast<unsigned char>(i);
+                std::fill_n(ptr, size, fill);
+                live.push_back({ptr, size, fill});
+            } else {
+                // Any overlap with another allocation would have overwritten the fill pattern
+                const size_t index = rng() % live.size();
+                const Allocation a = live[index];
+                REQUIRE(std::all_of(a.ptr, a.ptr + a.size, [&a](unsigned char c) { return c == a.fill; }));
+                pool.free(a.ptr);
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        const syn::MemoryPool::Stats busy = pool.stats();
+        REQUIRE(busy.numAllocations == live.size());
+        REQUIRE(busy.peakBytesUsed >= busy.bytesUsed);
+        REQUIRE(busy.bytesUsed + busy.bytesFree <= busy.capacity);
+        REQUIRE(busy.fragmentation() >= 0.0);
+        REQUIRE(busy.fragmentation() < 1.0);
+
+        for (const Allocation& a : live)
+            pool.free(a.ptr);
+        const syn::MemoryPool::Stats done = pool.stats();
+        REQUIRE(done.numAllocations == 0);
+        REQUIRE(done.bytesUsed == 0);
+        REQUIRE(done.numFreeBlocks == 1);
+        REQUIRE(done.largestFreeBlock == done.capacity);
+        REQUIRE(done.fragmentation() == 0.0);
+    }
+
+    SECTION("Exhaustion") {
+        std::vector<void*> blocks;
+        while (void* ptr = pool.allocate(1000))
+            blocks.push_back(ptr);
+        REQUIRE(blocks.size() > 1000);
+        REQUIRE(pool.allocate(size_t(1) << 40) == nullptr);
+        REQUIRE(pool.stats().numFailedAllocations == 2);
+        REQUIRE(pool.stats().peakBytesUsed == pool.stats().bytesUsed);
+        pool.free(blocks.back());
+        REQUIRE(pool.allocate(1000) != nullptr);
+    }
+
+    SECTION("Delay lines grow while processing") {
+        syn::NSampleDelay delay;
+        delay.resizeBuffer(3);
+        REQUIRE(delay.process(1.0) == 0.0);
+        REQUIRE(delay.process(0.0) == 0.0);
+        REQUIRE(delay.process(0.0) == 0.0);
+        REQUIRE(delay.process(0.0) == 1.0);
+
+        const size_t usedBefore = syn::MemoryPool::realtime().stats().bytesUsed;
+        delay.resizeBuffer(100000);
+        REQUIRE(delay.size() == 100000);
+        // Less the 3 sample buffer, which was given back
+        REQUIRE(syn::MemoryPool::realtime().stats().bytesUsed >= usedBefore + 100000 * sizeof(double) - 2 * syn::MemoryPool::MIN_ALIGNMENT);
+
+        syn::NSampleDelay copy(delay);
+        copy.process(2.0);
+        int delayed = 1;
+        while (copy.process(0.0) == 0.0)
+            delayed++;
+        REQUIRE(delayed == 100000);
+    }
+}
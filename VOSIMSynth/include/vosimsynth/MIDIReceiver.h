@@ -3,24 +3,26 @@
 
 #include <IPlug/IPlug_include_in_plug_hdr.h>
 #include <IPlug/IMidiQueue.h>
+#include <vosimlib/VoiceManager.h>
+#include <vector>
 
 namespace syn {
 
-    class VoiceManager;
-
     /**
      * \brief Midi queue handler
+     *
+     * Collects the MIDI messages received during a block into a list of timestamped events, to be passed to
+     * VoiceManager::tick.
      */
     class MIDIReceiver
     {
     public:
-        explicit MIDIReceiver(VoiceManager& a_vm) 
-            : m_offset(0),
-              m_vm(a_vm) 
+        MIDIReceiver()
         {
             for (int i = 0; i < s_keyCount; i++) {
                 m_keyStatus[i] = false;
             }
+            m_events.reserve(s_maxEvents);
         };
 
         // Returns true if the key with a given index is currently pressed
@@ -28,7 +30,15 @@ namespace syn {
             return m_keyStatus[keyIndex];
         }
 
-        void advance();
+        /**
+         * Converts the queued messages that fall within the next \p nFrames samples into events, and removes
+         * them from the queue. At most s_maxEvents messages are converted, so that the event list never grows on
+         * the real-time thread. The rest stay queued, and take effect at the start of the next block.
+         * \returns The number of events, which can be read from MIDIReceiver::events.
+         */
+        int collectEvents(int nFrames);
+
+        const MidiEvent* events() const { return m_events.data(); }
 
         void onMessageReceived(IMidiMsg* midiMessage);
 
@@ -39,9 +49,9 @@ namespace syn {
     private:
         IMidiQueue m_midiQueue;
         static const int s_keyCount = 128;
+        static const int s_maxEvents = MAX_VOICEMANAGER_MSG_QUEUE_SIZE; ///< Capacity of m_events
         bool m_keyStatus[s_keyCount]; // array of on/off for each key (index is note number)
-        int m_offset;
-        VoiceManager& m_vm;
+        std::vector<MidiEvent> m_events;
     };
 }
 
@@ -52,6 +52,11 @@ private:
 
     int m_tempo;
     unsigned m_tickCount;
+
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    /// Single precision copies of the host's left/right inputs and outputs
+    std::vector<syn::SampleType> m_hostBuffers[4];
+#endif
 };
 
 #endif
@@ -83,6 +83,10 @@ namespace synui
         bool m_isDirty;
     private:
         virtual void _build();
+        /**
+         * Applies \p a_change to a parameter of the prototype unit and of every voice's copy of it.
+         */
+        void _changeParam(int a_paramId, const std::function<void(syn::UnitParameter&)>& a_change);
     };
 
     class UnitEditorHost : public nanogui::StackedWidget
@@ -251,18 +251,9 @@ void synui::CircuitWidget::createInputOutputUnits_() {
 
 void synui::CircuitWidget::createUnit(syn::UnitTypeId a_classId) {
     auto unit = syn::UnitFactory::instance().createUnit(a_classId);
-    auto f = [this, unit]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).addUnit(unit->clone());
-                }
-                int unitId = m_vm->getPrototypeCircuit().addUnit(unit);
-                // Queue return message
-                auto f = [this, unitId]() {
-                            _changeState(new cwstate::CreatingUnitState(unitId));
-                        };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
-            };
-    m_vm->queueAction(syn::MakeCommand(f));
+    int unitId = -1;
+    m_vm->editCircuit([unit, &unitId](syn::Circuit& a_circuit) { unitId = a_circuit.addUnit(unit); });
+    _changeState(new cwstate::CreatingUnitState(unitId));
 }
 
 synui::UnitWidget* synui::CircuitWidget::createUnitWidget(syn::UnitTypeId a_classId, int a_unitId) {
@@ -295,13 +286,7 @@ void synui::CircuitWidget::deleteUnit(int a_unitId) {
     deleteUnitWidget(m_unitWidgets[a_unitId]);
 
     // Delete the unit from the circuit
-    auto f = [this, a_unitId]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).removeUnit(a_unitId);
-                }
-                m_vm->getPrototypeCircuit().removeUnit(a_unitId);
-            };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->editCircuit([a_unitId](syn::Circuit& a_circuit) { a_circuit.removeUnit(a_unitId); });
 }
 
 void synui::CircuitWidget::deleteConnection(const Port& a_inputPort, const Port& a_outputPort) {
@@ -320,44 +305,22 @@ void synui::CircuitWidget::deleteConnection(const Port& a_inputPort, const Port&
     if (!foundWire)
         return;
 
-    // Send message to RT thread to delete the connection
-    auto f = [this, a_outputPort, a_inputPort]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    syn::Circuit& circuit = m_vm->getVoiceCircuit(i);
-                    circuit.disconnectInternal(a_outputPort.first, a_outputPort.second, a_inputPort.first, a_inputPort.second);
-                }
-                syn::Circuit& circuit = m_vm->getPrototypeCircuit();
-                circuit.disconnectInternal(a_outputPort.first, a_outputPort.second, a_inputPort.first, a_inputPort.second);
-                // Queue return message
-                auto f = [this, a_outputPort, a_inputPort]() {
-                            UnitWidget* fromWidget = m_unitWidgets[a_outputPort.first];
-                            UnitWidget* toWidget = m_unitWidgets[a_inputPort.first];
-                            updateUnitPos(fromWidget, fromWidget->position(), true);
-                            updateUnitPos(toWidget, toWidget->position(), true);
-                        };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
-            };
-    m_vm->queueAction(syn::MakeCommand(f));
+    // Delete the connection, the voices are rebuilt in the background
+    m_vm->editCircuit([a_outputPort, a_inputPort](syn::Circuit& a_circuit) {
+                a_circuit.disconnectInternal(a_outputPort.first, a_outputPort.second, a_inputPort.first, a_inputPort.second);
+            });
+    UnitWidget* fromWidget = m_unitWidgets[a_outputPort.first];
+    UnitWidget* toWidget = m_unitWidgets[a_inputPort.first];
+    updateUnitPos(fromWidget, fromWidget->position(), true);
+    updateUnitPos(toWidget, toWidget->position(), true);
 }
 
 void synui::CircuitWidget::createConnection(const Port& a_inputPort, const Port& a_outputPort) {
-    // send the new connection request to the real-time thread
-    auto f = [this, a_inputPort, a_outputPort]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    syn::Circuit& circuit = m_vm->getVoiceCircuit(i);
-                    circuit.connectInternal(a_outputPort.first, a_outputPort.second, a_inputPort.first, a_inputPort.second);
-                }
-                syn::Circuit& circuit = m_vm->getPrototypeCircuit();
-                circuit.connectInternal(a_outputPort.first, a_outputPort.second, a_inputPort.first, a_inputPort.second);
-
-                // Queue return message
-                auto f = [this, a_outputPort, a_inputPort]() {
-                            this->createWireWidget(a_inputPort, a_outputPort);
-                        };
-                m_window->queueExternalMessage(syn::MakeCommand(f));
-            };
-
-    m_vm->queueAction(syn::MakeCommand(f));
+    // Make the connection, the voices are rebuilt in the background
+    m_vm->editCircuit([a_inputPort, a_outputPort](syn::Circuit& a_circuit) {
+                a_circuit.connectInternal(a_outputPort.first, a_outputPort.second, a_inputPort.first, a_inputPort.second);
+            });
+    createWireWidget(a_inputPort, a_outputPort);
 }
 
 void synui::CircuitWidget::createWireWidget(const Port& a_inputPort, const Port& a_outputPort) {
@@ -482,10 +445,8 @@ void synui::CircuitWidget::deleteUnitWidget(UnitWidget* widget) {
 void synui::CircuitWidget::createJunction(std::shared_ptr<CircuitWire> a_toWire, std::shared_ptr<CircuitWire> a_fromWire, const Vector2i& a_pos, syn::UnitTypeId a_classId) {
     auto unit = syn::UnitFactory::instance().createUnit(a_classId);
     auto f = [this, unit, a_toWire, a_fromWire, a_pos]() {
-                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).addUnit(unit->clone());
-                }
-                int unitId = m_vm->getPrototypeCircuit().addUnit(unit);
+                int unitId = -1;
+                m_vm->editCircuit([unit, &unitId](syn::Circuit& a_circuit) { unitId = a_circuit.addUnit(unit); });
                 // Queue return message
                 auto f = [this, unit, unitId, a_toWire, a_fromWire, a_pos]() {
                             UnitWidget* uw = createUnitWidget(unit->getClassIdentifier(), unitId);
@@ -514,10 +475,8 @@ void synui::CircuitWidget::createJunction(std::shared_ptr<CircuitWire> a_toWire,
 void synui::CircuitWidget::spliceWire(std::shared_ptr<CircuitWire> a_wire, const Eigen::Vector2i& a_pos, syn::UnitTypeId a_classId) {
     auto unit = syn::UnitFactory::instance().createUnit(a_classId);
     auto f = [this, unit, a_wire, a_pos]() {
-        for (int i = 0; i < m_vm->getMaxVoices(); i++) {
-            m_vm->getVoiceCircuit(i).addUnit(unit->clone());
-        }
-        int unitId = m_vm->getPrototypeCircuit().addUnit(unit);
+        int unitId = -1;
+        m_vm->editCircuit([unit, &unitId](syn::Circuit& a_circuit) { unitId = a_circuit.addUnit(unit); });
         // Queue return message
         auto f = [this, unit, unitId, a_wire, a_pos]() {
             UnitWidget* uw = createUnitWidget(unit->getClassIdentifier(), unitId);
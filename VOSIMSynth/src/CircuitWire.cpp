@@ -23,7 +23,7 @@ std::string synui::CircuitWire::info() const {
     os << std::setprecision(4) << std::showpos << std::showpoint;
     for (int vind : activeVoiceIndices) {
         const syn::Unit& unit = m_parentCircuit->m_vm->getUnit(m_outputPort.first, vind);
-        double value = unit.readOutput(m_outputPort.second, 0);
+        double value = unit.readOutputSnapshot(m_outputPort.second);
         os << "Voice " << vind << ": " << std::setprecision(4) << std::showpos << value << std::endl;
     }
     return os.str();
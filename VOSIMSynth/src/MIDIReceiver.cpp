@@ -17,7 +17,6 @@ You should have received a copy of the GNU General Public License
 along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 */
 #include "vosimsynth/MIDIReceiver.h"
-#include <vosimlib/VoiceManager.h>
 #include <IPlug/IPlugStructs.h>
 
 namespace syn {
@@ -30,42 +29,52 @@ namespace syn {
 
     void MIDIReceiver::Flush(int nFrames) {
         m_midiQueue.Flush(nFrames);
-        m_offset = 0;
     }
 
     void MIDIReceiver::Resize(int blockSize) {
         m_midiQueue.Resize(blockSize);
     }
 
-    void MIDIReceiver::advance() {
-        while (!m_midiQueue.Empty()) {
+    int MIDIReceiver::collectEvents(int nFrames) {
+        m_events.clear();
+        while (!m_midiQueue.Empty() && int(m_events.size()) < s_maxEvents) {
             IMidiMsg* midiMessage = m_midiQueue.Peek();
-            if (midiMessage->mOffset > m_offset)
+            if (midiMessage->mOffset >= nFrames)
                 break;
 
+            MidiEvent event{midiMessage->mOffset};
             IMidiMsg::EStatusMsg status = midiMessage->StatusMsg();
             if (status == IMidiMsg::kNoteOff || status == IMidiMsg::kNoteOn) {
                 int noteNumber = midiMessage->NoteNumber();
                 int velocity = midiMessage->Velocity();
+                event.number = noteNumber;
                 if (status == IMidiMsg::kNoteOn && velocity > 0) {
                     if (!m_keyStatus[noteNumber]) {
                         m_keyStatus[noteNumber] = true;
-                        m_vm.noteOn(noteNumber, velocity);
+                        event.type = MidiEvent::NoteOn;
+                        event.value = velocity;
+                        m_events.push_back(event);
                     }
                 }
                 else {
                     m_keyStatus[noteNumber] = false;
-                    m_vm.noteOff(noteNumber);
+                    event.type = MidiEvent::NoteOff;
+                    m_events.push_back(event);
                 }
             }
             else if (status == IMidiMsg::kControlChange) {
-                m_vm.sendControlChange(midiMessage->ControlChangeIdx(), midiMessage->ControlChange(midiMessage->ControlChangeIdx()));
+                event.type = MidiEvent::ControlChange;
+                event.number = midiMessage->ControlChangeIdx();
+                event.value = midiMessage->ControlChange(midiMessage->ControlChangeIdx());
+                m_events.push_back(event);
             }
             else if (status == IMidiMsg::kPitchWheel) {
-                m_vm.sendPitchWheelChange(midiMessage->PitchWheel());
+                event.type = MidiEvent::PitchWheel;
+                event.value = midiMessage->PitchWheel();
+                m_events.push_back(event);
             }
             m_midiQueue.Remove();
         }
-        m_offset++;
+        return int(m_events.size());
     }
 }
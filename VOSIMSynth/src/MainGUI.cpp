@@ -141,21 +141,22 @@ void synui::MainGui::createSettingsEditor_(nanogui::Widget* a_widget) {
     helper->addGroup("Plugin Settings");
 
     helper->addSerializableVariable<int>("max_voices", "Max voices", [this, helper](const int& maxVoices) {
-        auto f = [this, maxVoices, helper]() {
-            m_vm->setMaxVoices(maxVoices);
+        // The new voices are built in the background, and the action runs once they have been swapped in
+        m_vm->queueMaxVoices(maxVoices);
+        auto f = [helper]() {
             helper->refresh();
         };
-        m_vm->queueAction(syn::MakeCommand(f));
+        m_vm->queueAction(f);
     }, [this]() {
         return m_vm->getMaxVoices();
     });
 
     helper->addVariable<int>("Internal buffer size", [this, helper](const int& size) {
-        auto f = [this, size, helper]() {
-            m_vm->setInternalBufferSize(size);
+        m_vm->queueInternalBufferSize(size);
+        auto f = [helper]() {
             helper->refresh();
         };
-        m_vm->queueAction(syn::MakeCommand(f));
+        m_vm->queueAction(f);
     }, [this]() {
         return m_vm->getInternalBufferSize();
     });
@@ -166,7 +167,7 @@ void synui::MainGui::createSettingsEditor_(nanogui::Widget* a_widget) {
             m_vm->setVoiceStealPolicy(policy);
             helper->refresh();
         };
-        m_vm->queueAction(syn::MakeCommand(f));
+        m_vm->queueAction(f);
     }, [this]() {
         return m_vm->getVoiceStealPolicy();
     })->setItems({ "Oldest", "Newest", "Highest", "Lowest" });
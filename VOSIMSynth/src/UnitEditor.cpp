@@ -213,46 +213,45 @@ void synui::UnitEditor::_build()
 
 void synui::UnitEditor::setParamValue(int a_paramId, double a_val)
 {
-    auto f = [this, a_paramId, a_val]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).set(a_val);
-                }
-                m_isDirty = true;
-            };
-    m_vm->queueAction(syn::MakeCommand(f));
+    _changeParam(a_paramId, [a_val](syn::UnitParameter& a_param) { a_param.set(a_val); });
 }
 
 void synui::UnitEditor::setParamNorm(int a_paramId, double a_normval)
 {
-    auto f = [this, a_paramId, a_normval]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).setNorm(a_normval);
-                }
-                m_isDirty = true;
-            };
-    m_vm->queueAction(syn::MakeCommand(f));
+    _changeParam(a_paramId, [a_normval](syn::UnitParameter& a_param) { a_param.setNorm(a_normval); });
 }
 
 void synui::UnitEditor::nudgeParam(int a_paramId, double a_logScale, double a_linScale)
 {
-    auto f = [this, a_paramId, a_logScale, a_linScale]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).nudge(a_logScale, a_linScale);
-                }
-                m_isDirty = true;
-            };
-    m_vm->queueAction(syn::MakeCommand(f));
+    _changeParam(a_paramId, [a_logScale, a_linScale](syn::UnitParameter& a_param) { a_param.nudge(a_logScale, a_linScale); });
 }
 
 void synui::UnitEditor::setParamFromString(int a_paramId, const string& a_str)
 {
-    auto f = [this, a_paramId, a_str]() {
-                for (int i = -1; i < m_vm->getMaxVoices(); i++) {
-                    m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId).setFromString(a_str);
+    _changeParam(a_paramId, [a_str](syn::UnitParameter& a_param) { a_param.setFromString(a_str); });
+}
+
+void synui::UnitEditor::_changeParam(int a_paramId, const std::function<void(syn::UnitParameter&)>& a_change)
+{
+    // Changing a circuit's oversampling reallocates its resamplers and internal buffers, so the voices are
+    // rebuilt off the real-time thread instead
+    if (a_paramId == syn::Circuit::pOversampling && dynamic_cast<syn::Circuit*>(&m_vm->getUnit(m_unitId))) {
+        int unitId = m_unitId;
+        m_vm->editCircuit([unitId, a_paramId, &a_change](syn::Circuit& a_circuit) {
+                    a_change(a_circuit.getUnit(unitId).param(a_paramId));
+                });
+        m_isDirty = true;
+        return;
+    }
+    // The prototype circuit belongs to the gui thread, and the voices to the real-time thread
+    a_change(m_vm->getUnit(m_unitId).param(a_paramId));
+    auto f = [this, a_paramId, a_change]() {
+                for (int i = 0; i < m_vm->getMaxVoices(); i++) {
+                    a_change(m_vm->getVoiceCircuit(i).getUnit(m_unitId).param(a_paramId));
                 }
                 m_isDirty = true;
             };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 void synui::UnitEditor::draw(NVGcontext* ctx)
@@ -26,13 +26,13 @@ const string& synui::UnitWidget::getName() const {
 
 void synui::UnitWidget::setName(const string& a_name) {
     m_name = a_name;
+    m_vm->getPrototypeCircuit().getUnit(m_unitId).setName(m_name);
     auto f = [this]() {
         for (int i = 0; i < m_vm->getMaxVoices(); i++) {
             m_vm->getVoiceCircuit(i).getUnit(m_unitId).setName(m_name);
         }
-        m_vm->getPrototypeCircuit().getUnit(m_unitId).setName(m_name);
     };
-    m_vm->queueAction(syn::MakeCommand(f));
+    m_vm->queueAction(f);
 }
 
 synui::UnitWidget::operator json() const {
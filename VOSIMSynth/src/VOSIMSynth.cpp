@@ -28,6 +28,7 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 #include <vosimlib/units/StateVariableFilter.h>
 #include <vosimlib/units/NoiseUnits.h>
 #include <vosimlib/UnitFactory.h>
+#include <vosimlib/CircuitFile.h>
 #include <vosimlib/tables.h>
 #include "vosimsynth/ChildWindow.h"
 #include "vosimsynth/MainGUI.h"
@@ -40,7 +41,6 @@ along with VOSIMProject. If not, see <http://www.gnu.org/licenses/>.
 VOSIMSynth::VOSIMSynth(IPlugInstanceInfo instanceInfo)
     : IPLUG_CTOR(0, 1, instanceInfo),
       m_voiceManager(),
-      m_MIDIReceiver(m_voiceManager),
       m_tempo(0),
       m_tickCount(0)
 {
@@ -69,9 +69,8 @@ void VOSIMSynth::makeInstrument() {
 void VOSIMSynth::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames) {
     // Mutex is already locked for us.
 
-    for (int s = 0; s < nFrames; s++) {
-        m_MIDIReceiver.advance();
-    }
+    // Events are applied at their own offsets within the block by VoiceManager::tick
+    const int nEvents = m_MIDIReceiver.collectEvents(nFrames);
 
     // If tempo has changed, notify instrument
     if (m_tempo != GetTempo()) {
@@ -80,7 +79,17 @@ void VOSIMSynth::ProcessDoubleReplacing(double** inputs, double** outputs, int n
     }
 
     // Process samples
-    m_voiceManager.tick(inputs[0], inputs[1], outputs[0], outputs[1]);
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    // The host works in double precision, so convert to and from the engine's sample type
+    std::copy_n(inputs[0], nFrames, m_hostBuffers[0].data());
+    std::copy_n(inputs[1], nFrames, m_hostBuffers[1].data());
+    m_voiceManager.tick(m_hostBuffers[0].data(), m_hostBuffers[1].data(), m_hostBuffers[2].data(), m_hostBuffers[3].data(),
+                        m_MIDIReceiver.events(), nEvents);
+    std::copy_n(m_hostBuffers[2].data(), nFrames, outputs[0]);
+    std::copy_n(m_hostBuffers[3].data(), nFrames, outputs[1]);
+#else
+    m_voiceManager.tick(inputs[0], inputs[1], outputs[0], outputs[1], m_MIDIReceiver.events(), nEvents);
+#endif
 
     m_MIDIReceiver.Flush(nFrames);
     m_tickCount++;
@@ -96,15 +105,19 @@ bool VOSIMSynth::SerializeState(ByteChunk* pChunk) {
     const syn::Circuit& circuit = m_voiceManager.getPrototypeCircuit();
     std::stringstream ss;
     json j;
-    // Store synthesizer data
+    // The circuit is stored in binary after the JSON (see syn::saveBinaryCircuit)
     json& synth = j["synth"] = json();
-    synth["circuit"] = circuit.operator json();
+    synth["circuit_format"] = syn::BINARY_CIRCUIT_VERSION;
 
     // Store gui data
     j["gui"] = GetAppWindow()->operator json();
 
     ss << j;
     pChunk->PutStr(ss.str().c_str());
+    const std::vector<char> circuitData = syn::saveBinaryCircuit(circuit);
+    const int circuitSize = static_cast<int>(circuitData.size());
+    pChunk->Put(&circuitSize);
+    pChunk->PutBytes(circuitData.data(), circuitSize);
     return true;
 }
 
@@ -122,21 +135,33 @@ int VOSIMSynth::UnserializeState(ByteChunk* pChunk, int startPos) {
         const json& synth = j["synth"];
         const json& gui = j["gui"];
 
-        syn::Unit* circuit = syn::Unit::fromJSON(synth["circuit"]);
+        syn::Unit* circuit;
+        if (synth.count("circuit")) {
+            // Saved before the binary format was introduced
+            circuit = syn::Unit::fromJSON(synth["circuit"]);
+            startPos += ss.gcount();
+        } else {
+            // Read the binary circuit in place
+            int circuitSize;
+            startPos = pChunk->Get(&circuitSize, startPos);
+            if (startPos < 0 || circuitSize < 0 || startPos + circuitSize > pChunk->Size())
+                throw std::runtime_error("Truncated circuit data.");
+            circuit = syn::loadBinaryCircuit(reinterpret_cast<const char*>(pChunk->GetBytes()) + startPos, circuitSize);
+            startPos += circuitSize;
+        }
         if (!circuit) {
             throw std::runtime_error("Error loading circuit.");
         }
 
         // Reset gui
         GetAppWindow()->reset();
-        // Load new circuit into voice manager
-        m_voiceManager.setPrototypeCircuit(*static_cast<const syn::Circuit*>(circuit));
+        // Load new circuit into voice manager. The voices are built in the background and swapped in by the audio thread.
+        m_voiceManager.loadCircuit(*static_cast<const syn::Circuit*>(circuit));
         // Inform new circuit of buffer size, sampling rate, etc...
         Reset();
         // Load gui
         GetAppWindow()->load(gui);
         m_voiceManager.onIdle();
-        startPos += ss.gcount();
         return startPos;
     } catch (const std::exception& e) {
         std::ostringstream alertmsg;
@@ -216,4 +241,8 @@ void VOSIMSynth::Reset() {
     m_MIDIReceiver.Resize(GetBlockSize());
     m_voiceManager.setBufferSize(GetBlockSize());
     m_voiceManager.setFs(GetSampleRate());
+#if defined(VOSIMLIB_SINGLE_PRECISION)
+    for (auto& buf : m_hostBuffers)
+        buf.assign(GetBlockSize(), 0);
+#endif
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "app_main.h"
 #include "vosimsynth/MainGui.h"
+#include <boost/lockfree/spsc_queue.hpp>
+#include <chrono>
 
 #ifdef OS_WIN
   #include <windows.h>
@@ -28,6 +30,15 @@ unsigned int gBufIndex = 0; // Loops 0 to SigVS
 unsigned int gVecElapsed = 0;
 double gFadeMult = 0.; // Fade multiplier
 
+// MIDI input, timestamped on arrival and handed to the plugin by the audio callback
+struct TimedMidiMsg
+{
+  double mTime; // seconds, see GetMidiTime()
+  IMidiMsg mMsg;
+};
+boost::lockfree::spsc_queue<TimedMidiMsg, boost::lockfree::capacity<1024>> gMidiInQueue;
+double gLastCallbackTime = 0.; // Time at which the previous audio callback started
+
 std::vector<unsigned int> gAudioInputDevs;
 std::vector<unsigned int> gAudioOutputDevs;
 std::vector<std::string> gMIDIInputDevNames;
@@ -234,6 +245,11 @@ bool MIDISettingsInStateAreEqual(AppState* os, AppState* ns)
   return true;
 }
 
+double GetMidiTime()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void MIDICallback( double deltatime, std::vector< unsigned char > *message, void* userData )
 {
   if ( message->size() )
@@ -261,18 +277,37 @@ void MIDICallback( double deltatime, std::vector< unsigned char > *message, void
     delete myMsg;
 
     // filter midi messages based on channel, if gStatus.mMidiInChan != all (0)
-    if (gState->mMidiInChan)
-    {
-      if (gState->mMidiInChan == msg.Channel() + 1 )
-        gPluginInstance->ProcessMidiMsg(&msg);
-    }
-    else
+    if (!gState->mMidiInChan || gState->mMidiInChan == msg.Channel() + 1)
     {
-      gPluginInstance->ProcessMidiMsg(&msg);
+      // the audio callback passes the message on to the plugin, at the sample matching its arrival time
+      TimedMidiMsg timedMsg = {GetMidiTime(), msg};
+      if (!gMidiInQueue.push(timedMsg))
+        DBGMSG("MIDI input queue is full, dropping message\n");
     }
   }
 }
 
+/*
+ Passes the MIDI messages that fall within the signal vector starting at frame `start` to the plugin. Messages
+ received during the previous audio callback are placed at the same relative position in this one, which
+ delays them by one callback but keeps their timing intact.
+*/
+void DispatchMidiInput(double callbackTime, unsigned int nFrames, unsigned int start)
+{
+  const double period = callbackTime - gLastCallbackTime;
+  while (gMidiInQueue.read_available())
+  {
+    TimedMidiMsg& timedMsg = gMidiInQueue.front();
+    int frame = period > 0. ? (int) ((timedMsg.mTime - gLastCallbackTime) / period * nFrames) : 0;
+    if (frame >= (int) (start + gSigVS))
+      break;
+    frame -= start;
+    timedMsg.mMsg.mOffset = frame < 0 ? 0 : frame;
+    gPluginInstance->ProcessMidiMsg(&timedMsg.mMsg);
+    gMidiInQueue.pop();
+  }
+}
+
 int AudioCallback(void* outputBuffer,
                   void* inputBuffer,
                   unsigned int nFrames,
@@ -285,6 +320,7 @@ int AudioCallback(void* outputBuffer,
 
   double* inputBufferD = (double*)inputBuffer;
   double* outputBufferD = (double*)outputBuffer;
+  const double callbackTime = GetMidiTime();
 
   int inRightOffset = 0;
 
@@ -302,6 +338,7 @@ int AudioCallback(void* outputBuffer,
         double* inputs[2] = {inputBufferD + i, inputBufferD + inRightOffset + i};
         double* outputs[2] = {outputBufferD + i, outputBufferD + nFrames + i};
 
+        DispatchMidiInput(callbackTime, nFrames, i);
         gPluginInstance->LockMutexAndProcessDoubleReplacing(inputs, outputs, gSigVS);
       }
 
@@ -323,9 +360,11 @@ int AudioCallback(void* outputBuffer,
   else
   {
     memset(outputBuffer, 0, nFrames * 2 * sizeof(double));
+    gMidiInQueue.consume_all([](const TimedMidiMsg&) {});
   }
 
   gVecElapsed++;
+  gLastCallbackTime = callbackTime;
 
   return 0;
 }